@@ -193,6 +193,7 @@ static void display(void *cookie)
 		config.warmup_loops = WARMUP_TIME;
 		config.histogram_size = need_histo() ? histogram_size : 0;
 		config.histogram_bucketsize = bucketsize;
+		config.histogram_type = RTTST_HISTOGRAM_LINEAR;
 		config.freeze_max = freeze_max;
 
 		ret = ioctl(devfd, RTTST_RTIOC_TMBENCH_START, &config);
@@ -70,6 +70,29 @@ struct RT_BUFFER_INFO {
 
 typedef struct RT_BUFFER_INFO RT_BUFFER_INFO;
 
+/**
+ * @brief Buffer span descriptor
+ * @anchor RT_BUFFER_SPAN
+ *
+ * This structure describes a region of the buffer memory handed out
+ * by rt_buffer_write_reserve() or rt_buffer_read_peek(). Since the
+ * buffer is circular, the region may wrap around its end, in which
+ * case it is split in two contiguous parts.
+ */
+struct RT_BUFFER_SPAN {
+	/**
+	 * Addresses of the contiguous parts of the region. ptr[1]
+	 * is NULL if the region does not wrap around.
+	 */
+	void *ptr[2];
+	/**
+	 * Lengths in bytes of the contiguous parts of the region.
+	 */
+	size_t len[2];
+};
+
+typedef struct RT_BUFFER_SPAN RT_BUFFER_SPAN;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -129,6 +152,58 @@ ssize_t rt_buffer_read(RT_BUFFER *bf,
 				    alchemy_rel_timeout(timeout, &ts));
 }
 
+ssize_t rt_buffer_write_reserve_timed(RT_BUFFER *bf,
+				      size_t size, RT_BUFFER_SPAN *span,
+				      const struct timespec *abs_timeout);
+
+static inline
+ssize_t rt_buffer_write_reserve_until(RT_BUFFER *bf,
+				      size_t size, RT_BUFFER_SPAN *span,
+				      RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_write_reserve_timed(bf, size, span,
+					     alchemy_abs_timeout(timeout, &ts));
+}
+
+static inline
+ssize_t rt_buffer_write_reserve(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_write_reserve_timed(bf, size, span,
+					     alchemy_rel_timeout(timeout, &ts));
+}
+
+int rt_buffer_write_commit(RT_BUFFER *bf, size_t size);
+
+ssize_t rt_buffer_read_peek_timed(RT_BUFFER *bf,
+				  size_t size, RT_BUFFER_SPAN *span,
+				  const struct timespec *abs_timeout);
+
+static inline
+ssize_t rt_buffer_read_peek_until(RT_BUFFER *bf,
+				  size_t size, RT_BUFFER_SPAN *span,
+				  RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_read_peek_timed(bf, size, span,
+					 alchemy_abs_timeout(timeout, &ts));
+}
+
+static inline
+ssize_t rt_buffer_read_peek(RT_BUFFER *bf,
+			    size_t size, RT_BUFFER_SPAN *span,
+			    RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_read_peek_timed(bf, size, span,
+					 alchemy_rel_timeout(timeout, &ts));
+}
+
+int rt_buffer_read_consume(RT_BUFFER *bf, size_t size);
+
 int rt_buffer_clear(RT_BUFFER *bf);
 
 int rt_buffer_inquire(RT_BUFFER *bf,
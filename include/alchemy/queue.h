@@ -29,6 +29,7 @@
 /** Creation flags. */
 #define Q_PRIO  0x1	/* Pend by task priority order. */
 #define Q_FIFO  0x0	/* Pend by FIFO order. */
+#define Q_LOCKFREE  0x2	/* Lock-free message ring. */
 
 #define Q_UNLIMITED 0	/* No size limit. */
 
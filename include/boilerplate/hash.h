@@ -21,8 +21,20 @@
 
 #include <pthread.h>
 #include <boilerplate/list.h>
+#include <boilerplate/atomic.h>
 
-#define HASHSLOTS  (1<<8)
+/*
+ * Tables start with HASHSLOTS buckets, then grow one bucket at a
+ * time (linear hashing) as the average chain length exceeds
+ * HASH_LOADFACTOR, up to HASH_MAXSEGS segments of HASHSLOTS
+ * buckets. Buckets are guarded by HASH_STRIPES locks, all the
+ * buckets an object may move to during growth being covered by the
+ * same lock.
+ */
+#define HASHSLOTS	(1<<8)
+#define HASH_MAXSEGS	128
+#define HASH_STRIPES	16
+#define HASH_LOADFACTOR	2
 
 struct hashobj {
 	dref_type(const void *) key;
@@ -30,6 +42,7 @@ struct hashobj {
 	char static_key[16];
 #endif
 	size_t len;
+	unsigned int hash;
 	struct holder link;
 };
 
@@ -38,8 +51,14 @@ struct hash_bucket {
 };
 
 struct hash_table {
+	/* First segment, others are allocated on demand. */
 	struct hash_bucket table[HASHSLOTS];
-	pthread_mutex_t lock;
+	dref_type(struct hash_bucket *) segs[HASH_MAXSEGS];
+	atomic_t nr_buckets;
+	atomic_t nr_objs;
+	int walkers;
+	pthread_mutex_t stripes[HASH_STRIPES];
+	pthread_mutex_t resize_lock;
 };
 
 struct hash_operations {
@@ -64,6 +83,7 @@ typedef int (*hash_walk_op)(struct hash_table *t,
 struct pvhashobj {
 	const void *key;
 	size_t len;
+	unsigned int hash;
 	struct pvholder link;
 };
 
@@ -73,7 +93,12 @@ struct pvhash_bucket {
 
 struct pvhash_table {
 	struct pvhash_bucket table[HASHSLOTS];
-	pthread_mutex_t lock;
+	struct pvhash_bucket *segs[HASH_MAXSEGS];
+	atomic_t nr_buckets;
+	atomic_t nr_objs;
+	int walkers;
+	pthread_mutex_t stripes[HASH_STRIPES];
+	pthread_mutex_t resize_lock;
 };
 
 struct pvhash_operations {
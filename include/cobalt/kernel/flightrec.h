@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#ifndef _COBALT_KERNEL_FLIGHTREC_H
+#define _COBALT_KERNEL_FLIGHTREC_H
+
+#include <linux/types.h>
+#include <cobalt/uapi/kernel/types.h>
+
+/**
+ * @addtogroup cobalt_core_flightrec
+ * @{
+ */
+
+/* Flight recorder event types. */
+#define XNFLIGHTREC_SWITCH	0	/* pid: next, arg: prev pid */
+#define XNFLIGHTREC_WAKEUP	1	/* pid: thread, arg: cleared bits */
+#define XNFLIGHTREC_TIMER	2	/* pid: -, arg: timer address */
+#define XNFLIGHTREC_IRQ		3	/* pid: -, arg: irq number */
+#define XNFLIGHTREC_RELAX	4	/* pid: thread, arg: reason */
+#define XNFLIGHTREC_HARDEN	5	/* pid: thread, arg: - */
+#define XNFLIGHTREC_FREEZE	6	/* pid: current, arg: reason */
+
+#ifdef CONFIG_XENO_OPT_FLIGHTREC
+
+struct xnflightrec_event {
+	/** Raw timestamp from the core clock. */
+	xnticks_t timestamp;
+	/** Sequence number, also validating the record. */
+	unsigned long seq;
+	unsigned long arg;
+	pid_t pid;
+	int type;
+};
+
+extern int xnflightrec_frozen;
+
+void __xnflightrec_log(int type, pid_t pid, unsigned long arg);
+
+void xnflightrec_freeze(pid_t pid, int reason);
+
+int xnflightrec_init(void);
+
+void xnflightrec_cleanup(void);
+
+/*
+ * Events are dropped as soon as the recorder is frozen, so that the
+ * last moments before the trigger remain available for inspection.
+ */
+static inline void xnflightrec_log(int type, pid_t pid, unsigned long arg)
+{
+	if (likely(!xnflightrec_frozen))
+		__xnflightrec_log(type, pid, arg);
+}
+
+#else /* !CONFIG_XENO_OPT_FLIGHTREC */
+
+static inline void xnflightrec_log(int type, pid_t pid, unsigned long arg) { }
+
+static inline void xnflightrec_freeze(pid_t pid, int reason) { }
+
+static inline int xnflightrec_init(void)
+{
+	return 0;
+}
+
+static inline void xnflightrec_cleanup(void) { }
+
+#endif /* !CONFIG_XENO_OPT_FLIGHTREC */
+
+/** @} */
+
+#endif /* !_COBALT_KERNEL_FLIGHTREC_H */
@@ -52,17 +52,59 @@
 #define XNHEAP_NBUCKETS   (XNHEAP_MAXLOG2 - XNHEAP_MINLOG2 + 2)
 #define XNHEAP_MAXHEAPSZ  (1 << 31) /* i.e. 2Gb */
 
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+/*
+ * Requests up to XNHEAP_CLASS_MAXSZ bytes are served from pages
+ * dedicated to a single size class. Classes are 8, 16, 32 and 48
+ * bytes, then four classes per power of two up to the maximum,
+ * i.e. 64, 80, 96, 112, 128, 160 and so on. Larger requests go
+ * through the log2 buckets.
+ */
+#define XNHEAP_CLASS_MAXSZ  1024
+#define XNHEAP_NCLASSES     21
+/* Page map type of the pages holding blocks of class #0. */
+#define XNHEAP_PCLASS       32
+#endif
+
+/*
+ * Per-CPU caches hold up to XNHEAP_CACHE_DEPTH free blocks of each
+ * block size up to XNHEAP_CACHE_MAXSZ, refilled from or flushed to
+ * the heap XNHEAP_CACHE_BATCH blocks at a time.
+ */
+#define XNHEAP_CACHE_MAXSZ    512
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+#define XNHEAP_CACHE_NBINS    17 /* Classes #0 to #16 */
+#else
+#define XNHEAP_CACHE_NBINS    7	 /* 2 ** XNHEAP_MINLOG2 to 2 ** 9 */
+#endif
+#define XNHEAP_CACHE_DEPTH    16
+#define XNHEAP_CACHE_BATCH    8
+
 #define XNHEAP_PFREE   0
 #define XNHEAP_PCONT   1
 #define XNHEAP_PLIST   2
 
 struct xnpagemap {
-	/** PFREE, PCONT, PLIST or log2 */
+	/** PFREE, PCONT, PLIST, log2 or PCLASS + class */
 	u32 type : 8;
 	/** Number of active blocks */
 	u32 bcount : 24;
 };
 
+struct xnheap_cache {
+	/** Owner CPU vs remote drains */
+	DECLARE_XNLOCK(lock);
+	/** Per-size free block lists */
+	struct xnheap_fastbin {
+		caddr_t freelist;
+		int count;
+	} bins[XNHEAP_CACHE_NBINS];
+	/** Allocations served from the cache */
+	unsigned long hits;
+	/** Allocations which had to refill the cache */
+	unsigned long misses;
+};
+
 struct xnheap {
 	/** SMP lock */
 	DECLARE_XNLOCK(lock);
@@ -82,12 +124,22 @@ struct xnheap {
 	struct xnbucket {
 		caddr_t freelist;
 		int fcount;
+		/** Pages split into blocks of this size */
+		int npages;
 	} buckets[XNHEAP_NBUCKETS];
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+	/** Size class list */
+	struct xnbucket classes[XNHEAP_NCLASSES];
+#endif
 	char name[XNOBJECT_NAME_LEN];
 	/** Size of storage area */
 	u32 size;
 	/** Used/busy storage size */
 	u32 used;
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	/** Per-CPU caches of small free blocks */
+	struct xnheap_cache __percpu *cache;
+#endif
 };
 
 extern struct xnheap cobalt_heap;
@@ -100,10 +152,14 @@ static inline u32 xnheap_get_size(const struct xnheap *heap)
 	return heap->size;
 }
 
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+u32 xnheap_get_free(const struct xnheap *heap);
+#else
 static inline u32 xnheap_get_free(const struct xnheap *heap)
 {
 	return heap->size - heap->used;
 }
+#endif
 
 static inline void *xnheap_get_membase(const struct xnheap *heap)
 {
@@ -0,0 +1,123 @@
+/*
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#ifndef _COBALT_KERNEL_OBJLOCK_H
+#define _COBALT_KERNEL_OBJLOCK_H
+
+#include <linux/hash.h>
+#include <cobalt/kernel/lock.h>
+#include <cobalt/uapi/kernel/types.h>
+
+/**
+ * @addtogroup cobalt_core_lock
+ *
+ * @{
+ */
+
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+
+/*
+ * Fine-grained object locks serialize the fast paths of objects
+ * which do not involve any scheduler state change, i.e. those which
+ * neither block nor wake up threads. Such paths run under the
+ * object lock only, the others still grab the nklock first, then
+ * the object lock for updating the object state. Therefore, an
+ * object lock must never be held when acquiring the nklock, and no
+ * more than a single object lock may be held at any time.
+ *
+ * Objects which are only reachable through a registry handle are
+ * guarded by a lock stripe indexed on the handle, so that a lookup
+ * from the fast path cannot race with the object deletion.
+ */
+#define XNOBJLOCK_STRIPE_SHIFT	6
+#define XNOBJLOCK_STRIPES	(1 << XNOBJLOCK_STRIPE_SHIFT)
+
+struct xnobjlock_stripe {
+	struct xnlock lock;
+} ____cacheline_aligned_in_smp;
+
+struct xnobjlock_stats {
+	/* Object lock acquisitions. */
+	unsigned long acquired;
+	/* Object lock found busy on entry. */
+	unsigned long contended;
+	/* Fast path declined, nklock taken instead. */
+	unsigned long fallback;
+	/* nklock found busy on fallback entry. */
+	unsigned long nkcontended;
+};
+
+extern struct xnobjlock_stripe xnobjlock_stripes[XNOBJLOCK_STRIPES];
+
+DECLARE_PER_CPU(struct xnobjlock_stats, xnobjlock_stats);
+
+static inline struct xnlock *xnobjlock_stripe(xnhandle_t handle)
+{
+	handle = xnhandle_get_index(handle);
+	return &xnobjlock_stripes[hash_32(handle, XNOBJLOCK_STRIPE_SHIFT)].lock;
+}
+
+#define xnobjlock_init(lock)	xnlock_init(lock)
+
+#define DECLARE_XNOBJLOCK(lock)	DECLARE_XNLOCK(lock)
+
+#define xnobjlock_get_irqsave(lock, s)			\
+	do {						\
+		struct xnobjlock_stats *__stats;	\
+		splhigh(s);				\
+		__stats = raw_cpu_ptr(&xnobjlock_stats); \
+		__stats->acquired++;			\
+		if (arch_spin_is_locked(&(lock)->alock)) \
+			__stats->contended++;		\
+		xnlock_get(lock);			\
+	} while (0)
+
+#define xnobjlock_put_irqrestore(lock, s)	\
+	do {					\
+		xnlock_put(lock);		\
+		splexit(s);			\
+	} while (0)
+
+/* Nested into the nklock, from a slow path. */
+#define xnobjlock_get(lock)	xnlock_get(lock)
+#define xnobjlock_put(lock)	xnlock_put(lock)
+
+/* Grab the nklock when the fast path cannot proceed. */
+#define xnobjlock_fallback_irqsave(s)			\
+	do {						\
+		struct xnobjlock_stats *__stats;	\
+		splhigh(s);				\
+		__stats = raw_cpu_ptr(&xnobjlock_stats); \
+		__stats->fallback++;			\
+		if (arch_spin_is_locked(&nklock.alock))	\
+			__stats->nkcontended++;		\
+		splexit(s);				\
+		xnlock_get_irqsave(&nklock, s);		\
+	} while (0)
+
+#else /* !CONFIG_XENO_OPT_FINE_LOCKING */
+
+#define DECLARE_XNOBJLOCK(lock)
+#define xnobjlock_init(lock)		do { } while (0)
+#define xnobjlock_get(lock)		do { } while (0)
+#define xnobjlock_put(lock)		do { } while (0)
+#define xnobjlock_fallback_irqsave(s)	xnlock_get_irqsave(&nklock, s)
+
+#endif /* !CONFIG_XENO_OPT_FINE_LOCKING */
+
+/** @} */
+
+#endif /* !_COBALT_KERNEL_OBJLOCK_H */
@@ -30,12 +30,23 @@ struct cobalt_umm {
 	void (*release)(struct cobalt_umm *umm);
 };
 
+struct rtdm_fd;
+
+/*
+ * Two-level table of RTDM file descriptors, indexed by ufd. Leaves
+ * are allocated on demand and only released with the table.
+ */
+struct cobalt_fdtab {
+	struct rtdm_fd ***dir;
+	unsigned int nr_leaves;
+};
+
 struct cobalt_ppd {
 	struct cobalt_umm umm;
 	unsigned long mayday_tramp;
 	atomic_t refcnt;
 	char *exe_path;
-	struct rb_root fds;
+	struct cobalt_fdtab fds;
 };
 
 extern struct cobalt_ppd cobalt_kernel_ppd;
@@ -21,6 +21,7 @@
 #include <cobalt/kernel/list.h>
 #include <cobalt/kernel/synch.h>
 #include <cobalt/kernel/vfile.h>
+#include <cobalt/uapi/kernel/limits.h>
 
 /**
  * @addtogroup cobalt_core_registry
@@ -45,6 +46,8 @@ struct xnobject {
 	} vfile_u;
 	struct xnvfile *vfilp;
 #endif /* CONFIG_XENO_OPT_VFILE */
+	unsigned int hash;	/* !< Hash value of key. */
+	char name[XNOBJECT_NAME_LEN]; /* !< Key copy for lockless lookups. */
 	struct hlist_node hlink; /* !< Link in h-table */
 	struct list_head link;
 };
@@ -188,6 +191,7 @@ void *xnregistry_lookup(xnhandle_t handle,
 
 int xnregistry_unlink(const char *key);
 
+/* Current number of buckets of the name index. */
 unsigned xnregistry_hash_size(void);
 
 extern struct xnpnode_ops xnregistry_vfsnap_ops;
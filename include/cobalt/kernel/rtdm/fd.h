@@ -162,6 +162,57 @@ ssize_t rtdm_recvmsg_handler(struct rtdm_fd *fd, struct user_msghdr *msg, int fl
  */
 ssize_t rtdm_sendmsg_handler(struct rtdm_fd *fd, const struct user_msghdr *msg, int flags);
 
+/**
+ * Batched receive message handler
+ *
+ * @param[in] fd File descriptor
+ * @param[in,out] msgvec Vector of message descriptors as passed by the
+ * user, automatically mirrored to safe kernel memory in case of user
+ * mode call. The handler should update the @a msg_len field of each
+ * message received.
+ * @param[in] vlen Number of entries in @a msgvec
+ * @param[in] flags Message flags as passed by the user, which may
+ * include MSG_WAITFORONE
+ *
+ * @return On success, the number of messages received, which may be
+ * less than @a vlen. On failure return either -ENOSYS, to request that
+ * this handler be called again from the opposite realtime/non-realtime
+ * context, or another negative error code.
+ *
+ * @note This handler is optional. If neither the real-time nor the
+ * non real-time variant is implemented, the RTDM core issues one call
+ * to the recvmsg handler for each message instead.
+ *
+ * @see @c recvmmsg() in Linux
+ */
+int rtdm_recvmmsg_handler(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			  unsigned int vlen, int flags);
+
+/**
+ * Batched transmit message handler
+ *
+ * @param[in] fd File descriptor
+ * @param[in,out] msgvec Vector of message descriptors as passed by the
+ * user, automatically mirrored to safe kernel memory in case of user
+ * mode call. The handler should update the @a msg_len field of each
+ * message transmitted.
+ * @param[in] vlen Number of entries in @a msgvec
+ * @param[in] flags Message flags as passed by the user
+ *
+ * @return On success, the number of messages transmitted, which may
+ * be less than @a vlen. On failure return either -ENOSYS, to request
+ * that this handler be called again from the opposite
+ * realtime/non-realtime context, or another negative error code.
+ *
+ * @note This handler is optional. If neither the real-time nor the
+ * non real-time variant is implemented, the RTDM core issues one call
+ * to the sendmsg handler for each message instead.
+ *
+ * @see @c sendmmsg() in Linux
+ */
+int rtdm_sendmmsg_handler(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			  unsigned int vlen, int flags);
+
 /**
  * Select handler
  *
@@ -277,6 +328,18 @@ struct rtdm_fd_ops {
 	/** See rtdm_sendmsg_handler(). */
 	ssize_t (*sendmsg_nrt)(struct rtdm_fd *fd,
 			       const struct user_msghdr *msg, int flags);
+	/** See rtdm_recvmmsg_handler(). */
+	int (*recvmmsg_rt)(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			   unsigned int vlen, int flags);
+	/** See rtdm_recvmmsg_handler(). */
+	int (*recvmmsg_nrt)(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			    unsigned int vlen, int flags);
+	/** See rtdm_sendmmsg_handler(). */
+	int (*sendmmsg_rt)(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			   unsigned int vlen, int flags);
+	/** See rtdm_sendmmsg_handler(). */
+	int (*sendmmsg_nrt)(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			    unsigned int vlen, int flags);
 	/** See rtdm_select_handler(). */
 	int (*select)(struct rtdm_fd *fd,
 		      struct xnselector *selector,
@@ -368,6 +431,22 @@ ssize_t rtdm_fd_recvmsg(int ufd, struct user_msghdr *msg, int flags);
 ssize_t rtdm_fd_sendmsg(int ufd, const struct user_msghdr *msg,
 			int flags);
 
+int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags, void __user *u_timeout,
+		       int (*get_mmsg)(struct mmsghdr *mmsg,
+				       void __user **u_mmsg_p),
+		       int (*put_mmsg)(void __user **u_mmsg_p,
+				       const struct mmsghdr *mmsg),
+		       int (*get_timespec)(struct timespec *ts,
+					   const void __user *u_ts));
+
+int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags,
+		       int (*get_mmsg)(struct mmsghdr *mmsg,
+				       void __user **u_mmsg_p),
+		       int (*put_mmsg)(void __user **u_mmsg_p,
+				       const struct mmsghdr *mmsg));
+
 int rtdm_fd_mmap(int ufd, struct _rtdm_mmap_request *rma,
 		 void * __user *u_addrp);
 
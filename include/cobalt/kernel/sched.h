@@ -61,6 +61,10 @@ struct xnsched {
 	unsigned long lflags;
 	/*!< Current thread. */
 	struct xnthread *curr;
+#ifdef CONFIG_XENO_OPT_SCHED_CLASSES
+	/*!< Scheduling classes which may have runnable threads. */
+	unsigned long rclasses;
+#endif
 #ifdef CONFIG_SMP
 	/*!< Owner CPU id. */
 	int cpu;
@@ -159,6 +163,10 @@ struct xnsched_class {
 	int weight;
 	int policy;
 	const char *name;
+	/* Rank in xnsched::rclasses, assigned at registration. */
+	int index;
+	/* Classes to probe for runnable threads after queuing to this one. */
+	unsigned long pickmask;
 };
 
 #define XNSCHED_CLASS_WEIGHT(n)		(n * XNSCHED_CLASS_WEIGHT_FACTOR)
@@ -502,12 +510,26 @@ static inline int xnsched_declare(struct xnsched_class *sched_class,
 
 #ifdef CONFIG_XENO_OPT_SCHED_CLASSES
 
+/*
+ * Make @sched_class and the classes sharing its runqueue eligible
+ * for picking on @sched. Classes which may change the set of
+ * threads they would pick without going through xnsched_enqueue()
+ * or xnsched_requeue() must call this explicitly.
+ */
+static inline void xnsched_mark_class(struct xnsched *sched,
+				      struct xnsched_class *sched_class)
+{
+	sched->rclasses |= sched_class->pickmask;
+}
+
 static inline void xnsched_enqueue(struct xnthread *thread)
 {
 	struct xnsched_class *sched_class = thread->sched_class;
 
-	if (sched_class != &xnsched_class_idle)
+	if (sched_class != &xnsched_class_idle) {
 		sched_class->sched_enqueue(thread);
+		xnsched_mark_class(thread->sched, sched_class);
+	}
 }
 
 static inline void xnsched_dequeue(struct xnthread *thread)
@@ -522,8 +544,10 @@ static inline void xnsched_requeue(struct xnthread *thread)
 {
 	struct xnsched_class *sched_class = thread->sched_class;
 
-	if (sched_class != &xnsched_class_idle)
+	if (sched_class != &xnsched_class_idle) {
 		sched_class->sched_requeue(thread);
+		xnsched_mark_class(thread->sched, sched_class);
+	}
 }
 
 static inline void xnsched_setparam(struct xnthread *thread,
@@ -40,6 +40,7 @@ struct xnselector {
 	} fds [XNSELECT_MAX_TYPES];
 	struct list_head destroy_link;
 	struct list_head bindings; /* only used by xnselector_destroy */
+	struct list_head readyq; /* bindings with pending events */
 };
 
 #define __NFDBITS__	(8 * sizeof(unsigned long))
@@ -83,6 +84,8 @@ static inline void __FD_ZERO__(__kernel_fd_set *__p)
 
 struct xnselect {
 	struct list_head bindings;
+	/* Last state signaled, or -1 if unknown. */
+	int state;
 };
 
 #define DECLARE_XNSELECT(name) struct xnselect name
@@ -94,6 +97,12 @@ struct xnselect_binding {
 	unsigned int bit_index;
 	struct list_head link;  /* link in selected fds list. */
 	struct list_head slink; /* link in selector list */
+	struct list_head rlink; /* link in selector ready list */
+};
+
+struct xnselect_event {
+	unsigned int index;
+	unsigned int type;
 };
 
 void xnselect_init(struct xnselect *select_block);
@@ -110,16 +119,28 @@ int __xnselect_signal(struct xnselect *select_block, unsigned int state);
 /**
  * Signal a file descriptor state change.
  *
+ * Signaling the current state again is a no-op, so that drivers
+ * reporting every event do not walk the bindings each time.
+ *
  * @param select_block pointer to an @a xnselect structure representing the file
  * descriptor whose state changed;
  * @param state new value of the state.
  *
  * @retval 1 if rescheduling is needed;
  * @retval 0 otherwise.
+ *
+ * Must be called with nklock locked irqs off.
  */
 static inline int
 xnselect_signal(struct xnselect *select_block, unsigned int state)
 {
+	int ready = state != 0;
+
+	if (select_block->state == ready)
+		return 0;
+
+	select_block->state = ready;
+
 	if (!list_empty(&select_block->bindings))
 		return __xnselect_signal(select_block, state);
 
@@ -136,6 +157,20 @@ int xnselect(struct xnselector *selector,
 	     int nfds,
 	     xnticks_t timeout, xntmode_t timeout_mode);
 
+int xnselector_wait(struct xnselector *selector,
+		    struct xnselect_event *events, int maxevents,
+		    xnticks_t timeout, xntmode_t timeout_mode);
+
+void xnselector_unbind(struct xnselector *selector, unsigned int index);
+
+/* Must be called with nklock locked irqs off */
+static inline int
+xnselector_bound_p(struct xnselector *selector,
+		   unsigned int type, unsigned int index)
+{
+	return __FD_ISSET__(index, &selector->fds[type].expected);
+}
+
 void xnselector_destroy(struct xnselector *selector);
 
 int xnselect_mount(void);
@@ -20,6 +20,7 @@
 #ifndef _COBALT_KERNEL_STAT_H
 #define _COBALT_KERNEL_STAT_H
 
+#include <linux/log2.h>
 #include <cobalt/kernel/clock.h>
 
 /*
@@ -131,6 +132,60 @@ typedef struct xnstat_counter {
 #define xnstat_counter_set(c, value) do { } while (0)
 #endif /* CONFIG_XENO_OPT_STATS */
 
+#ifdef CONFIG_XENO_OPT_STATS_WAKEUP
+
+/*
+ * Wakeup latency histogram: bucket #0 counts delays below 1024 ns,
+ * bucket #n delays in [2^(n+9), 2^(n+10)) ns, the last one catching
+ * everything beyond.
+ */
+#define XNSTAT_WAKEUP_BUCKETS	16
+
+typedef struct xnstat_wakeup {
+	xnticks_t release;	/* Pending release date (raw), zero if none */
+	unsigned long count;	/* Number of accounted wakeups */
+	xnticks_t min;		/* Shortest latency (ns) */
+	xnticks_t max;		/* Longest latency (ns) */
+	xnticks_t total;	/* Accumulated latency (ns) */
+	unsigned long hist[XNSTAT_WAKEUP_BUCKETS];
+} xnstat_wakeup_t;
+
+/* Record the date at which a sleeper should resume. */
+#define xnstat_wakeup_arm(w, date)	((w)->release = (date))
+
+/* Account for the latency of a thread resuming execution. */
+static inline void xnstat_wakeup_update(xnstat_wakeup_t *w)
+{
+	xnsticks_t delta;
+	xnticks_t ns;
+	int n;
+
+	if (likely(w->release == 0))
+		return;
+
+	delta = xnclock_core_read_raw() - w->release;
+	w->release = 0;
+	ns = delta > 0 ? xnclock_core_ticks_to_ns(delta) : 0;
+	if (w->count++ == 0 || ns < w->min)
+		w->min = ns;
+	if (ns > w->max)
+		w->max = ns;
+	w->total += ns;
+	n = ns < 1024 ? 0 : ilog2(ns) - 9;
+	w->hist[min(n, XNSTAT_WAKEUP_BUCKETS - 1)]++;
+}
+
+#define xnstat_wakeup_reset(w)		memset(w, 0, sizeof(*(w)))
+
+#else /* !CONFIG_XENO_OPT_STATS_WAKEUP */
+typedef struct xnstat_wakeup {
+} xnstat_wakeup_t;
+
+#define xnstat_wakeup_arm(w, date)	do { } while (0)
+#define xnstat_wakeup_update(w)		do { } while (0)
+#define xnstat_wakeup_reset(w)		do { } while (0)
+#endif /* CONFIG_XENO_OPT_STATS_WAKEUP */
+
 /* Account the exectime of the current account until now, switch to
    new_account, and return the previous one. */
 #define xnstat_exectime_switch(sched, new_account) \
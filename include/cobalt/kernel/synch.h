@@ -48,6 +48,24 @@
 struct xnthread;
 struct xnsynch;
 
+#ifdef CONFIG_XENO_OPT_STATS_LOCK
+
+struct xnsynch_stat {
+	struct list_head next;	/* In the lockstat list, if published */
+	xnhandle_t handle;	/* Registry handle of the object */
+	pid_t pid;		/* Creator process */
+	unsigned long uaddr;	/* User-space address of the object */
+	unsigned long acquires;	/* Successful acquisitions */
+	unsigned long contended; /* Acquisitions which had to wait */
+	unsigned long boosts;	/* Owner boosts (PIP) */
+	xnticks_t wait_total;	/* Accumulated wait time (ns) */
+	xnticks_t wait_max;	/* Longest wait time (ns) */
+	xnticks_t hold_max;	/* Longest hold time (ns) */
+	xnticks_t hold_start;	/* Date of last acquisition (raw) */
+};
+
+#endif /* CONFIG_XENO_OPT_STATS_LOCK */
+
 struct xnsynch {
 	struct list_head link;	/** thread->claimq */
 	int wprio;		/** wait prio in claimq */
@@ -56,6 +74,9 @@ struct xnsynch {
 	struct xnthread *owner;	/** Thread which owns the resource */
 	atomic_t *fastlock; /** Pointer to fast lock word */
 	void (*cleanup)(struct xnsynch *synch); /* Cleanup handler */
+#ifdef CONFIG_XENO_OPT_STATS_LOCK
+	struct xnsynch_stat stat; /** Contention statistics */
+#endif
 };
 
 #define XNSYNCH_WAITQUEUE_INITIALIZER(__name) {		\
@@ -126,6 +147,31 @@ void xnsynch_init(struct xnsynch *synch, int flags,
 
 int xnsynch_destroy(struct xnsynch *synch);
 
+#ifdef CONFIG_XENO_OPT_STATS_LOCK
+
+void xnsynch_stat_publish(struct xnsynch *synch,
+			  xnhandle_t handle, unsigned long uaddr);
+
+#ifdef CONFIG_XENO_OPT_VFILE
+void xnsynch_init_proc(void);
+void xnsynch_cleanup_proc(void);
+#else
+static inline void xnsynch_init_proc(void) { }
+static inline void xnsynch_cleanup_proc(void) { }
+#endif
+
+#else /* !CONFIG_XENO_OPT_STATS_LOCK */
+
+static inline void xnsynch_stat_publish(struct xnsynch *synch,
+					xnhandle_t handle, unsigned long uaddr)
+{
+}
+
+static inline void xnsynch_init_proc(void) { }
+static inline void xnsynch_cleanup_proc(void) { }
+
+#endif /* !CONFIG_XENO_OPT_STATS_LOCK */
+
 static inline void xnsynch_set_owner(struct xnsynch *synch,
 				     struct xnthread *thread)
 {
@@ -163,6 +163,7 @@ struct xnthread {
 		xnstat_counter_t pf;	/* Number of page faults */
 		xnstat_exectime_t account; /* Execution time accounting entity */
 		xnstat_exectime_t lastperiod; /* Interval marker for execution time reports */
+		xnstat_wakeup_t wakeup;	/* Wakeup latency statistics */
 	} stat;
 
 	struct xnselector *selector;    /* For select. */
@@ -190,6 +190,96 @@ typedef struct { } xntimerq_it_t;
 #define xntimerq_it_begin(q,i)	((void) (i), xntimerq_head(q))
 #define xntimerq_it_next(q,i,h) ((void) (i), xntimerq_next((q),(h)))
 
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+/*
+ * Hierarchical timing wheel. Timers are hashed on their date shifted
+ * right by XNTIMERQ_WHEEL_SHIFT (the wheel index), into unsorted
+ * slots spread over XNTIMERQ_WHEEL_LEVELS levels of
+ * XNTIMERQ_WHEEL_SIZE slots each. The level of a timer is given by
+ * the most significant bit differing between its index and the
+ * current wheel base. Timers whose index is not past the base live
+ * in the near bucket, which is kept sorted by date and priority
+ * exactly like the linear queue, so that the head of the queue is
+ * always the first entry of the near bucket.
+ *
+ * When the near bucket drains, the earliest occupied slot is
+ * cascaded down, advancing the base. Each timer is moved at most
+ * XNTIMERQ_WHEEL_LEVELS times before it reaches the near bucket.
+ */
+#define XNTIMERQ_WHEEL_BITS	6
+#define XNTIMERQ_WHEEL_SIZE	(1 << XNTIMERQ_WHEEL_BITS)
+#define XNTIMERQ_WHEEL_MASK	(XNTIMERQ_WHEEL_SIZE - 1)
+#define XNTIMERQ_WHEEL_LEVELS	4
+#define XNTIMERQ_WHEEL_SHIFT	CONFIG_XENO_OPT_TIMER_WHEEL_SHIFT
+
+typedef struct xntlholder xntimerh_t;
+
+#define xntimerh_date(h)       xntlholder_date(h)
+#define xntimerh_prio(h)       xntlholder_prio(h)
+#define xntimerh_init(h)       do { } while (0)
+
+typedef struct {
+	/* Sorted timers not later than the base index. */
+	struct list_head near;
+	/* Unsorted wheel slots, indexed relative to the base. */
+	struct list_head slots[XNTIMERQ_WHEEL_LEVELS][XNTIMERQ_WHEEL_SIZE];
+	/* Occupancy bitmap of the wheel slots, one word per level. */
+	u64 map[XNTIMERQ_WHEEL_LEVELS];
+	/* Timers beyond the wheel span, unsorted. */
+	struct list_head overflow;
+	xnticks_t base;
+	unsigned int nr;
+} xntimerq_t;
+
+void xntimerq_init(xntimerq_t *q);
+
+#define xntimerq_destroy(q) do { } while (0)
+#define xntimerq_empty(q)   ((q)->nr == 0)
+
+void __xntimerq_pull(xntimerq_t *q, struct list_head *last);
+
+static inline xntimerh_t *xntimerq_head(xntimerq_t *q)
+{
+	if (list_empty(&q->near)) {
+		if (q->nr == 0)
+			return NULL;
+		__xntimerq_pull(q, &q->near);
+	}
+
+	return list_first_entry(&q->near, xntimerh_t, link);
+}
+
+static inline xntimerh_t *xntimerq_second(xntimerq_t *q, xntimerh_t *h)
+{
+	if (list_is_last(&h->link, &q->near)) {
+		if (q->nr < 2)
+			return NULL;
+		__xntimerq_pull(q, &h->link);
+	}
+
+	return list_entry(h->link.next, xntimerh_t, link);
+}
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder);
+
+void xntimerq_remove(xntimerq_t *q, xntimerh_t *holder);
+
+/* Iterates over all timers, only the near bucket is ordered. */
+typedef struct {
+	int bucket;
+} xntimerq_it_t;
+
+xntimerh_t *xntimerq_it_next(xntimerq_t *q, xntimerq_it_t *it,
+			     xntimerh_t *holder);
+
+static inline xntimerh_t *xntimerq_it_begin(xntimerq_t *q,
+					    xntimerq_it_t *it)
+{
+	it->bucket = -1;
+	return xntimerq_it_next(q, it, NULL);
+}
+
 #else /* CONFIG_XENO_OPT_TIMER_LIST */
 
 typedef struct xntlholder xntimerh_t;
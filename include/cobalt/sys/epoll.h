@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_SYS_EPOLL_H
+#define _COBALT_SYS_EPOLL_H
+
+#pragma GCC system_header
+#include_next <sys/epoll.h>
+#include <cobalt/wrappers.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int epoll_create_np(int flags);
+
+COBALT_DECL(int, epoll_ctl(int epfd, int op, int fd,
+			   struct epoll_event *event));
+
+COBALT_DECL(int, epoll_wait(int epfd, struct epoll_event *events,
+			    int maxevents, int timeout));
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _COBALT_SYS_EPOLL_H */
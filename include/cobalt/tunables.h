@@ -33,6 +33,8 @@ extern int __cobalt_print_bufcount;
 
 extern int __cobalt_print_syncdelay;
 
+extern int __cobalt_print_deferred;
+
 static inline define_config_tunable(main_prio, int, prio)
 {
 	__cobalt_main_prio = prio;
@@ -73,6 +75,26 @@ static inline read_config_tunable(print_sync_delay, int)
 	return __cobalt_print_syncdelay;
 }
 
+static inline define_config_tunable(print_deferred, int, on)
+{
+	__cobalt_print_deferred = on;
+}
+
+static inline read_config_tunable(print_deferred, int)
+{
+	return __cobalt_print_deferred;
+}
+
+static inline define_runtime_tunable(print_deferred, int, on)
+{
+	__cobalt_print_deferred = on;
+}
+
+static inline read_runtime_tunable(print_deferred, int)
+{
+	return __cobalt_print_deferred;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -117,6 +117,11 @@
 #define sc_cobalt_backtrace			94
 #define sc_cobalt_serialdbg			95
 #define sc_cobalt_extend			96
+#define sc_cobalt_recvmmsg			97
+#define sc_cobalt_sendmmsg			98
+#define sc_cobalt_epoll_create			99
+#define sc_cobalt_epoll_ctl			100
+#define sc_cobalt_epoll_wait			101
 
 #define __NR_COBALT_SYSCALLS			128 /* Power of 2 */
 
@@ -114,6 +114,21 @@ void registry_init_file_obstack(struct fsobj *fsobj,
 	registry_init_file(fsobj, ops, sizeof(struct fsobstack));
 }
 
+/*
+ * The snapshot built by the ->open() handler of a cached file is
+ * reused by subsequent opens, until registry_bump_file() is called,
+ * or a thread waiting on @sobj is cancelled.
+ */
+static inline
+void registry_init_file_cached(struct fsobj *fsobj,
+			       const struct registry_operations *ops,
+			       struct syncobj *sobj)
+{
+	registry_init_file_obstack(fsobj, ops);
+	fsobj->sobj = sobj;
+	fsobj->cached = 1;
+}
+
 #else /* !CONFIG_XENO_REGISTRY */
 
 static inline
@@ -121,6 +136,12 @@ void registry_init_file_obstack(struct fsobj *fsobj,
 				const struct registry_operations *ops)
 { }
 
+static inline
+void registry_init_file_cached(struct fsobj *fsobj,
+			       const struct registry_operations *ops,
+			       struct syncobj *sobj)
+{ }
+
 #endif /* !CONFIG_XENO_REGISTRY */
 
 #endif /* !_COPPERPLATE_REGISTRY_OBSTACK_H */
@@ -27,6 +27,7 @@
 #include <boilerplate/obstack.h>
 
 struct fsobj;
+struct syncobj;
 
 #define REGISTRY_SHARED  1
 #define REGISTRY_ANON    2
@@ -58,6 +59,16 @@ struct fsobj {
 	const struct registry_operations *ops;
 	struct pvholder link;
 	struct pvhashobj hobj;
+	/* Advanced by registry_bump_file() on object updates. */
+	unsigned long version;
+	/* Object whose waiters are reported, if any. */
+	struct syncobj *sobj;
+	int cached;
+	struct {
+		void *data;
+		size_t len;
+		unsigned long version;
+	} cache;
 };
 
 #ifdef __cplusplus
@@ -91,6 +102,16 @@ void registry_pkg_destroy(void);
 }
 #endif
 
+/*
+ * Invalidate the snapshot cached for a file (see
+ * registry_init_file_cached()). Callers must serialize updates,
+ * usually by holding the lock of the underlying object.
+ */
+static inline void registry_bump_file(struct fsobj *fsobj)
+{
+	fsobj->version++;
+}
+
 #else /* !CONFIG_XENO_REGISTRY */
 
 struct fsobj {
@@ -130,6 +151,11 @@ void registry_touch_file(struct fsobj *fsobj)
 {
 }
 
+static inline
+void registry_bump_file(struct fsobj *fsobj)
+{
+}
+
 static inline
 int __registry_pkg_init(const char *arg0,
 			char *mountpt, int flags)
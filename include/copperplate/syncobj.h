@@ -69,6 +69,8 @@ struct syncobj {
 	int grant_count;
 	struct listobj drain_list;
 	int drain_count;
+	/* Waiters removed upon cancellation, see __syncobj_cleanup_wait(). */
+	unsigned long cancel_count;
 	struct syncobj_corespec core;
 	fnref_type(void (*)(struct syncobj *sobj)) finalizer;
 };
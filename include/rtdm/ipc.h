@@ -20,7 +20,96 @@
 #ifndef _RTDM_IPC_H
 #define _RTDM_IPC_H
 
+#include <sys/ioctl.h>
+#include <string.h>
+#include <errno.h>
 #include <rtdm/rtdm.h>
 #include <rtdm/uapi/ipc.h>
 
+/*
+ * Helpers for exchanging data over a mapped BUFP ring (see
+ * BUFP_MMAP). @fd is the socket the ring was mapped from. These
+ * calls return zero on success, a negated error code otherwise.
+ */
+
+static inline void *bufp_ring_data(struct bufp_ring *ring)
+{
+	return (char *)ring + ring->data;
+}
+
+static inline __u32 bufp_ring_fill(struct bufp_ring *ring)
+{
+	volatile struct bufp_ring *r = ring;
+
+	return r->head - r->tail;
+}
+
+static inline int bufp_ring_write(int fd, struct bufp_ring *ring,
+				  const void *buf, size_t len)
+{
+	volatile struct bufp_ring *r = ring;
+	__u32 head = r->head, size = ring->size, wlen = len;
+	char *data = bufp_ring_data(ring);
+	size_t off, n;
+
+	if (len > size)
+		return -EINVAL;
+
+	while (size - (head - r->tail) < wlen) {
+		if (ioctl(fd, BUFP_RTIOC_WAITWR, &wlen))
+			return -errno;
+	}
+
+	/* Read the consumer index before overwriting the room. */
+	__sync_synchronize();
+
+	off = head & (size - 1);
+	n = size - off < len ? size - off : len;
+	memcpy(data + off, buf, n);
+	memcpy(data, (const char *)buf + n, len - n);
+
+	__sync_synchronize();
+	r->head = head + wlen;
+	__sync_synchronize();
+
+	if (r->rdwait && ioctl(fd, BUFP_RTIOC_NOTIFY))
+		return -errno;
+
+	return 0;
+}
+
+static inline int bufp_ring_read(int fd, struct bufp_ring *ring,
+				 void *buf, size_t len)
+{
+	volatile struct bufp_ring *r = ring;
+	__u32 tail = r->tail, size = ring->size, rlen = len;
+	char *data = bufp_ring_data(ring);
+	size_t off, n;
+
+	if (len > size)
+		return -EINVAL;
+
+	while (r->head - tail < rlen) {
+		if (ioctl(fd, BUFP_RTIOC_WAITRD, &rlen))
+			return -errno;
+	}
+
+	/* Read the producer index before the data. */
+	__sync_synchronize();
+
+	off = tail & (size - 1);
+	n = size - off < len ? size - off : len;
+	memcpy(buf, data + off, n);
+	memcpy((char *)buf + n, data, len - n);
+
+	__sync_synchronize();
+	r->tail = tail + rlen;
+	__sync_synchronize();
+
+	if (r->wrwait && ioctl(fd, BUFP_RTIOC_NOTIFY))
+		return -errno;
+
+	return 0;
+}
+
 #endif /* !_RTDM_IPC_H */
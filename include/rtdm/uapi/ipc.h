@@ -834,6 +834,160 @@ struct sockaddr_ipc {
  * RT/non-RT
  */
 #define BUFP_BUFSZ		2
+/**
+ * BUFP mapped ring mode
+ *
+ * When enabled, the socket buffer is laid out as a ring which
+ * both the consumer and the producers may map into their address
+ * space via mmap(2), exchanging data directly through the shared
+ * memory without copying it through the kernel (see struct
+ * bufp_ring). The buffer size set by @ref BUFP_BUFSZ is rounded
+ * up to the next power of two in this mode.
+ *
+ * Calling mmap(2) on a socket maps the ring of its destination,
+ * i.e. its own ring if bound and not connected to another port,
+ * or the ring of its peer otherwise. The mapping must start at
+ * offset zero, and cover the length returned by getsockopt() for
+ * this option.
+ *
+ * Mapped rings are designed for a single producer and a single
+ * consumer. Regular send and receive calls remain available on
+ * either side, but may not be mixed with direct ring accesses
+ * performed concurrently from the same side.
+ *
+ * Since the kernel does not see the ring updates userland performs
+ * directly, select(2) only reflects the ring state as of the last
+ * kernel transfer or @ref BUFP_RTIOC_NOTIFY request. Threads
+ * exchanging data through a mapped ring should rather wait via
+ * @ref BUFP_RTIOC_WAITRD and @ref BUFP_RTIOC_WAITWR.
+ *
+ * This option must be set prior to binding.
+ *
+ * @param [in] level @ref sockopts_bufp "SOL_BUFP"
+ * @param [in] optname @b BUFP_MMAP
+ * @param [in] optval Pointer to a variable of type int, non-zero
+ * for enabling the mapped ring mode when setting the option. When
+ * getting the option, pointer to a variable of type size_t
+ * receiving the length of the ring to map, or zero if unavailable.
+ * @param [in] optlen sizeof(int) or sizeof(size_t)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen is invalid)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define BUFP_MMAP		3
+/** @} */
+
+/**
+ * Shared header of a mapped BUFP ring.
+ *
+ * The data area follows the header at offset @a data from the start
+ * of the mapping. @a head and @a tail count the bytes written to
+ * and read from the ring since it was created, wrapping around at
+ * 2^32; the data at index @a i lives at offset (@a i & (@a size -
+ * 1)) in the data area.
+ *
+ * The producer stores the data, then advances @a head. The consumer
+ * loads the data, then advances @a tail. Both sides must issue a
+ * full memory barrier after updating their index, then check the
+ * waiter flag of the other side, issuing @ref BUFP_RTIOC_NOTIFY if
+ * set. A side which cannot proceed waits for the other one by
+ * issuing @ref BUFP_RTIOC_WAITRD or @ref BUFP_RTIOC_WAITWR.
+ */
+struct bufp_ring {
+	/** Size of the data area (power of two). */
+	__u32 size;
+	/** Offset of the data area from the start of the mapping. */
+	__u32 data;
+	__u32 __pad0[14];
+	/** Producer index. */
+	__u32 head;
+	/** Set when the consumer is waiting in the kernel. */
+	__u32 rdwait;
+	__u32 __pad1[14];
+	/** Consumer index. */
+	__u32 tail;
+	/** Set when a producer is waiting in the kernel. */
+	__u32 wrwait;
+	__u32 __pad2[14];
+};
+
+#define RTIOC_TYPE_IPC		RTDM_CLASS_RTIPC
+
+/**
+ * @anchor bufp_ring_ioctls @name BUFP ring requests
+ * Synchronizing on a mapped BUFP ring.
+ * @{ */
+/**
+ * Wait for data in a mapped ring.
+ *
+ * Blocks the caller until the ring of the bound socket holds at
+ * least the given amount of data, or the @c SO_RCVTIMEO timeout
+ * elapses.
+ *
+ * @param [in] arg Pointer to a variable of type __u32, containing
+ * the amount of data to wait for.
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -ENXIO (socket not bound in mapped ring mode)
+ * - -EINVAL (invalid amount of data)
+ * - -ETIMEDOUT (timeout elapsed)
+ * - -EINTR (interrupted by a signal)
+ * .
+ *
+ * @par Calling context:
+ * RT
+ */
+#define BUFP_RTIOC_WAITRD	_IOW(RTIOC_TYPE_IPC, 0x00, __u32)
+/**
+ * Wait for room in a mapped ring.
+ *
+ * Blocks the caller until the ring of the peer socket has room for
+ * at least the given amount of data, or the @c SO_SNDTIMEO timeout
+ * elapses.
+ *
+ * @param [in] arg Pointer to a variable of type __u32, containing
+ * the amount of room to wait for.
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -ENXIO (peer socket not bound in mapped ring mode)
+ * - -ECONNRESET (peer socket closed)
+ * - -EDESTADDRREQ (socket not connected)
+ * - -EINVAL (invalid amount of room)
+ * - -ETIMEDOUT (timeout elapsed)
+ * - -EINTR (interrupted by a signal)
+ * .
+ *
+ * @par Calling context:
+ * RT
+ */
+#define BUFP_RTIOC_WAITWR	_IOW(RTIOC_TYPE_IPC, 0x01, __u32)
+/**
+ * Notify the other side of a mapped ring.
+ *
+ * Wakes up the threads waiting on the ring mapped by the caller, if
+ * they may proceed, and updates the select(2) state of the ring
+ * accordingly.
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -ENXIO (no ring available)
+ * - -ECONNRESET (peer socket closed)
+ * - -EDESTADDRREQ (socket not connected)
+ * .
+ *
+ * @par Calling context:
+ * RT
+ */
+#define BUFP_RTIOC_NOTIFY	_IO(RTIOC_TYPE_IPC, 0x02)
 /** @} */
 
 /**
@@ -25,7 +25,7 @@
 
 #include <linux/types.h>
 
-#define RTTST_PROFILE_VER		2
+#define RTTST_PROFILE_VER		3
 
 typedef struct rttst_bench_res {
 	__s32 avg;
@@ -51,6 +51,10 @@ typedef struct rttst_overall_bench_res {
 #define RTTST_TMBENCH_TASK		0
 #define RTTST_TMBENCH_HANDLER		1
 
+/* Possible values for struct rttst_tmbench_config::histogram_type. */
+#define RTTST_HISTOGRAM_LINEAR		0
+#define RTTST_HISTOGRAM_HDR		1
+
 typedef struct rttst_tmbench_config {
 	int mode;
 	int priority;
@@ -59,8 +63,58 @@ typedef struct rttst_tmbench_config {
 	int histogram_size;
 	int histogram_bucketsize;
 	int freeze_max;
+	int histogram_type;
 } rttst_tmbench_config_t;
 
+/*
+ * Log-linear (HDR) histogram layout. Values below
+ * RTTST_HDR_SUB_COUNT nanoseconds get one bucket each, then every
+ * power-of-two range [2^e, 2^(e+1)) is split into RTTST_HDR_SUB_COUNT
+ * buckets of 2^(e - RTTST_HDR_SUB_BITS) ns, which bounds the relative
+ * error to 1/RTTST_HDR_SUB_COUNT over the whole __s32 range. Negative
+ * values are accounted for in bucket #0.
+ */
+#define RTTST_HDR_SUB_BITS		5
+#define RTTST_HDR_SUB_COUNT		(1 << RTTST_HDR_SUB_BITS)
+#define RTTST_HDR_BUCKETS		((32 - RTTST_HDR_SUB_BITS) << RTTST_HDR_SUB_BITS)
+
+static inline int rttst_hdr_index(__s32 value)
+{
+	int e;
+
+	if (value < RTTST_HDR_SUB_COUNT)
+		return value < 0 ? 0 : value;
+
+	e = 31 - __builtin_clz((__u32)value);
+
+	return ((e - RTTST_HDR_SUB_BITS + 1) << RTTST_HDR_SUB_BITS) |
+		(((__u32)value >> (e - RTTST_HDR_SUB_BITS)) &
+		 (RTTST_HDR_SUB_COUNT - 1));
+}
+
+/* Lowest value accounted for in bucket @index. */
+static inline __u32 rttst_hdr_lowest(int index)
+{
+	int shift;
+
+	if (index < RTTST_HDR_SUB_COUNT)
+		return index;
+
+	shift = (index >> RTTST_HDR_SUB_BITS) - 1;
+
+	return (__u32)(RTTST_HDR_SUB_COUNT |
+		       (index & (RTTST_HDR_SUB_COUNT - 1))) << shift;
+}
+
+/* Number of distinct values accounted for in bucket @index. */
+static inline __u32 rttst_hdr_width(int index)
+{
+	if (index < RTTST_HDR_SUB_COUNT * 2)
+		return 1;
+
+	return 1U << ((index >> RTTST_HDR_SUB_BITS) - 1);
+}
+
 struct rttst_swtest_task {
 	unsigned int index;
 	unsigned int flags;
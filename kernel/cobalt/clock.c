@@ -26,6 +26,7 @@
 #include <cobalt/kernel/vdso.h>
 #include <cobalt/uapi/time.h>
 #include <asm/xenomai/calibration.h>
+#include <cobalt/kernel/flightrec.h>
 #include <trace/events/cobalt-core.h>
 /**
  * @ingroup cobalt_core
@@ -737,6 +738,7 @@ void xnclock_tick(struct xnclock *clock)
 			break;
 
 		trace_cobalt_timer_expire(timer);
+		xnflightrec_log(XNFLIGHTREC_TIMER, 0, (unsigned long)timer);
 
 		xntimer_dequeue(timer, timerq);
 		xntimer_account_fired(timer);
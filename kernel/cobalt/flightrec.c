@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <linux/log2.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <cobalt/kernel/lock.h>
+#include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/vfile.h>
+#include <cobalt/kernel/flightrec.h>
+#include <cobalt/uapi/signal.h>
+
+/**
+ * @ingroup cobalt_core
+ * @defgroup cobalt_core_flightrec Flight recorder
+ *
+ * The flight recorder logs the core scheduling events into
+ * per-CPU rings of fixed size, overwriting the oldest records. It
+ * is always armed, and frozen automatically when the watchdog
+ * triggers or SIGDEBUG is sent to a thread, so that the history
+ * leading to the incident can be retrieved post-mortem from
+ * /proc/xenomai/flightrec.
+ *
+ * Each ring is only written by its owner CPU with hard interrupts
+ * off, so no lock is needed. Records carry their sequence number,
+ * which readers use for detecting entries overwritten while they
+ * were copying them.
+ *
+ * @{
+ */
+
+struct flightrec_ring {
+	unsigned long head;
+	struct xnflightrec_event events[0];
+};
+
+static DEFINE_PER_CPU(struct flightrec_ring *, flightrec_rings);
+
+static unsigned long flightrec_mask;
+
+static int flightrec_freeze_cpu;
+
+static int flightrec_freeze_reason;
+
+static pid_t flightrec_freeze_pid;
+
+int xnflightrec_frozen;
+EXPORT_SYMBOL_GPL(xnflightrec_frozen);
+
+void __xnflightrec_log(int type, pid_t pid, unsigned long arg)
+{
+	struct xnflightrec_event *ev;
+	struct flightrec_ring *ring;
+	unsigned long seq;
+	spl_t s;
+
+	splhigh(s);
+
+	ring = *raw_cpu_ptr(&flightrec_rings);
+	if (unlikely(ring == NULL))
+		goto out;
+
+	seq = ring->head++;
+	ev = ring->events + (seq & flightrec_mask);
+	ev->seq = ~0UL;
+	smp_wmb();
+	ev->timestamp = xnclock_core_read_raw();
+	ev->type = type;
+	ev->pid = pid;
+	ev->arg = arg;
+	smp_wmb();
+	ev->seq = seq;
+out:
+	splexit(s);
+}
+EXPORT_SYMBOL_GPL(__xnflightrec_log);
+
+/**
+ * @fn void xnflightrec_freeze(pid_t pid, int reason)
+ * @brief Freeze the flight recorder.
+ *
+ * Stop recording events on all CPUs, after logging a freeze marker
+ * on the current one. Subsequent calls are ignored, until the
+ * recorder is restarted by writing "thaw" to
+ * /proc/xenomai/flightrec.
+ *
+ * @param pid The pid of the thread causing the freeze, zero for
+ * none.
+ *
+ * @param reason A SIGDEBUG_* code describing the cause.
+ *
+ * @coretags{unrestricted}
+ */
+void xnflightrec_freeze(pid_t pid, int reason)
+{
+	if (cmpxchg(&xnflightrec_frozen, 0, 1))
+		return;
+
+	flightrec_freeze_cpu = ipipe_processor_id();
+	flightrec_freeze_reason = reason;
+	flightrec_freeze_pid = pid;
+	__xnflightrec_log(XNFLIGHTREC_FREEZE, pid, reason);
+}
+EXPORT_SYMBOL_GPL(xnflightrec_freeze);
+
+static void flightrec_thaw(void)
+{
+	int cpu;
+
+	if (!xnflightrec_frozen)
+		return;
+
+	for_each_online_cpu(cpu)
+		if (per_cpu(flightrec_rings, cpu))
+			per_cpu(flightrec_rings, cpu)->head = 0;
+
+	smp_wmb();
+	xnflightrec_frozen = 0;
+}
+
+#ifdef CONFIG_XENO_OPT_VFILE
+
+static const char *event_str[] = {
+	[XNFLIGHTREC_SWITCH] = "switch",
+	[XNFLIGHTREC_WAKEUP] = "wakeup",
+	[XNFLIGHTREC_TIMER] = "timer",
+	[XNFLIGHTREC_IRQ] = "irq",
+	[XNFLIGHTREC_RELAX] = "relax",
+	[XNFLIGHTREC_HARDEN] = "harden",
+	[XNFLIGHTREC_FREEZE] = "freeze",
+};
+
+struct vfile_flightrec_priv {
+	int frozen;
+	int cpu;
+	unsigned long seq;
+	struct xnflightrec_event ev;
+	/* Ring heads sampled at open time, indexed by CPU. */
+	unsigned long head[0];
+};
+
+/*
+ * Records are output CPU after CPU, oldest first, so that it->pos
+ * can be mapped to a ring slot from the heads sampled by
+ * ->rewind().
+ */
+static int flightrec_locate(struct vfile_flightrec_priv *priv, loff_t pos)
+{
+	unsigned long nr;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		nr = min(priv->head[cpu], flightrec_mask + 1);
+		if (pos < nr) {
+			priv->cpu = cpu;
+			priv->seq = priv->head[cpu] - nr + pos;
+			return 1;
+		}
+		pos -= nr;
+	}
+
+	return 0;
+}
+
+static void *flightrec_fetch(struct xnvfile_regular_iterator *it)
+{
+	struct vfile_flightrec_priv *priv = xnvfile_iterator_priv(it);
+	struct xnflightrec_event *ev;
+	struct flightrec_ring *ring;
+
+	if (!flightrec_locate(priv, it->pos - 1))
+		return NULL;
+
+	ring = per_cpu(flightrec_rings, priv->cpu);
+	ev = ring->events + (priv->seq & flightrec_mask);
+	priv->ev = *ev;
+	smp_rmb();
+	/* Overwritten meanwhile, ->show() will skip it. */
+	if (ACCESS_ONCE(ev->seq) != priv->seq)
+		priv->ev.seq = ~0UL;
+
+	return &priv->ev;
+}
+
+static int flightrec_vfile_rewind(struct xnvfile_regular_iterator *it)
+{
+	struct vfile_flightrec_priv *priv = xnvfile_iterator_priv(it);
+	struct flightrec_ring *ring;
+	int cpu;
+
+	priv->frozen = xnflightrec_frozen;
+	smp_rmb();
+
+	for_each_online_cpu(cpu) {
+		ring = per_cpu(flightrec_rings, cpu);
+		priv->head[cpu] = ring ? ACCESS_ONCE(ring->head) : 0;
+	}
+
+	return 0;
+}
+
+static void *flightrec_vfile_begin(struct xnvfile_regular_iterator *it)
+{
+	if (it->pos == 0)
+		return VFILE_SEQ_START;
+
+	return flightrec_fetch(it);
+}
+
+static void *flightrec_vfile_next(struct xnvfile_regular_iterator *it)
+{
+	return flightrec_fetch(it);
+}
+
+static int flightrec_vfile_show(struct xnvfile_regular_iterator *it,
+				void *data)
+{
+	struct vfile_flightrec_priv *priv = xnvfile_iterator_priv(it);
+	struct xnflightrec_event *ev = data;
+
+	if (ev == NULL) {
+		if (priv->frozen)
+			xnvfile_printf(it, "# frozen cpu=%d pid=%d reason=%d\n",
+				       flightrec_freeze_cpu,
+				       flightrec_freeze_pid,
+				       flightrec_freeze_reason);
+		else
+			xnvfile_printf(it, "# running\n");
+		xnvfile_printf(it, "# %-4s %-10s %-16s %-8s %-8s %s\n",
+			       "CPU", "SEQ", "TIMESTAMP", "EVENT", "PID", "ARG");
+		return 0;
+	}
+
+	if (ev->seq != priv->seq || ev->type >= ARRAY_SIZE(event_str))
+		return VFILE_SEQ_SKIP;
+
+	xnvfile_printf(it, "%-6d %-10lu %-16Lu %-8s %-8d %#lx\n",
+		       priv->cpu, ev->seq,
+		       xnclock_core_ticks_to_ns(ev->timestamp),
+		       event_str[ev->type], ev->pid, ev->arg);
+
+	return 0;
+}
+
+static ssize_t flightrec_vfile_store(struct xnvfile_input *input)
+{
+	char buf[8];
+	ssize_t ret;
+
+	ret = xnvfile_get_string(input, buf, sizeof(buf));
+	if (ret < 0)
+		return ret;
+
+	if (strcmp(buf, "freeze") == 0)
+		xnflightrec_freeze(task_pid_nr(current), SIGDEBUG_UNDEFINED);
+	else if (strcmp(buf, "thaw") == 0)
+		flightrec_thaw();
+	else
+		return -EINVAL;
+
+	return ret;
+}
+
+static struct xnvfile_regular_ops flightrec_vfile_ops = {
+	.rewind = flightrec_vfile_rewind,
+	.begin = flightrec_vfile_begin,
+	.next = flightrec_vfile_next,
+	.show = flightrec_vfile_show,
+	.store = flightrec_vfile_store,
+};
+
+static struct xnvfile_regular flightrec_vfile = {
+	.ops = &flightrec_vfile_ops,
+};
+
+static inline int init_flightrec_vfile(void)
+{
+	flightrec_vfile.privsz = sizeof(struct vfile_flightrec_priv) +
+		nr_cpu_ids * sizeof(unsigned long);
+
+	return xnvfile_init_regular("flightrec", &flightrec_vfile,
+				    &cobalt_vfroot);
+}
+
+static inline void cleanup_flightrec_vfile(void)
+{
+	xnvfile_destroy_regular(&flightrec_vfile);
+}
+
+#else /* !CONFIG_XENO_OPT_VFILE */
+
+static inline int init_flightrec_vfile(void)
+{
+	return 0;
+}
+
+static inline void cleanup_flightrec_vfile(void) { }
+
+#endif /* !CONFIG_XENO_OPT_VFILE */
+
+static void free_rings(void)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		vfree(per_cpu(flightrec_rings, cpu));
+		per_cpu(flightrec_rings, cpu) = NULL;
+	}
+}
+
+int __init xnflightrec_init(void)
+{
+	struct flightrec_ring *ring;
+	unsigned long nr;
+	int cpu, ret;
+
+	nr = rounddown_pow_of_two(CONFIG_XENO_OPT_FLIGHTREC_EVENTS);
+	flightrec_mask = nr - 1;
+
+	for_each_online_cpu(cpu) {
+		ring = vzalloc(sizeof(*ring) + nr * sizeof(ring->events[0]));
+		if (ring == NULL) {
+			free_rings();
+			return -ENOMEM;
+		}
+		per_cpu(flightrec_rings, cpu) = ring;
+	}
+
+	ret = init_flightrec_vfile();
+	if (ret)
+		free_rings();
+
+	return ret;
+}
+
+void xnflightrec_cleanup(void)
+{
+	cleanup_flightrec_vfile();
+	xnflightrec_frozen = 1;
+	free_rings();
+}
+
+/** @} */
@@ -22,6 +22,7 @@
 #include <linux/kernel.h>
 #include <linux/log2.h>
 #include <linux/kconfig.h>
+#include <linux/percpu.h>
 #include <asm/pgtable.h>
 #include <cobalt/kernel/assert.h>
 #include <cobalt/kernel/heap.h>
@@ -46,6 +47,98 @@ static LIST_HEAD(heapq);	/* Heap list for v-file dump */
 
 static int nrheaps;
 
+/*
+ * Small blocks are identified by an index, either in the size
+ * classes or in the log2 buckets, which the per-CPU caches use for
+ * selecting their bin.
+ */
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+
+static const u32 class_size[XNHEAP_NCLASSES] = {
+	8, 16, 32, 48,
+	64, 80, 96, 112,
+	128, 160, 192, 224,
+	256, 320, 384, 448,
+	512, 640, 768, 896,
+	1024,
+};
+
+/*
+ * Return the smallest class fitting a request already rounded by
+ * xnheap_alloc(), i.e. either 8 bytes or a multiple of
+ * XNHEAP_MINALIGNSZ.
+ */
+static inline int small_index(u32 size)
+{
+	int log2size, step;
+
+	if (size <= 64)
+		return size / XNHEAP_MINALIGNSZ;
+
+	/* 2 ** log2size < size <= 2 ** (log2size + 1) */
+	log2size = fls(size - 1) - 1;
+	step = 1 << (log2size - 2);
+
+	return (log2size - 6) * 4 + 4 +
+		(size - (1 << log2size) + step - 1) / step;
+}
+
+static inline u32 small_size(int index)
+{
+	return class_size[index];
+}
+
+static inline int page_small_index(int type)
+{
+	return type >= XNHEAP_PCLASS ? type - XNHEAP_PCLASS : -1;
+}
+
+static inline int small_block_start(int index, u32 boffset)
+{
+	u32 bsize = class_size[index];
+
+	return boffset % bsize == 0 && boffset + bsize <= XNHEAP_PAGESZ;
+}
+
+#else /* !CONFIG_XENO_OPT_HEAP_SIZECLASS */
+
+static inline int small_index(u32 size)
+{
+	return order_base_2(size) - XNHEAP_MINLOG2;
+}
+
+static inline u32 small_size(int index)
+{
+	return XNHEAP_MINALLOCSZ << index;
+}
+
+static inline int page_small_index(int type)
+{
+	return type >= XNHEAP_MINLOG2 ? type - XNHEAP_MINLOG2 : -1;
+}
+
+static inline int small_block_start(int index, u32 boffset)
+{
+	return (boffset & (small_size(index) - 1)) == 0;
+}
+
+#endif /* !CONFIG_XENO_OPT_HEAP_SIZECLASS */
+
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+
+/* Number of free blocks of a size held by all per-CPU caches. */
+static int cached_blocks(const struct xnheap *heap, int index)
+{
+	int cpu, count = 0;
+
+	for_each_possible_cpu(cpu)
+		count += per_cpu_ptr(heap->cache, cpu)->bins[index].count;
+
+	return count;
+}
+
+#endif /* CONFIG_XENO_OPT_HEAP_CACHE */
+
 #ifdef CONFIG_XENO_OPT_VFILE
 
 static struct xnvfile_rev_tag vfile_tag;
@@ -59,6 +152,12 @@ struct vfile_priv {
 struct vfile_data {
 	size_t all_mem;
 	size_t free_mem;
+	size_t frag_mem;
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	size_t cached_mem;
+	unsigned long hits;
+	unsigned long misses;
+#endif
 	char name[XNOBJECT_NAME_LEN];
 };
 
@@ -87,7 +186,12 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
 	struct vfile_data *p = data;
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	struct xnheap_cache *cache;
+	int cpu;
+#endif
 	struct xnheap *heap;
+	int n;
 
 	if (priv->curr == NULL)
 		return 0;	/* We are done. */
@@ -103,37 +207,240 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 	p->free_mem = xnheap_get_free(heap);
 	knamecpy(p->name, heap->name);
 
+	/*
+	 * Free memory scattered over partially used pages cannot
+	 * serve page-sized requests, count it as fragmented.
+	 */
+	xnlock_get(&heap->lock);
+	p->frag_mem = 0;
+	for (n = 0; (XNHEAP_MINALLOCSZ << n) <= XNHEAP_PAGESZ; n++)
+		p->frag_mem += (size_t)heap->buckets[n].fcount
+			<< (n + XNHEAP_MINLOG2);
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+	for (n = 0; n < XNHEAP_NCLASSES; n++)
+		p->frag_mem += (size_t)heap->classes[n].fcount * class_size[n];
+#endif
+	xnlock_put(&heap->lock);
+
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	p->cached_mem = 0;
+	p->hits = p->misses = 0;
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(heap->cache, cpu);
+		p->hits += cache->hits;
+		p->misses += cache->misses;
+	}
+	for (n = 0; n < XNHEAP_CACHE_NBINS; n++)
+		p->cached_mem += (size_t)cached_blocks(heap, n) * small_size(n);
+#endif
+
 	return 1;
 }
 
+static inline unsigned int percent(unsigned long part, unsigned long whole)
+{
+	return whole ? (unsigned int)div_u64((u64)part * 100, whole) : 0;
+}
+
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+
 static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_data *p = data;
 
 	if (p == NULL)
-		xnvfile_printf(it, "%9s %9s  %s\n",
-			       "TOTAL", "FREE", "NAME");
+		xnvfile_printf(it, "%9s %9s %9s %5s %5s  %s\n",
+			       "TOTAL", "FREE", "CACHED", "HIT%", "FRAG%", "NAME");
 	else
-		xnvfile_printf(it, "%9Zu %9Zu  %s\n",
+		xnvfile_printf(it, "%9Zu %9Zu %9Zu %5u %5u  %s\n",
 			       p->all_mem,
 			       p->free_mem,
+			       p->cached_mem,
+			       percent(p->hits, p->hits + p->misses),
+			       percent(p->frag_mem, p->free_mem),
 			       p->name);
 	return 0;
 }
 
+#else /* !CONFIG_XENO_OPT_HEAP_CACHE */
+
+static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
+{
+	struct vfile_data *p = data;
+
+	if (p == NULL)
+		xnvfile_printf(it, "%9s %9s %5s  %s\n",
+			       "TOTAL", "FREE", "FRAG%", "NAME");
+	else
+		xnvfile_printf(it, "%9Zu %9Zu %5u  %s\n",
+			       p->all_mem,
+			       p->free_mem,
+			       percent(p->frag_mem, p->free_mem),
+			       p->name);
+	return 0;
+}
+
+#endif /* !CONFIG_XENO_OPT_HEAP_CACHE */
+
 static struct xnvfile_snapshot_ops vfile_ops = {
 	.rewind = vfile_rewind,
 	.next = vfile_next,
 	.show = vfile_show,
 };
 
+/*
+ * The heapclass file reports the occupancy of the pages split into
+ * blocks of each size, which tells how much memory is lost to
+ * rounding and partially used pages, so that heaps may be sized
+ * tightly.
+ */
+
+static struct xnvfile_snapshot_ops class_vfile_ops;
+
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+#define NR_SMALL_BUCKETS  (XNHEAP_NBUCKETS + XNHEAP_NCLASSES)
+#else
+#define NR_SMALL_BUCKETS  XNHEAP_NBUCKETS
+#endif
+
+struct class_vfile_priv {
+	struct xnheap *curr;
+	int bucket;
+};
+
+struct class_vfile_data {
+	u32 bsize;
+	int npages;
+	int nbusy;
+	int nfree;
+	char name[XNOBJECT_NAME_LEN];
+};
+
+static struct xnvfile_snapshot class_vfile = {
+	.privsz = sizeof(struct class_vfile_priv),
+	.datasz = sizeof(struct class_vfile_data),
+	.tag = &vfile_tag,
+	.ops = &class_vfile_ops,
+};
+
+static int class_vfile_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct class_vfile_priv *priv = xnvfile_iterator_priv(it);
+
+	priv->bucket = 0;
+
+	if (list_empty(&heapq)) {
+		priv->curr = NULL;
+		return 0;
+	}
+
+	priv->curr = list_first_entry(&heapq, struct xnheap, next);
+
+	return nrheaps * NR_SMALL_BUCKETS;
+}
+
+static int class_vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
+{
+	struct class_vfile_priv *priv = xnvfile_iterator_priv(it);
+	struct class_vfile_data *p = data;
+	struct xnbucket *bucket;
+	struct xnheap *heap;
+	int n;
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	int cached;
+#endif
+
+	for (;;) {
+		heap = priv->curr;
+		if (heap == NULL)
+			return 0;	/* We are done. */
+
+		n = priv->bucket++;
+		if (n < XNHEAP_NBUCKETS) {
+			p->bsize = XNHEAP_MINALLOCSZ << n;
+			/* Multi-page blocks are reported by the heap file. */
+			if (p->bsize > XNHEAP_PAGESZ)
+				continue;
+			bucket = heap->buckets + n;
+		}
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+		else if (n < NR_SMALL_BUCKETS) {
+			p->bsize = class_size[n - XNHEAP_NBUCKETS];
+			bucket = heap->classes + n - XNHEAP_NBUCKETS;
+		}
+#endif
+		else {
+			priv->bucket = 0;
+			if (list_is_last(&heap->next, &heapq))
+				priv->curr = NULL;
+			else
+				priv->curr = list_entry(heap->next.next,
+							struct xnheap, next);
+			continue;
+		}
+
+		xnlock_get(&heap->lock);
+		p->npages = bucket->npages;
+		p->nfree = bucket->fcount;
+		xnlock_put(&heap->lock);
+		if (p->npages == 0)
+			continue;
+
+		p->nbusy = p->npages * (XNHEAP_PAGESZ / p->bsize) - p->nfree;
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+		/* Blocks held in per-CPU caches are free for users. */
+		if (p->bsize <= XNHEAP_CACHE_MAXSZ) {
+			cached = cached_blocks(heap, small_index(p->bsize));
+			p->nbusy -= cached;
+			p->nfree += cached;
+		}
+#endif
+		knamecpy(p->name, heap->name);
+
+		return 1;
+	}
+}
+
+static int class_vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
+{
+	struct class_vfile_data *p = data;
+	unsigned long pagemem;
+
+	if (p == NULL) {
+		xnvfile_printf(it, "%6s %6s %8s %8s %5s  %s\n",
+			       "BSIZE", "PAGES", "BUSY", "FREE", "LOSS%", "NAME");
+		return 0;
+	}
+
+	/*
+	 * Loss is the share of the pages not covered by busy
+	 * blocks, including the unused page remainder.
+	 */
+	pagemem = (unsigned long)p->npages * XNHEAP_PAGESZ;
+	xnvfile_printf(it, "%6u %6d %8d %8d %5u  %s\n",
+		       p->bsize, p->npages, p->nbusy, p->nfree,
+		       percent(pagemem - (unsigned long)p->nbusy * p->bsize,
+			       pagemem),
+		       p->name);
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops class_vfile_ops = {
+	.rewind = class_vfile_rewind,
+	.next = class_vfile_next,
+	.show = class_vfile_show,
+};
+
 void xnheap_init_proc(void)
 {
 	xnvfile_init_snapshot("heap", &vfile, &cobalt_vfroot);
+	xnvfile_init_snapshot("heapclass", &class_vfile, &cobalt_vfroot);
 }
 
 void xnheap_cleanup_proc(void)
 {
+	xnvfile_destroy_snapshot(&class_vfile);
 	xnvfile_destroy_snapshot(&vfile);
 }
 
@@ -146,6 +453,9 @@ static void init_freelist(struct xnheap *heap)
 
 	heap->used = 0;
 	memset(heap->buckets, 0, sizeof(heap->buckets));
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+	memset(heap->classes, 0, sizeof(heap->classes));
+#endif
 	lastpgnum = heap->npages - 1;
 
 	/* Mark each page as free in the page map. */
@@ -195,6 +505,9 @@ static void init_freelist(struct xnheap *heap)
  */
 int xnheap_init(struct xnheap *heap, void *membase, u32 size)
 {
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	int cpu;
+#endif
 	spl_t s;
 
 	secondary_mode_only();
@@ -228,6 +541,16 @@ int xnheap_init(struct xnheap *heap, void *membase, u32 size)
 	if (heap->pagemap == NULL)
 		return -ENOMEM;
 
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	heap->cache = alloc_percpu(struct xnheap_cache);
+	if (heap->cache == NULL) {
+		kfree(heap->pagemap);
+		return -ENOMEM;
+	}
+	for_each_possible_cpu(cpu)
+		xnlock_init(&per_cpu_ptr(heap->cache, cpu)->lock);
+#endif
+
 	xnlock_init(&heap->lock);
 	init_freelist(heap);
 
@@ -265,6 +588,9 @@ void xnheap_destroy(struct xnheap *heap)
 	nrheaps--;
 	xnvfile_touch_tag(&vfile_tag);
 	xnlock_put_irqrestore(&nklock, s);
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	free_percpu(heap->cache);
+#endif
 	kfree(heap->pagemap);
 }
 EXPORT_SYMBOL_GPL(xnheap_destroy);
@@ -381,125 +707,101 @@ splitpage:
 	return headpage;
 }
 
-/**
- * @fn void *xnheap_alloc(struct xnheap *heap, u32 size)
- * @brief Allocate a memory block from a memory heap.
- *
- * Allocates a contiguous region of memory from an active memory heap.
- * Such allocation is guaranteed to be time-bounded.
- *
- * @param heap The descriptor address of the heap to get memory from.
- *
- * @param size The size in bytes of the requested block. Sizes lower
- * or equal to the page size are rounded either to the minimum
- * allocation size if lower than this value, or to the minimum
- * alignment size if greater or equal to this value. In the current
- * implementation, with MINALLOC = 8 and MINALIGN = 16, a 7 bytes
- * request will be rounded to 8 bytes, and a 17 bytes request will be
- * rounded to 32.
- *
- * @return The address of the allocated region upon success, or NULL
- * if no memory is available from the specified heap.
- *
- * @coretags{unrestricted}
+/*
+ * alloc_block() -- Pull a block of 2 ** log2size bytes from the
+ * bucketed memory space. The caller must have acquired the heap
+ * lock.
  */
-void *xnheap_alloc(struct xnheap *heap, u32 size)
+static caddr_t alloc_block(struct xnheap *heap, u32 bsize, int log2size)
 {
-	u32 pagenum, bsize;
-	int log2size, ilog;
+	struct xnbucket *bucket = heap->buckets + log2size - XNHEAP_MINLOG2;
 	caddr_t block;
-	spl_t s;
+	u32 pagenum;
 
-	if (size == 0)
-		return NULL;
+	block = bucket->freelist;
+	if (block == NULL) {
+		block = get_free_range(heap, bsize, log2size);
+		if (block == NULL)
+			return NULL;
+		if (bsize <= XNHEAP_PAGESZ) {
+			bucket->fcount += (XNHEAP_PAGESZ >> log2size) - 1;
+			bucket->npages++;
+		}
+	} else {
+		if (bsize <= XNHEAP_PAGESZ)
+			--bucket->fcount;
+		XENO_BUG_ON(COBALT, (caddr_t)block < heap->membase ||
+			    (caddr_t)block >= heap->memlim);
+		pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
+		++heap->pagemap[pagenum].bcount;
+	}
+	bucket->freelist = *((caddr_t *)block);
+	heap->used += bsize;
 
-	/*
-	 * Sizes lower or equal to the page size are rounded either to
-	 * the minimum allocation size if lower than this value, or to
-	 * the minimum alignment size if greater or equal to this
-	 * value.
-	 */
-	if (size > XNHEAP_PAGESZ)
-		size = ALIGN(size, XNHEAP_PAGESZ);
-	else if (size <= XNHEAP_MINALIGNSZ)
-		size = ALIGN(size, XNHEAP_MINALLOCSZ);
-	else
-		size = ALIGN(size, XNHEAP_MINALIGNSZ);
+	return block;
+}
 
-	/*
-	 * It is more space efficient to directly allocate pages from
-	 * the free page list whenever the requested size is greater
-	 * than 2 times the page size. Otherwise, use the bucketed
-	 * memory blocks.
-	 */
-	if (likely(size <= XNHEAP_PAGESZ * 2)) {
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+
+/*
+ * alloc_class_block() -- Pull a block from a size class, splitting
+ * a fresh page for that class if none is free. The caller must have
+ * acquired the heap lock.
+ */
+static caddr_t alloc_class_block(struct xnheap *heap, int class)
+{
+	struct xnbucket *bucket = heap->classes + class;
+	u32 pagenum, bsize = class_size[class];
+	caddr_t block, eblock;
+	int nblocks;
+
+	block = bucket->freelist;
+	if (block == NULL) {
+		block = get_free_range(heap, XNHEAP_PAGESZ, 0);
+		if (block == NULL)
+			return NULL;
 		/*
-		 * Find the first power of two greater or equal to the
-		 * rounded size.
+		 * Unlike log2 blocks, class blocks may not fill the
+		 * page exactly, the remainder is left unused.
 		 */
-		bsize = size < XNHEAP_MINALLOCSZ ? XNHEAP_MINALLOCSZ : size;
-		log2size = order_base_2(bsize);
-		bsize = 1 << log2size;
-		ilog = log2size - XNHEAP_MINLOG2;
-		xnlock_get_irqsave(&heap->lock, s);
-		block = heap->buckets[ilog].freelist;
-		if (block == NULL) {
-			block = get_free_range(heap, bsize, log2size);
-			if (block == NULL)
-				goto out;
-			if (bsize <= XNHEAP_PAGESZ)
-				heap->buckets[ilog].fcount += (XNHEAP_PAGESZ >> log2size) - 1;
-		} else {
-			if (bsize <= XNHEAP_PAGESZ)
-				--heap->buckets[ilog].fcount;
-			XENO_BUG_ON(COBALT, (caddr_t)block < heap->membase ||
-				    (caddr_t)block >= heap->memlim);
-			pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
-			++heap->pagemap[pagenum].bcount;
-		}
-		heap->buckets[ilog].freelist = *((caddr_t *)block);
-		heap->used += bsize;
+		nblocks = XNHEAP_PAGESZ / bsize;
+		for (eblock = block + (nblocks - 1) * bsize;
+		     block < eblock; block += bsize)
+			*((caddr_t *)block) = block + bsize;
+		*((caddr_t *)eblock) = NULL;
+		block = eblock - (nblocks - 1) * bsize;
+		pagenum = (block - heap->membase) / XNHEAP_PAGESZ;
+		heap->pagemap[pagenum].type = XNHEAP_PCLASS + class;
+		bucket->fcount += nblocks - 1;
+		bucket->npages++;
 	} else {
-		if (size > heap->size)
-			return NULL;
-
-		xnlock_get_irqsave(&heap->lock, s);
-
-		/* Directly request a free page range. */
-		block = get_free_range(heap, size, 0);
-		if (block)
-			heap->used += size;
+		--bucket->fcount;
+		XENO_BUG_ON(COBALT, (caddr_t)block < heap->membase ||
+			    (caddr_t)block >= heap->memlim);
+		pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
+		++heap->pagemap[pagenum].bcount;
 	}
-out:
-	xnlock_put_irqrestore(&heap->lock, s);
+	bucket->freelist = *((caddr_t *)block);
+	heap->used += bsize;
 
 	return block;
 }
-EXPORT_SYMBOL_GPL(xnheap_alloc);
 
-/**
- * @fn void xnheap_free(struct xnheap *heap, void *block)
- * @brief Release a block to a memory heap.
- *
- * Releases a memory block to a heap.
- *
- * @param heap The heap descriptor.
- *
- * @param block The block to be returned to the heap.
- *
- * @coretags{unrestricted}
+#endif /* CONFIG_XENO_OPT_HEAP_SIZECLASS */
+
+/*
+ * free_block() -- Release a block to the heap. The caller must have
+ * acquired the heap lock.
  */
-void xnheap_free(struct xnheap *heap, void *block)
+static int free_block(struct xnheap *heap, void *block)
 {
 	caddr_t freepage, lastpage, nextpage, tailpage, freeptr, *tailptr;
-	int log2size, npages, nblocks, xpage, ilog;
 	u32 pagenum, pagecont, boffset, bsize;
-	spl_t s;
-
-	xnlock_get_irqsave(&heap->lock, s);
+	int log2size, npages, nblocks, xpage, __maybe_unused n;
+	struct xnbucket *bucket;
 
 	if ((caddr_t)block < heap->membase || (caddr_t)block >= heap->memlim)
-		goto bad_block;
+		return -EINVAL;
 
 	/* Compute the heading page number in the page map. */
 	pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
@@ -508,10 +810,7 @@ void xnheap_free(struct xnheap *heap, void *block)
 	switch (heap->pagemap[pagenum].type) {
 	case XNHEAP_PFREE:	/* Unallocated page? */
 	case XNHEAP_PCONT:	/* Not a range heading page? */
-	bad_block:
-		xnlock_put_irqrestore(&heap->lock, s);
-		XENO_BUG(COBALT);
-		return;
+		return -EINVAL;
 
 	case XNHEAP_PLIST:
 		npages = 1;
@@ -551,24 +850,36 @@ void xnheap_free(struct xnheap *heap, void *block)
 		break;
 
 	default:
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+		if (heap->pagemap[pagenum].type >= XNHEAP_PCLASS) {
+			n = heap->pagemap[pagenum].type - XNHEAP_PCLASS;
+			if (!small_block_start(n, boffset))
+				return -EINVAL;
+			bucket = heap->classes + n;
+			bsize = class_size[n];
+			goto release_block;
+		}
+#endif
 		log2size = heap->pagemap[pagenum].type;
 		bsize = (1 << log2size);
 		if ((boffset & (bsize - 1)) != 0) /* Not a block start? */
-			goto bad_block;
+			return -EINVAL;
 
+		bucket = heap->buckets + log2size - XNHEAP_MINLOG2;
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+	release_block:
+#endif
 		/*
 		 * Return the page to the free list if we've just
 		 * freed its last busy block. Pages from multi-page
 		 * blocks are always pushed to the free list (bcount
 		 * value for the heading page is always 1).
 		 */
-
-		ilog = log2size - XNHEAP_MINLOG2;
 		if (likely(--heap->pagemap[pagenum].bcount > 0)) {
 			/* Return the block to the bucketed memory space. */
-			*((caddr_t *)block) = heap->buckets[ilog].freelist;
-			heap->buckets[ilog].freelist = block;
-			++heap->buckets[ilog].fcount;
+			*((caddr_t *)block) = bucket->freelist;
+			bucket->freelist = block;
+			++bucket->fcount;
 			break;
 		}
 
@@ -586,17 +897,18 @@ void xnheap_free(struct xnheap *heap, void *block)
 		block = freepage;
 		tailpage = freepage;
 		nextpage = freepage + XNHEAP_PAGESZ;
-		nblocks = XNHEAP_PAGESZ >> log2size;
-		heap->buckets[ilog].fcount -= (nblocks - 1);
-		XENO_BUG_ON(COBALT, heap->buckets[ilog].fcount < 0);
+		nblocks = XNHEAP_PAGESZ / bsize;
+		bucket->fcount -= (nblocks - 1);
+		bucket->npages--;
+		XENO_BUG_ON(COBALT, bucket->fcount < 0);
 
 		/*
 		 * Still easy case: all free blocks are laid on a
 		 * single page we are now releasing. Just clear the
 		 * bucket and bail out.
 		 */
-		if (likely(heap->buckets[ilog].fcount == 0)) {
-			heap->buckets[ilog].freelist = NULL;
+		if (likely(bucket->fcount == 0)) {
+			bucket->freelist = NULL;
 			goto free_pages;
 		}
 
@@ -608,7 +920,7 @@ void xnheap_free(struct xnheap *heap, void *block)
 		 * traversed, or we hit the end of list, whichever
 		 * comes first.
 		 */
-		for (tailptr = &heap->buckets[ilog].freelist, freeptr = *tailptr, xpage = 1;
+		for (tailptr = &bucket->freelist, freeptr = *tailptr, xpage = 1;
 		     freeptr != NULL && nblocks > 0; freeptr = *((caddr_t *) freeptr)) {
 			if (unlikely(freeptr < freepage || freeptr >= nextpage)) {
 				if (unlikely(xpage)) {
@@ -627,7 +939,328 @@ void xnheap_free(struct xnheap *heap, void *block)
 
 	heap->used -= bsize;
 
+	return 0;
+}
+
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+
+static inline caddr_t alloc_small(struct xnheap *heap, int index)
+{
+	return alloc_class_block(heap, index);
+}
+
+#else /* !CONFIG_XENO_OPT_HEAP_SIZECLASS */
+
+static inline caddr_t alloc_small(struct xnheap *heap, int index)
+{
+	return alloc_block(heap, small_size(index), index + XNHEAP_MINLOG2);
+}
+
+#endif /* !CONFIG_XENO_OPT_HEAP_SIZECLASS */
+
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+
+/*
+ * The per-CPU caches are mostly accessed by their owner CPU with
+ * hard irqs off, under a cache lock which is only contended when an
+ * exhausted heap reclaims the blocks kept in reserve by all CPUs, so
+ * that the fast paths do not grab the heap lock. Cached blocks are
+ * still accounted as busy by the page map, which guarantees that
+ * their page map entry cannot change until they are flushed back.
+ * Locking order is cache lock, then heap lock.
+ */
+
+static void cache_flush(struct xnheap *heap, struct xnheap_fastbin *bin,
+			int count)
+{
+	caddr_t block;
+
+	while (count-- > 0 && bin->freelist) {
+		block = bin->freelist;
+		bin->freelist = *((caddr_t *)block);
+		bin->count--;
+		free_block(heap, block);
+	}
+}
+
+static void cache_drain(struct xnheap *heap, struct xnheap_cache *cache)
+{
+	int n;
+
+	for (n = 0; n < XNHEAP_CACHE_NBINS; n++)
+		cache_flush(heap, cache->bins + n, XNHEAP_CACHE_DEPTH);
+}
+
+/*
+ * The heap is exhausted: give back the blocks every CPU keeps in
+ * reserve, then retry once. This is bounded by the number of CPUs
+ * times the cache capacity, and only happens on the way to an
+ * allocation failure.
+ */
+static caddr_t cache_reclaim(struct xnheap *heap, int index)
+{
+	struct xnheap_cache *cache;
+	caddr_t block;
+	int cpu;
+	spl_t s;
+
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(heap->cache, cpu);
+		xnlock_get_irqsave(&cache->lock, s);
+		xnlock_get(&heap->lock);
+		cache_drain(heap, cache);
+		xnlock_put(&heap->lock);
+		xnlock_put_irqrestore(&cache->lock, s);
+	}
+
+	xnlock_get_irqsave(&heap->lock, s);
+	block = alloc_small(heap, index);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	return block;
+}
+
+static caddr_t cache_alloc(struct xnheap *heap, int index)
+{
+	struct xnheap_fastbin *bin;
+	struct xnheap_cache *cache;
+	caddr_t block, extra;
+	int n;
+	spl_t s;
+
+	splhigh(s);
+
+	cache = raw_cpu_ptr(heap->cache);
+	xnlock_get(&cache->lock);
+	bin = cache->bins + index;
+	block = bin->freelist;
+	if (likely(block)) {
+		bin->freelist = *((caddr_t *)block);
+		bin->count--;
+		cache->hits++;
+		goto out;
+	}
+
+	cache->misses++;
+
+	/* Refill the bin with a batch of blocks in a single lock section. */
+	xnlock_get(&heap->lock);
+
+	block = alloc_small(heap, index);
+	if (unlikely(block == NULL)) {
+		xnlock_put(&heap->lock);
+		xnlock_put(&cache->lock);
+		splexit(s);
+		return cache_reclaim(heap, index);
+	}
+
+	for (n = 1; n < XNHEAP_CACHE_BATCH; n++) {
+		extra = alloc_small(heap, index);
+		if (extra == NULL)
+			break;
+		*((caddr_t *)extra) = bin->freelist;
+		bin->freelist = extra;
+		bin->count++;
+	}
+
+	xnlock_put(&heap->lock);
+out:
+	xnlock_put(&cache->lock);
+	splexit(s);
+
+	return block;
+}
+
+static int cache_free(struct xnheap *heap, void *block)
+{
+	struct xnheap_fastbin *bin;
+	struct xnheap_cache *cache;
+	u32 pagenum, boffset;
+	int index;
+	spl_t s;
+
+	if ((caddr_t)block < heap->membase || (caddr_t)block >= heap->memlim)
+		return -EINVAL;
+
+	pagenum = ((caddr_t)block - heap->membase) / XNHEAP_PAGESZ;
+	boffset = ((caddr_t)block - (heap->membase + pagenum * XNHEAP_PAGESZ));
+	index = page_small_index(heap->pagemap[pagenum].type);
+	/*
+	 * Let the slow path deal with large and invalid blocks,
+	 * including those from unallocated pages.
+	 */
+	if (index < 0 || index >= XNHEAP_CACHE_NBINS ||
+	    !small_block_start(index, boffset))
+		return -EINVAL;
+
+	splhigh(s);
+
+	cache = raw_cpu_ptr(heap->cache);
+	xnlock_get(&cache->lock);
+	bin = cache->bins + index;
+	if (unlikely(bin->count >= XNHEAP_CACHE_DEPTH)) {
+		xnlock_get(&heap->lock);
+		cache_flush(heap, bin, XNHEAP_CACHE_BATCH);
+		xnlock_put(&heap->lock);
+	}
+
+	*((caddr_t *)block) = bin->freelist;
+	bin->freelist = block;
+	bin->count++;
+
+	xnlock_put(&cache->lock);
+	splexit(s);
+
+	return 0;
+}
+
+/**
+ * @fn u32 xnheap_get_free(const struct xnheap *heap)
+ * @brief Return the amount of free memory in a heap.
+ *
+ * The blocks held in reserve by the per-CPU caches count as free,
+ * since an allocation reclaims them before failing. The result is
+ * a snapshot which may be stale on return.
+ *
+ * @param heap The heap descriptor.
+ *
+ * @return The number of free bytes.
+ *
+ * @coretags{unrestricted}
+ */
+u32 xnheap_get_free(const struct xnheap *heap)
+{
+	u32 cached = 0;
+	int n;
+
+	for (n = 0; n < XNHEAP_CACHE_NBINS; n++)
+		cached += cached_blocks(heap, n) * small_size(n);
+
+	return heap->size - heap->used + cached;
+}
+EXPORT_SYMBOL_GPL(xnheap_get_free);
+
+#endif /* CONFIG_XENO_OPT_HEAP_CACHE */
+
+/**
+ * @fn void *xnheap_alloc(struct xnheap *heap, u32 size)
+ * @brief Allocate a memory block from a memory heap.
+ *
+ * Allocates a contiguous region of memory from an active memory heap.
+ * Such allocation is guaranteed to be time-bounded.
+ *
+ * @param heap The descriptor address of the heap to get memory from.
+ *
+ * @param size The size in bytes of the requested block. Sizes lower
+ * or equal to the page size are rounded either to the minimum
+ * allocation size if lower than this value, or to the minimum
+ * alignment size if greater or equal to this value. In the current
+ * implementation, with MINALLOC = 8 and MINALIGN = 16, a 7 bytes
+ * request will be rounded to 8 bytes, and a 17 bytes request will be
+ * rounded to 32.
+ *
+ * @return The address of the allocated region upon success, or NULL
+ * if no memory is available from the specified heap.
+ *
+ * @coretags{unrestricted}
+ */
+void *xnheap_alloc(struct xnheap *heap, u32 size)
+{
+	int log2size, __maybe_unused index;
+	caddr_t block;
+	u32 bsize;
+	spl_t s;
+
+	if (size == 0)
+		return NULL;
+
+	/*
+	 * Sizes lower or equal to the page size are rounded either to
+	 * the minimum allocation size if lower than this value, or to
+	 * the minimum alignment size if greater or equal to this
+	 * value.
+	 */
+	if (size > XNHEAP_PAGESZ)
+		size = ALIGN(size, XNHEAP_PAGESZ);
+	else if (size <= XNHEAP_MINALIGNSZ)
+		size = ALIGN(size, XNHEAP_MINALLOCSZ);
+	else
+		size = ALIGN(size, XNHEAP_MINALIGNSZ);
+
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	if (size <= XNHEAP_CACHE_MAXSZ)
+		return cache_alloc(heap, small_index(size));
+#endif
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+	if (size <= XNHEAP_CLASS_MAXSZ) {
+		index = small_index(size);
+		xnlock_get_irqsave(&heap->lock, s);
+		block = alloc_small(heap, index);
+		goto out;
+	}
+#endif
+	/*
+	 * It is more space efficient to directly allocate pages from
+	 * the free page list whenever the requested size is greater
+	 * than 2 times the page size. Otherwise, use the bucketed
+	 * memory blocks.
+	 */
+	if (likely(size <= XNHEAP_PAGESZ * 2)) {
+		/*
+		 * Find the first power of two greater or equal to the
+		 * rounded size.
+		 */
+		bsize = size < XNHEAP_MINALLOCSZ ? XNHEAP_MINALLOCSZ : size;
+		log2size = order_base_2(bsize);
+		bsize = 1 << log2size;
+		xnlock_get_irqsave(&heap->lock, s);
+		block = alloc_block(heap, bsize, log2size);
+	} else {
+		if (size > heap->size)
+			return NULL;
+
+		xnlock_get_irqsave(&heap->lock, s);
+
+		/* Directly request a free page range. */
+		block = get_free_range(heap, size, 0);
+		if (block)
+			heap->used += size;
+	}
+#ifdef CONFIG_XENO_OPT_HEAP_SIZECLASS
+out:
+#endif
 	xnlock_put_irqrestore(&heap->lock, s);
+
+	return block;
+}
+EXPORT_SYMBOL_GPL(xnheap_alloc);
+
+/**
+ * @fn void xnheap_free(struct xnheap *heap, void *block)
+ * @brief Release a block to a memory heap.
+ *
+ * Releases a memory block to a heap.
+ *
+ * @param heap The heap descriptor.
+ *
+ * @param block The block to be returned to the heap.
+ *
+ * @coretags{unrestricted}
+ */
+void xnheap_free(struct xnheap *heap, void *block)
+{
+	int ret;
+	spl_t s;
+
+#ifdef CONFIG_XENO_OPT_HEAP_CACHE
+	if (cache_free(heap, block) == 0)
+		return;
+#endif
+	xnlock_get_irqsave(&heap->lock, s);
+	ret = free_block(heap, block);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	XENO_BUG_ON(COBALT, ret);
 }
 EXPORT_SYMBOL_GPL(xnheap_free);
 
@@ -121,6 +121,10 @@ devm_hwmon_device_register_with_groups(struct device *dev, const char *name,
 
 #define reinit_completion(__x)	INIT_COMPLETION(*(__x))
 
+#define raw_read_seqcount_begin(__s)	read_seqcount_begin(__s)
+#define raw_write_seqcount_begin(__s)	write_seqcount_begin(__s)
+#define raw_write_seqcount_end(__s)	write_seqcount_end(__s)
+
 #endif /* < 3.13 */
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,11,0)
@@ -30,6 +30,7 @@
 #include <cobalt/kernel/pipe.h>
 #include <cobalt/kernel/select.h>
 #include <cobalt/kernel/vdso.h>
+#include <cobalt/kernel/flightrec.h>
 #include <rtdm/fd.h>
 #include "rtdm/internal.h"
 #include "posix/internal.h"
@@ -356,10 +357,14 @@ static int __init xenomai_init(void)
 	if (ret)
 		goto fail;
 
-	ret = mach_setup();
+	ret = xnflightrec_init();
 	if (ret)
 		goto cleanup_proc;
 
+	ret = mach_setup();
+	if (ret)
+		goto cleanup_flightrec;
+
 	xnintr_mount();
 
 	ret = xnpipe_mount();
@@ -408,6 +413,8 @@ cleanup_pipe:
 	xnpipe_umount();
 cleanup_mach:
 	mach_cleanup();
+cleanup_flightrec:
+	xnflightrec_cleanup();
 cleanup_proc:
 	xnprocfs_cleanup_tree();
 fail:
@@ -26,6 +26,7 @@
 #include <cobalt/kernel/stat.h>
 #include <cobalt/kernel/clock.h>
 #include <cobalt/kernel/assert.h>
+#include <cobalt/kernel/flightrec.h>
 #include <trace/events/cobalt-core.h>
 
 /**
@@ -201,6 +202,8 @@ void xnintr_core_clock_handler(void)
 	prev = switch_core_irqstats(sched);
 
 	trace_cobalt_clock_entry(per_cpu(ipipe_percpu.hrtimer_irq, cpu));
+	xnflightrec_log(XNFLIGHTREC_IRQ, 0,
+			per_cpu(ipipe_percpu.hrtimer_irq, cpu));
 
 	++sched->inesting;
 	sched->lflags |= XNINIRQ;
@@ -308,6 +311,7 @@ static void xnintr_vec_handler(unsigned int irq, void *cookie)
 	prev  = xnstat_exectime_get_current(sched);
 	start = xnstat_exectime_now();
 	trace_cobalt_irq_entry(irq);
+	xnflightrec_log(XNFLIGHTREC_IRQ, 0, irq);
 
 	++sched->inesting;
 	sched->lflags |= XNINIRQ;
@@ -380,6 +384,7 @@ static void xnintr_edge_vec_handler(unsigned int irq, void *cookie)
 	prev  = xnstat_exectime_get_current(sched);
 	start = xnstat_exectime_now();
 	trace_cobalt_irq_entry(irq);
+	xnflightrec_log(XNFLIGHTREC_IRQ, 0, irq);
 
 	++sched->inesting;
 	sched->lflags |= XNINIRQ;
@@ -584,6 +589,7 @@ static void xnintr_irq_handler(unsigned int irq, void *cookie)
 	prev  = xnstat_exectime_get_current(sched);
 	start = xnstat_exectime_now();
 	trace_cobalt_irq_entry(irq);
+	xnflightrec_log(XNFLIGHTREC_IRQ, 0, irq);
 
 	++sched->inesting;
 	sched->lflags |= XNINIRQ;
@@ -19,6 +19,7 @@
  */
 #include <linux/module.h>
 #include <cobalt/kernel/lock.h>
+#include <cobalt/kernel/objlock.h>
 
 /**
  * @ingroup cobalt_core
@@ -62,4 +63,14 @@ DEFINE_PER_CPU(struct xnlockinfo, xnlock_stats);
 EXPORT_PER_CPU_SYMBOL_GPL(xnlock_stats);
 #endif
 
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+struct xnobjlock_stripe xnobjlock_stripes[XNOBJLOCK_STRIPES] = {
+	[0 ... XNOBJLOCK_STRIPES - 1] = { .lock = XNARCH_LOCK_UNLOCKED },
+};
+EXPORT_SYMBOL_GPL(xnobjlock_stripes);
+
+DEFINE_PER_CPU(struct xnobjlock_stats, xnobjlock_stats);
+EXPORT_PER_CPU_SYMBOL_GPL(xnobjlock_stats);
+#endif
+
 /** @} */
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/eventpoll.h>
+#include <cobalt/kernel/select.h>
+#include <rtdm/fd.h>
+#include "internal.h"
+#include "clock.h"
+#include "epoll.h"
+
+/*
+ * An epoll instance is a RTDM file descriptor owning a selector, to
+ * which the descriptors of the interest set remain bound until they
+ * are removed or closed. Waiting only scans the selector's ready
+ * list, regardless of the size of the interest set.
+ */
+struct cobalt_epoll {
+	struct rtdm_fd fd;
+	struct xnselector *selector;
+	/* Serializes updates to the interest set. */
+	struct mutex ctl_lock;
+	/* User data returned with events, indexed by target fd. */
+	__u64 data[__FD_SETSIZE];
+};
+
+#define COBALT_EPOLL_EVENTS	(POLLIN | POLLOUT | POLLPRI)
+/* Always reported by Linux, hence accepted but ignored. */
+#define COBALT_EPOLL_IGNORED	(POLLERR | POLLHUP)
+
+/* Maximum number of events returned by a single wait. */
+#define COBALT_EPOLL_MAXEVENTS	64
+
+static const unsigned int epoll_types[XNSELECT_MAX_TYPES] = {
+	[XNSELECT_READ] = POLLIN,
+	[XNSELECT_WRITE] = POLLOUT,
+	[XNSELECT_EXCEPT] = POLLPRI,
+};
+
+static void epoll_close(struct rtdm_fd *fd)
+{
+	struct cobalt_epoll *ep = container_of(fd, struct cobalt_epoll, fd);
+
+	/* The selector and its bindings are released asynchronously. */
+	xnselector_destroy(ep->selector);
+	kfree(ep);
+}
+
+static struct rtdm_fd_ops epoll_ops = {
+	.close = epoll_close,
+};
+
+COBALT_SYSCALL(epoll_create, lostage, (int flags))
+{
+	struct cobalt_epoll *ep;
+	int ret, ufd;
+
+	if (flags & ~EPOLL_CLOEXEC)
+		return -EINVAL;
+
+	ep = kzalloc(sizeof(*ep), GFP_KERNEL);
+	if (ep == NULL)
+		return -ENOMEM;
+
+	ep->selector = xnmalloc(sizeof(*ep->selector));
+	if (ep->selector == NULL) {
+		ret = -ENOMEM;
+		goto fail_selector;
+	}
+
+	xnselector_init(ep->selector);
+	mutex_init(&ep->ctl_lock);
+
+	ufd = __rtdm_anon_getfd("[cobalt-epoll]",
+				O_RDWR | (flags & EPOLL_CLOEXEC));
+	if (ufd < 0) {
+		ret = ufd;
+		goto fail_getfd;
+	}
+
+	ret = rtdm_fd_enter(&ep->fd, ufd, COBALT_EPOLL_MAGIC, &epoll_ops);
+	if (ret < 0)
+		goto fail;
+
+	return ufd;
+fail:
+	__rtdm_anon_putfd(ufd);
+fail_getfd:
+	xnselector_destroy(ep->selector);
+fail_selector:
+	kfree(ep);
+
+	return ret;
+}
+
+static inline struct cobalt_epoll *epoll_get(int ufd)
+{
+	struct rtdm_fd *fd;
+
+	fd = rtdm_fd_get(ufd, COBALT_EPOLL_MAGIC);
+	if (IS_ERR(fd))
+		return ERR_CAST(fd);
+
+	return container_of(fd, struct cobalt_epoll, fd);
+}
+
+static inline void epoll_put(struct cobalt_epoll *ep)
+{
+	rtdm_fd_put(&ep->fd);
+}
+
+static bool epoll_bound_p(struct cobalt_epoll *ep, int ufd)
+{
+	unsigned int type;
+	bool bound = false;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	for (type = 0; type < XNSELECT_MAX_TYPES; type++)
+		if (xnselector_bound_p(ep->selector, type, ufd))
+			bound = true;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return bound;
+}
+
+static int epoll_add(struct cobalt_epoll *ep, int ufd,
+		     const struct epoll_event *ev)
+{
+	unsigned int type;
+	int ret;
+
+	if (epoll_bound_p(ep, ufd))
+		return -EEXIST;
+
+	ep->data[ufd] = ev->data;
+
+	for (type = 0; type < XNSELECT_MAX_TYPES; type++) {
+		if (!(ev->events & epoll_types[type]))
+			continue;
+		ret = rtdm_fd_select(ufd, ep->selector, type);
+		if (ret) {
+			xnselector_unbind(ep->selector, ufd);
+			/*
+			 * Distinguish the target from the epoll
+			 * descriptor, like Linux does for files which
+			 * cannot be polled.
+			 */
+			return ret == -EBADF || ret == -ENOENT ? -EPERM : ret;
+		}
+	}
+
+	return 0;
+}
+
+int __cobalt_epoll_ctl(int epfd, int op, int fd,
+		       const struct epoll_event *ev)
+{
+	struct cobalt_epoll *ep;
+	int ret = 0;
+
+	if (fd < 0 || fd >= __FD_SETSIZE || fd == epfd)
+		return -EINVAL;
+
+	if (op != EPOLL_CTL_DEL &&
+	    (ev->events & ~(COBALT_EPOLL_EVENTS | COBALT_EPOLL_IGNORED)))
+		return -EINVAL;
+
+	ep = epoll_get(epfd);
+	if (IS_ERR(ep))
+		return PTR_ERR(ep);
+
+	mutex_lock(&ep->ctl_lock);
+
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		ret = epoll_add(ep, fd, ev);
+		break;
+	case EPOLL_CTL_MOD:
+		if (!epoll_bound_p(ep, fd)) {
+			ret = -ENOENT;
+			break;
+		}
+		xnselector_unbind(ep->selector, fd);
+		ret = epoll_add(ep, fd, ev);
+		break;
+	case EPOLL_CTL_DEL:
+		if (!epoll_bound_p(ep, fd)) {
+			ret = -ENOENT;
+			break;
+		}
+		xnselector_unbind(ep->selector, fd);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+
+	mutex_unlock(&ep->ctl_lock);
+
+	epoll_put(ep);
+
+	return ret;
+}
+
+COBALT_SYSCALL(epoll_ctl, lostage,
+	       (int epfd, int op, int fd, struct epoll_event __user *u_ev))
+{
+	struct epoll_event ev;
+	int ret;
+
+	if (op != EPOLL_CTL_DEL) {
+		ret = cobalt_copy_from_user(&ev, u_ev, sizeof(ev));
+		if (ret)
+			return ret;
+	}
+
+	return __cobalt_epoll_ctl(epfd, op, fd, &ev);
+}
+
+int __cobalt_epoll_wait(int epfd, struct epoll_event __user *u_events,
+			int maxevents, const void __user *u_ts,
+			int (*fetch_timeout)(struct timespec *ts,
+					     const void __user *u_ts))
+{
+	struct xnselect_event events[COBALT_EPOLL_MAXEVENTS];
+	xntmode_t tmode = XN_RELATIVE;
+	xnticks_t timeout = XN_INFINITE;
+	unsigned int index, mask;
+	struct cobalt_epoll *ep;
+	struct epoll_event ev;
+	struct timespec ts;
+	int ret, n, k, m;
+
+	if (maxevents <= 0)
+		return -EINVAL;
+
+	if (maxevents > COBALT_EPOLL_MAXEVENTS)
+		maxevents = COBALT_EPOLL_MAXEVENTS;
+
+	if (u_ts) {
+		ret = fetch_timeout(&ts, u_ts);
+		if (ret)
+			return ret;
+		if ((unsigned long)ts.tv_nsec >= ONE_BILLION)
+			return -EINVAL;
+		if (ts.tv_sec == 0 && ts.tv_nsec == 0)
+			timeout = XN_NONBLOCK;
+		else {
+			/* Spurious wakeups must not extend the delay. */
+			timeout = clock_get_ticks(CLOCK_MONOTONIC) + ts2ns(&ts);
+			tmode = XN_ABSOLUTE;
+		}
+	}
+
+	ep = epoll_get(epfd);
+	if (IS_ERR(ep))
+		return PTR_ERR(ep);
+
+	/*
+	 * The selector reports each ready type of a descriptor as a
+	 * separate event, fetch enough of them for filling
+	 * @maxevents entries once merged.
+	 */
+	ret = xnselector_wait(ep->selector, events,
+			      min(maxevents * XNSELECT_MAX_TYPES,
+				  COBALT_EPOLL_MAXEVENTS),
+			      timeout, tmode);
+	if (ret < 0)
+		goto out;
+
+	/*
+	 * Merge the ready types of each descriptor in place, the
+	 * type field of the first @m events now holding the epoll
+	 * event mask.
+	 */
+	for (n = 0, m = 0; n < ret; n++) {
+		index = events[n].index;
+		mask = epoll_types[events[n].type];
+		for (k = 0; k < m; k++)
+			if (events[k].index == index)
+				break;
+		if (k == m) {
+			if (m == maxevents)
+				continue;
+			events[m].index = index;
+			events[m].type = 0;
+			m++;
+		}
+		events[k].type |= mask;
+	}
+
+	for (n = 0, ret = m; n < m; n++) {
+		ev.events = events[n].type;
+		ev.data = ep->data[events[n].index];
+		if (cobalt_copy_to_user(&u_events[n], &ev, sizeof(ev))) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+out:
+	epoll_put(ep);
+
+	return ret;
+}
+
+static int epoll_fetch_timeout(struct timespec *ts, const void __user *u_ts)
+{
+	return cobalt_copy_from_user(ts, u_ts, sizeof(*ts));
+}
+
+COBALT_SYSCALL(epoll_wait, primary,
+	       (int epfd, struct epoll_event __user *u_events,
+		int maxevents, const struct timespec __user *u_timeout))
+{
+	return __cobalt_epoll_wait(epfd, u_events, maxevents, u_timeout,
+				   epoll_fetch_timeout);
+}
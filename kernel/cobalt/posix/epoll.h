@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _COBALT_POSIX_EPOLL_H
+#define _COBALT_POSIX_EPOLL_H
+
+#include <linux/time.h>
+#include <xenomai/posix/syscall.h>
+
+struct epoll_event;
+
+int __cobalt_epoll_ctl(int epfd, int op, int fd,
+		       const struct epoll_event *ev);
+
+int __cobalt_epoll_wait(int epfd, struct epoll_event __user *u_events,
+			int maxevents, const void __user *u_ts,
+			int (*fetch_timeout)(struct timespec *ts,
+					     const void __user *u_ts));
+
+COBALT_SYSCALL_DECL(epoll_create, (int flags));
+
+COBALT_SYSCALL_DECL(epoll_ctl,
+		    (int epfd, int op, int fd,
+		     struct epoll_event __user *u_ev));
+
+COBALT_SYSCALL_DECL(epoll_wait,
+		    (int epfd, struct epoll_event __user *u_events,
+		     int maxevents, const struct timespec __user *u_timeout));
+
+#endif /* !_COBALT_POSIX_EPOLL_H */
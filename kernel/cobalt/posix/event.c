@@ -15,6 +15,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
+#include <cobalt/kernel/objlock.h>
 #include "internal.h"
 #include "thread.h"
 #include "clock.h"
@@ -91,7 +92,9 @@ COBALT_SYSCALL(event_init, current,
 
 	xnlock_get_irqsave(&nklock, s);
 	cobalt_add_resource(&event->resnode, event, pshared);
+	xnobjlock_get(xnobjlock_stripe(event->resnode.handle));
 	event->magic = COBALT_EVENT_MAGIC;
+	xnobjlock_put(xnobjlock_stripe(event->resnode.handle));
 	xnlock_put_irqrestore(&nklock, s);
 
 	shadow.flags = flags;
@@ -101,6 +104,58 @@ COBALT_SYSCALL(event_init, current,
 	return cobalt_copy_to_user(u_event, &shadow, sizeof(*u_event));
 }
 
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+
+/*
+ * Try satisfying a wait request under the object lock only,
+ * returns -EAGAIN if the caller has to sleep.
+ */
+static int event_wait_fast(xnhandle_t handle, unsigned int bits,
+			   int mode, xnticks_t timeout,
+			   unsigned int *rbits_r)
+{
+	struct xnlock *lock = xnobjlock_stripe(handle);
+	struct cobalt_event_state *state;
+	struct cobalt_event *event;
+	unsigned int testval;
+	int ret = 0;
+	spl_t s;
+
+	xnobjlock_get_irqsave(lock, s);
+
+	event = xnregistry_lookup(handle, NULL);
+	if (event == NULL || event->magic != COBALT_EVENT_MAGIC) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	state = event->state;
+
+	if (bits == 0) {
+		*rbits_r = state->value;
+		goto out;
+	}
+
+	*rbits_r = state->value & bits;
+	testval = mode & COBALT_EVENT_ANY ? *rbits_r : state->value;
+	if (*rbits_r == 0 || *rbits_r != testval) {
+		if (timeout != XN_NONBLOCK) {
+			ret = -EAGAIN;
+			goto out;
+		}
+		ret = -EWOULDBLOCK;
+	}
+
+	if (state->nwaiters == 0)
+		state->flags &= ~COBALT_EVENT_PENDED;
+out:
+	xnobjlock_put_irqrestore(lock, s);
+
+	return ret;
+}
+
+#endif /* CONFIG_XENO_OPT_FINE_LOCKING */
+
 int __cobalt_event_wait(struct cobalt_event_shadow __user *u_event,
 			unsigned int bits,
 			unsigned int __user *u_bits_r,
@@ -129,7 +184,14 @@ int __cobalt_event_wait(struct cobalt_event_shadow __user *u_event,
 	} else
 		trace_cobalt_event_wait(u_event, bits, mode);
 
-	xnlock_get_irqsave(&nklock, s);
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	ret = event_wait_fast(handle, bits, mode, timeout, &rbits);
+	if (ret != -EAGAIN)
+		goto copy_out;
+	ret = 0;
+#endif
+
+	xnobjlock_fallback_irqsave(s);
 
 	event = xnregistry_lookup(handle, NULL);
 	if (event == NULL || event->magic != COBALT_EVENT_MAGIC) {
@@ -138,6 +200,7 @@ int __cobalt_event_wait(struct cobalt_event_shadow __user *u_event,
 	}
 
 	state = event->state;
+	xnobjlock_get(xnobjlock_stripe(handle));
 
 	if (bits == 0) {
 		/*
@@ -145,7 +208,7 @@ int __cobalt_event_wait(struct cobalt_event_shadow __user *u_event,
 		 * return the current flag group value.
 		 */
 		rbits = state->value;
-		goto out;
+		goto unlock;
 	}
 
 	state->flags |= COBALT_EVENT_PENDED;
@@ -163,11 +226,13 @@ int __cobalt_event_wait(struct cobalt_event_shadow __user *u_event,
 	ewc.mode = mode;
 	xnthread_prepare_wait(&ewc.wc);
 	state->nwaiters++;
+	xnobjlock_put(xnobjlock_stripe(handle));
 	info = xnsynch_sleep_on(&event->synch, timeout, tmode);
 	if (info & XNRMID) {
 		ret = -EIDRM;
 		goto out;
 	}
+	xnobjlock_get(xnobjlock_stripe(handle));
 	if (info & (XNBREAK|XNTIMEO)) {
 		state->nwaiters--;
 		ret = (info & XNBREAK) ? -EINTR : -ETIMEDOUT;
@@ -176,9 +241,13 @@ int __cobalt_event_wait(struct cobalt_event_shadow __user *u_event,
 done:
 	if (!xnsynch_pended_p(&event->synch))
 		state->flags &= ~COBALT_EVENT_PENDED;
+unlock:
+	xnobjlock_put(xnobjlock_stripe(handle));
 out:
 	xnlock_put_irqrestore(&nklock, s);
-
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+copy_out:
+#endif
 	if (ret == 0 &&
 	    cobalt_copy_to_user(u_bits_r, &rbits, sizeof(rbits)))
 		return -EFAULT;
@@ -220,7 +289,25 @@ COBALT_SYSCALL(event_sync, current,
 
 	handle = cobalt_get_handle_from_user(&u_event->handle);
 
-	xnlock_get_irqsave(&nklock, s);
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	/*
+	 * Nobody sleeps on the event, there is nothing to wake up
+	 * and no need for the nklock. Sleepers count themselves
+	 * under the object lock, after checking the bitmask.
+	 */
+	xnobjlock_get_irqsave(xnobjlock_stripe(handle), s);
+	event = xnregistry_lookup(handle, NULL);
+	if (event == NULL || event->magic != COBALT_EVENT_MAGIC)
+		ret = -EINVAL;
+	else if (event->state->nwaiters > 0)
+		ret = -EAGAIN;
+	xnobjlock_put_irqrestore(xnobjlock_stripe(handle), s);
+	if (ret != -EAGAIN)
+		return ret;
+	ret = 0;
+#endif
+
+	xnobjlock_fallback_irqsave(s);
 
 	event = xnregistry_lookup(handle, NULL);
 	if (event == NULL || event->magic != COBALT_EVENT_MAGIC) {
@@ -234,6 +321,7 @@ COBALT_SYSCALL(event_sync, current,
 	 * value.
 	 */
 	state = event->state;
+	xnobjlock_get(xnobjlock_stripe(handle));
 	bits = state->value;
 
 	xnsynch_for_each_sleeper_safe(p, tmp, &event->synch) {
@@ -248,6 +336,7 @@ COBALT_SYSCALL(event_sync, current,
 		}
 	}
 
+	xnobjlock_put(xnobjlock_stripe(handle));
 	xnsched_run();
 out:
 	xnlock_put_irqrestore(&nklock, s);
@@ -372,7 +461,9 @@ void cobalt_event_reclaim(struct cobalt_resnode *node, spl_t s)
 	int pshared;
 
 	event = container_of(node, struct cobalt_event, resnode);
+	xnobjlock_get(xnobjlock_stripe(node->handle));
 	xnregistry_remove(node->handle);
+	xnobjlock_put(xnobjlock_stripe(node->handle));
 	cobalt_del_resource(node);
 	xnsynch_destroy(&event->synch);
 	pshared = (event->flags & COBALT_EVENT_SHARED) != 0;
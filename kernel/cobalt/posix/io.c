@@ -104,6 +104,45 @@ COBALT_SYSCALL(sendmsg, probing,
 	return ret ?: rtdm_fd_sendmsg(fd, &m, flags);
 }
 
+static int get_mmsg(struct mmsghdr *mmsg, void __user **u_mmsg_p)
+{
+	struct mmsghdr __user *u_mmsg = *u_mmsg_p;
+
+	*u_mmsg_p = u_mmsg + 1;
+
+	return cobalt_copy_from_user(mmsg, u_mmsg, sizeof(*mmsg));
+}
+
+static int put_mmsg(void __user **u_mmsg_p, const struct mmsghdr *mmsg)
+{
+	struct mmsghdr __user *u_mmsg = *u_mmsg_p;
+
+	*u_mmsg_p = u_mmsg + 1;
+
+	return cobalt_copy_to_user(u_mmsg, mmsg, sizeof(*mmsg));
+}
+
+static int mmsg_fetch_timeout(struct timespec *ts, const void __user *u_ts)
+{
+	return cobalt_copy_from_user(ts, u_ts, sizeof(*ts));
+}
+
+COBALT_SYSCALL(recvmmsg, probing,
+	       (int fd, struct mmsghdr __user *u_msgvec, unsigned int vlen,
+		unsigned int flags, struct timespec __user *u_timeout))
+{
+	return __rtdm_fd_recvmmsg(fd, u_msgvec, vlen, flags, u_timeout,
+				  get_mmsg, put_mmsg, mmsg_fetch_timeout);
+}
+
+COBALT_SYSCALL(sendmmsg, probing,
+	       (int fd, struct mmsghdr __user *u_msgvec, unsigned int vlen,
+		unsigned int flags))
+{
+	return __rtdm_fd_sendmmsg(fd, u_msgvec, vlen, flags,
+				  get_mmsg, put_mmsg);
+}
+
 COBALT_SYSCALL(mmap, lostage,
 	       (int fd, struct _rtdm_mmap_request __user *u_rma,
 	        void __user **u_addrp))
@@ -21,6 +21,7 @@
 #include <linux/mm.h>
 #include <linux/sched.h>
 #include <cobalt/kernel/select.h>
+#include <cobalt/kernel/objlock.h>
 #include <rtdm/fd.h>
 #include "internal.h"
 #include "thread.h"
@@ -46,6 +47,11 @@ struct cobalt_mq {
 	struct list_head queued;
 	struct list_head avail;
 	int nrqueued;
+	/* Threads waiting for receiving, sending. */
+	int rcvwait;
+	int sndwait;
+	/* Serializes the queues, nested into the nklock if held. */
+	DECLARE_XNOBJLOCK(lock);
 
 	/* mq_notify */
 	struct siginfo si;
@@ -134,6 +140,9 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 	mq->memsize = memsize;
 	INIT_LIST_HEAD(&mq->queued);
 	mq->nrqueued = 0;
+	mq->rcvwait = 0;
+	mq->sndwait = 0;
+	xnobjlock_init(&mq->lock);
 	xnsynch_init(&mq->receivers, XNSYNCH_PRIO | XNSYNCH_NOPIP, NULL);
 	xnsynch_init(&mq->senders, XNSYNCH_PRIO | XNSYNCH_NOPIP, NULL);
 	mq->mem = mem;
@@ -477,18 +486,35 @@ mq_timedsend_inner(struct cobalt_mqd *mqd,
 	spl_t s;
 	int ret;
 
+	mq = mqd->mq;
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	/*
+	 * Grab a free slot under the queue lock only, unless this
+	 * is the last one, which requires signaling the writers.
+	 */
+	xnobjlock_get_irqsave(&mq->lock, s);
+	msg = ERR_PTR(-EAGAIN);
+	if (!list_empty(&mq->avail) && !list_is_singular(&mq->avail))
+		msg = mq_trysend(mqd, len);
+	xnobjlock_put_irqrestore(&mq->lock, s);
+	if (msg != ERR_PTR(-EAGAIN))
+		return msg;
+#endif
+
 	to = XN_INFINITE;
 	tmode = XN_RELATIVE;
 redo:
-	xnlock_get_irqsave(&nklock, s);
+	xnobjlock_fallback_irqsave(s);
+	xnobjlock_get(&mq->lock);
 	msg = mq_trysend(mqd, len);
 	if (msg != ERR_PTR(-EAGAIN))
-		goto out;
+		goto unlock;
 
 	if (rtdm_fd_flags(&mqd->fd) & O_NONBLOCK)
-		goto out;
+		goto unlock;
 
 	if (fetch_timeout) {
+		xnobjlock_put(&mq->lock);
 		xnlock_put_irqrestore(&nklock, s);
 		ret = fetch_timeout(&ts, u_ts);
 		if (ret)
@@ -501,9 +527,12 @@ redo:
 		goto redo;
 	}
 
-	mq = mqd->mq;
+	mq->sndwait++;
+	xnobjlock_put(&mq->lock);
 	xnthread_prepare_wait(&mwc.wc);
 	ret = xnsynch_sleep_on(&mq->senders, to, tmode);
+	xnobjlock_get(&mq->lock);
+	mq->sndwait--;
 	if (ret) {
 		if (ret & XNBREAK)
 			msg = ERR_PTR(-EINTR);
@@ -513,7 +542,8 @@ redo:
 			msg = ERR_PTR(-EBADF);
 	} else
 		msg = mwc.msg;
-out:
+unlock:
+	xnobjlock_put(&mq->lock);
 	xnlock_put_irqrestore(&nklock, s);
 
 	return msg;
@@ -536,9 +566,11 @@ static void mq_release_msg(struct cobalt_mq *mq, struct cobalt_msg *msg)
 		mwc->msg = msg;
 		xnthread_complete_wait(wc);
 	} else {
+		xnobjlock_get(&mq->lock);
 		mq_msg_free(mq, msg);
 		if (list_is_singular(&mq->avail))
 			xnselect_signal(&mq->write_select, 1);
+		xnobjlock_put(&mq->lock);
 	}
 }
 
@@ -554,7 +586,23 @@ mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 
 	mq = mqd->mq;
 
-	xnlock_get_irqsave(&nklock, s);
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	/*
+	 * Nobody waits for receiving and the queue is not empty,
+	 * so that no reader needs to be signaled: queue the message
+	 * under the queue lock only.
+	 */
+	xnobjlock_get_irqsave(&mq->lock, s);
+	if (mq->rcvwait == 0 && !list_empty(&mq->queued)) {
+		list_add_priff(msg, &mq->queued, prio, link);
+		mq->nrqueued++;
+		xnobjlock_put_irqrestore(&mq->lock, s);
+		return 0;
+	}
+	xnobjlock_put_irqrestore(&mq->lock, s);
+#endif
+
+	xnobjlock_fallback_irqsave(s);
 	/* Can we do pipelined sending? */
 	if (xnsynch_pended_p(&mq->receivers)) {
 		thread = xnsynch_wakeup_one_sleeper(&mq->receivers);
@@ -564,6 +612,7 @@ mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 		xnthread_complete_wait(wc);
 	} else {
 		/* Nope, have to go through the queue. */
+		xnobjlock_get(&mq->lock);
 		list_add_priff(msg, &mq->queued, prio, link);
 		mq->nrqueued++;
 
@@ -583,6 +632,7 @@ mq_finish_send(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 				mq->target = NULL;
 			}
 		}
+		xnobjlock_put(&mq->lock);
 	}
 	xnsched_run();
 	xnlock_put_irqrestore(&nklock, s);
@@ -606,18 +656,35 @@ mq_timedrcv_inner(struct cobalt_mqd *mqd,
 	spl_t s;
 	int ret;
 
+	mq = mqd->mq;
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	/*
+	 * Pull a message under the queue lock only, unless this is
+	 * the last one, which requires signaling the readers.
+	 */
+	xnobjlock_get_irqsave(&mq->lock, s);
+	msg = ERR_PTR(-EAGAIN);
+	if (!list_empty(&mq->queued) && !list_is_singular(&mq->queued))
+		msg = mq_tryrcv(mqd, len);
+	xnobjlock_put_irqrestore(&mq->lock, s);
+	if (msg != ERR_PTR(-EAGAIN))
+		return msg;
+#endif
+
 	to = XN_INFINITE;
 	tmode = XN_RELATIVE;
 redo:
-	xnlock_get_irqsave(&nklock, s);
+	xnobjlock_fallback_irqsave(s);
+	xnobjlock_get(&mq->lock);
 	msg = mq_tryrcv(mqd, len);
 	if (msg != ERR_PTR(-EAGAIN))
-		goto out;
+		goto unlock;
 
 	if (rtdm_fd_flags(&mqd->fd) & O_NONBLOCK)
-		goto out;
+		goto unlock;
 
 	if (fetch_timeout) {
+		xnobjlock_put(&mq->lock);
 		xnlock_put_irqrestore(&nklock, s);
 		ret = fetch_timeout(&ts, u_ts);
 		if (ret)
@@ -630,9 +697,12 @@ redo:
 		goto redo;
 	}
 
-	mq = mqd->mq;
+	mq->rcvwait++;
+	xnobjlock_put(&mq->lock);
 	xnthread_prepare_wait(&mwc.wc);
 	ret = xnsynch_sleep_on(&mq->receivers, to, tmode);
+	xnobjlock_get(&mq->lock);
+	mq->rcvwait--;
 	if (ret == 0)
 		msg = mwc.msg;
 	else if (ret & XNRMID)
@@ -641,7 +711,8 @@ redo:
 		msg = ERR_PTR(-ETIMEDOUT);
 	else
 		msg = ERR_PTR(-EINTR);
-out:
+unlock:
+	xnobjlock_put(&mq->lock);
 	xnlock_put_irqrestore(&nklock, s);
 
 	return msg;
@@ -652,7 +723,23 @@ mq_finish_rcv(struct cobalt_mqd *mqd, struct cobalt_msg *msg)
 {
 	spl_t s;
 
-	xnlock_get_irqsave(&nklock, s);
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	struct cobalt_mq *mq = mqd->mq;
+
+	/*
+	 * No sender waits for a free slot and some are left, so
+	 * that no writer needs to be signaled.
+	 */
+	xnobjlock_get_irqsave(&mq->lock, s);
+	if (mq->sndwait == 0 && !list_empty(&mq->avail)) {
+		mq_msg_free(mq, msg);
+		xnobjlock_put_irqrestore(&mq->lock, s);
+		return 0;
+	}
+	xnobjlock_put_irqrestore(&mq->lock, s);
+#endif
+
+	xnobjlock_fallback_irqsave(s);
 	mq_release_msg(mqd->mq, msg);
 	xnsched_run();
 	xnlock_put_irqrestore(&nklock, s);
@@ -667,10 +754,17 @@ static inline int mq_getattr(struct cobalt_mqd *mqd, struct mq_attr *attr)
 
 	mq = mqd->mq;
 	*attr = mq->attr;
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	xnobjlock_get_irqsave(&mq->lock, s);
+	attr->mq_flags = rtdm_fd_flags(&mqd->fd);
+	attr->mq_curmsgs = mq->nrqueued;
+	xnobjlock_put_irqrestore(&mq->lock, s);
+#else
 	xnlock_get_irqsave(&nklock, s);
 	attr->mq_flags = rtdm_fd_flags(&mqd->fd);
 	attr->mq_curmsgs = mq->nrqueued;
 	xnlock_put_irqrestore(&nklock, s);
+#endif
 
 	return 0;
 }
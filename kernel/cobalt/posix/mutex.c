@@ -252,6 +252,9 @@ COBALT_SYSCALL(mutex_init, current,
 		return err;
 	}
 
+	xnsynch_stat_publish(&mutex->synchbase, mutex->resnode.handle,
+			     (unsigned long)u_mx);
+
 	return cobalt_copy_to_user(u_mx, &mx, sizeof(*u_mx));
 }
 
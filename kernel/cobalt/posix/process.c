@@ -1337,7 +1337,7 @@ static int attach_process(struct cobalt_process *process)
 		exe_path = NULL; /* Not lethal, but weird. */
 	}
 	p->exe_path = exe_path;
-	xntree_init(&p->fds);
+	memset(&p->fds, 0, sizeof(p->fds));
 	atomic_set(&p->refcnt, 1);
 
 	ret = process_hash_enter(process);
@@ -19,6 +19,7 @@
 
 #include <stddef.h>
 #include <linux/err.h>
+#include <cobalt/kernel/objlock.h>
 #include "internal.h"
 #include "thread.h"
 #include "clock.h"
@@ -61,8 +62,10 @@ int __cobalt_sem_destroy(xnhandle_t handle)
 		goto fail;
 	}
 
+	xnobjlock_get(xnobjlock_stripe(handle));
 	cobalt_mark_deleted(sem);
 	xnregistry_remove(sem->resnode.handle);
+	xnobjlock_put(xnobjlock_stripe(handle));
 	if (!sem->pathname)
 		cobalt_del_resource(&sem->resnode);
 	if (xnsynch_destroy(&sem->synchbase) == XNSYNCH_RESCHED) {
@@ -134,10 +137,13 @@ __cobalt_sem_init(const char *name, struct cobalt_sem_shadow *sm,
 		goto err_lock_put;
 	}
 
+	/* Fast paths may look this semaphore up as soon as it is entered. */
+	sem->magic = 0;
 	ret = xnregistry_enter(name ?: "", sem, &sem->resnode.handle, NULL);
 	if (ret < 0)
 		goto err_lock_put;
 
+	xnobjlock_get(xnobjlock_stripe(sem->resnode.handle));
 	sem->magic = COBALT_SEM_MAGIC;
 	if (!name)
 		cobalt_add_resource(&sem->resnode, sem, pshared);
@@ -152,6 +158,7 @@ __cobalt_sem_init(const char *name, struct cobalt_sem_shadow *sm,
 	sem->flags = flags;
 	sem->refs = name ? 2 : 1;
 	sem->pathname = NULL;
+	xnobjlock_put(xnobjlock_stripe(sem->resnode.handle));
 
 	sm->magic = name ? COBALT_NAMED_SEM_MAGIC : COBALT_SEM_MAGIC;
 	sm->handle = sem->resnode.handle;
@@ -237,7 +244,9 @@ static int sem_wait(xnhandle_t handle)
 	xnlock_get_irqsave(&nklock, s);
 
 	sem = xnregistry_lookup(handle, NULL);
+	xnobjlock_get(xnobjlock_stripe(handle));
 	ret = do_trywait(sem);
+	xnobjlock_put(xnobjlock_stripe(handle));
 	if (ret != -EAGAIN)
 		goto out;
 
@@ -246,7 +255,9 @@ static int sem_wait(xnhandle_t handle)
 	if (info & XNRMID) {
 		ret = -EINVAL;
 	} else if (info & XNBREAK) {
+		xnobjlock_get(xnobjlock_stripe(handle));
 		atomic_inc(&sem->state->value); /* undo do_trywait() */
+		xnobjlock_put(xnobjlock_stripe(handle));
 		ret = -EINTR;
 	}
 out:
@@ -281,9 +292,12 @@ int __cobalt_sem_timedwait(struct cobalt_sem_shadow __user *u_sem,
 
 	for (;;) {
 		sem = xnregistry_lookup(handle, NULL);
+		xnobjlock_get(xnobjlock_stripe(handle));
 		ret = do_trywait(sem);
-		if (ret != -EAGAIN)
+		if (ret != -EAGAIN) {
+			xnobjlock_put(xnobjlock_stripe(handle));
 			break;
+		}
 
 		/*
 		 * POSIX states that the validity of the timeout spec
@@ -294,6 +308,7 @@ int __cobalt_sem_timedwait(struct cobalt_sem_shadow __user *u_sem,
 		 */
 		if (pull_ts) {
 			atomic_inc(&sem->state->value);
+			xnobjlock_put(xnobjlock_stripe(handle));
 			xnlock_put_irqrestore(&nklock, s);
 			ret = fetch_timeout(&ts, u_ts);
 			xnlock_get_irqsave(&nklock, s);
@@ -307,6 +322,7 @@ int __cobalt_sem_timedwait(struct cobalt_sem_shadow __user *u_sem,
 			continue;
 		}
 
+		xnobjlock_put(xnobjlock_stripe(handle));
 		ret = 0;
 		tmode = sem->flags & SEM_RAWCLOCK ? XN_ABSOLUTE : XN_REALTIME;
 		info = xnsynch_sleep_on(&sem->synchbase, ts2ns(&ts) + 1, tmode);
@@ -314,7 +330,9 @@ int __cobalt_sem_timedwait(struct cobalt_sem_shadow __user *u_sem,
 			ret = -EINVAL;
 		else if (info & (XNBREAK|XNTIMEO)) {
 			ret = (info & XNBREAK) ? -EINTR : -ETIMEDOUT;
+			xnobjlock_get(xnobjlock_stripe(handle));
 			atomic_inc(&sem->state->value);
+			xnobjlock_put(xnobjlock_stripe(handle));
 		}
 		break;
 	}
@@ -324,29 +342,75 @@ int __cobalt_sem_timedwait(struct cobalt_sem_shadow __user *u_sem,
 	return ret;
 }
 
-static int sem_post(xnhandle_t handle)
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+
+/*
+ * Post to a semaphore nobody waits on, under the object lock
+ * only. Returns -EAGAIN if some thread has to be woken up, which
+ * requires the nklock.
+ */
+static int sem_post_fast(xnhandle_t handle)
 {
+	struct xnlock *lock = xnobjlock_stripe(handle);
 	struct cobalt_sem *sem;
-	int ret;
+	int ret, value;
 	spl_t s;
 
-	xnlock_get_irqsave(&nklock, s);
+	xnobjlock_get_irqsave(lock, s);
 
 	sem = xnregistry_lookup(handle, NULL);
 	ret = sem_check(sem);
 	if (ret)
 		goto out;
 
-	if (atomic_read(&sem->state->value) == SEM_VALUE_MAX) {
+	value = atomic_read(&sem->state->value);
+	if (value == SEM_VALUE_MAX)
 		ret = -EINVAL;
+	else if (value < 0)
+		ret = -EAGAIN;
+	else if (atomic_inc_return(&sem->state->value) > 0 &&
+		 (sem->flags & SEM_PULSE))
+		atomic_set(&sem->state->value, 0);
+out:
+	xnobjlock_put_irqrestore(lock, s);
+
+	return ret;
+}
+
+#endif /* CONFIG_XENO_OPT_FINE_LOCKING */
+
+static int sem_post(xnhandle_t handle)
+{
+	struct cobalt_sem *sem;
+	int ret, wakeup = 0;
+	spl_t s;
+
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	ret = sem_post_fast(handle);
+	if (ret != -EAGAIN)
+		return ret;
+#endif
+
+	xnobjlock_fallback_irqsave(s);
+
+	sem = xnregistry_lookup(handle, NULL);
+	ret = sem_check(sem);
+	if (ret)
 		goto out;
-	}
 
-	if (atomic_inc_return(&sem->state->value) <= 0) {
-		if (xnsynch_wakeup_one_sleeper(&sem->synchbase))
-			xnsched_run();
-	} else if (sem->flags & SEM_PULSE)
+	xnobjlock_get(xnobjlock_stripe(handle));
+
+	if (atomic_read(&sem->state->value) == SEM_VALUE_MAX)
+		ret = -EINVAL;
+	else if (atomic_inc_return(&sem->state->value) <= 0)
+		wakeup = 1;
+	else if (sem->flags & SEM_PULSE)
 		atomic_set(&sem->state->value, 0);
+
+	xnobjlock_put(xnobjlock_stripe(handle));
+
+	if (wakeup && xnsynch_wakeup_one_sleeper(&sem->synchbase))
+		xnsched_run();
 out:	
 	xnlock_put_irqrestore(&nklock, s);
 
@@ -359,22 +423,27 @@ static int sem_getvalue(xnhandle_t handle, int *value)
 	int ret;
 	spl_t s;
 
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	xnobjlock_get_irqsave(xnobjlock_stripe(handle), s);
+#else
 	xnlock_get_irqsave(&nklock, s);
+#endif
 
 	sem = xnregistry_lookup(handle, NULL);
 	ret = sem_check(sem);
-	if (ret) {
-		xnlock_put_irqrestore(&nklock, s);
-		return ret;
+	if (ret == 0) {
+		*value = atomic_read(&sem->state->value);
+		if ((sem->flags & SEM_REPORT) == 0 && *value < 0)
+			*value = 0;
 	}
 
-	*value = atomic_read(&sem->state->value);
-	if ((sem->flags & SEM_REPORT) == 0 && *value < 0)
-		*value = 0;
-
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	xnobjlock_put_irqrestore(xnobjlock_stripe(handle), s);
+#else
 	xnlock_put_irqrestore(&nklock, s);
+#endif
 
-	return 0;
+	return ret;
 }
 
 COBALT_SYSCALL(sem_init, current,
@@ -438,10 +507,17 @@ COBALT_SYSCALL(sem_trywait, primary,
 	handle = cobalt_get_handle_from_user(&u_sem->handle);
 	trace_cobalt_psem_trywait(handle);
 
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	xnobjlock_get_irqsave(xnobjlock_stripe(handle), s);
+	sem = xnregistry_lookup(handle, NULL);
+	ret = do_trywait(sem);
+	xnobjlock_put_irqrestore(xnobjlock_stripe(handle), s);
+#else
 	xnlock_get_irqsave(&nklock, s);
 	sem = xnregistry_lookup(handle, NULL);
 	ret = do_trywait(sem);
 	xnlock_put_irqrestore(&nklock, s);
+#endif
 
 	return ret;
 }
@@ -485,9 +561,9 @@ COBALT_SYSCALL(sem_broadcast_np, current,
 	       (struct cobalt_sem_shadow __user *u_sem))
 {
 	struct cobalt_sem *sem;
+	int ret, flush = 0;
 	xnhandle_t handle;
 	spl_t s;
-	int ret;
 
 	handle = cobalt_get_handle_from_user(&u_sem->handle);
 	trace_cobalt_psem_broadcast(u_sem->handle);
@@ -496,10 +572,17 @@ COBALT_SYSCALL(sem_broadcast_np, current,
 
 	sem = xnregistry_lookup(handle, NULL);
 	ret = sem_check(sem);
-	if (ret == 0 && atomic_read(&sem->state->value) < 0) {
-		atomic_set(&sem->state->value, 0);
-		xnsynch_flush(&sem->synchbase, 0);
-		xnsched_run();
+	if (ret == 0) {
+		xnobjlock_get(xnobjlock_stripe(handle));
+		if (atomic_read(&sem->state->value) < 0) {
+			atomic_set(&sem->state->value, 0);
+			flush = 1;
+		}
+		xnobjlock_put(xnobjlock_stripe(handle));
+		if (flush) {
+			xnsynch_flush(&sem->synchbase, 0);
+			xnsched_run();
+		}
 	}
 
 	xnlock_put_irqrestore(&nklock, s);
@@ -38,6 +38,7 @@
 #include "monitor.h"
 #include "clock.h"
 #include "event.h"
+#include "epoll.h"
 #include "timerfd.h"
 #include "io.h"
 #include "corectl.h"
@@ -32,6 +32,7 @@
 #include "signal.h"
 #include "monitor.h"
 #include "event.h"
+#include "epoll.h"
 #include "mqueue.h"
 #include "io.h"
 #include "../debug.h"
@@ -795,6 +796,56 @@ COBALT_SYSCALL32emu(sendmsg, probing,
 	return ret ?: rtdm_fd_sendmsg(fd, &m, flags);
 }
 
+static int get_mmsg32(struct mmsghdr *mmsg, void __user **u_mmsg_p)
+{
+	struct compat_mmsghdr __user *u_mmsg = *u_mmsg_p;
+
+	*u_mmsg_p = u_mmsg + 1;
+
+	return sys32_get_msghdr(&mmsg->msg_hdr, &u_mmsg->msg_hdr);
+}
+
+static int put_mmsg32(void __user **u_mmsg_p, const struct mmsghdr *mmsg)
+{
+	struct compat_mmsghdr __user *u_mmsg = *u_mmsg_p;
+	int ret;
+
+	*u_mmsg_p = u_mmsg + 1;
+
+	ret = sys32_put_msghdr(&u_mmsg->msg_hdr, &mmsg->msg_hdr);
+	if (ret)
+		return ret;
+
+	return __xn_put_user(mmsg->msg_len, &u_mmsg->msg_len) ? -EFAULT : 0;
+}
+
+COBALT_SYSCALL32emu(recvmmsg, probing,
+		    (int fd, struct compat_mmsghdr __user *u_msgvec,
+		     unsigned int vlen, unsigned int flags,
+		     struct compat_timespec __user *u_timeout))
+{
+	return __rtdm_fd_recvmmsg(fd, u_msgvec, vlen, flags, u_timeout,
+				  get_mmsg32, put_mmsg32,
+				  sys32_fetch_timeout);
+}
+
+COBALT_SYSCALL32emu(sendmmsg, probing,
+		    (int fd, struct compat_mmsghdr __user *u_msgvec,
+		     unsigned int vlen, unsigned int flags))
+{
+	return __rtdm_fd_sendmmsg(fd, u_msgvec, vlen, flags,
+				  get_mmsg32, put_mmsg32);
+}
+
+COBALT_SYSCALL32emu(epoll_wait, primary,
+		    (int epfd, struct epoll_event __user *u_events,
+		     int maxevents,
+		     const struct compat_timespec __user *u_timeout))
+{
+	return __cobalt_epoll_wait(epfd, u_events, maxevents, u_timeout,
+				   sys32_fetch_timeout);
+}
+
 COBALT_SYSCALL32emu(mmap, lostage,
 		    (int fd, struct compat_rtdm_mmap_request __user *u_crma,
 		     compat_uptr_t __user *u_caddrp))
@@ -25,6 +25,7 @@ struct cobalt_event_shadow;
 struct cobalt_cond_shadow;
 struct cobalt_sem_shadow;
 struct cobalt_monitor_shadow;
+struct epoll_event;
 
 COBALT_SYSCALL32emu_DECL(thread_create,
 			 (compat_ulong_t pth,
@@ -194,6 +195,20 @@ COBALT_SYSCALL32emu_DECL(sendmsg,
 			 (int fd, struct compat_msghdr __user *umsg,
 			  int flags));
 
+COBALT_SYSCALL32emu_DECL(recvmmsg,
+			 (int fd, struct compat_mmsghdr __user *u_msgvec,
+			  unsigned int vlen, unsigned int flags,
+			  struct compat_timespec __user *u_timeout));
+
+COBALT_SYSCALL32emu_DECL(sendmmsg,
+			 (int fd, struct compat_mmsghdr __user *u_msgvec,
+			  unsigned int vlen, unsigned int flags));
+
+COBALT_SYSCALL32emu_DECL(epoll_wait,
+			 (int epfd, struct epoll_event __user *u_events,
+			  int maxevents,
+			  const struct compat_timespec __user *u_timeout));
+
 COBALT_SYSCALL32emu_DECL(mmap,
 			 (int fd,
 			  struct compat_rtdm_mmap_request __user *u_rma,
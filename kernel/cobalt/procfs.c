@@ -17,6 +17,7 @@
  * 02111-1307, USA.
  */
 #include <cobalt/kernel/lock.h>
+#include <cobalt/kernel/objlock.h>
 #include <cobalt/kernel/clock.h>
 #include <cobalt/kernel/apc.h>
 #include <cobalt/kernel/vfile.h>
@@ -92,6 +93,65 @@ static struct xnvfile_regular lock_vfile = {
 
 #endif /* XENO_DEBUG(LOCKING) */
 
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+
+static int objlock_vfile_show(struct xnvfile_regular_iterator *it, void *data)
+{
+	struct xnobjlock_stats stats;
+	spl_t s;
+	int cpu;
+
+	xnvfile_printf(it, "%-4s %12s %12s %12s %12s\n",
+		       "CPU", "ACQUIRED", "CONTENDED", "FALLBACK", "NKCONTENDED");
+
+	for_each_realtime_cpu(cpu) {
+		xnlock_get_irqsave(&nklock, s);
+		stats = per_cpu(xnobjlock_stats, cpu);
+		xnlock_put_irqrestore(&nklock, s);
+		xnvfile_printf(it, "%-4d %12lu %12lu %12lu %12lu\n",
+			       cpu, stats.acquired, stats.contended,
+			       stats.fallback, stats.nkcontended);
+	}
+
+	return 0;
+}
+
+static ssize_t objlock_vfile_store(struct xnvfile_input *input)
+{
+	ssize_t ret;
+	spl_t s;
+	int cpu;
+
+	long val;
+
+	ret = xnvfile_get_integer(input, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val != 0)
+		return -EINVAL;
+
+	for_each_realtime_cpu(cpu) {
+		xnlock_get_irqsave(&nklock, s);
+		memset(&per_cpu(xnobjlock_stats, cpu), '\0',
+		       sizeof(struct xnobjlock_stats));
+		xnlock_put_irqrestore(&nklock, s);
+	}
+
+	return ret;
+}
+
+static struct xnvfile_regular_ops objlock_vfile_ops = {
+	.show = objlock_vfile_show,
+	.store = objlock_vfile_store,
+};
+
+static struct xnvfile_regular objlock_vfile = {
+	.ops = &objlock_vfile_ops,
+};
+
+#endif /* CONFIG_XENO_OPT_FINE_LOCKING */
+
 static int latency_vfile_show(struct xnvfile_regular_iterator *it, void *data)
 {
 	xnvfile_printf(it, "%Lu\n",
@@ -221,10 +281,14 @@ void xnprocfs_cleanup_tree(void)
 #endif
 	xnvfile_destroy_dir(&cobalt_debug_vfroot);
 #endif /* XENO_DEBUG(COBALT) */
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	xnvfile_destroy_regular(&objlock_vfile);
+#endif
 	xnvfile_destroy_regular(&apc_vfile);
 	xnvfile_destroy_regular(&faults_vfile);
 	xnvfile_destroy_regular(&version_vfile);
 	xnvfile_destroy_regular(&latency_vfile);
+	xnsynch_cleanup_proc();
 	xnintr_cleanup_proc();
 	xnheap_cleanup_proc();
 	xnclock_cleanup_proc();
@@ -247,10 +311,14 @@ int __init xnprocfs_init_tree(void)
 	xnclock_init_proc();
 	xnheap_init_proc();
 	xnintr_init_proc();
+	xnsynch_init_proc();
 	xnvfile_init_regular("latency", &latency_vfile, &cobalt_vfroot);
 	xnvfile_init_regular("version", &version_vfile, &cobalt_vfroot);
 	xnvfile_init_regular("faults", &faults_vfile, &cobalt_vfroot);
 	xnvfile_init_regular("apc", &apc_vfile, &cobalt_vfroot);
+#ifdef CONFIG_XENO_OPT_FINE_LOCKING
+	xnvfile_init_regular("objlock", &objlock_vfile, &cobalt_vfroot);
+#endif
 #ifdef CONFIG_XENO_OPT_DEBUG
 	xnvfile_init_dir("debug", &cobalt_debug_vfroot, &cobalt_vfroot);
 #if XENO_DEBUG(LOCKING)
@@ -17,6 +17,9 @@
  */
 
 #include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/seqlock.h>
 #include <cobalt/kernel/sched.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/registry.h>
@@ -50,9 +53,44 @@ static unsigned int nr_active_objects;
 
 static unsigned long next_object_stamp;
 
-static struct hlist_head *object_index;
+/*
+ * Named objects are indexed by a hash table which doubles in size
+ * as registrations pile up, until it has as many buckets as there
+ * are registry slots. Entries are moved from the previous table to
+ * the new one a few buckets at a time, on each update, so that no
+ * single call ever rehashes the whole index with the nklock held.
+ *
+ * Updates are serialized by the nklock, and bumped through
+ * registry_seq, so that xnregistry_bind() may look up an object
+ * without grabbing the nklock. Since such lookups may still be
+ * walking a former table, retired tables are only released when
+ * the registry is cleaned up; the total memory they consume is
+ * bounded by the size of the largest table. Likewise, lockless
+ * lookups never dereference the key of an object, which its owner
+ * may release as soon as it is unregistered, but compare against a
+ * copy held in the registry slot. Keys too long for that copy are
+ * only matched with the nklock held.
+ */
+struct registry_hash {
+	struct registry_hash *retired;
+	unsigned int bits;
+	struct hlist_head buckets[0];
+};
+
+#define REGISTRY_HASH_MINBITS	4
+#define REGISTRY_REHASH_BATCH	8
+
+static struct registry_hash *object_index;
 
-static int nr_object_entries;
+static struct registry_hash *rehash_index; /* Table being drained. */
+
+static unsigned int rehash_pos;	/* Next bucket to drain. */
+
+static unsigned int max_hash_bits;
+
+static unsigned int nr_hashed_objects;
+
+static seqcount_t registry_seq;
 
 static struct xnsynch register_synch;
 
@@ -90,18 +128,40 @@ static struct xnvfile_regular usage_vfile = {
 
 #endif /* CONFIG_XENO_OPT_VFILE */
 
+static unsigned int registry_hash_initial_bits(void)
+{
+	unsigned int size;
+
+	size = max(CONFIG_XENO_OPT_REGISTRY_NRSLOTS / 8,
+		   1 << REGISTRY_HASH_MINBITS);
+
+	return ilog2(roundup_pow_of_two(size));
+}
+
+/*
+ * Current number of buckets of the name index, which grows from
+ * NRSLOTS / 8 up to NRSLOTS as objects are registered.
+ */
 unsigned xnregistry_hash_size(void)
 {
-	static const int primes[] = {
-		101, 211, 307, 401, 503, 601,
-		701, 809, 907, 1009, 1103
-	};
+	return 1U << ACCESS_ONCE(object_index)->bits;
+}
+
+static struct registry_hash *registry_hash_alloc(unsigned int bits)
+{
+	struct registry_hash *h;
+	int n;
 
-#define obj_hash_max(n)			 \
-((n) < sizeof(primes) / sizeof(int) ? \
- (n) : sizeof(primes) / sizeof(int) - 1)
+	h = xnmalloc(sizeof(*h) + (sizeof(struct hlist_head) << bits));
+	if (h == NULL)
+		return NULL;
 
-	return primes[obj_hash_max(CONFIG_XENO_OPT_REGISTRY_NRSLOTS / 100)];
+	h->retired = NULL;
+	h->bits = bits;
+	for (n = 0; n < (1 << bits); n++)
+		INIT_HLIST_HEAD(&h->buckets[n]);
+
+	return h;
 }
 
 int xnregistry_init(void)
@@ -145,10 +205,13 @@ int xnregistry_init(void)
 	list_get_entry(&free_object_list, struct xnobject, link);
 	nr_active_objects = 1;
 
-	nr_object_entries = xnregistry_hash_size();
-	object_index = kmalloc(sizeof(*object_index) *
-				      nr_object_entries, GFP_KERNEL);
+	max_hash_bits = ilog2(roundup_pow_of_two(CONFIG_XENO_OPT_REGISTRY_NRSLOTS));
+	max_hash_bits = max(max_hash_bits, (unsigned int)REGISTRY_HASH_MINBITS);
+	nr_hashed_objects = 0;
+	rehash_index = NULL;
+	seqcount_init(&registry_seq);
 
+	object_index = registry_hash_alloc(registry_hash_initial_bits());
 	if (object_index == NULL) {
 #ifdef CONFIG_XENO_OPT_VFILE
 		xnvfile_destroy_regular(&usage_vfile);
@@ -158,9 +221,6 @@ int xnregistry_init(void)
 		return -ENOMEM;
 	}
 
-	for (n = 0; n < nr_object_entries; n++)
-		INIT_HLIST_HEAD(&object_index[n]);
-
 	xnsynch_init(&register_synch, XNSYNCH_FIFO, NULL);
 
 	return 0;
@@ -168,6 +228,7 @@ int xnregistry_init(void)
 
 void xnregistry_cleanup(void)
 {
+	struct registry_hash *h, *retired;
 #ifdef CONFIG_XENO_OPT_VFILE
 	struct hlist_node *enext;
 	struct xnobject *ecurr;
@@ -176,26 +237,31 @@ void xnregistry_cleanup(void)
 
 	flush_scheduled_work();
 
-	for (n = 0; n < nr_object_entries; n++)
-		hlist_for_each_entry_safe(ecurr, enext, 
-					&object_index[n], hlink) {
-			pnode = ecurr->pnode;
-			if (pnode == NULL)
-				continue;
+	for (h = object_index; h; h = h == object_index ? rehash_index : NULL)
+		for (n = 0; n < (1 << h->bits); n++)
+			hlist_for_each_entry_safe(ecurr, enext,
+						  &h->buckets[n], hlink) {
+				pnode = ecurr->pnode;
+				if (pnode == NULL)
+					continue;
 
-			pnode->ops->unexport(ecurr, pnode);
+				pnode->ops->unexport(ecurr, pnode);
 
-			if (--pnode->entries > 0)
-				continue;
+				if (--pnode->entries > 0)
+					continue;
 
-			xnvfile_destroy_dir(&pnode->vdir);
+				xnvfile_destroy_dir(&pnode->vdir);
 
-			if (--pnode->root->entries == 0)
-				xnvfile_destroy_dir(&pnode->root->vdir);
-		}
+				if (--pnode->root->entries == 0)
+					xnvfile_destroy_dir(&pnode->root->vdir);
+			}
 #endif /* CONFIG_XENO_OPT_VFILE */
 
-	kfree(object_index);
+	for (h = object_index; h; h = retired) {
+		retired = h->retired;
+		xnfree(h);
+	}
+
 	xnsynch_destroy(&register_synch);
 
 #ifdef CONFIG_XENO_OPT_VFILE
@@ -513,52 +579,197 @@ static unsigned registry_hash_crunch(const char *key)
 			h = (h ^ (g >> HQON)) ^ g;
 	}
 
-	return h % nr_object_entries;
+	return h;
 }
 
-static inline int registry_hash_enter(const char *key, struct xnobject *object)
+static inline struct hlist_head *
+registry_hash_bucket(struct registry_hash *h, unsigned int hash)
+{
+	return &h->buckets[hash_32(hash, h->bits)];
+}
+
+/* nklock held, registry_seq write-locked. */
+static void registry_rehash_step(void)
 {
+	struct registry_hash *h = rehash_index;
+	struct hlist_node *enext;
 	struct xnobject *ecurr;
-	unsigned s;
+	int n;
 
-	object->key = key;
-	s = registry_hash_crunch(key);
+	for (n = 0; n < REGISTRY_REHASH_BATCH; n++) {
+		if (rehash_pos >= (1U << h->bits)) {
+			rehash_index = NULL;
+			return;
+		}
+		hlist_for_each_entry_safe(ecurr, enext,
+					  &h->buckets[rehash_pos], hlink) {
+			hlist_del(&ecurr->hlink);
+			hlist_add_head(&ecurr->hlink,
+				       registry_hash_bucket(object_index,
+							    ecurr->hash));
+		}
+		rehash_pos++;
+	}
+}
 
-	hlist_for_each_entry(ecurr, &object_index[s], hlink)
-		if (ecurr == object || strcmp(key, ecurr->key) == 0)
-			return -EEXIST;
+/* nklock held, registry_seq write-locked. */
+static void registry_hash_update(void)
+{
+	struct registry_hash *h;
 
-	hlist_add_head(&object->hlink, &object_index[s]);
+	if (rehash_index) {
+		registry_rehash_step();
+		return;
+	}
 
-	return 0;
+	if (nr_hashed_objects <= (1U << object_index->bits) ||
+	    object_index->bits >= max_hash_bits)
+		return;
+
+	/*
+	 * Failing to grow the index is not an error, lookups just
+	 * have to walk longer hash chains.
+	 */
+	h = registry_hash_alloc(object_index->bits + 1);
+	if (h == NULL)
+		return;
+
+	h->retired = object_index;
+	rehash_index = object_index;
+	rehash_pos = 0;
+	object_index = h;
+	registry_rehash_step();
 }
 
-static inline int registry_hash_remove(struct xnobject *object)
+static struct xnobject *registry_hash_search(struct hlist_head *head,
+					     const char *key,
+					     unsigned int hash)
 {
-	unsigned int s = registry_hash_crunch(object->key);
 	struct xnobject *ecurr;
 
-	hlist_for_each_entry(ecurr, &object_index[s], hlink)
-		if (ecurr == object) {
-			hlist_del(&ecurr->hlink);
-			return 0;
-		}
+	hlist_for_each_entry(ecurr, head, hlink)
+		if (ecurr->hash == hash && strcmp(key, ecurr->key) == 0)
+			return ecurr;
 
-	return -ESRCH;
+	return NULL;
 }
 
+/* nklock held. */
 static struct xnobject *registry_hash_find(const char *key)
 {
+	unsigned int hash = registry_hash_crunch(key);
+	struct xnobject *object;
+
+	object = registry_hash_search(registry_hash_bucket(object_index, hash),
+				      key, hash);
+	if (object == NULL && rehash_index)
+		object = registry_hash_search(registry_hash_bucket(rehash_index,
+								   hash),
+					      key, hash);
+	return object;
+}
+
+static inline int registry_hash_enter(const char *key, struct xnobject *object)
+{
+	if (registry_hash_find(key))
+		return -EEXIST;
+
+	object->key = key;
+	object->hash = registry_hash_crunch(key);
+
+	raw_write_seqcount_begin(&registry_seq);
+	if (strlen(key) < sizeof(object->name))
+		strcpy(object->name, key);
+	else
+		*object->name = '\0';
+	hlist_add_head(&object->hlink,
+		       registry_hash_bucket(object_index, object->hash));
+	nr_hashed_objects++;
+	registry_hash_update();
+	raw_write_seqcount_end(&registry_seq);
+
+	return 0;
+}
+
+static inline int registry_hash_remove(struct xnobject *object)
+{
+	raw_write_seqcount_begin(&registry_seq);
+	hlist_del(&object->hlink);
+	nr_hashed_objects--;
+	if (rehash_index)
+		registry_rehash_step();
+	raw_write_seqcount_end(&registry_seq);
+
+	return 0;
+}
+
+static inline int registry_valid_slot(struct hlist_node *node)
+{
+	struct xnobject *base = registry_obj_slots;
+
+	return (void *)node >= (void *)base &&
+		(void *)node < (void *)(base + CONFIG_XENO_OPT_REGISTRY_NRSLOTS);
+}
+
+static struct xnobject *
+registry_hash_peek(struct registry_hash *h, const char *key, unsigned int hash)
+{
+	struct hlist_node *node;
 	struct xnobject *ecurr;
+	int n;
 
-	hlist_for_each_entry(ecurr, 
-			&object_index[registry_hash_crunch(key)], hlink)
-		if (strcmp(key, ecurr->key) == 0)
+	/*
+	 * We may race with updates, so only follow links to registry
+	 * slots, do not walk more entries than there are slots, and
+	 * do not read past the key copy. The caller detects any
+	 * inconsistency and retries.
+	 */
+	node = ACCESS_ONCE(registry_hash_bucket(h, hash)->first);
+	for (n = 0; node && n < CONFIG_XENO_OPT_REGISTRY_NRSLOTS; n++) {
+		if (!registry_valid_slot(node))
+			break;
+		ecurr = container_of(node, struct xnobject, hlink);
+		if (ACCESS_ONCE(ecurr->hash) == hash &&
+		    strncmp(key, ecurr->name, sizeof(ecurr->name)) == 0)
 			return ecurr;
+		node = ACCESS_ONCE(node->next);
+	}
 
 	return NULL;
 }
 
+/*
+ * Look up an object by key without holding the nklock. The
+ * object may be removed by the time the caller gets the handle,
+ * which would not be any different if the nklock had been released
+ * before returning. Keys which do not fit the copy held in the
+ * registry slots are left to the caller's locked path.
+ */
+static xnhandle_t registry_hash_lookup(const char *key)
+{
+	struct registry_hash *h, *oh;
+	unsigned int hash, seq;
+	struct xnobject *object;
+	size_t len;
+
+	len = strlen(key);
+	if (len == 0 || len >= XNOBJECT_NAME_LEN)
+		return XN_NO_HANDLE;
+
+	hash = registry_hash_crunch(key);
+
+	do {
+		seq = raw_read_seqcount_begin(&registry_seq);
+		h = ACCESS_ONCE(object_index);
+		oh = ACCESS_ONCE(rehash_index);
+		object = registry_hash_peek(h, key, hash);
+		if (object == NULL && oh)
+			object = registry_hash_peek(oh, key, hash);
+	} while (read_seqcount_retry(&registry_seq, seq));
+
+	return object ? object - registry_obj_slots : XN_NO_HANDLE;
+}
+
 struct registry_wait_context {
 	struct xnthread_wait_context wc;
 	const char *key;
@@ -756,6 +967,11 @@ int xnregistry_bind(const char *key, xnticks_t timeout, int timeout_mode,
 	if (key == NULL)
 		return -EINVAL;
 
+	/* Fast path: the object is already registered. */
+	*phandle = registry_hash_lookup(key);
+	if (*phandle != XN_NO_HANDLE)
+		return 0;
+
 	xnlock_get_irqsave(&nklock, s);
 
 	if (timeout_mode == XN_RELATIVE &&
@@ -18,6 +18,7 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/err.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
@@ -33,17 +34,23 @@
 #include "internal.h"
 #include "posix/process.h"
 #include "posix/syscall.h"
+#include "posix/clock.h"
 
 #define RTDM_SETFL_MASK (O_NONBLOCK)
 
-DEFINE_PRIVATE_XNLOCK(fdtree_lock);
+DEFINE_PRIVATE_XNLOCK(fdtab_lock);
 static LIST_HEAD(rtdm_fd_cleanup_queue);
 static struct semaphore rtdm_fd_cleanup_sem;
 
-struct rtdm_fd_index {
-	struct xnid id;
-	struct rtdm_fd *fd;
-};
+/*
+ * The per-process descriptor table is made of leaves of
+ * RTDM_FDTAB_LEAFSZ slots, hanging off a directory which grows on
+ * demand. Looking up a ufd costs two dereferences under fdtab_lock.
+ */
+#define RTDM_FDTAB_SHIFT	7
+#define RTDM_FDTAB_LEAFSZ	(1U << RTDM_FDTAB_SHIFT)
+#define RTDM_FDTAB_MASK		(RTDM_FDTAB_LEAFSZ - 1)
+#define RTDM_FDTAB_MINDIR	4
 
 static int enosys(void)
 {
@@ -59,23 +66,93 @@ static void nop_close(struct rtdm_fd *fd)
 {
 }
 
-static inline struct rtdm_fd_index *
-fetch_fd_index(struct cobalt_ppd *p, int ufd)
+static inline struct rtdm_fd **fetch_fd_slot(struct cobalt_ppd *p, int ufd)
 {
-	struct xnid *id = xnid_fetch(&p->fds, ufd);
-	if (id == NULL)
+	unsigned int leaf = (unsigned int)ufd >> RTDM_FDTAB_SHIFT;
+	struct cobalt_fdtab *tab = &p->fds;
+
+	/* Negative ufds end up out of range too. */
+	if (leaf >= tab->nr_leaves || tab->dir[leaf] == NULL)
 		return NULL;
 
-	return container_of(id, struct rtdm_fd_index, id);
+	return &tab->dir[leaf][ufd & RTDM_FDTAB_MASK];
 }
 
 static struct rtdm_fd *fetch_fd(struct cobalt_ppd *p, int ufd)
 {
-	struct rtdm_fd_index *idx = fetch_fd_index(p, ufd);
-	if (idx == NULL)
-		return NULL;
+	struct rtdm_fd **slot = fetch_fd_slot(p, ufd);
 
-	return idx->fd;
+	return slot ? *slot : NULL;
+}
+
+/*
+ * Install @fd at index @ufd, growing the table as needed. Memory is
+ * allocated with the lock dropped, then the table is checked again.
+ */
+static int install_fd(struct cobalt_ppd *p, int ufd, struct rtdm_fd *fd)
+{
+	unsigned int leaf = (unsigned int)ufd >> RTDM_FDTAB_SHIFT, nr = 0;
+	struct rtdm_fd ***dir = NULL, ***olddir = NULL, **newleaf = NULL;
+	struct cobalt_fdtab *tab = &p->fds;
+	struct rtdm_fd **slot;
+	int ret = 0;
+	spl_t s;
+
+	if (ufd < 0)
+		return -EBADF;
+retry:
+	xnlock_get_irqsave(&fdtab_lock, s);
+
+	if (leaf >= tab->nr_leaves) {
+		if (dir == NULL) {
+			xnlock_put_irqrestore(&fdtab_lock, s);
+			nr = max_t(unsigned int, roundup_pow_of_two(leaf + 1),
+				   RTDM_FDTAB_MINDIR);
+			dir = kcalloc(nr, sizeof(*dir), GFP_KERNEL);
+			if (dir == NULL) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			goto retry;
+		}
+		/* Our directory always covers @leaf, it may only grow. */
+		if (tab->nr_leaves)
+			memcpy(dir, tab->dir, tab->nr_leaves * sizeof(*dir));
+		olddir = tab->dir;
+		tab->dir = dir;
+		tab->nr_leaves = nr;
+		dir = NULL;
+	}
+
+	if (tab->dir[leaf] == NULL) {
+		if (newleaf == NULL) {
+			xnlock_put_irqrestore(&fdtab_lock, s);
+			newleaf = kcalloc(RTDM_FDTAB_LEAFSZ, sizeof(*newleaf),
+					  GFP_KERNEL);
+			if (newleaf == NULL) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			goto retry;
+		}
+		tab->dir[leaf] = newleaf;
+		newleaf = NULL;
+	}
+
+	slot = &tab->dir[leaf][ufd & RTDM_FDTAB_MASK];
+	if (*slot)
+		ret = -EBUSY;
+	else
+		*slot = fd;
+
+	xnlock_put_irqrestore(&fdtab_lock, s);
+out:
+	/* Lookups run under fdtab_lock, nobody may see olddir anymore. */
+	kfree(olddir);
+	kfree(newleaf);
+	kfree(dir);
+
+	return ret;
 }
 
 #define assign_invalid_handler(__handler)				\
@@ -119,6 +196,19 @@ static struct rtdm_fd *fetch_fd(struct cobalt_ppd *p, int ufd)
 		}							\
 	while (0)
 
+/*
+ * Optional dual handlers are left NULL if none of them is
+ * implemented, so that the caller may fall back to a generic
+ * implementation.
+ */
+#define assign_optional_dual_handlers(__handler)			\
+	do								\
+		if (__rt(__handler) || __nrt(__handler)) {		\
+			assign_default_handler(__rt(__handler));	\
+			assign_default_handler(__nrt(__handler));	\
+		}							\
+	while (0)
+
 #ifdef CONFIG_XENO_ARCH_SYS3264
 
 static inline void set_compat_bit(struct rtdm_fd *fd)
@@ -145,25 +235,20 @@ static inline void set_compat_bit(struct rtdm_fd *fd)
 int rtdm_fd_enter(struct rtdm_fd *fd, int ufd, unsigned int magic,
 		  struct rtdm_fd_ops *ops)
 {
-	struct rtdm_fd_index *idx;
 	struct cobalt_ppd *ppd;
-	spl_t s;
-	int ret;
 
 	secondary_mode_only();
 
 	if (magic == 0)
 		return -EINVAL;
 
-	idx = kmalloc(sizeof(*idx), GFP_KERNEL);
-	if (idx == NULL)
-		return -ENOMEM;
-
 	assign_default_dual_handlers(ops->ioctl);
 	assign_default_dual_handlers(ops->read);
 	assign_default_dual_handlers(ops->write);
 	assign_default_dual_handlers(ops->recvmsg);
 	assign_default_dual_handlers(ops->sendmsg);
+	assign_optional_dual_handlers(ops->recvmmsg);
+	assign_optional_dual_handlers(ops->sendmmsg);
 	assign_invalid_default_handler(ops->select);
 	assign_invalid_default_handler(ops->mmap);
 	__assign_default_handler(ops->close, nop_close);
@@ -175,17 +260,7 @@ int rtdm_fd_enter(struct rtdm_fd *fd, int ufd, unsigned int magic,
 	fd->refs = 1;
 	set_compat_bit(fd);
 
-	idx->fd = fd;
-
-	xnlock_get_irqsave(&fdtree_lock, s);
-	ret = xnid_enter(&ppd->fds, &idx->id, ufd);
-	xnlock_put_irqrestore(&fdtree_lock, s);
-	if (ret < 0) {
-		kfree(idx);
-		ret = -EBUSY;
-	}
-
-	return ret;
+	return install_fd(ppd, ufd, fd);
 }
 
 /**
@@ -208,7 +283,7 @@ struct rtdm_fd *rtdm_fd_get(int ufd, unsigned int magic)
 	struct rtdm_fd *fd;
 	spl_t s;
 
-	xnlock_get_irqsave(&fdtree_lock, s);
+	xnlock_get_irqsave(&fdtab_lock, s);
 	fd = fetch_fd(p, ufd);
 	if (fd == NULL || (magic != 0 && fd->magic != magic)) {
 		fd = ERR_PTR(-EBADF);
@@ -217,7 +292,7 @@ struct rtdm_fd *rtdm_fd_get(int ufd, unsigned int magic)
 
 	++fd->refs;
 out:
-	xnlock_put_irqrestore(&fdtree_lock, s);
+	xnlock_put_irqrestore(&fdtab_lock, s);
 
 	return fd;
 }
@@ -243,11 +318,11 @@ static int fd_cleanup_thread(void *data)
 		if (kthread_should_stop())
 			break;
 
-		xnlock_get_irqsave(&fdtree_lock, s);
+		xnlock_get_irqsave(&fdtab_lock, s);
 		fd = list_first_entry(&rtdm_fd_cleanup_queue,
 				struct rtdm_fd, cleanup);
 		list_del(&fd->cleanup);
-		xnlock_put_irqrestore(&fdtree_lock, s);
+		xnlock_put_irqrestore(&fdtab_lock, s);
 
 		fd->ops->close(fd);
 	}
@@ -265,7 +340,7 @@ static void __put_fd(struct rtdm_fd *fd, spl_t s)
 	int destroy;
 
 	destroy = --fd->refs == 0;
-	xnlock_put_irqrestore(&fdtree_lock, s);
+	xnlock_put_irqrestore(&fdtab_lock, s);
 
 	if (!destroy)
 		return;
@@ -280,9 +355,9 @@ static void __put_fd(struct rtdm_fd *fd, spl_t s)
 			},
 		};
 
-		xnlock_get_irqsave(&fdtree_lock, s);
+		xnlock_get_irqsave(&fdtab_lock, s);
 		list_add_tail(&fd->cleanup, &rtdm_fd_cleanup_queue);
-		xnlock_put_irqrestore(&fdtree_lock, s);
+		xnlock_put_irqrestore(&fdtab_lock, s);
 
 		ipipe_post_work_root(&closework, work);
 	}
@@ -302,7 +377,7 @@ void rtdm_fd_put(struct rtdm_fd *fd)
 {
 	spl_t s;
 
-	xnlock_get_irqsave(&fdtree_lock, s);
+	xnlock_get_irqsave(&fdtab_lock, s);
 	__put_fd(fd, s);
 }
 EXPORT_SYMBOL_GPL(rtdm_fd_put);
@@ -325,13 +400,13 @@ int rtdm_fd_lock(struct rtdm_fd *fd)
 {
 	spl_t s;
 
-	xnlock_get_irqsave(&fdtree_lock, s);
+	xnlock_get_irqsave(&fdtab_lock, s);
 	if (fd->refs == 0) {
-		xnlock_put_irqrestore(&fdtree_lock, s);
+		xnlock_put_irqrestore(&fdtab_lock, s);
 		return -EIDRM;
 	}
 	++fd->refs;
-	xnlock_put_irqrestore(&fdtree_lock, s);
+	xnlock_put_irqrestore(&fdtab_lock, s);
 
 	return 0;
 }
@@ -351,7 +426,7 @@ void rtdm_fd_unlock(struct rtdm_fd *fd)
 {
 	spl_t s;
 
-	xnlock_get_irqsave(&fdtree_lock, s);
+	xnlock_get_irqsave(&fdtab_lock, s);
 	/* Warn if fd was unreferenced. */
 	XENO_WARN_ON(COBALT, fd->refs <= 0);
 	__put_fd(fd, s);
@@ -567,19 +642,200 @@ out:
 }
 EXPORT_SYMBOL_GPL(rtdm_fd_sendmsg);
 
+/* Number of message descriptors mirrored on the stack at once. */
+#define RTDM_MMSG_BATCH  8
+
+/*
+ * Pass a batch of messages to the driver, looping over the single
+ * message handler if no batch handler is available. MSG_WAITFORONE
+ * is handled here for the latter, since drivers may not accept
+ * this flag.
+ */
+static int fd_mmsg_batch(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+			 unsigned int vlen, int flags, bool recv)
+{
+	int (*batch)(struct rtdm_fd *fd, struct mmsghdr *msgvec,
+		     unsigned int vlen, int flags);
+	unsigned int n;
+	ssize_t ret;
+
+	if (recv)
+		batch = ipipe_root_p ? fd->ops->recvmmsg_nrt :
+			fd->ops->recvmmsg_rt;
+	else
+		batch = ipipe_root_p ? fd->ops->sendmmsg_nrt :
+			fd->ops->sendmmsg_rt;
+
+	if (batch)
+		return batch(fd, msgvec, vlen, flags);
+
+	for (n = 0; n < vlen; n++) {
+		if (recv)
+			ret = ipipe_root_p ?
+				fd->ops->recvmsg_nrt(fd, &msgvec[n].msg_hdr,
+						     flags & ~MSG_WAITFORONE) :
+				fd->ops->recvmsg_rt(fd, &msgvec[n].msg_hdr,
+						    flags & ~MSG_WAITFORONE);
+		else
+			ret = ipipe_root_p ?
+				fd->ops->sendmsg_nrt(fd, &msgvec[n].msg_hdr,
+						     flags) :
+				fd->ops->sendmsg_rt(fd, &msgvec[n].msg_hdr,
+						    flags);
+		if (ret < 0)
+			return n ?: ret;
+
+		msgvec[n].msg_len = ret;
+		if (flags & MSG_WAITFORONE)
+			flags |= MSG_DONTWAIT;
+	}
+
+	return n;
+}
+
+static int fd_mmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		   int flags, xnticks_t deadline, bool recv,
+		   int (*get_mmsg)(struct mmsghdr *mmsg,
+				   void __user **u_mmsg_p),
+		   int (*put_mmsg)(void __user **u_mmsg_p,
+				   const struct mmsghdr *mmsg))
+{
+	void __user *u_get = u_msgvec, *u_put = u_msgvec;
+	struct mmsghdr msgvec[RTDM_MMSG_BATCH];
+	unsigned int count, nr, n, done = 0;
+	struct rtdm_fd *fd;
+	int ret = 0;
+
+	if (vlen > UIO_MAXIOV)
+		vlen = UIO_MAXIOV;
+
+	fd = rtdm_fd_get(ufd, 0);
+	if (IS_ERR(fd)) {
+		ret = PTR_ERR(fd);
+		goto fail;
+	}
+
+	set_compat_bit(fd);
+
+	if (recv)
+		trace_cobalt_fd_recvmmsg(current, fd, ufd, flags);
+	else
+		trace_cobalt_fd_sendmmsg(current, fd, ufd, flags);
+
+	/*
+	 * Messages are processed by chunks mirrored on the stack,
+	 * holding a single reference on the file for the whole
+	 * vector.
+	 */
+	while (done < vlen) {
+		count = min_t(unsigned int, vlen - done, RTDM_MMSG_BATCH);
+		for (n = 0; n < count; n++) {
+			ret = get_mmsg(&msgvec[n], &u_get);
+			if (ret)
+				goto out;
+		}
+
+		ret = fd_mmsg_batch(fd, msgvec, count, flags, recv);
+		if (ret <= 0)
+			break;
+
+		nr = ret;
+		for (n = 0; n < nr; n++) {
+			ret = put_mmsg(&u_put, &msgvec[n]);
+			if (ret)
+				goto out;
+			done++;
+		}
+
+		if (nr < count)
+			break;
+
+		/*
+		 * The timeout is only checked between chunks, i.e. it
+		 * does not bound the time spent blocking in the
+		 * driver, as with Linux.
+		 */
+		if (deadline && xnclock_read_monotonic(&nkclock) >= deadline)
+			break;
+
+		if (flags & MSG_WAITFORONE)
+			flags |= MSG_DONTWAIT;
+	}
+out:
+	if (!XENO_ASSERT(COBALT, !spltest()))
+		splnone();
+
+	rtdm_fd_put(fd);
+
+	/*
+	 * Like Linux, report the number of messages processed if
+	 * any, the error is lost otherwise.
+	 */
+	if (done)
+		return done;
+fail:
+	if (ret < 0) {
+		if (recv)
+			trace_cobalt_fd_recvmmsg_status(current, fd, ufd, ret);
+		else
+			trace_cobalt_fd_sendmmsg_status(current, fd, ufd, ret);
+	}
+
+	return ret;
+}
+
+int __rtdm_fd_recvmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags, void __user *u_timeout,
+		       int (*get_mmsg)(struct mmsghdr *mmsg,
+				       void __user **u_mmsg_p),
+		       int (*put_mmsg)(void __user **u_mmsg_p,
+				       const struct mmsghdr *mmsg),
+		       int (*get_timespec)(struct timespec *ts,
+					   const void __user *u_ts))
+{
+	xnticks_t deadline = 0;
+	struct timespec ts;
+	int ret;
+
+	if (u_timeout) {
+		ret = get_timespec(&ts, u_timeout);
+		if (ret)
+			return ret;
+
+		if ((unsigned long)ts.tv_nsec >= ONE_BILLION)
+			return -EINVAL;
+
+		deadline = xnclock_read_monotonic(&nkclock) + ts2ns(&ts);
+	}
+
+	return fd_mmsg(ufd, u_msgvec, vlen, flags, deadline, true,
+		       get_mmsg, put_mmsg);
+}
+
+int __rtdm_fd_sendmmsg(int ufd, void __user *u_msgvec, unsigned int vlen,
+		       unsigned int flags,
+		       int (*get_mmsg)(struct mmsghdr *mmsg,
+				       void __user **u_mmsg_p),
+		       int (*put_mmsg)(void __user **u_mmsg_p,
+				       const struct mmsghdr *mmsg))
+{
+	return fd_mmsg(ufd, u_msgvec, vlen, flags, 0, false,
+		       get_mmsg, put_mmsg);
+}
+
 static void
-__fd_close(struct cobalt_ppd *p, struct rtdm_fd_index *idx, spl_t s)
+__fd_close(struct rtdm_fd **slot, spl_t s)
 {
-	xnid_remove(&p->fds, &idx->id);
-	__put_fd(idx->fd, s);
+	struct rtdm_fd *fd = *slot;
 
-	kfree(idx);
+	*slot = NULL;
+	__put_fd(fd, s);
 }
 
 int rtdm_fd_close(int ufd, unsigned int magic)
 {
-	struct rtdm_fd_index *idx;
 	struct cobalt_ppd *ppd;
+	struct rtdm_fd **slot;
 	struct rtdm_fd *fd;
 	spl_t s;
 
@@ -587,15 +843,15 @@ int rtdm_fd_close(int ufd, unsigned int magic)
 
 	ppd = cobalt_ppd_get(0);
 
-	xnlock_get_irqsave(&fdtree_lock, s);
-	idx = fetch_fd_index(ppd, ufd);
-	if (idx == NULL)
+	xnlock_get_irqsave(&fdtab_lock, s);
+	slot = fetch_fd_slot(ppd, ufd);
+	if (slot == NULL || *slot == NULL)
 		goto ebadf;
 
-	fd = idx->fd;
+	fd = *slot;
 	if (magic != 0 && fd->magic != magic) {
 ebadf:
-		xnlock_put_irqrestore(&fdtree_lock, s);
+		xnlock_put_irqrestore(&fdtab_lock, s);
 		return -EBADF;
 	}
 
@@ -610,7 +866,7 @@ ebadf:
 	 * descriptor was removed from the fdtable if some refs on
 	 * rtdm_fd are still pending.
 	 */
-	__fd_close(ppd, idx, s);
+	__fd_close(slot, s);
 	__close_fd(current->files, ufd);
 
 	return 0;
@@ -656,9 +912,9 @@ int rtdm_fd_valid_p(int ufd)
 	struct rtdm_fd *fd;
 	spl_t s;
 
-	xnlock_get_irqsave(&fdtree_lock, s);
+	xnlock_get_irqsave(&fdtab_lock, s);
 	fd = fetch_fd(cobalt_ppd_get(0), ufd);
-	xnlock_put_irqrestore(&fdtree_lock, s);
+	xnlock_put_irqrestore(&fdtab_lock, s);
 
 	return fd != NULL;
 }
@@ -704,25 +960,35 @@ int rtdm_fd_select(int ufd, struct xnselector *selector,
 	return ret;
 }
 
-static void destroy_fd(void *cookie, struct xnid *id)
+void rtdm_fd_cleanup(struct cobalt_ppd *p)
 {
-	struct cobalt_ppd *p = cookie;
-	struct rtdm_fd_index *idx;
+	struct cobalt_fdtab *tab = &p->fds;
+	unsigned int leaf, n;
+	struct rtdm_fd **slot;
 	spl_t s;
 
-	idx = container_of(id, struct rtdm_fd_index, id);
-	xnlock_get_irqsave(&fdtree_lock, s);
-	__fd_close(p, idx, 0);
-}
-
-void rtdm_fd_cleanup(struct cobalt_ppd *p)
-{
 	/*
 	 * This is called on behalf of a (userland) task exit handler,
 	 * so we don't have to deal with the regular file descriptors,
 	 * we only have to empty our own index.
 	 */
-	xntree_cleanup(&p->fds, p, destroy_fd);
+	for (leaf = 0; leaf < tab->nr_leaves; leaf++) {
+		if (tab->dir[leaf] == NULL)
+			continue;
+		for (n = 0; n < RTDM_FDTAB_LEAFSZ; n++) {
+			slot = &tab->dir[leaf][n];
+			xnlock_get_irqsave(&fdtab_lock, s);
+			if (*slot)
+				__fd_close(slot, s);
+			else
+				xnlock_put_irqrestore(&fdtab_lock, s);
+		}
+		kfree(tab->dir[leaf]);
+	}
+
+	kfree(tab->dir);
+	tab->dir = NULL;
+	tab->nr_leaves = 0;
 }
 
 void rtdm_fd_init(void)
@@ -174,6 +174,7 @@ static void quota_refill_handler(struct xntimer *timer)
 			list_del_init(&thread->quota_expired);
 			xnsched_addq(&sched->rt.runnable, thread);
 		}
+		xnsched_mark_class(sched, &xnsched_class_quota);
 	}
 
 	xnsched_set_self_resched(timer->sched);
@@ -340,6 +341,7 @@ static void xnsched_quota_kick(struct xnthread *thread)
 	if (tg->run_budget_ns == 0 && !list_empty(&thread->quota_expired)) {
 		list_del_init(&thread->quota_expired);
 		xnsched_addq_tail(&sched->rt.runnable, thread);
+		xnsched_mark_class(sched, &xnsched_class_quota);
 	}
 }
 
@@ -66,6 +66,8 @@ static void tp_schedule_next(struct xnsched_tp *tp)
 	}
 
 	sched = container_of(tp, struct xnsched, tp);
+	/* Threads from the incoming partition may be picked now. */
+	xnsched_mark_class(sched, &xnsched_class_tp);
 	xnsched_set_resched(sched);
 }
 
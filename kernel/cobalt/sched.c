@@ -28,6 +28,7 @@
 #include <cobalt/kernel/arith.h>
 #include <cobalt/uapi/signal.h>
 #define CREATE_TRACE_POINTS
+#include <cobalt/kernel/flightrec.h>
 #include <trace/events/cobalt-core.h>
 
 /**
@@ -52,13 +53,25 @@ struct xnvfile_rev_tag nkthreadlist_tag;
 
 static struct xnsched_class *xnsched_class_highest;
 
+#define XNSCHED_MAX_CLASSES  8
+
+/* Registered classes, indexed on their rank. */
+static struct xnsched_class *xnsched_class_table[XNSCHED_MAX_CLASSES];
+
+static int xnsched_class_nr;
+
 #define for_each_xnsched_class(p) \
    for (p = xnsched_class_highest; p; p = p->next)
 
 static void xnsched_register_class(struct xnsched_class *sched_class)
 {
+	XENO_BUG_ON(COBALT, xnsched_class_nr >= XNSCHED_MAX_CLASSES);
+
 	sched_class->next = xnsched_class_highest;
 	xnsched_class_highest = sched_class;
+	sched_class->index = xnsched_class_nr++;
+	sched_class->pickmask = 1UL << sched_class->index;
+	xnsched_class_table[sched_class->index] = sched_class;
 
 	/*
 	 * Classes shall be registered by increasing priority order,
@@ -86,6 +99,24 @@ void xnsched_register_classes(void)
 	xnsched_register_class(&xnsched_class_quota);
 #endif
 	xnsched_register_class(&xnsched_class_rt);
+
+	/*
+	 * SCHED_QUOTA and SCHED_SPORADIC piggyback on the SCHED_FIFO
+	 * runqueue, so queuing a thread to any of those classes
+	 * makes all of them eligible for picking.
+	 */
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	xnsched_class_rt.pickmask |= xnsched_class_quota.pickmask;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_SPORADIC
+	xnsched_class_rt.pickmask |= xnsched_class_sporadic.pickmask;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	xnsched_class_quota.pickmask = xnsched_class_rt.pickmask;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_SPORADIC
+	xnsched_class_sporadic.pickmask = xnsched_class_rt.pickmask;
+#endif
 }
 
 #ifdef CONFIG_XENO_OPT_WATCHDOG
@@ -118,6 +149,7 @@ static void watchdog_handler(struct xntimer *timer)
 		return;
 
 	trace_cobalt_watchdog_signal(curr);
+	xnflightrec_freeze(xnthread_host_pid(curr), SIGDEBUG_WATCHDOG);
 
 	if (xnthread_test_state(curr, XNUSER)) {
 		printk(XENO_WARNING "watchdog triggered on CPU #%d -- runaway thread "
@@ -178,6 +210,10 @@ void xnsched_init(struct xnsched *sched, int cpu)
 	sched->lflags = 0;
 	sched->inesting = 0;
 	sched->curr = &sched->rootcb;
+#ifdef CONFIG_XENO_OPT_SCHED_CLASSES
+	/* The idle class always has a thread to pick. */
+	sched->rclasses = xnsched_class_idle.pickmask;
+#endif
 
 	attr.flags = XNROOT | XNFPU;
 	attr.name = root_name;
@@ -247,6 +283,7 @@ struct xnthread *xnsched_pick_next(struct xnsched *sched)
 	struct xnsched_class *p __maybe_unused;
 	struct xnthread *curr = sched->curr;
 	struct xnthread *thread;
+	int idx __maybe_unused;
 
 	if (!xnthread_test_state(curr, XNTHREAD_BLOCK_BITS | XNZOMBIE)) {
 		/*
@@ -271,17 +308,25 @@ struct xnthread *xnsched_pick_next(struct xnsched *sched)
 	/*
 	 * Find the runnable thread having the highest priority among
 	 * all scheduling classes, scanned by decreasing priority.
+	 * Only the classes marked in sched->rclasses are probed: a
+	 * class is marked each time a thread is queued to it, and
+	 * unmarked lazily as soon as its pick handler comes back
+	 * empty-handed. The idle class is never unmarked, which
+	 * guarantees the scan ends.
 	 */
 #ifdef CONFIG_XENO_OPT_SCHED_CLASSES
-	for_each_xnsched_class(p) {
+	for (;;) {
+		idx = __fls(sched->rclasses);
+		p = xnsched_class_table[idx];
 		thread = p->sched_pick(sched);
-		if (thread) {
-			set_thread_running(sched, thread);
-			return thread;
-		}
+		if (thread)
+			break;
+		__clear_bit(idx, &sched->rclasses);
 	}
 
-	return NULL; /* Never executed because of the idle class. */
+	set_thread_running(sched, thread);
+
+	return thread;
 #else /* !CONFIG_XENO_OPT_SCHED_CLASSES */
 	thread = xnsched_rt_pick(sched);
 	if (unlikely(thread == NULL))
@@ -858,6 +903,8 @@ reschedule:
 	prev = curr;
 
 	trace_cobalt_switch_context(prev, next);
+	xnflightrec_log(XNFLIGHTREC_SWITCH, xnthread_host_pid(next),
+			xnthread_host_pid(prev));
 
 	if (xnthread_test_state(next, XNROOT))
 		xnsched_reset_watchdog(sched);
@@ -897,6 +944,7 @@ reschedule:
 	 * because of relaxed/hardened transitions.
 	 */
 	curr = sched->curr;
+	xnstat_wakeup_update(&curr->stat.wakeup);
 	xnthread_switch_fpu(sched);
 	xntrace_pid(task_pid_nr(current), xnthread_current_priority(curr));
 out:
@@ -1298,6 +1346,129 @@ static struct xnvfile_snapshot_ops vfile_schedacct_ops = {
 	.show = vfile_schedacct_show,
 };
 
+#ifdef CONFIG_XENO_OPT_STATS_WAKEUP
+
+struct vfile_schedwakeup_priv {
+	struct xnthread *curr;
+};
+
+struct vfile_schedwakeup_data {
+	int cpu;
+	pid_t pid;
+	int state;
+	char name[XNOBJECT_NAME_LEN];
+	xnstat_wakeup_t wakeup;
+};
+
+static struct xnvfile_snapshot_ops vfile_schedwakeup_ops;
+
+static struct xnvfile_snapshot schedwakeup_vfile = {
+	.privsz = sizeof(struct vfile_schedwakeup_priv),
+	.datasz = sizeof(struct vfile_schedwakeup_data),
+	.tag = &nkthreadlist_tag,
+	.ops = &vfile_schedwakeup_ops,
+};
+
+static int vfile_schedwakeup_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_schedwakeup_priv *priv = xnvfile_iterator_priv(it);
+
+	priv->curr = list_first_entry(&nkthreadq, struct xnthread, glink);
+
+	return cobalt_nrthreads;
+}
+
+static int vfile_schedwakeup_next(struct xnvfile_snapshot_iterator *it,
+				  void *data)
+{
+	struct vfile_schedwakeup_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_schedwakeup_data *p = data;
+	struct xnthread *thread;
+
+	if (priv->curr == NULL)
+		return 0;	/* All done. */
+
+	thread = priv->curr;
+	if (list_is_last(&thread->glink, &nkthreadq))
+		priv->curr = NULL;
+	else
+		priv->curr = list_next_entry(thread, glink);
+
+	/* Threads which never slept on a timer are not listed. */
+	if (thread->stat.wakeup.count == 0)
+		return VFILE_SEQ_SKIP;
+
+	p->cpu = xnsched_cpu(thread->sched);
+	p->pid = xnthread_host_pid(thread);
+	p->state = xnthread_get_state(thread);
+	memcpy(p->name, thread->name, sizeof(p->name));
+	p->wakeup = thread->stat.wakeup;
+
+	return 1;
+}
+
+static int vfile_schedwakeup_show(struct xnvfile_snapshot_iterator *it,
+				  void *data)
+{
+	struct vfile_schedwakeup_data *p = data;
+	char hbuf[XNSTAT_WAKEUP_BUCKETS * 12];
+	int n, last, len;
+
+	if (p == NULL) {
+		xnvfile_printf(it,
+			       "%-3s  %-6s %-10s %-10s %-10s %-10s  %-24s %s\n",
+			       "CPU", "PID", "COUNT", "MIN(ns)", "AVG(ns)",
+			       "MAX(ns)", "HISTOGRAM(1us,2us,4us..)", "NAME");
+		return 0;
+	}
+
+	/* Trailing empty buckets are omitted. */
+	for (last = XNSTAT_WAKEUP_BUCKETS - 1; last > 0; last--)
+		if (p->wakeup.hist[last])
+			break;
+
+	for (n = 0, len = 0; n <= last && len < sizeof(hbuf); n++)
+		len += ksformat(hbuf + len, sizeof(hbuf) - len,
+				n ? ",%lu" : "%lu", p->wakeup.hist[n]);
+
+	xnvfile_printf(it, "%3u  %-6d %-10lu %-10Lu %-10Lu %-10Lu  %-24s %s%s%s\n",
+		       p->cpu, p->pid, p->wakeup.count,
+		       p->wakeup.min,
+		       xnarch_ulldiv(p->wakeup.total, p->wakeup.count, NULL),
+		       p->wakeup.max, hbuf,
+		       (p->state & XNUSER) ? "" : "[",
+		       p->name,
+		       (p->state & XNUSER) ? "" : "]");
+
+	return 0;
+}
+
+static ssize_t vfile_schedwakeup_store(struct xnvfile_input *input)
+{
+	struct xnthread *thread;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	list_for_each_entry(thread, &nkthreadq, glink)
+		xnstat_wakeup_reset(&thread->stat.wakeup);
+
+	xnvfile_touch_tag(&nkthreadlist_tag);
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return input->size;
+}
+
+static struct xnvfile_snapshot_ops vfile_schedwakeup_ops = {
+	.rewind = vfile_schedwakeup_rewind,
+	.next = vfile_schedwakeup_next,
+	.show = vfile_schedwakeup_show,
+	.store = vfile_schedwakeup_store,
+};
+
+#endif /* CONFIG_XENO_OPT_STATS_WAKEUP */
+
 #endif /* CONFIG_XENO_OPT_STATS */
 
 #ifdef CONFIG_SMP
@@ -1397,6 +1568,11 @@ int xnsched_init_proc(void)
 	ret = xnvfile_init_snapshot("acct", &schedacct_vfile, &sched_vfroot);
 	if (ret)
 		return ret;
+#ifdef CONFIG_XENO_OPT_STATS_WAKEUP
+	ret = xnvfile_init_snapshot("wakeup", &schedwakeup_vfile, &sched_vfroot);
+	if (ret)
+		return ret;
+#endif /* CONFIG_XENO_OPT_STATS_WAKEUP */
 #endif /* CONFIG_XENO_OPT_STATS */
 
 #ifdef CONFIG_SMP
@@ -1419,6 +1595,9 @@ void xnsched_cleanup_proc(void)
 	xnvfile_destroy_regular(&affinity_vfile);
 #endif /* CONFIG_SMP */
 #ifdef CONFIG_XENO_OPT_STATS
+#ifdef CONFIG_XENO_OPT_STATS_WAKEUP
+	xnvfile_destroy_snapshot(&schedwakeup_vfile);
+#endif /* CONFIG_XENO_OPT_STATS_WAKEUP */
 	xnvfile_destroy_snapshot(&schedacct_vfile);
 	xnvfile_destroy_snapshot(&schedstat_vfile);
 #endif /* CONFIG_XENO_OPT_STATS */
@@ -64,6 +64,7 @@ static int deletion_apc;
 void xnselect_init(struct xnselect *select_block)
 {
 	INIT_LIST_HEAD(&select_block->bindings);
+	select_block->state = -1;
 }
 EXPORT_SYMBOL_GPL(xnselect_init);
 
@@ -124,37 +125,55 @@ int xnselect_bind(struct xnselect *select_block,
 	list_add_tail(&binding->slink, &selector->bindings);
 	list_add_tail(&binding->link, &select_block->bindings);
 	__FD_SET__(index, &selector->fds[type].expected);
+
+	/*
+	 * The driver may sample the state of the descriptor
+	 * differently than it last signaled it, in which case the
+	 * next signal must update all the bindings.
+	 */
+	if (select_block->state != (state != 0))
+		select_block->state = -1;
+
 	if (state) {
 		__FD_SET__(index, &selector->fds[type].pending);
+		list_add_tail(&binding->rlink, &selector->readyq);
 		if (xnselect_wakeup(selector))
 			xnsched_run();
-	} else
+	} else {
 		__FD_CLR__(index, &selector->fds[type].pending);
+		INIT_LIST_HEAD(&binding->rlink);
+	}
 
 	return 0;
 }
 EXPORT_SYMBOL_GPL(xnselect_bind);
 
-/* Must be called with nklock locked irqs off */
+/*
+ * Must be called with nklock locked irqs off. Only the selectors
+ * whose pending set actually changes are updated, and woken up if
+ * the descriptor became ready.
+ */
 int __xnselect_signal(struct xnselect *select_block, unsigned state)
 {
 	struct xnselect_binding *binding;
 	struct xnselector *selector;
+	fd_set *pending;
 	int resched = 0;
 
 	list_for_each_entry(binding, &select_block->bindings, link) {
 		selector = binding->selector;
+		pending = &selector->fds[binding->type].pending;
 		if (state) {
-			if (!__FD_ISSET__(binding->bit_index,
-					&selector->fds[binding->type].pending)) {
-				__FD_SET__(binding->bit_index,
-					 &selector->fds[binding->type].pending);
-				if (xnselect_wakeup(selector))
-					resched = 1;
-			}
-		} else
-			__FD_CLR__(binding->bit_index,
-				 &selector->fds[binding->type].pending);
+			if (__FD_ISSET__(binding->bit_index, pending))
+				continue;
+			__FD_SET__(binding->bit_index, pending);
+			list_add_tail(&binding->rlink, &selector->readyq);
+			if (xnselect_wakeup(selector))
+				resched = 1;
+		} else if (__FD_ISSET__(binding->bit_index, pending)) {
+			list_del_init(&binding->rlink);
+			__FD_CLR__(binding->bit_index, pending);
+		}
 	}
 
 	return resched;
@@ -196,6 +215,7 @@ void xnselect_destroy(struct xnselect *select_block)
 				resched = 1;
 		}
 		list_del(&binding->slink);
+		list_del(&binding->rlink);
 		xnlock_put_irqrestore(&nklock, s);
 		xnfree(binding);
 		xnlock_get_irqsave(&nklock, s);
@@ -289,6 +309,7 @@ int xnselector_init(struct xnselector *selector)
 		__FD_ZERO__(&selector->fds[i].pending);
 	}
 	INIT_LIST_HEAD(&selector->bindings);
+	INIT_LIST_HEAD(&selector->readyq);
 
 	return 0;
 }
@@ -384,6 +405,117 @@ int xnselect(struct xnselector *selector,
 }
 EXPORT_SYMBOL_GPL(xnselect);
 
+/**
+ * Wait for events on the descriptors bound to a selector.
+ *
+ * Unlike xnselect(), this service does not scan the descriptor sets
+ * but only the list of bindings with pending events, which the
+ * selector maintains across calls. Its cost therefore depends on the
+ * number of events reported, not on the number of descriptors bound.
+ *
+ * Events are level-triggered: a binding remains ready until the
+ * descriptor clears its state. Reported bindings are moved to the
+ * end of the ready list, so that the next call reports the others
+ * first when @a maxevents is too small to collect all of them.
+ *
+ * @param selector the selector block to wait on;
+ * @param events array receiving the index and type of each binding
+ * with pending events;
+ * @param maxevents the number of entries in @a events;
+ * @param timeout the timeout, whose meaning depends on @a
+ * timeout_mode, XN_NONBLOCK to only poll the selector;
+ * @param timeout_mode the mode of @a timeout.
+ *
+ * @retval -EINTR if the caller was interrupted while waiting;
+ * @retval -EBADF if the selector was destroyed while waiting;
+ * @retval 0 in case of timeout;
+ * @retval the number of events stored into @a events.
+ *
+ * @coretags{primary-only, might-switch}
+ */
+int xnselector_wait(struct xnselector *selector,
+		    struct xnselect_event *events, int maxevents,
+		    xnticks_t timeout, xntmode_t timeout_mode)
+{
+	struct xnselect_binding *binding, *first = NULL;
+	int info = 0, n = 0;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	while (list_empty(&selector->readyq)) {
+		if (timeout == XN_NONBLOCK || (info & (XNBREAK | XNTIMEO)))
+			goto out;
+		info = xnsynch_sleep_on(&selector->synchbase,
+					timeout, timeout_mode);
+		/* The selector may be gone already, do not touch it. */
+		if (info & XNRMID) {
+			xnlock_put_irqrestore(&nklock, s);
+			return -EBADF;
+		}
+	}
+
+	while (n < maxevents && !list_empty(&selector->readyq)) {
+		binding = list_first_entry(&selector->readyq,
+					   struct xnselect_binding, rlink);
+		if (binding == first)
+			break;
+		if (first == NULL)
+			first = binding;
+		events[n].index = binding->bit_index;
+		events[n].type = binding->type;
+		list_move_tail(&binding->rlink, &selector->readyq);
+		n++;
+	}
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (n == 0 && (info & XNBREAK))
+		return -EINTR;
+
+	return n;
+}
+EXPORT_SYMBOL_GPL(xnselector_wait);
+
+/**
+ * Unbind a file descriptor from a selector.
+ *
+ * All the bindings of the file descriptor designated by @a index
+ * with @a selector are destroyed, whatever their event type.
+ *
+ * @param selector the selector block;
+ * @param index index of the file descriptor, as passed to
+ * xnselect_bind().
+ *
+ * @coretags{task-unrestricted}
+ */
+void xnselector_unbind(struct xnselector *selector, unsigned int index)
+{
+	struct xnselect_binding *binding, *tmp;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	list_for_each_entry_safe(binding, tmp, &selector->bindings, slink) {
+		if (binding->bit_index != index)
+			continue;
+		list_del(&binding->link);
+		list_del(&binding->slink);
+		list_del(&binding->rlink);
+		__FD_CLR__(index, &selector->fds[binding->type].expected);
+		__FD_CLR__(index, &selector->fds[binding->type].pending);
+		xnlock_put_irqrestore(&nklock, s);
+		xnfree(binding);
+		xnlock_get_irqsave(&nklock, s);
+		/* The list may have changed while unlocked. */
+		tmp = list_first_entry(&selector->bindings,
+				       struct xnselect_binding, slink);
+	}
+
+	xnlock_put_irqrestore(&nklock, s);
+}
+EXPORT_SYMBOL_GPL(xnselector_unbind);
+
 /**
  * Destroy a selector block.
  *
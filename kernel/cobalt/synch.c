@@ -22,6 +22,8 @@
 #include <cobalt/kernel/synch.h>
 #include <cobalt/kernel/thread.h>
 #include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/registry.h>
+#include <cobalt/kernel/vfile.h>
 #include <cobalt/uapi/signal.h>
 #include <trace/events/cobalt-core.h>
 
@@ -31,6 +33,88 @@
  * @{
  */
 
+#ifdef CONFIG_XENO_OPT_STATS_LOCK
+
+static LIST_HEAD(lockstatq);
+
+static int nrlockstats;
+
+static struct xnvfile_rev_tag lockstat_tag;
+
+static inline xnticks_t lockstat_now(void)
+{
+	return xnclock_core_read_raw();
+}
+
+/* Only the owner updates the acquisition and hold figures. */
+static inline void lockstat_grab(struct xnsynch *synch)
+{
+	synch->stat.acquires++;
+	synch->stat.hold_start = xnclock_core_read_raw();
+}
+
+static inline void lockstat_wait(struct xnsynch *synch, xnticks_t start)
+{
+	xnticks_t wait;
+
+	wait = xnclock_core_ticks_to_ns(xnclock_core_read_raw() - start);
+	synch->stat.contended++;
+	synch->stat.wait_total += wait;
+	if (wait > synch->stat.wait_max)
+		synch->stat.wait_max = wait;
+}
+
+static inline void lockstat_release(struct xnsynch *synch)
+{
+	xnticks_t hold;
+
+	hold = xnclock_core_ticks_to_ns(xnclock_core_read_raw() -
+					synch->stat.hold_start);
+	if (hold > synch->stat.hold_max)
+		synch->stat.hold_max = hold;
+}
+
+static inline void lockstat_boost(struct xnsynch *synch)
+{
+	synch->stat.boosts++;	/* nklock held */
+}
+
+static inline void lockstat_init(struct xnsynch *synch)
+{
+	memset(&synch->stat, 0, sizeof(synch->stat));
+}
+
+static void lockstat_unpublish(struct xnsynch *synch)
+{
+	spl_t s;
+
+	if (synch->stat.handle == XN_NO_HANDLE)
+		return;
+
+	xnlock_get_irqsave(&nklock, s);
+	list_del(&synch->stat.next);
+	synch->stat.handle = XN_NO_HANDLE;
+	nrlockstats--;
+	xnvfile_touch_tag(&lockstat_tag);
+	xnlock_put_irqrestore(&nklock, s);
+}
+
+#else /* !CONFIG_XENO_OPT_STATS_LOCK */
+
+static inline xnticks_t lockstat_now(void)
+{
+	return 0;
+}
+
+static inline void lockstat_grab(struct xnsynch *synch) { }
+static inline void lockstat_wait(struct xnsynch *synch, xnticks_t start) { }
+static inline void lockstat_release(struct xnsynch *synch) { }
+static inline void lockstat_boost(struct xnsynch *synch) { }
+static inline void lockstat_init(struct xnsynch *synch) { }
+static inline void lockstat_unpublish(struct xnsynch *synch) { }
+
+#endif /* !CONFIG_XENO_OPT_STATS_LOCK */
+
 /**
  * @fn void xnsynch_init(struct xnsynch *synch, int flags,
  *                       atomic_t *fastlock)
@@ -88,6 +172,7 @@ void xnsynch_init(struct xnsynch *synch, int flags, atomic_t *fastlock)
 	synch->cleanup = NULL;	/* Only works for PIP-enabled objects. */
 	synch->wprio = -1;
 	INIT_LIST_HEAD(&synch->pendq);
+	lockstat_init(synch);
 
 	if (flags & XNSYNCH_OWNER) {
 		BUG_ON(fastlock == NULL);
@@ -120,6 +205,7 @@ int xnsynch_destroy(struct xnsynch *synch)
 	
 	ret = xnsynch_flush(synch, XNRMID);
 	XENO_BUG_ON(COBALT, synch->status & XNSYNCH_CLAIMED);
+	lockstat_unpublish(synch);
 
 	return ret;
 }
@@ -378,6 +464,7 @@ int xnsynch_try_acquire(struct xnsynch *synch)
 
 	xnsynch_set_owner(synch, curr);
 	xnthread_get_resource(curr);
+	lockstat_grab(synch);
 
 	return 0;
 }
@@ -426,6 +513,7 @@ int xnsynch_acquire(struct xnsynch *synch, xnticks_t timeout,
 {
 	struct xnthread *curr, *owner;
 	xnhandle_t currh, h, oldh;
+	xnticks_t wait_start = 0;
 	atomic_t *lockp;
 	spl_t s;
 
@@ -443,9 +531,15 @@ redo:
 	if (likely(h == XN_NO_HANDLE)) {
 		xnsynch_set_owner(synch, curr);
 		xnthread_get_resource(curr);
+		if (wait_start)	/* Released while we were redoing. */
+			lockstat_wait(synch, wait_start);
+		lockstat_grab(synch);
 		return 0;
 	}
 
+	if (wait_start == 0)
+		wait_start = lockstat_now();
+
 	xnlock_get_irqsave(&nklock, s);
 
 	/*
@@ -516,6 +610,7 @@ redo:
 			synch->wprio = curr->wprio;
 			list_add_priff(synch, &owner->claimq, wprio, link);
 			xnsynch_renice_thread(owner, curr);
+			lockstat_boost(synch);
 		}
 	} else
 		list_add_priff(curr, &synch->pendq, wprio, plink);
@@ -547,6 +642,8 @@ block:
 	}
  grab:
 	xnthread_get_resource(curr);
+	lockstat_wait(synch, wait_start);
+	lockstat_grab(synch);
 
 	if (xnsynch_pended_p(synch))
 		currh = xnsynch_fast_claimed(currh);
@@ -672,6 +769,8 @@ struct xnthread *xnsynch_release(struct xnsynch *synch,
 	if (xnthread_put_resource(thread))
 		return NULL;
 
+	lockstat_release(synch);
+
 	lockp = xnsynch_fastlock(synch);
 	XENO_BUG_ON(COBALT, lockp == NULL);
 	threadh = thread->handle;
@@ -951,4 +1050,169 @@ void xnsynch_detect_claimed_relax(struct xnthread *owner)
 
 #endif /* XENO_DEBUG(MUTEX_RELAXED) */
 
+#ifdef CONFIG_XENO_OPT_STATS_LOCK
+
+/**
+ * @fn void xnsynch_stat_publish(struct xnsynch *synch, xnhandle_t handle, unsigned long uaddr)
+ * @brief Publish the contention statistics of a synchronization object.
+ *
+ * Make the contention statistics of @a synch available from the
+ * /proc/xenomai/lockstat interface, until the object is destroyed by
+ * a call to xnsynch_destroy(), which must eventually happen.
+ *
+ * @param synch The descriptor address of the synchronization object,
+ * which must track ownership (XNSYNCH_OWNER set).
+ *
+ * @param handle The registry handle of the object @a synch belongs
+ * to, which is used for naming it.
+ *
+ * @param uaddr The user-space address of the object, for mapping it
+ * to a symbol. Zero if none.
+ *
+ * @coretags{task-unrestricted}
+ */
+void xnsynch_stat_publish(struct xnsynch *synch,
+			  xnhandle_t handle, unsigned long uaddr)
+{
+	spl_t s;
+
+	XENO_BUG_ON(COBALT, (synch->status & XNSYNCH_OWNER) == 0);
+
+	xnlock_get_irqsave(&nklock, s);
+	synch->stat.handle = handle;
+	synch->stat.pid = current->tgid;
+	synch->stat.uaddr = uaddr;
+	list_add_tail(&synch->stat.next, &lockstatq);
+	nrlockstats++;
+	xnvfile_touch_tag(&lockstat_tag);
+	xnlock_put_irqrestore(&nklock, s);
+}
+EXPORT_SYMBOL_GPL(xnsynch_stat_publish);
+
+#ifdef CONFIG_XENO_OPT_VFILE
+
+struct vfile_lockstat_priv {
+	struct xnsynch_stat *curr;
+};
+
+struct vfile_lockstat_data {
+	struct xnsynch_stat stat;
+	char name[XNOBJECT_NAME_LEN];
+};
+
+static struct xnvfile_snapshot_ops vfile_lockstat_ops;
+
+static struct xnvfile_snapshot lockstat_vfile = {
+	.privsz = sizeof(struct vfile_lockstat_priv),
+	.datasz = sizeof(struct vfile_lockstat_data),
+	.tag = &lockstat_tag,
+	.ops = &vfile_lockstat_ops,
+};
+
+static int vfile_lockstat_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_lockstat_priv *priv = xnvfile_iterator_priv(it);
+
+	if (list_empty(&lockstatq)) {
+		priv->curr = NULL;
+		return 0;
+	}
+
+	priv->curr = list_first_entry(&lockstatq, struct xnsynch_stat, next);
+
+	return nrlockstats;
+}
+
+static int vfile_lockstat_next(struct xnvfile_snapshot_iterator *it,
+			       void *data)
+{
+	struct vfile_lockstat_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_lockstat_data *p = data;
+	struct xnsynch_stat *stat;
+	const char *key;
+
+	if (priv->curr == NULL)
+		return 0;	/* We are done. */
+
+	stat = priv->curr;
+	if (list_is_last(&stat->next, &lockstatq))
+		priv->curr = NULL;
+	else
+		priv->curr = list_next_entry(stat, next);
+
+	p->stat = *stat;
+	/* Anonymous objects are named after their handle. */
+	key = xnregistry_key(stat->handle);
+	if (key)
+		knamecpy(p->name, key);
+	else
+		ksformat(p->name, sizeof(p->name), "@%x", stat->handle);
+
+	return 1;
+}
+
+static int vfile_lockstat_show(struct xnvfile_snapshot_iterator *it,
+			       void *data)
+{
+	struct vfile_lockstat_data *p = data;
+
+	if (p == NULL)
+		xnvfile_printf(it, "%-6s %-16s %-10s %-10s %-8s %-14s %-10s "
+			       "%-10s %s\n", "PID", "ADDRESS", "ACQUIRE",
+			       "CONTEND", "BOOST", "WAIT-TOTAL", "WAIT-MAX",
+			       "HOLD-MAX", "NAME");
+	else
+		xnvfile_printf(it, "%-6d %-16lx %-10lu %-10lu %-8lu %-14Lu %-10Lu "
+			       "%-10Lu %s\n", p->stat.pid, p->stat.uaddr,
+			       p->stat.acquires, p->stat.contended,
+			       p->stat.boosts, p->stat.wait_total,
+			       p->stat.wait_max, p->stat.hold_max, p->name);
+
+	return 0;
+}
+
+static ssize_t vfile_lockstat_store(struct xnvfile_input *input)
+{
+	struct xnsynch_stat *stat;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	list_for_each_entry(stat, &lockstatq, next) {
+		stat->acquires = 0;
+		stat->contended = 0;
+		stat->boosts = 0;
+		stat->wait_total = 0;
+		stat->wait_max = 0;
+		stat->hold_max = 0;
+	}
+
+	xnvfile_touch_tag(&lockstat_tag);
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return input->size;
+}
+
+static struct xnvfile_snapshot_ops vfile_lockstat_ops = {
+	.rewind = vfile_lockstat_rewind,
+	.next = vfile_lockstat_next,
+	.show = vfile_lockstat_show,
+	.store = vfile_lockstat_store,
+};
+
+void xnsynch_init_proc(void)
+{
+	xnvfile_init_snapshot("lockstat", &lockstat_vfile, &cobalt_vfroot);
+}
+
+void xnsynch_cleanup_proc(void)
+{
+	xnvfile_destroy_snapshot(&lockstat_vfile);
+}
+
+#endif /* CONFIG_XENO_OPT_VFILE */
+
+#endif /* CONFIG_XENO_OPT_STATS_LOCK */
+
 /** @} */
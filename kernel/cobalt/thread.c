@@ -37,6 +37,7 @@
 #include <cobalt/kernel/select.h>
 #include <cobalt/kernel/lock.h>
 #include <cobalt/kernel/thread.h>
+#include <cobalt/kernel/flightrec.h>
 #include <trace/events/cobalt-core.h>
 #include <asm-generic/xenomai/mayday.h>
 #include "debug.h"
@@ -49,10 +50,36 @@ static DECLARE_WAIT_QUEUE_HEAD(join_all);
  * @{
  */
 
+static inline void stamp_release(struct xnthread *thread,
+				 struct xntimer *timer)
+{
+#ifdef CONFIG_XENO_OPT_STATS_WAKEUP
+	xnticks_t date;
+
+	/* Only plain sleepers timed by the core clock are accounted. */
+	if (xnthread_test_state(thread, XNDELAY|XNPEND) != XNDELAY ||
+	    xntimer_clock(timer) != &nkclock)
+		return;
+
+	/*
+	 * The periodic release point only moves forward when the
+	 * thread collects the overruns, so it still designates the
+	 * expected date of the current shot.
+	 */
+	if (xntimer_periodic_p(timer))
+		date = xntimer_pexpect(timer);
+	else
+		date = xntimer_expiry(timer);
+
+	xnstat_wakeup_arm(&thread->stat.wakeup, date);
+#endif
+}
+
 static void timeout_handler(struct xntimer *timer)
 {
 	struct xnthread *thread = container_of(timer, struct xnthread, rtimer);
 
+	stamp_release(thread, timer);
 	xnthread_set_info(thread, XNTIMEO);	/* Interrupts are off. */
 	xnthread_resume(thread, XNDELAY);
 }
@@ -81,8 +108,10 @@ static void periodic_handler(struct xntimer *timer)
 	 * Prevent unwanted round-robin, and do not wake up threads
 	 * blocked on a resource.
 	 */
-	if (xnthread_test_state(thread, XNDELAY|XNPEND) == XNDELAY)
+	if (xnthread_test_state(thread, XNDELAY|XNPEND) == XNDELAY) {
+		stamp_release(thread, timer);
 		xnthread_resume(thread, XNDELAY);
+	}
 
 	fixup_ptimer_affinity(thread);
 }
@@ -182,9 +211,11 @@ int __xnthread_init(struct xnthread *thread,
 	/*
 	 * We mirror the global user debug state into the per-thread
 	 * state, to speed up branch taking in lib/cobalt wherever
-	 * this needs to be tested.
+	 * this needs to be tested. Collecting lock statistics
+	 * requires the mutex fast paths to be disabled as well.
 	 */
-	if (IS_ENABLED(CONFIG_XENO_OPT_DEBUG_MUTEX_SLEEP))
+	if (IS_ENABLED(CONFIG_XENO_OPT_DEBUG_MUTEX_SLEEP) ||
+	    IS_ENABLED(CONFIG_XENO_OPT_STATS_LOCK))
 		flags |= XNDEBUG;
 
 	thread->personality = attr->personality;
@@ -1102,6 +1133,7 @@ void xnthread_resume(struct xnthread *thread, int mask)
 	xnlock_get_irqsave(&nklock, s);
 
 	trace_cobalt_thread_resume(thread, mask);
+	xnflightrec_log(XNFLIGHTREC_WAKEUP, xnthread_host_pid(thread), mask);
 
 	xntrace_pid(xnthread_host_pid(thread), xnthread_current_priority(thread));
 
@@ -2047,6 +2079,7 @@ int xnthread_harden(void)
 	xnthread_test_cancel();
 
 	trace_cobalt_shadow_hardened(thread);
+	xnflightrec_log(XNFLIGHTREC_HARDEN, xnthread_host_pid(thread), 0);
 
 	/*
 	 * Recheck pending signals once again. As we block task
@@ -2136,6 +2169,7 @@ void xnthread_relax(int notify, int reason)
 	 * to resume using the register state of the shadow thread.
 	 */
 	trace_cobalt_shadow_gorelax(thread, reason);
+	xnflightrec_log(XNFLIGHTREC_RELAX, xnthread_host_pid(thread), reason);
 
 	/*
 	 * If you intend to change the following interrupt-free
@@ -2423,6 +2457,9 @@ void xnthread_signal(struct xnthread *thread, int sig, int arg)
 
 	trace_cobalt_lostage_request("signal", sigwork.task);
 
+	if (sig == SIGDEBUG)
+		xnflightrec_freeze(xnthread_host_pid(thread), arg);
+
 	ipipe_post_work_root(&sigwork, work);
 }
 EXPORT_SYMBOL_GPL(xnthread_signal);
@@ -952,6 +952,196 @@ void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
 	rb_link_node(&holder->link, parent, new);
 	rb_insert_color(&holder->link, &q->root);
 }
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+#define XNTIMERQ_WHEEL_NEAR	-1
+
+static inline xnticks_t xntimerh_index(xntimerh_t *holder)
+{
+	return xntimerh_date(holder) >> XNTIMERQ_WHEEL_SHIFT;
+}
+
+/*
+ * The bucket a timer belongs to only depends on its index and on the
+ * current base, since advancing the base never changes the level of
+ * the timers which are not cascaded. We can therefore recompute it
+ * on removal instead of storing it into the holder.
+ */
+static struct list_head *xntimerq_locate(xntimerq_t *q, xnticks_t idx,
+					 int *level, int *slot)
+{
+	int l;
+
+	if (idx <= q->base) {
+		*level = XNTIMERQ_WHEEL_NEAR;
+		return &q->near;
+	}
+
+	l = (fls64(idx ^ q->base) - 1) / XNTIMERQ_WHEEL_BITS;
+	*level = l;
+	if (l >= XNTIMERQ_WHEEL_LEVELS)
+		return &q->overflow;
+
+	*slot = (idx >> (l * XNTIMERQ_WHEEL_BITS)) & XNTIMERQ_WHEEL_MASK;
+
+	return &q->slots[l][*slot];
+}
+
+static void xntimerq_enqueue(xntimerq_t *q, xntimerh_t *holder)
+{
+	struct list_head *bucket;
+	int level, slot = 0;
+
+	bucket = xntimerq_locate(q, xntimerh_index(holder), &level, &slot);
+	if (level == XNTIMERQ_WHEEL_NEAR) {
+		xntlist_insert(bucket, holder);
+		return;
+	}
+
+	list_add_tail(&holder->link, bucket);
+	if (level < XNTIMERQ_WHEEL_LEVELS)
+		q->map[level] |= 1ULL << slot;
+}
+
+void xntimerq_init(xntimerq_t *q)
+{
+	int level, slot;
+
+	INIT_LIST_HEAD(&q->near);
+	INIT_LIST_HEAD(&q->overflow);
+
+	for (level = 0; level < XNTIMERQ_WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < XNTIMERQ_WHEEL_SIZE; slot++)
+			INIT_LIST_HEAD(&q->slots[level][slot]);
+		q->map[level] = 0;
+	}
+
+	q->base = 0;
+	q->nr = 0;
+}
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
+{
+	/*
+	 * Restart from the inserted date when the queue is empty, so
+	 * that the base does not lag behind the timeline. Conversely,
+	 * the host tick timer keeps the base from running too far
+	 * ahead of the current time, which would send the new timers
+	 * to the (linear) near bucket.
+	 */
+	if (q->nr++ == 0)
+		q->base = xntimerh_index(holder);
+
+	xntimerq_enqueue(q, holder);
+}
+
+void xntimerq_remove(xntimerq_t *q, xntimerh_t *holder)
+{
+	struct list_head *bucket;
+	int level, slot = 0;
+
+	bucket = xntimerq_locate(q, xntimerh_index(holder), &level, &slot);
+	list_del(&holder->link);
+	q->nr--;
+
+	if (level >= 0 && level < XNTIMERQ_WHEEL_LEVELS &&
+	    list_empty(bucket))
+		q->map[level] &= ~(1ULL << slot);
+}
+
+/*
+ * Cascade the earliest wheel slots into the near bucket, until
+ * something follows @last in the latter, or the wheel is empty. All
+ * timers from a level precede those from any upper level, and only
+ * the slots past the base digit may be occupied at any level.
+ */
+void __xntimerq_pull(xntimerq_t *q, struct list_head *last)
+{
+	xntimerh_t *holder, *tmp;
+	xnticks_t idx, minidx;
+	int level, digit, slot;
+	LIST_HEAD(pending);
+	u64 map = 0;
+
+	while (q->near.prev == last) {
+		for (level = 0; level < XNTIMERQ_WHEEL_LEVELS; level++) {
+			digit = (q->base >> (level * XNTIMERQ_WHEEL_BITS)) &
+				XNTIMERQ_WHEEL_MASK;
+			if (digit == XNTIMERQ_WHEEL_MASK)
+				continue;
+			map = q->map[level] & (~0ULL << (digit + 1));
+			if (map)
+				break;
+		}
+
+		if (level < XNTIMERQ_WHEEL_LEVELS) {
+			slot = __ffs64(map);
+			q->base &= ~((1ULL << ((level + 1) * XNTIMERQ_WHEEL_BITS)) - 1);
+			q->base |= (xnticks_t)slot << (level * XNTIMERQ_WHEEL_BITS);
+			list_splice_init(&q->slots[level][slot], &pending);
+			q->map[level] &= ~(1ULL << slot);
+		} else {
+			if (list_empty(&q->overflow))
+				return;
+			/*
+			 * The wheel is empty, restart from the
+			 * earliest far timer. This is O(N), but only
+			 * happens with timers set beyond the wheel
+			 * span.
+			 */
+			minidx = (xnticks_t)-1;
+			list_for_each_entry(holder, &q->overflow, link) {
+				idx = xntimerh_index(holder);
+				if (idx < minidx)
+					minidx = idx;
+			}
+			q->base = minidx;
+			list_splice_init(&q->overflow, &pending);
+		}
+
+		list_for_each_entry_safe(holder, tmp, &pending, link) {
+			list_del(&holder->link);
+			xntimerq_enqueue(q, holder);
+		}
+	}
+}
+
+static struct list_head *xntimerq_bucket(xntimerq_t *q, int bucket)
+{
+	int nrslots = XNTIMERQ_WHEEL_LEVELS * XNTIMERQ_WHEEL_SIZE;
+
+	if (bucket == 0)
+		return &q->near;
+
+	if (bucket <= nrslots) {
+		bucket--;
+		return &q->slots[bucket / XNTIMERQ_WHEEL_SIZE]
+			[bucket % XNTIMERQ_WHEEL_SIZE];
+	}
+
+	if (bucket == nrslots + 1)
+		return &q->overflow;
+
+	return NULL;
+}
+
+xntimerh_t *xntimerq_it_next(xntimerq_t *q, xntimerq_it_t *it,
+			     xntimerh_t *holder)
+{
+	struct list_head *bucket;
+
+	if (holder &&
+	    !list_is_last(&holder->link, xntimerq_bucket(q, it->bucket)))
+		return list_entry(holder->link.next, xntimerh_t, link);
+
+	for (;;) {
+		bucket = xntimerq_bucket(q, ++it->bucket);
+		if (bucket == NULL)
+			return NULL;
+		if (!list_empty(bucket))
+			return list_first_entry(bucket, xntimerh_t, link);
+	}
+}
 #endif
 
 /** @} */
@@ -22,6 +22,8 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/map.h>
 #include <cobalt/kernel/bufd.h>
@@ -37,6 +39,7 @@ struct bufp_socket {
 
 	void *bufmem;
 	size_t bufsz;
+	struct bufp_ring *ring;
 	u_long status;
 	xnhandle_t handle;
 	char label[XNOBJECT_NAME_LEN];
@@ -71,6 +74,7 @@ static struct xnmap *portmap;
 #define _BUFP_BINDING   0
 #define _BUFP_BOUND     1
 #define _BUFP_CONNECTED 2
+#define _BUFP_MMAP      3
 
 #ifdef CONFIG_XENO_OPT_VFILE
 
@@ -102,6 +106,146 @@ static struct xnpnode_link __bufp_pnode = {
 
 #endif /* !CONFIG_XENO_OPT_VFILE */
 
+/*
+ * In mapped ring mode, the fill state of the buffer is kept in the
+ * shared ring header, which userland may update concurrently. The
+ * indices are free-running, so that the producer and the consumer
+ * never write to the same location. Since userland may scribble
+ * over them, we sanitize the values we get.
+ */
+static inline size_t __bufp_fillsz(struct bufp_socket *sk)
+{
+	struct bufp_ring *ring = sk->ring;
+	u32 fillsz;
+
+	if (ring == NULL)
+		return sk->fillsz;
+
+	fillsz = READ_ONCE(ring->head) - READ_ONCE(ring->tail);
+	/* Order the index loads before the data accesses. */
+	smp_rmb();
+
+	return fillsz > sk->bufsz ? sk->bufsz : fillsz;
+}
+
+static inline off_t __bufp_rdoff(struct bufp_socket *sk)
+{
+	if (sk->ring)
+		return READ_ONCE(sk->ring->tail) & (sk->bufsz - 1);
+
+	return sk->rdoff;
+}
+
+static inline off_t __bufp_wroff(struct bufp_socket *sk)
+{
+	if (sk->ring)
+		return READ_ONCE(sk->ring->head) & (sk->bufsz - 1);
+
+	return sk->wroff;
+}
+
+static inline void __bufp_consume(struct bufp_socket *sk,
+				  size_t len, off_t rdoff)
+{
+	struct bufp_ring *ring = sk->ring;
+
+	if (ring) {
+		/* Release the room once we are done reading. */
+		smp_mb();
+		WRITE_ONCE(ring->tail, ring->tail + len);
+	} else {
+		sk->fillsz -= len;
+		sk->rdoff = rdoff;
+	}
+}
+
+static inline void __bufp_produce(struct bufp_socket *sk,
+				  size_t len, off_t wroff)
+{
+	struct bufp_ring *ring = sk->ring;
+
+	if (ring) {
+		/* Publish the data before the index. */
+		smp_wmb();
+		WRITE_ONCE(ring->head, ring->head + len);
+	} else {
+		sk->fillsz += len;
+		sk->wroff = wroff;
+	}
+}
+
+/*
+ * Raise a waiter flag in the ring header before sleeping, so that
+ * userland knows it has to notify us after updating its index. The
+ * caller must check the wait condition again afterwards, which
+ * pairs with the barrier the other side issues between updating
+ * its index and testing our flag. Called with the nucleus lock
+ * held.
+ */
+static inline void __bufp_raise_waiter(u32 *flag)
+{
+	WRITE_ONCE(*flag, 1);
+	smp_mb();
+}
+
+static inline void __bufp_update_waiters(struct bufp_socket *sk)
+{
+	struct bufp_ring *ring = sk->ring;
+
+	if (ring) {
+		WRITE_ONCE(ring->rdwait,
+			   rtipc_peek_wait_head(&sk->i_event) != NULL);
+		WRITE_ONCE(ring->wrwait,
+			   rtipc_peek_wait_head(&sk->o_event) != NULL);
+	}
+}
+
+static inline size_t __bufp_ringlen(struct bufp_socket *sk)
+{
+	return PAGE_SIZE + PAGE_ALIGN(sk->bufsz);
+}
+
+static int __bufp_alloc_buffer(struct bufp_socket *sk)
+{
+	struct bufp_ring *ring;
+	size_t len;
+
+	if (!test_bit(_BUFP_MMAP, &sk->status)) {
+		sk->bufmem = xnheap_vmalloc(sk->bufsz);
+		return sk->bufmem ? 0 : -ENOMEM;
+	}
+
+	/* Indices wrap at 2^32, which the ring size must divide. */
+	if (sk->bufsz > (1UL << 31))
+		return -EINVAL;
+
+	sk->bufsz = roundup_pow_of_two(sk->bufsz);
+	len = __bufp_ringlen(sk);
+	ring = xnheap_vmalloc(len);
+	if (ring == NULL)
+		return -ENOMEM;
+
+	/* This memory is visible from userland. */
+	memset(ring, 0, len);
+	ring->size = sk->bufsz;
+	ring->data = PAGE_SIZE;
+	sk->ring = ring;
+	sk->bufmem = (void *)ring + PAGE_SIZE;
+
+	return 0;
+}
+
+static void __bufp_free_buffer(struct bufp_socket *sk)
+{
+	/*
+	 * Pages of a mapped ring stay referenced by the user
+	 * mappings until these are removed.
+	 */
+	xnheap_vfree(sk->ring ?: sk->bufmem);
+	sk->ring = NULL;
+	sk->bufmem = NULL;
+}
+
 static int bufp_socket(struct rtdm_fd *fd)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
@@ -112,6 +256,7 @@ static int bufp_socket(struct rtdm_fd *fd)
 	sk->peer = nullsa;
 	sk->bufmem = NULL;
 	sk->bufsz = 0;
+	sk->ring = NULL;
 	sk->rdoff = 0;
 	sk->wroff = 0;
 	sk->fillsz = 0;
@@ -149,7 +294,7 @@ static void bufp_close(struct rtdm_fd *fd)
 			xnregistry_remove(sk->handle);
 
 		if (sk->bufmem)
-			xnheap_vfree(sk->bufmem);
+			__bufp_free_buffer(sk);
 	}
 
 	kfree(sk);
@@ -164,7 +309,7 @@ static ssize_t __bufp_readbuf(struct bufp_socket *sk,
 	struct xnthread *waiter;
 	rtdm_toseq_t toseq;
 	ssize_t len, ret;
-	size_t rbytes, n;
+	size_t rbytes, n, fillsz;
 	rtdm_lockctx_t s;
 	u_long rdtoken;
 	off_t rdoff;
@@ -181,7 +326,7 @@ redo:
 		 * We should be able to read a complete message of the
 		 * requested length, or block.
 		 */
-		if (sk->fillsz < len)
+		if (__bufp_fillsz(sk) < len)
 			goto wait;
 
 		/*
@@ -191,7 +336,7 @@ redo:
 		rdtoken = ++sk->rdtoken;
 
 		/* Read from the buffer in a circular way. */
-		rdoff = sk->rdoff;
+		rdoff = __bufp_rdoff(sk);
 		rbytes = len;
 
 		do {
@@ -223,15 +368,15 @@ redo:
 			rbytes -= n;
 		} while (rbytes > 0);
 
-		sk->fillsz -= len;
-		sk->rdoff = rdoff;
+		__bufp_consume(sk, len, rdoff);
+		fillsz = __bufp_fillsz(sk);
 		ret = len;
 
 		resched = 0;
-		if (sk->fillsz + len == sk->bufsz) /* -> writable */
+		if (fillsz + len == sk->bufsz) /* -> writable */
 			resched |= xnselect_signal(&sk->priv->send_block, POLLOUT);
 
-		if (sk->fillsz == 0) /* -> non-readable */
+		if (fillsz == 0) /* -> non-readable */
 			resched |= xnselect_signal(&sk->priv->recv_block, 0);
 
 		/*
@@ -246,7 +391,7 @@ redo:
 		wc = rtipc_get_wait_context(waiter);
 		XENO_BUG_ON(COBALT, wc == NULL);
 		bufwc = container_of(wc, struct bufp_wait_context, wc);
-		if (bufwc->len + sk->fillsz <= sk->bufsz)
+		if (bufwc->len + fillsz <= sk->bufsz)
 			/* This call rescheds internally. */
 			rtdm_event_pulse(&sk->o_event);
 		else if (resched)
@@ -271,11 +416,18 @@ redo:
 		 * pathological use of the buffer. We must allow for a
 		 * short read to prevent a deadlock.
 		 */
-		if (sk->fillsz > 0 && rtipc_peek_wait_head(&sk->o_event)) {
-			len = sk->fillsz;
+		fillsz = __bufp_fillsz(sk);
+		if (fillsz > 0 && rtipc_peek_wait_head(&sk->o_event)) {
+			len = fillsz;
 			goto redo;
 		}
 
+		if (sk->ring) {
+			__bufp_raise_waiter(&sk->ring->rdwait);
+			if (__bufp_fillsz(sk) >= len)
+				continue;
+		}
+
 		wait.len = len;
 		wait.sk = sk;
 		rtipc_prepare_wait(&wait.wc);
@@ -289,6 +441,7 @@ redo:
 			break;
 	}
 out:
+	__bufp_update_waiters(sk);
 	cobalt_atomic_leave(s);
 
 	return ret;
@@ -417,7 +570,7 @@ static ssize_t __bufp_writebuf(struct bufp_socket *rsk,
 	rtdm_toseq_t toseq;
 	rtdm_lockctx_t s;
 	ssize_t len, ret;
-	size_t wbytes, n;
+	size_t wbytes, n, fillsz;
 	u_long wrtoken;
 	off_t wroff;
 	int resched;
@@ -433,7 +586,7 @@ redo:
 		 * We should be able to write the entire message at
 		 * once or block.
 		 */
-		if (rsk->fillsz + len > rsk->bufsz)
+		if (__bufp_fillsz(rsk) + len > rsk->bufsz)
 			goto wait;
 
 		/*
@@ -443,7 +596,7 @@ redo:
 		wrtoken = ++rsk->wrtoken;
 
 		/* Write to the buffer in a circular way. */
-		wroff = rsk->wroff;
+		wroff = __bufp_wroff(rsk);
 		wbytes = len;
 
 		do {
@@ -474,15 +627,15 @@ redo:
 			wbytes -= n;
 		} while (wbytes > 0);
 
-		rsk->fillsz += len;
-		rsk->wroff = wroff;
+		__bufp_produce(rsk, len, wroff);
+		fillsz = __bufp_fillsz(rsk);
 		ret = len;
 		resched = 0;
 
-		if (rsk->fillsz == len) /* -> readable */
+		if (fillsz == len) /* -> readable */
 			resched |= xnselect_signal(&rsk->priv->recv_block, POLLIN);
 
-		if (rsk->fillsz == rsk->bufsz) /* non-writable */
+		if (fillsz == rsk->bufsz) /* non-writable */
 			resched |= xnselect_signal(&rsk->priv->send_block, 0);
 		/*
 		 * Wake up all threads pending on the input wait
@@ -496,7 +649,7 @@ redo:
 		wc = rtipc_get_wait_context(waiter);
 		XENO_BUG_ON(COBALT, wc == NULL);
 		bufwc = container_of(wc, struct bufp_wait_context, wc);
-		if (bufwc->len <= rsk->fillsz)
+		if (bufwc->len <= fillsz)
 			rtdm_event_pulse(&rsk->i_event);
 		else if (resched)
 			xnsched_run();
@@ -512,6 +665,12 @@ redo:
 			break;
 		}
 
+		if (rsk->ring) {
+			__bufp_raise_waiter(&rsk->ring->wrwait);
+			if (__bufp_fillsz(rsk) + len <= rsk->bufsz)
+				continue;
+		}
+
 		wait.len = len;
 		wait.sk = rsk;
 		rtipc_prepare_wait(&wait.wc);
@@ -525,26 +684,23 @@ redo:
 			break;
 	}
 out:
+	__bufp_update_waiters(rsk);
 	cobalt_atomic_leave(s);
 
 	return ret;
 }
 
-static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
-			      struct iovec *iov, int iovlen, int flags,
-			      const struct sockaddr_ipc *daddr)
+/*
+ * Find the socket bound to the destination port, locking its file
+ * descriptor on success. The caller should release the latter by a
+ * call to rtdm_fd_unlock().
+ */
+static struct bufp_socket *__bufp_lock_peer(const struct sockaddr_ipc *daddr,
+					    struct rtdm_fd **rfdp)
 {
-	struct rtipc_private *priv = rtdm_fd_to_private(fd);
-	struct bufp_socket *sk = priv->state, *rsk;
-	ssize_t len, rdlen, vlen, ret = 0;
+	struct bufp_socket *rsk;
 	struct rtdm_fd *rfd;
-	struct xnbufd bufd;
 	rtdm_lockctx_t s;
-	int nvec;
-
-	len = rtipc_get_iov_flatlen(iov, iovlen);
-	if (len == 0)
-		return 0;
 
 	cobalt_atomic_enter(s);
 	rfd = xnmap_fetch_nocheck(portmap, daddr->sipc_port);
@@ -552,14 +708,38 @@ static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
 		rfd = NULL;
 	cobalt_atomic_leave(s);
 	if (rfd == NULL)
-		return -ECONNRESET;
+		return ERR_PTR(-ECONNRESET);
 
 	rsk = rtipc_fd_to_state(rfd);
 	if (!test_bit(_BUFP_BOUND, &rsk->status)) {
 		rtdm_fd_unlock(rfd);
-		return -ECONNREFUSED;
+		return ERR_PTR(-ECONNREFUSED);
 	}
 
+	*rfdp = rfd;
+
+	return rsk;
+}
+
+static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
+			      struct iovec *iov, int iovlen, int flags,
+			      const struct sockaddr_ipc *daddr)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct bufp_socket *sk = priv->state, *rsk;
+	ssize_t len, rdlen, vlen, ret = 0;
+	struct rtdm_fd *rfd;
+	struct xnbufd bufd;
+	int nvec;
+
+	len = rtipc_get_iov_flatlen(iov, iovlen);
+	if (len == 0)
+		return 0;
+
+	rsk = __bufp_lock_peer(daddr, &rfd);
+	if (IS_ERR(rsk))
+		return PTR_ERR(rsk);
+
 	/*
 	 * We may only send complete messages, so there is no point in
 	 * accepting messages which are larger than what the buffer
@@ -705,11 +885,9 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 	if (sk->bufsz == 0)
 		return -ENOBUFS;
 
-	sk->bufmem = xnheap_vmalloc(sk->bufsz);
-	if (sk->bufmem == NULL) {
-		ret = -ENOMEM;
+	ret = __bufp_alloc_buffer(sk);
+	if (ret)
 		goto fail;
-	}
 
 	sk->name = *sa;
 	/* Set default destination if unset at binding time. */
@@ -720,7 +898,7 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 		ret = xnregistry_enter(sk->label, sk,
 				       &sk->handle, &__bufp_pnode.node);
 		if (ret) {
-			xnheap_vfree(sk->bufmem);
+			__bufp_free_buffer(sk);
 			goto fail;
 		}
 	}
@@ -816,6 +994,136 @@ set_assoc:
 	return 0;
 }
 
+/*
+ * Find the socket owning the ring which @sk refers to, i.e. its own
+ * ring if bound and not connected to another port, otherwise the
+ * ring of the peer. *rfdp receives the locked file descriptor of
+ * the peer, or NULL if @sk owns the ring.
+ */
+static struct bufp_socket *__bufp_lock_ring(struct bufp_socket *sk,
+					    struct rtdm_fd **rfdp)
+{
+	struct bufp_socket *rsk = sk;
+
+	*rfdp = NULL;
+
+	if (!test_bit(_BUFP_BOUND, &sk->status) ||
+	    sk->peer.sipc_port != sk->name.sipc_port) {
+		if (sk->peer.sipc_port < 0)
+			return ERR_PTR(-EDESTADDRREQ);
+		rsk = __bufp_lock_peer(&sk->peer, rfdp);
+		if (IS_ERR(rsk))
+			return rsk;
+	}
+
+	if (rsk->ring == NULL) {
+		if (*rfdp)
+			rtdm_fd_unlock(*rfdp);
+		return ERR_PTR(-ENXIO);
+	}
+
+	return rsk;
+}
+
+static inline void __bufp_unlock_ring(struct rtdm_fd *rfd)
+{
+	if (rfd)
+		rtdm_fd_unlock(rfd);
+}
+
+static inline int __bufp_ring_ready(struct bufp_socket *rsk,
+				    size_t len, int out)
+{
+	size_t fillsz = __bufp_fillsz(rsk);
+
+	return out ? fillsz + len <= rsk->bufsz : fillsz >= len;
+}
+
+static int __bufp_ring_wait(struct bufp_socket *rsk, size_t len,
+			    int out, nanosecs_rel_t timeout)
+{
+	struct bufp_wait_context wait;
+	rtdm_event_t *event;
+	rtdm_toseq_t toseq;
+	rtdm_lockctx_t s;
+	int ret = 0;
+	u32 *flag;
+
+	if (len == 0 || len > rsk->bufsz)
+		return -EINVAL;
+
+	if (out) {
+		event = &rsk->o_event;
+		flag = &rsk->ring->wrwait;
+	} else {
+		event = &rsk->i_event;
+		flag = &rsk->ring->rdwait;
+	}
+
+	rtdm_toseq_init(&toseq, timeout);
+
+	cobalt_atomic_enter(s);
+
+	while (!__bufp_ring_ready(rsk, len, out)) {
+		__bufp_raise_waiter(flag);
+		if (__bufp_ring_ready(rsk, len, out))
+			break;
+		wait.len = len;
+		wait.sk = rsk;
+		rtipc_prepare_wait(&wait.wc);
+		ret = rtdm_event_timedwait(event, timeout, &toseq);
+		if (unlikely(ret))
+			break;
+	}
+
+	__bufp_update_waiters(rsk);
+
+	cobalt_atomic_leave(s);
+
+	return ret;
+}
+
+static void __bufp_ring_notify(struct bufp_socket *rsk)
+{
+	struct bufp_wait_context *bufwc;
+	struct rtipc_wait_context *wc;
+	struct xnthread *waiter;
+	rtdm_lockctx_t s;
+	size_t fillsz;
+	int resched;
+
+	cobalt_atomic_enter(s);
+
+	fillsz = __bufp_fillsz(rsk);
+	resched = xnselect_signal(&rsk->priv->recv_block,
+				  fillsz > 0 ? POLLIN : 0);
+	resched |= xnselect_signal(&rsk->priv->send_block,
+				   fillsz < rsk->bufsz ? POLLOUT : 0);
+
+	waiter = rtipc_peek_wait_head(&rsk->i_event);
+	if (waiter) {
+		wc = rtipc_get_wait_context(waiter);
+		XENO_BUG_ON(COBALT, wc == NULL);
+		bufwc = container_of(wc, struct bufp_wait_context, wc);
+		if (bufwc->len <= fillsz)
+			rtdm_event_pulse(&rsk->i_event);
+	}
+
+	waiter = rtipc_peek_wait_head(&rsk->o_event);
+	if (waiter) {
+		wc = rtipc_get_wait_context(waiter);
+		XENO_BUG_ON(COBALT, wc == NULL);
+		bufwc = container_of(wc, struct bufp_wait_context, wc);
+		if (bufwc->len + fillsz <= rsk->bufsz)
+			rtdm_event_pulse(&rsk->o_event);
+	}
+
+	if (resched)
+		xnsched_run();
+
+	cobalt_atomic_leave(s);
+}
+
 static int __bufp_setsockopt(struct bufp_socket *sk,
 			     struct rtdm_fd *fd,
 			     void *arg)
@@ -824,8 +1132,8 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 	struct rtipc_port_label plabel;
 	struct timeval tv;
 	rtdm_lockctx_t s;
+	int ret, val;
 	size_t len;
-	int ret;
 
 	ret = rtipc_get_sockoptin(fd, &sopt, arg);
 	if (ret)
@@ -898,6 +1206,22 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case BUFP_MMAP:
+		if (sopt.optlen < sizeof(val))
+			return -EINVAL;
+		if (rtipc_get_arg(fd, &val, sopt.optval, sizeof(val)))
+			return -EFAULT;
+		cobalt_atomic_enter(s);
+		if (test_bit(_BUFP_BOUND, &sk->status) ||
+		    test_bit(_BUFP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else if (val)
+			__set_bit(_BUFP_MMAP, &sk->status);
+		else
+			__clear_bit(_BUFP_MMAP, &sk->status);
+		cobalt_atomic_leave(s);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -911,8 +1235,11 @@ static int __bufp_getsockopt(struct bufp_socket *sk,
 {
 	struct _rtdm_getsockopt_args sopt;
 	struct rtipc_port_label plabel;
+	struct bufp_socket *rsk;
+	struct rtdm_fd *rfd;
 	struct timeval tv;
 	rtdm_lockctx_t s;
+	size_t ringlen;
 	socklen_t len;
 	int ret;
 
@@ -962,6 +1289,20 @@ static int __bufp_getsockopt(struct bufp_socket *sk,
 			return -EFAULT;
 		break;
 
+	case BUFP_MMAP:
+		if (len < sizeof(ringlen))
+			return -EINVAL;
+		rsk = __bufp_lock_ring(sk, &rfd);
+		if (IS_ERR(rsk))
+			ringlen = 0;
+		else {
+			ringlen = __bufp_ringlen(rsk);
+			__bufp_unlock_ring(rfd);
+		}
+		if (rtipc_put_arg(fd, sopt.optval, &ringlen, sizeof(ringlen)))
+			return -EFAULT;
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -974,8 +1315,10 @@ static int __bufp_ioctl(struct rtdm_fd *fd,
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
 	struct sockaddr_ipc saddr, *saddrp = &saddr;
-	struct bufp_socket *sk = priv->state;
+	struct bufp_socket *sk = priv->state, *rsk;
+	struct rtdm_fd *rfd;
 	int ret = 0;
+	__u32 len;
 
 	switch (request) {
 
@@ -1020,6 +1363,37 @@ static int __bufp_ioctl(struct rtdm_fd *fd,
 		ret = -ENOTCONN;
 		break;
 
+	case BUFP_RTIOC_WAITRD:
+		if (rtipc_get_arg(fd, &len, arg, sizeof(len)))
+			return -EFAULT;
+		if (!test_bit(_BUFP_BOUND, &sk->status) || sk->ring == NULL)
+			return -ENXIO;
+		ret = __bufp_ring_wait(sk, len, 0, sk->rx_timeout);
+		break;
+
+	case BUFP_RTIOC_WAITWR:
+		if (rtipc_get_arg(fd, &len, arg, sizeof(len)))
+			return -EFAULT;
+		if (sk->peer.sipc_port < 0)
+			return -EDESTADDRREQ;
+		rsk = __bufp_lock_peer(&sk->peer, &rfd);
+		if (IS_ERR(rsk))
+			return PTR_ERR(rsk);
+		if (rsk->ring)
+			ret = __bufp_ring_wait(rsk, len, 1, sk->tx_timeout);
+		else
+			ret = -ENXIO;
+		rtdm_fd_unlock(rfd);
+		break;
+
+	case BUFP_RTIOC_NOTIFY:
+		rsk = __bufp_lock_ring(sk, &rfd);
+		if (IS_ERR(rsk))
+			return PTR_ERR(rsk);
+		__bufp_ring_notify(rsk);
+		__bufp_unlock_ring(rfd);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1053,7 +1427,7 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd)
 
 	cobalt_atomic_enter(s);
 
-	if (test_bit(_BUFP_BOUND, &sk->status) && sk->fillsz > 0)
+	if (test_bit(_BUFP_BOUND, &sk->status) && __bufp_fillsz(sk) > 0)
 		mask |= POLLIN;
 
 	/*
@@ -1066,7 +1440,7 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd)
 		rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
 		if (rfd) {
 			rsk = rtipc_fd_to_state(rfd);
-			if (rsk->fillsz < rsk->bufsz)
+			if (__bufp_fillsz(rsk) < rsk->bufsz)
 				mask |= POLLOUT;
 		}
 	} else
@@ -1077,6 +1451,28 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd)
 	return mask;
 }
 
+static int bufp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct bufp_socket *sk = priv->state, *rsk;
+	struct rtdm_fd *rfd;
+	int ret;
+
+	rsk = __bufp_lock_ring(sk, &rfd);
+	if (IS_ERR(rsk))
+		return PTR_ERR(rsk);
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start != __bufp_ringlen(rsk))
+		ret = -EINVAL;
+	else
+		ret = rtdm_mmap_vmem(vma, rsk->ring);
+
+	__bufp_unlock_ring(rfd);
+
+	return ret;
+}
+
 static int bufp_init(void)
 {
 	portmap = xnmap_create(CONFIG_XENO_OPT_BUFP_NRPORT, 0, 0);
@@ -1105,5 +1501,6 @@ struct rtipc_protocol bufp_proto_driver = {
 		.write = bufp_write,
 		.ioctl = bufp_ioctl,
 		.pollstate = bufp_pollstate,
+		.mmap = bufp_mmap,
 	}
 };
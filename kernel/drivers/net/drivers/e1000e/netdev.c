@@ -608,12 +608,14 @@ static void e1000_alloc_rx_buffers(struct e1000_adapter *adapter,
 	struct e1000_ring *rx_ring = adapter->rx_ring;
 	union e1000_rx_desc_extended *rx_desc;
 	struct e1000_buffer *buffer_info;
+	struct rtskb_bulk bulk;
 	struct rtskb *skb;
 	unsigned int i;
 	unsigned int bufsz = adapter->rx_buffer_len;
 
 	i = rx_ring->next_to_use;
 	buffer_info = &rx_ring->buffer_info[i];
+	rtskb_bulk_init(&bulk);
 
 	while (cleaned_count--) {
 		skb = buffer_info->skb;
@@ -622,12 +624,14 @@ static void e1000_alloc_rx_buffers(struct e1000_adapter *adapter,
 			goto map_skb;
 		}
 
-		skb = rtnetdev_alloc_rtskb(adapter->netdev, bufsz);
+		skb = rtskb_bulk_get(&bulk, &adapter->netdev->dev_pool,
+				     bufsz, cleaned_count + 1);
 		if (!skb) {
 			/* Better luck next round */
 			adapter->alloc_rx_buff_failed++;
 			break;
 		}
+		skb->rtdev = adapter->netdev;
 		rtskb_reserve(skb, NET_IP_ALIGN);
 
 		buffer_info->skb = skb;
@@ -656,6 +660,7 @@ map_skb:
 		buffer_info = &rx_ring->buffer_info[i];
 	}
 
+	rtskb_bulk_release(&bulk);
 	rx_ring->next_to_use = i;
 }
 
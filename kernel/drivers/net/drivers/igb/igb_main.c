@@ -4604,10 +4604,13 @@ static bool igb_clean_tx_irq(struct igb_q_vector *q_vector)
 	unsigned int total_bytes = 0, total_packets = 0;
 	unsigned int budget = q_vector->tx.work_limit;
 	unsigned int i = tx_ring->next_to_clean;
+	struct rtskb_bulk freed;
 
 	if (test_bit(__IGB_DOWN, &adapter->state))
 		return true;
 
+	rtskb_bulk_init(&freed);
+
 	tx_buffer = &tx_ring->tx_buffer_info[i];
 	tx_desc = IGB_TX_DESC(tx_ring, i);
 	i -= tx_ring->count;
@@ -4633,8 +4636,8 @@ static bool igb_clean_tx_irq(struct igb_q_vector *q_vector)
 		total_bytes += tx_buffer->bytecount;
 		total_packets += tx_buffer->gso_segs;
 
-		/* free the skb */
-		kfree_rtskb(tx_buffer->skb);
+		/* free the skb, in batches */
+		rtskb_bulk_put(&freed, tx_buffer->skb);
 
 		/* clear tx_buffer data */
 		tx_buffer->skb = NULL;
@@ -4668,6 +4671,7 @@ static bool igb_clean_tx_irq(struct igb_q_vector *q_vector)
 		budget--;
 	} while (likely(budget));
 
+	rtskb_bulk_release(&freed);
 	i += tx_ring->count;
 	tx_ring->next_to_clean = i;
 	tx_ring->tx_stats.bytes += total_bytes;
@@ -4942,7 +4946,8 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 }
 
 static bool igb_alloc_mapped_skb(struct igb_ring *rx_ring,
-				 struct igb_rx_buffer *bi)
+				 struct igb_rx_buffer *bi,
+				 struct rtskb_bulk *bulk, u16 hint)
 {
 	struct igb_adapter *adapter = rx_ring->q_vector->adapter;
 	struct rtskb *skb = bi->skb;
@@ -4952,8 +4957,9 @@ static bool igb_alloc_mapped_skb(struct igb_ring *rx_ring,
 		return true;
 
 	if (likely(!skb)) {
-		skb = rtnetdev_alloc_rtskb(adapter->netdev,
-					rx_ring->rx_buffer_len + NET_IP_ALIGN);
+		skb = rtskb_bulk_get(bulk, &adapter->netdev->dev_pool,
+				     rx_ring->rx_buffer_len + NET_IP_ALIGN,
+				     hint);
 		if (!skb) {
 			rx_ring->rx_stats.alloc_failed++;
 			return false;
@@ -4977,6 +4983,7 @@ void igb_alloc_rx_buffers(struct igb_ring *rx_ring, u16 cleaned_count)
 {
 	union e1000_adv_rx_desc *rx_desc;
 	struct igb_rx_buffer *bi;
+	struct rtskb_bulk bulk;
 	u16 i = rx_ring->next_to_use;
 
 	/* nothing to do */
@@ -4986,9 +4993,10 @@ void igb_alloc_rx_buffers(struct igb_ring *rx_ring, u16 cleaned_count)
 	rx_desc = IGB_RX_DESC(rx_ring, i);
 	bi = &rx_ring->rx_buffer_info[i];
 	i -= rx_ring->count;
+	rtskb_bulk_init(&bulk);
 
 	do {
-		if (!igb_alloc_mapped_skb(rx_ring, bi))
+		if (!igb_alloc_mapped_skb(rx_ring, bi, &bulk, cleaned_count))
 			break;
 
 		/* Refresh the desc even if buffer_addrs didn't change
@@ -5011,6 +5019,7 @@ void igb_alloc_rx_buffers(struct igb_ring *rx_ring, u16 cleaned_count)
 		cleaned_count--;
 	} while (cleaned_count);
 
+	rtskb_bulk_release(&bulk);
 	i += rx_ring->count;
 
 	if (rx_ring->next_to_use != i) {
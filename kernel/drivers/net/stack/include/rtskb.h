@@ -89,6 +89,12 @@ rtskbs can be exchanged between pools (rtskb_acquire()). In this case, the
 passed rtskb switches over to from its owning pool to a given pool, but only if
 this pool can pass an empty rtskb from its own queue back.
 
+Drivers refilling or reclaiming many descriptors at once can take a batch of
+rtskbs from a pool (alloc_rtskb_bulk()) and release one (kfree_rtskb_bulk())
+while acquiring the pool lock only once. struct rtskb_bulk wraps a small
+on-stack batch for such loops (rtskb_bulk_get(), rtskb_bulk_put(),
+rtskb_bulk_release()).
+
 
 5. rtskb Chains
 
@@ -293,6 +299,73 @@ extern struct rtskb *alloc_rtskb(unsigned int size, struct rtskb_pool *pool);
 extern void kfree_rtskb(struct rtskb *skb);
 #define dev_kfree_rtskb(a)  kfree_rtskb(a)
 
+extern unsigned int alloc_rtskb_bulk(unsigned int size,
+				     struct rtskb_pool *pool,
+				     struct rtskb **skbs, unsigned int count);
+
+extern void kfree_rtskb_bulk(struct rtskb **skbs, unsigned int count);
+
+#define RTSKB_BULK_MAX      16
+
+struct rtskb_bulk {
+    unsigned int next;
+    unsigned int count;
+    struct rtskb *skbs[RTSKB_BULK_MAX];
+};
+
+static inline void rtskb_bulk_init(struct rtskb_bulk *bulk)
+{
+    bulk->next = 0;
+    bulk->count = 0;
+}
+
+/***
+ *  rtskb_bulk_get - take the next rtskb from a batch
+ *  @bulk: batch
+ *  @pool: pool to refill the batch from once it is exhausted
+ *  @size: required buffer size
+ *  @hint: number of rtskbs the caller still expects to take
+ */
+static inline struct rtskb *rtskb_bulk_get(struct rtskb_bulk *bulk,
+					   struct rtskb_pool *pool,
+					   unsigned int size, unsigned int hint)
+{
+    if (bulk->next == bulk->count) {
+	bulk->next = 0;
+	bulk->count = alloc_rtskb_bulk(size, pool, bulk->skbs,
+				       min_t(unsigned int, hint, RTSKB_BULK_MAX));
+	if (bulk->count == 0)
+	    return NULL;
+    }
+
+    return bulk->skbs[bulk->next++];
+}
+
+/***
+ *  rtskb_bulk_release - return all unused rtskbs of a batch to their pools
+ *  @bulk: batch
+ */
+static inline void rtskb_bulk_release(struct rtskb_bulk *bulk)
+{
+    if (bulk->next < bulk->count)
+	kfree_rtskb_bulk(bulk->skbs + bulk->next, bulk->count - bulk->next);
+
+    rtskb_bulk_init(bulk);
+}
+
+/***
+ *  rtskb_bulk_put - queue an rtskb for release
+ *  @bulk: batch, only used for releasing
+ *  @skb: rtskb to release
+ */
+static inline void rtskb_bulk_put(struct rtskb_bulk *bulk, struct rtskb *skb)
+{
+    if (bulk->count == RTSKB_BULK_MAX)
+	rtskb_bulk_release(bulk);
+
+    bulk->skbs[bulk->count++] = skb;
+}
+
 
 #define rtskb_checksum_none_assert(skb) (skb->ip_summed = CHECKSUM_NONE)
 
@@ -198,21 +198,8 @@ void rtskb_pool_queue_tail(struct rtskb_pool *pool, struct rtskb *skb)
 }
 EXPORT_SYMBOL_GPL(rtskb_pool_queue_tail);
 
-/***
- *  alloc_rtskb - allocate an rtskb from a pool
- *  @size: required buffer size (to check against maximum boundary)
- *  @pool: pool to take the rtskb from
- */
-struct rtskb *alloc_rtskb(unsigned int size, struct rtskb_pool *pool)
+static inline void rtskb_init_data(struct rtskb *skb, unsigned int size)
 {
-    struct rtskb *skb;
-
-    RTNET_ASSERT(size <= SKB_DATA_ALIGN(RTSKB_SIZE), return NULL;);
-
-    skb = rtskb_pool_dequeue(pool);
-    if (!skb)
-	return NULL;
-
     /* Load the data pointers. */
     skb->data = skb->buf_start;
     skb->tail = skb->buf_start;
@@ -227,6 +214,24 @@ struct rtskb *alloc_rtskb(unsigned int size, struct rtskb_pool *pool)
 #if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_ADDON_RTCAP)
     skb->cap_flags = 0;
 #endif
+}
+
+/***
+ *  alloc_rtskb - allocate an rtskb from a pool
+ *  @size: required buffer size (to check against maximum boundary)
+ *  @pool: pool to take the rtskb from
+ */
+struct rtskb *alloc_rtskb(unsigned int size, struct rtskb_pool *pool)
+{
+    struct rtskb *skb;
+
+    RTNET_ASSERT(size <= SKB_DATA_ALIGN(RTSKB_SIZE), return NULL;);
+
+    skb = rtskb_pool_dequeue(pool);
+    if (!skb)
+	return NULL;
+
+    rtskb_init_data(skb, size);
 
     return skb;
 }
@@ -234,6 +239,47 @@ struct rtskb *alloc_rtskb(unsigned int size, struct rtskb_pool *pool)
 EXPORT_SYMBOL_GPL(alloc_rtskb);
 
 
+/***
+ *  alloc_rtskb_bulk - allocate a batch of rtskbs from a pool
+ *  @size: required buffer size (to check against maximum boundary)
+ *  @pool: pool to take the rtskbs from
+ *  @skbs: array receiving the rtskbs
+ *  @count: number of rtskbs requested
+ *
+ *  The pool queue is locked only once for the whole batch. Returns the
+ *  number of rtskbs actually stored into @skbs, which is less than
+ *  @count if the pool ran short of buffers.
+ */
+unsigned int alloc_rtskb_bulk(unsigned int size, struct rtskb_pool *pool,
+			      struct rtskb **skbs, unsigned int count)
+{
+    struct rtskb_queue *queue = &pool->queue;
+    rtdm_lockctx_t context;
+    struct rtskb *skb;
+    unsigned int n;
+
+    RTNET_ASSERT(size <= SKB_DATA_ALIGN(RTSKB_SIZE), return 0;);
+
+    rtdm_lock_get_irqsave(&queue->lock, context);
+
+    for (n = 0; n < count; n++) {
+	skb = __rtskb_pool_dequeue(pool);
+	if (skb == NULL)
+	    break;
+	skbs[n] = skb;
+    }
+
+    rtdm_lock_put_irqrestore(&queue->lock, context);
+
+    for (count = 0; count < n; count++)
+	rtskb_init_data(skbs[count], size);
+
+    return n;
+}
+
+EXPORT_SYMBOL_GPL(alloc_rtskb_bulk);
+
+
 /***
  *  kfree_rtskb
  *  @skb    rtskb
@@ -291,6 +337,44 @@ void kfree_rtskb(struct rtskb *skb)
 EXPORT_SYMBOL_GPL(kfree_rtskb);
 
 
+/***
+ *  kfree_rtskb_bulk - release a batch of rtskbs
+ *  @skbs: array of rtskbs
+ *  @count: number of entries in @skbs
+ *
+ *  Consecutive rtskbs returning to the same pool are queued under a
+ *  single acquisition of the pool lock.
+ */
+void kfree_rtskb_bulk(struct rtskb **skbs, unsigned int count)
+{
+#if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_ADDON_RTCAP)
+    /* Shared buffers are swapped with their compensation rtskb. */
+    while (count-- > 0)
+	kfree_rtskb(*skbs++);
+#else  /* CONFIG_XENO_DRIVERS_NET_ADDON_RTCAP */
+    struct rtskb_pool *pool;
+    rtdm_lockctx_t context;
+    unsigned int n = 0;
+
+    while (n < count) {
+	RTNET_ASSERT(skbs[n] != NULL, return;);
+	RTNET_ASSERT(skbs[n]->pool != NULL, return;);
+
+	pool = skbs[n]->pool;
+	rtdm_lock_get_irqsave(&pool->queue.lock, context);
+
+	do {
+	    __rtskb_pool_queue_tail(pool, skbs[n]);
+	} while (++n < count && skbs[n]->pool == pool);
+
+	rtdm_lock_put_irqrestore(&pool->queue.lock, context);
+    }
+#endif /* CONFIG_XENO_DRIVERS_NET_ADDON_RTCAP */
+}
+
+EXPORT_SYMBOL_GPL(kfree_rtskb_bulk);
+
+
 static int rtskb_nop_pool_trylock(void *cookie)
 {
     return 1;
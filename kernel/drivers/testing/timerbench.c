@@ -27,7 +27,7 @@
 
 MODULE_DESCRIPTION("Timer latency test helper");
 MODULE_AUTHOR("Jan Kiszka <jan.kiszka@web.de>");
-MODULE_VERSION("0.2.1");
+MODULE_VERSION("0.2.2");
 MODULE_LICENSE("GPL");
 
 struct rt_tmbench_context {
@@ -40,6 +40,7 @@ struct rt_tmbench_context {
 	int32_t *histogram_max;
 	int32_t *histogram_avg;
 	int histogram_size;
+	int histogram_type;
 	int bucketsize;
 
 	rtdm_task_t timer_task;
@@ -59,8 +60,15 @@ struct rt_tmbench_context {
 static inline void add_histogram(struct rt_tmbench_context *ctx,
 				 __s32 *histogram, __s32 addval)
 {
+	int inabs;
+
+	if (ctx->histogram_type == RTTST_HISTOGRAM_HDR) {
+		histogram[rttst_hdr_index(addval)]++;
+		return;
+	}
+
 	/* bucketsize steps */
-	int inabs = (addval >= 0 ? addval : -addval) / ctx->bucketsize;
+	inabs = (addval >= 0 ? addval : -addval) / ctx->bucketsize;
 	histogram[inabs < ctx->histogram_size ?
 		  inabs : ctx->histogram_size - 1]++;
 }
@@ -243,12 +251,28 @@ static int rt_tmbench_start(struct rtdm_fd *fd,
 		config = &config_buf;
 	}
 
+	switch (config->histogram_type) {
+	case RTTST_HISTOGRAM_LINEAR:
+		if (config->histogram_size > 0 &&
+		    config->histogram_bucketsize <= 0)
+			return -EINVAL;
+		break;
+	case RTTST_HISTOGRAM_HDR:
+		if (config->histogram_size > 0 &&
+		    config->histogram_size != RTTST_HDR_BUCKETS)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
 	down(&ctx->nrt_mutex);
 
 	ctx->period = config->period;
 	ctx->warmup_loops = config->warmup_loops;
 	ctx->samples_per_sec = 1000000000 / ctx->period;
 	ctx->histogram_size = config->histogram_size;
+	ctx->histogram_type = config->histogram_type;
 	ctx->freeze_max = config->freeze_max;
 
 	if (ctx->histogram_size > 0) {
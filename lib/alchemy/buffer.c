@@ -41,6 +41,11 @@
  * under a well-defined situation (see note in rt_buffer_read()),
  * albeit they can be fully avoided by proper use of the buffer.
  *
+ * Large messages may be transferred without copying them, by
+ * writing them in place between rt_buffer_write_reserve() and
+ * rt_buffer_write_commit(), and reading them in place between
+ * rt_buffer_read_peek() and rt_buffer_read_consume().
+ *
  * @{
  */
 struct syncluster alchemy_buffer_table;
@@ -165,9 +170,11 @@ fnref_register(libalchemy, buffer_finalize);
  * This routine creates an IPC object that allows tasks to send and
  * receive data asynchronously via a memory buffer. Data may be of an
  * arbitrary length, albeit this IPC is best suited for small to
- * medium-sized messages, since data always have to be copied to the
- * buffer during transit. Large messages may be more efficiently
- * handled by message queues (RT_QUEUE).
+ * medium-sized messages, since data have to be copied to the buffer
+ * during transit, unless they are written and read in place (see
+ * rt_buffer_write_reserve() and rt_buffer_read_peek()). Large
+ * messages may be more efficiently handled by message queues
+ * (RT_QUEUE).
  *
  * @param bf The address of a buffer descriptor which can be later
  * used to identify uniquely the created object, upon success of this
@@ -246,6 +253,8 @@ int rt_buffer_create(RT_BUFFER *bf, const char *name,
 	bcb->rdoff = 0;
 	bcb->wroff = 0;
 	bcb->fillsz = 0;
+	bcb->wrsvd = 0;
+	bcb->rdpeek = 0;
 	if (mode & B_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
 
@@ -256,7 +265,7 @@ int rt_buffer_create(RT_BUFFER *bf, const char *name,
 
 	bcb->magic = buffer_magic;
 
-	registry_init_file_obstack(&bcb->fsobj, &registry_ops);
+	registry_init_file_cached(&bcb->fsobj, &registry_ops, &bcb->sobj);
 	ret = __bt(registry_add_file(&bcb->fsobj, O_RDONLY,
 				     "/alchemy/buffers/%s", bcb->name));
 	if (ret)
@@ -330,6 +339,192 @@ out:
 	return ret;
 }
 
+static void get_span(struct alchemy_buffer *bcb, size_t off, size_t len,
+		     RT_BUFFER_SPAN *span)
+{
+	void *buf = __mptr(bcb->buf);
+
+	span->ptr[0] = buf + off;
+	span->len[0] = len;
+	span->ptr[1] = NULL;
+	span->len[1] = 0;
+
+	/* Split the region if it wraps around the end of the buffer. */
+	if (off + len > bcb->bufsz) {
+		span->len[0] = bcb->bufsz - off;
+		span->ptr[1] = buf;
+		span->len[1] = len - span->len[0];
+	}
+}
+
+/*
+ * Wait for a complete message of @len bytes to be available for
+ * reading, returning the number of bytes which may be read from
+ * bcb->rdoff, or a negative error code. The buffer is unlocked on
+ * -EIDRM.
+ */
+static ssize_t wait_read_span(struct alchemy_buffer *bcb, size_t len,
+			      const struct timespec *abs_timeout,
+			      struct syncstate *syns,
+			      struct alchemy_buffer_wait **waitp)
+{
+	struct alchemy_buffer_wait *wait = *waitp;
+	int ret;
+
+	/*
+	 * We may only return complete messages to readers, so there
+	 * is no point in waiting for messages which are larger than
+	 * what the buffer can hold.
+	 */
+	if (len > bcb->bufsz)
+		return -EINVAL;
+
+	for (;;) {
+		/*
+		 * We should be able to read a complete message of the
+		 * requested length, or block. Data held by a peeking
+		 * reader remains unavailable until it is consumed.
+		 */
+		if (bcb->rdpeek == 0 && bcb->fillsz >= len)
+			return (ssize_t)len;
+
+		if (alchemy_poll_mode(abs_timeout))
+			return -EWOULDBLOCK;
+
+		/*
+		 * Check whether writers are already waiting for
+		 * sending data, while we are about to wait for
+		 * receiving some. In such a case, we have a
+		 * pathological use of the buffer. We must allow for a
+		 * short read to prevent a deadlock. Writers waiting
+		 * for a pending reservation to be committed do not
+		 * count, since the reservation holder does not wait
+		 * for us.
+		 */
+		if (bcb->rdpeek == 0 && bcb->wrsvd == 0 &&
+		    bcb->fillsz > 0 && syncobj_count_drain(&bcb->sobj))
+			return (ssize_t)bcb->fillsz;
+
+		if (wait == NULL) {
+			wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
+			*waitp = wait;
+		}
+
+		wait->size = len;
+
+		ret = syncobj_wait_grant(&bcb->sobj, abs_timeout, syns);
+		if (ret)
+			return ret;
+	}
+}
+
+static void release_read_span(struct alchemy_buffer *bcb, size_t len)
+{
+	struct alchemy_buffer_wait *wait;
+	struct threadobj *thobj;
+
+	bcb->fillsz -= len;
+	bcb->rdoff = (bcb->rdoff + len) % bcb->bufsz;
+
+	/*
+	 * Wake up all threads waiting for the buffer to drain, if we
+	 * freed enough room for the leading one to post its message.
+	 */
+	thobj = syncobj_peek_drain(&bcb->sobj);
+	if (thobj == NULL)
+		return;
+
+	wait = threadobj_get_wait(thobj);
+	if (wait->size + bcb->fillsz <= bcb->bufsz)
+		syncobj_drain(&bcb->sobj);
+}
+
+/*
+ * Wait for enough room to write a message of @len bytes from
+ * bcb->wroff, returning @len or a negative error code. The buffer is
+ * unlocked on -EIDRM.
+ */
+static ssize_t wait_write_span(struct alchemy_buffer *bcb, size_t len,
+			       const struct timespec *abs_timeout,
+			       struct syncstate *syns,
+			       struct alchemy_buffer_wait **waitp)
+{
+	struct alchemy_buffer_wait *wait = *waitp;
+	int ret;
+
+	/*
+	 * We may only send complete messages, so there is no point in
+	 * accepting messages which are larger than what the buffer
+	 * can hold.
+	 */
+	if (len > bcb->bufsz)
+		return -EINVAL;
+
+	for (;;) {
+		/*
+		 * We should be able to write the entire message at
+		 * once, or block. Messages may not be written past a
+		 * pending reservation, until it is committed.
+		 */
+		if (bcb->wrsvd == 0 && bcb->fillsz + len <= bcb->bufsz)
+			return (ssize_t)len;
+
+		if (alchemy_poll_mode(abs_timeout))
+			return -EWOULDBLOCK;
+
+		if (wait == NULL) {
+			wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
+			*waitp = wait;
+		}
+
+		wait->size = len;
+
+		/*
+		 * Check whether readers are already waiting for
+		 * receiving data, while we are about to wait for
+		 * sending some. In such a case, we have the converse
+		 * pathological use of the buffer. We must kick
+		 * readers to allow for a short read to prevent a
+		 * deadlock.
+		 *
+		 * XXX: instead of broadcasting a general wake up
+		 * event, we could be smarter and wake up only the
+		 * number of waiters required to consume the amount of
+		 * data we want to send, but this does not seem worth
+		 * the burden: this is an error condition, we just
+		 * have to mitigate its effect, avoiding a deadlock.
+		 */
+		if (bcb->wrsvd == 0 && bcb->fillsz > 0 &&
+		    syncobj_count_grant(&bcb->sobj))
+			syncobj_grant_all(&bcb->sobj);
+
+		ret = syncobj_wait_drain(&bcb->sobj, abs_timeout, syns);
+		if (ret)
+			return ret;
+	}
+}
+
+static void commit_write_span(struct alchemy_buffer *bcb, size_t len)
+{
+	struct alchemy_buffer_wait *wait;
+	struct threadobj *thobj;
+
+	bcb->fillsz += len;
+	bcb->wroff = (bcb->wroff + len) % bcb->bufsz;
+
+	/*
+	 * Wake up all threads waiting for input, if we accumulated
+	 * enough data to feed the leading one.
+	 */
+	thobj = syncobj_peek_grant(&bcb->sobj);
+	if (thobj == NULL)
+		return;
+
+	wait = threadobj_get_wait(thobj);
+	if (wait->size <= bcb->fillsz)
+		syncobj_grant_all(&bcb->sobj);
+}
+
 /**
  * @fn ssize_t rt_buffer_read(RT_BUFFER *bf, void *ptr, size_t len, RTIME timeout)
  * @brief Read from an IPC buffer (with relative scalar timeout).
@@ -453,13 +648,11 @@ ssize_t rt_buffer_read_timed(RT_BUFFER *bf,
 {
 	struct alchemy_buffer_wait *wait = NULL;
 	struct alchemy_buffer *bcb;
-	struct threadobj *thobj;
-	size_t len, rbytes, n;
 	struct syncstate syns;
+	RT_BUFFER_SPAN span;
 	struct service svc;
-	size_t rdoff;
 	int ret = 0;
-	void *p;
+	size_t len;
 
 	len = size;
 	if (len == 0)
@@ -474,88 +667,21 @@ ssize_t rt_buffer_read_timed(RT_BUFFER *bf,
 	if (bcb == NULL)
 		goto out;
 
-	/*
-	 * We may only return complete messages to readers, so there
-	 * is no point in waiting for messages which are larger than
-	 * what the buffer can hold.
-	 */
-	if (len > bcb->bufsz) {
-		ret = -EINVAL;
+	ret = wait_read_span(bcb, len, abs_timeout, &syns, &wait);
+	if (ret < 0) {
+		if (ret == -EIDRM)
+			goto out;
 		goto done;
 	}
-redo:
-	for (;;) {
-		/*
-		 * We should be able to read a complete message of the
-		 * requested length, or block.
-		 */
-		if (bcb->fillsz < len)
-			goto wait;
-
-		/* Read from the buffer in a circular way. */
-		rdoff = bcb->rdoff;
-		rbytes = len;
-		p = ptr;
-
-		do {
-			if (rdoff + rbytes > bcb->bufsz)
-				n = bcb->bufsz - rdoff;
-			else
-				n = rbytes;
-			memcpy(p, __mptr(bcb->buf) + rdoff, n);
-			p += n;
-			rdoff = (rdoff + n) % bcb->bufsz;
-			rbytes -= n;
-		} while (rbytes > 0);
-
-		bcb->fillsz -= len;
-		bcb->rdoff = rdoff;
-		ret = (ssize_t)len;
-
-		/*
-		 * Wake up all threads waiting for the buffer to
-		 * drain, if we freed enough room for the leading one
-		 * to post its message.
-		 */
-		thobj = syncobj_peek_drain(&bcb->sobj);
-		if (thobj == NULL)
-			goto done;
-
-		wait = threadobj_get_wait(thobj);
-		if (wait->size + bcb->fillsz <= bcb->bufsz)
-			syncobj_drain(&bcb->sobj);
 
-		goto done;
-	wait:
-		if (alchemy_poll_mode(abs_timeout)) {
-			ret = -EWOULDBLOCK;
-			goto done;
-		}
+	/* Read from the buffer in a circular way. */
+	len = ret;
+	get_span(bcb, bcb->rdoff, len, &span);
+	memcpy(ptr, span.ptr[0], span.len[0]);
+	if (span.len[1])
+		memcpy(ptr + span.len[0], span.ptr[1], span.len[1]);
 
-		/*
-		 * Check whether writers are already waiting for
-		 * sending data, while we are about to wait for
-		 * receiving some. In such a case, we have a
-		 * pathological use of the buffer. We must allow for a
-		 * short read to prevent a deadlock.
-		 */
-		if (bcb->fillsz > 0 && syncobj_count_drain(&bcb->sobj)) {
-			len = bcb->fillsz;
-			goto redo;
-		}
-
-		if (wait == NULL)
-			wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
-
-		wait->size = len;
-
-		ret = syncobj_wait_grant(&bcb->sobj, abs_timeout, &syns);
-		if (ret) {
-			if (ret == -EIDRM)
-				goto out;
-			break;
-		}
-	}
+	release_read_span(bcb, len);
 done:
 	put_alchemy_buffer(bcb, &syns);
 out:
@@ -668,13 +794,11 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 {
 	struct alchemy_buffer_wait *wait = NULL;
 	struct alchemy_buffer *bcb;
-	struct threadobj *thobj;
-	size_t len, rbytes, n;
 	struct syncstate syns;
+	RT_BUFFER_SPAN span;
 	struct service svc;
-	const void *p;
-	size_t wroff;
 	int ret = 0;
+	size_t len;
 
 	len = size;
 	if (len == 0)
@@ -689,94 +813,345 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 	if (bcb == NULL)
 		goto out;
 
-	/*
-	 * We may only send complete messages, so there is no point in
-	 * accepting messages which are larger than what the buffer
-	 * can hold.
-	 */
-	if (len > bcb->bufsz) {
-		ret = -EINVAL;
+	ret = wait_write_span(bcb, len, abs_timeout, &syns, &wait);
+	if (ret < 0) {
+		if (ret == -EIDRM)
+			goto out;
 		goto done;
 	}
 
-	for (;;) {
-		/*
-		 * We should be able to write the entire message at
-		 * once, or block.
-		 */
-		if (bcb->fillsz + len > bcb->bufsz)
-			goto wait;
-
-		/* Write to the buffer in a circular way. */
-		wroff = bcb->wroff;
-		rbytes = len;
-		p = ptr;
-
-		do {
-			if (wroff + rbytes > bcb->bufsz)
-				n = bcb->bufsz - wroff;
-			else
-				n = rbytes;
-
-			memcpy(__mptr(bcb->buf) + wroff, p, n);
-			p += n;
-			wroff = (wroff + n) % bcb->bufsz;
-			rbytes -= n;
-		} while (rbytes > 0);
-
-		bcb->fillsz += len;
-		bcb->wroff = wroff;
-		ret = (ssize_t)len;
+	/* Write to the buffer in a circular way. */
+	get_span(bcb, bcb->wroff, len, &span);
+	memcpy(span.ptr[0], ptr, span.len[0]);
+	if (span.len[1])
+		memcpy(span.ptr[1], ptr + span.len[0], span.len[1]);
 
-		/*
-		 * Wake up all threads waiting for input, if we
-		 * accumulated enough data to feed the leading one.
-		 */
-		thobj = syncobj_peek_grant(&bcb->sobj);
-		if (thobj == NULL)
-			goto done;
+	commit_write_span(bcb, len);
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	if (wait)
+		threadobj_finish_wait();
 
-		wait = threadobj_get_wait(thobj);
-		if (wait->size <= bcb->fillsz)
-			syncobj_grant_all(&bcb->sobj);
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
 
+/**
+ * @fn ssize_t rt_buffer_write_reserve(RT_BUFFER *bf, size_t len, RT_BUFFER_SPAN *span, RTIME timeout)
+ * @brief Reserve space in an IPC buffer (with relative scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_write_reserve_timed()
+ * accepting a relative timeout specification expressed as a scalar
+ * value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message to be written.
+ *
+ * @param span The address of a span descriptor which receives the
+ * location of the reserved space upon success.
+ *
+ * @param timeout A delay expressed in clock ticks.
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_write_reserve_until(RT_BUFFER *bf, size_t len, RT_BUFFER_SPAN *span, RTIME abs_timeout)
+ * @brief Reserve space in an IPC buffer (with absolute scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_write_reserve_timed()
+ * accepting an absolute timeout specification expressed as a scalar
+ * value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message to be written.
+ *
+ * @param span The address of a span descriptor which receives the
+ * location of the reserved space upon success.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks.
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_write_reserve_timed(RT_BUFFER *bf, size_t len, RT_BUFFER_SPAN *span, const struct timespec *abs_timeout)
+ * @brief Reserve space in an IPC buffer.
+ *
+ * This routine reserves space for writing a message directly into
+ * the memory of the specified buffer, which saves the copy
+ * rt_buffer_write_timed() performs. The message becomes visible to
+ * readers when rt_buffer_write_commit() is called. If not enough
+ * buffer space is available on entry, the caller is allowed to block
+ * until enough room is freed, or a timeout elapses, whichever comes
+ * first.
+ *
+ * A single reservation may be pending on a buffer at any time: other
+ * writers wait until it is committed, which preserves the ordering
+ * of messages. The reservation belongs to the caller, which is the
+ * only thread allowed to commit it. rt_buffer_clear() forcibly
+ * releases it, e.g. when its owner went away without committing.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message to be written. Zero
+ * is a valid value, in which case no space is reserved, and zero is
+ * returned to the caller.
+ *
+ * @param span The address of a span descriptor which receives the
+ * location of the reserved space upon success. This space may be
+ * split in two parts, if it wraps around the end of the buffer.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks,
+ * specifying a time limit to wait for enough buffer space to be
+ * available (see note). Passing NULL causes the caller to block
+ * indefinitely until enough buffer space is available. Passing {
+ * .tv_sec = 0, .tv_nsec = 0 } causes the service to return
+ * immediately without blocking in case of buffer space shortage.
+ *
+ * @return The number of bytes reserved is returned upon
+ * success. Otherwise, the same error codes as
+ * rt_buffer_write_timed() are returned, except that -EPERM is
+ * returned whenever the caller is not a Xenomai thread.
+ *
+ * @apitags{xthread-only, switch-primary}
+ *
+ * @note @a abs_timeout is interpreted as a multiple of the Alchemy
+ * clock resolution (see --alchemy-clock-resolution option, defaults
+ * to 1 nanosecond).
+ */
+ssize_t rt_buffer_write_reserve_timed(RT_BUFFER *bf,
+				      size_t size, RT_BUFFER_SPAN *span,
+				      const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer_wait *wait = NULL;
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	memset(span, 0, sizeof(*span));
+	if (size == 0)
+		return 0;
+
+	/* The reservation must have an owner. */
+	if (!threadobj_current_p())
+		return -EPERM;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	ret = wait_write_span(bcb, size, abs_timeout, &syns, &wait);
+	if (ret < 0) {
+		if (ret == -EIDRM)
+			goto out;
 		goto done;
-	wait:
-		if (alchemy_poll_mode(abs_timeout)) {
-			ret = -EWOULDBLOCK;
-			goto done;
-		}
+	}
 
-		if (wait == NULL)
-			wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
+	get_span(bcb, bcb->wroff, size, span);
+	bcb->wrsvd = size;
+	bcb->wrowner = __moff(threadobj_current());
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	if (wait)
+		threadobj_finish_wait();
 
-		wait->size = len;
+	CANCEL_RESTORE(svc);
 
-		/*
-		 * Check whether readers are already waiting for
-		 * receiving data, while we are about to wait for
-		 * sending some. In such a case, we have the converse
-		 * pathological use of the buffer. We must kick
-		 * readers to allow for a short read to prevent a
-		 * deadlock.
-		 *
-		 * XXX: instead of broadcasting a general wake up
-		 * event, we could be smarter and wake up only the
-		 * number of waiters required to consume the amount of
-		 * data we want to send, but this does not seem worth
-		 * the burden: this is an error condition, we just
-		 * have to mitigate its effect, avoiding a deadlock.
-		 */
-		if (bcb->fillsz > 0 && syncobj_count_grant(&bcb->sobj))
-			syncobj_grant_all(&bcb->sobj);
+	return ret;
+}
 
-		ret = syncobj_wait_drain(&bcb->sobj, abs_timeout, &syns);
-		if (ret) {
-			if (ret == -EIDRM)
-				goto out;
-			break;
-		}
+/**
+ * @fn int rt_buffer_write_commit(RT_BUFFER *bf, size_t len)
+ * @brief Commit a message written to reserved buffer space.
+ *
+ * This routine makes the first @a len bytes of the space reserved by
+ * the last call to rt_buffer_write_reserve_timed() available to
+ * readers, then releases the reservation. Any remaining reserved
+ * space is given back to the buffer.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message written to the
+ * reserved space. Passing zero cancels the reservation.
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor,
+ * or @a len is greater than the reserved space.
+ *
+ * - -EPERM is returned if the caller does not hold a reservation on
+ * @a bf, i.e. none is pending, it was made by another thread, or it
+ * was released by rt_buffer_clear().
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+int rt_buffer_write_commit(RT_BUFFER *bf, size_t size)
+{
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	if (bcb->wrsvd == 0 ||
+	    __mptr(bcb->wrowner) != threadobj_current()) {
+		ret = -EPERM;
+		goto done;
+	}
+
+	if (size > bcb->wrsvd) {
+		ret = -EINVAL;
+		goto done;
 	}
+
+	bcb->wrsvd = 0;
+	commit_write_span(bcb, size);
+
+	/* Writers waiting for the reservation may proceed. */
+	if (syncobj_count_drain(&bcb->sobj))
+		syncobj_drain(&bcb->sobj);
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
+/**
+ * @fn ssize_t rt_buffer_read_peek(RT_BUFFER *bf, size_t len, RT_BUFFER_SPAN *span, RTIME timeout)
+ * @brief Peek at data in an IPC buffer (with relative scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_read_peek_timed() accepting
+ * a relative timeout specification expressed as a scalar value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message to be read.
+ *
+ * @param span The address of a span descriptor which receives the
+ * location of the message upon success.
+ *
+ * @param timeout A delay expressed in clock ticks.
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_read_peek_until(RT_BUFFER *bf, size_t len, RT_BUFFER_SPAN *span, RTIME abs_timeout)
+ * @brief Peek at data in an IPC buffer (with absolute scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_read_peek_timed() accepting
+ * an absolute timeout specification expressed as a scalar value.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message to be read.
+ *
+ * @param span The address of a span descriptor which receives the
+ * location of the message upon success.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks.
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+
+/**
+ * @fn ssize_t rt_buffer_read_peek_timed(RT_BUFFER *bf, size_t len, RT_BUFFER_SPAN *span, const struct timespec *abs_timeout)
+ * @brief Peek at data in an IPC buffer.
+ *
+ * This routine returns the location of the next message in the
+ * memory of the specified buffer, so that it can be read in place,
+ * which saves the copy rt_buffer_read_timed() performs. The message
+ * remains in the buffer until rt_buffer_read_consume() is
+ * called. If no message is available on entry, the caller is allowed
+ * to block until enough data is written to the buffer, or a timeout
+ * elapses.
+ *
+ * A single reader may peek at a buffer at any time: other readers
+ * wait until the data is consumed. The peeked data belongs to the
+ * caller, which is the only thread allowed to consume it.
+ * rt_buffer_clear() forcibly releases it, e.g. when its owner went
+ * away without consuming.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the message to be read. Zero is
+ * a valid value, in which case the buffer is left untouched, and
+ * zero is returned to the caller.
+ *
+ * @param span The address of a span descriptor which receives the
+ * location of the message upon success. The message may be split in
+ * two parts, if it wraps around the end of the buffer.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks,
+ * specifying a time limit to wait for a message to be available from
+ * the buffer (see note). Passing NULL causes the caller to block
+ * indefinitely until enough data is available. Passing { .tv_sec = 0,
+ * .tv_nsec = 0 } causes the service to return immediately without
+ * blocking in case not enough data is available.
+ *
+ * @return The number of bytes available from @a span is returned
+ * upon success, which may be less than @a len in the same
+ * circumstances as a short read from rt_buffer_read_timed().
+ * Otherwise, the same error codes as rt_buffer_read_timed() are
+ * returned, except that -EPERM is returned whenever the caller is
+ * not a Xenomai thread.
+ *
+ * @apitags{xthread-only, switch-primary}
+ *
+ * @note @a abs_timeout is interpreted as a multiple of the Alchemy
+ * clock resolution (see --alchemy-clock-resolution option, defaults
+ * to 1 nanosecond).
+ */
+ssize_t rt_buffer_read_peek_timed(RT_BUFFER *bf,
+				  size_t size, RT_BUFFER_SPAN *span,
+				  const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer_wait *wait = NULL;
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	memset(span, 0, sizeof(*span));
+	if (size == 0)
+		return 0;
+
+	/* The peeked data must have an owner. */
+	if (!threadobj_current_p())
+		return -EPERM;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	ret = wait_read_span(bcb, size, abs_timeout, &syns, &wait);
+	if (ret < 0) {
+		if (ret == -EIDRM)
+			goto out;
+		goto done;
+	}
+
+	get_span(bcb, bcb->rdoff, ret, span);
+	bcb->rdpeek = ret;
+	bcb->rdowner = __moff(threadobj_current());
 done:
 	put_alchemy_buffer(bcb, &syns);
 out:
@@ -788,11 +1163,80 @@ out:
 	return ret;
 }
 
+/**
+ * @fn int rt_buffer_read_consume(RT_BUFFER *bf, size_t len)
+ * @brief Consume data read in place from an IPC buffer.
+ *
+ * This routine removes the first @a len bytes of the message
+ * returned by the last call to rt_buffer_read_peek_timed() from the
+ * buffer, making room for writers. Any remaining data is left
+ * available to subsequent reads.
+ *
+ * @param bf The buffer descriptor.
+ *
+ * @param len The length in bytes of the data to consume. Passing
+ * zero leaves the whole message in the buffer.
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor,
+ * or @a len is greater than the length returned by
+ * rt_buffer_read_peek_timed().
+ *
+ * - -EPERM is returned if the caller does not hold peeked data from
+ * @a bf, i.e. none is pending, it was peeked by another thread, or
+ * it was released by rt_buffer_clear().
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+int rt_buffer_read_consume(RT_BUFFER *bf, size_t size)
+{
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	if (bcb->rdpeek == 0 ||
+	    __mptr(bcb->rdowner) != threadobj_current()) {
+		ret = -EPERM;
+		goto done;
+	}
+
+	if (size > bcb->rdpeek) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	bcb->rdpeek = 0;
+	release_read_span(bcb, size);
+
+	/* Readers waiting for the peeked data may proceed. */
+	if (syncobj_count_grant(&bcb->sobj))
+		syncobj_grant_all(&bcb->sobj);
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
 /**
  * @fn int rt_buffer_clear(RT_BUFFER *bf)
  * @brief Clear an IPC buffer.
  *
- * This routine empties a buffer from any data.
+ * This routine empties a buffer from any data. A reservation
+ * pending on the buffer (see rt_buffer_write_reserve()) and data
+ * being read in place (see rt_buffer_read_peek()) are released as
+ * well: their owners get -EPERM from rt_buffer_write_commit() and
+ * rt_buffer_read_consume() respectively, and must not access the
+ * spans they obtained anymore.
  *
  * @param bf The buffer descriptor.
  *
@@ -815,6 +1259,8 @@ int rt_buffer_clear(RT_BUFFER *bf)
 	if (bcb == NULL)
 		goto out;
 
+	bcb->wrsvd = 0;
+	bcb->rdpeek = 0;
 	bcb->wroff = 0;
 	bcb->rdoff = 0;
 	bcb->fillsz = 0;
@@ -35,6 +35,10 @@ struct alchemy_buffer {
 	size_t rdoff;
 	size_t wroff;
 	size_t fillsz;
+	size_t wrsvd;		/* Reserved by rt_buffer_write_reserve(). */
+	size_t rdpeek;		/* Held by rt_buffer_read_peek(). */
+	dref_type(struct threadobj *) wrowner;
+	dref_type(struct threadobj *) rdowner;
 	struct fsobj fsobj;
 };
 
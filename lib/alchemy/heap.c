@@ -257,7 +257,7 @@ int rt_heap_create(RT_HEAP *heap,
 
 	hcb->magic = heap_magic;
 
-	registry_init_file_obstack(&hcb->fsobj, &registry_ops);
+	registry_init_file_cached(&hcb->fsobj, &registry_ops, &hcb->sobj);
 	ret = __bt(registry_add_file(&hcb->fsobj, O_RDONLY,
 				     "/alchemy/heaps/%s", hcb->name));
 	if (ret)
@@ -46,6 +46,9 @@ get_alchemy_ ## __name(__dsctype *desc,					\
 		return NULL;						\
 	}								\
 									\
+	/* Updates may happen from now on, including while waiting. */	\
+	registry_bump_file(&cb->fsobj);					\
+									\
 	return cb;							\
 }									\
 									\
@@ -53,6 +56,7 @@ static inline								\
 void put_alchemy_ ## __name(struct alchemy_ ## __name *cb,		\
 			    struct syncstate *syns)			\
 {									\
+	registry_bump_file(&cb->fsobj);					\
 	syncobj_unlock(&cb->sobj, syns);				\
 }
 
@@ -17,6 +17,7 @@
  */
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 #include <copperplate/threadobj.h>
 #include <copperplate/heapobj.h>
 #include <copperplate/registry-obstack.h>
@@ -46,6 +47,189 @@ static DEFINE_NAME_GENERATOR(queue_namegen, "queue",
 
 DEFINE_SYNC_LOOKUP(queue, RT_QUEUE);
 
+DEFINE_LOOKUP_PRIVATE(queue, RT_QUEUE);
+
+/*
+ * Q_LOCKFREE queues convey messages through a bounded ring, which
+ * any number of tasks may push to and pop from concurrently. Each
+ * slot carries a sequence number, telling whether it is ready for
+ * the producer or the consumer claiming the matching index. The
+ * queue lock is only taken for sleeping and waking up receivers.
+ */
+static struct alchemy_queue_ring *alloc_ring(size_t qlimit)
+{
+	struct alchemy_queue_ring *ring;
+	unsigned int n, nslots;
+
+	for (nslots = 1; nslots < qlimit; nslots <<= 1)
+		;
+
+	ring = xnmalloc(sizeof(*ring) + nslots * sizeof(ring->slots[0]));
+	if (ring == NULL)
+		return NULL;
+
+	atomic_set(&ring->tail, 0);
+	atomic_set(&ring->head, 0);
+	ring->mask = nslots - 1;
+	for (n = 0; n < nslots; n++)
+		atomic_set(&ring->slots[n].seq, n);
+
+	return ring;
+}
+
+static int ring_push(struct alchemy_queue *qcb,
+		     struct alchemy_queue_msg *msg)
+{
+	struct alchemy_queue_ring *ring = __mptr(qcb->ring);
+	struct alchemy_queue_slot *slot;
+	unsigned int pos;
+	int diff;
+
+	pos = atomic_read(&ring->tail);
+	for (;;) {
+		/* The ring may be larger than the queue limit. */
+		if (pos - atomic_read(&ring->head) >= qcb->limit)
+			return -ENOMEM;
+		slot = ring->slots + (pos & ring->mask);
+		diff = (int)(atomic_read(&slot->seq) - pos);
+		if (diff == 0) {
+			if (atomic_cmpxchg(&ring->tail, pos, pos + 1) == pos)
+				break;
+		} else if (diff < 0)
+			return -ENOMEM;
+		barrier();
+		pos = atomic_read(&ring->tail);
+	}
+
+	slot->msg = __moff(msg);
+	smp_wmb();
+	atomic_set(&slot->seq, pos + 1);
+
+	return 0;
+}
+
+static struct alchemy_queue_msg *ring_pop(struct alchemy_queue *qcb)
+{
+	struct alchemy_queue_ring *ring = __mptr(qcb->ring);
+	struct alchemy_queue_slot *slot;
+	struct alchemy_queue_msg *msg;
+	unsigned int pos;
+	int diff;
+
+	pos = atomic_read(&ring->head);
+	for (;;) {
+		slot = ring->slots + (pos & ring->mask);
+		diff = (int)(atomic_read(&slot->seq) - (pos + 1));
+		if (diff == 0) {
+			if (atomic_cmpxchg(&ring->head, pos, pos + 1) == pos)
+				break;
+		} else if (diff < 0)
+			return NULL;
+		barrier();
+		pos = atomic_read(&ring->head);
+	}
+
+	msg = __mptr(slot->msg);
+	/* Producers may reuse the slot as soon as seq is updated. */
+	smp_mb();
+	atomic_set(&slot->seq, pos + ring->mask + 1);
+
+	return msg;
+}
+
+static inline unsigned int queue_count(struct alchemy_queue *qcb)
+{
+	struct alchemy_queue_ring *ring;
+
+	if ((qcb->mode & Q_LOCKFREE) == 0)
+		return qcb->mcount;
+
+	ring = __mptr(qcb->ring);
+
+	return atomic_read(&ring->tail) - atomic_read(&ring->head);
+}
+
+/*
+ * Wake up a receiver after a message was pushed, if some was found
+ * sleeping, or about to. Pairs with the sequence in ring_receive().
+ */
+static int ring_wakeup(struct alchemy_queue *qcb)
+{
+	struct syncstate syns;
+	int ret = 0;
+
+	smp_mb();
+	if (atomic_read(&qcb->nwaiters) == 0)
+		return 0;
+
+	if (syncobj_lock(&qcb->sobj, &syns))
+		return 0;
+
+	if (syncobj_grant_one(&qcb->sobj))
+		ret = 1;
+
+	syncobj_unlock(&qcb->sobj, &syns);
+
+	return ret;
+}
+
+static int ring_send(struct alchemy_queue *qcb,
+		     struct alchemy_queue_msg *msg)
+{
+	int ret;
+
+	ret = ring_push(qcb, msg);
+	if (ret)
+		return ret;
+
+	return ring_wakeup(qcb);
+}
+
+static ssize_t ring_receive(struct alchemy_queue *qcb,
+			    struct alchemy_queue_msg **msgp,
+			    const struct timespec *abs_timeout)
+{
+	struct alchemy_queue_msg *msg;
+	struct syncstate syns;
+	int ret;
+
+	for (;;) {
+		msg = ring_pop(qcb);
+		if (msg)
+			break;
+
+		if (alchemy_poll_mode(abs_timeout))
+			return -EWOULDBLOCK;
+
+		if (syncobj_lock(&qcb->sobj, &syns))
+			return -EINVAL;
+		/*
+		 * Announce that we are about to sleep, then check the
+		 * ring again: a message pushed meanwhile is either
+		 * seen by us, or followed by a wakeup from
+		 * ring_wakeup().
+		 */
+		atomic_add_fetch(&qcb->nwaiters, 1);
+		msg = ring_pop(qcb);
+		ret = 0;
+		if (msg == NULL) {
+			ret = syncobj_wait_grant(&qcb->sobj, abs_timeout, &syns);
+			if (ret == -EIDRM)
+				return ret;
+		}
+		atomic_sub_fetch(&qcb->nwaiters, 1);
+		syncobj_unlock(&qcb->sobj, &syns);
+		if (msg)
+			break;
+		if (ret)
+			return ret;
+	}
+
+	*msgp = msg;
+
+	return (ssize_t)msg->size;
+}
+
 #ifdef CONFIG_XENO_REGISTRY
 
 static int prepare_waiter_cache(struct fsobstack *o,
@@ -93,7 +277,7 @@ static int queue_registry_open(struct fsobj *fsobj, void *priv)
 	usable_mem = heapobj_size(&qcb->hobj);
 	used_mem = heapobj_inquire(&qcb->hobj);
 	limit = qcb->limit;
-	mcount = qcb->mcount;
+	mcount = queue_count(qcb);
 	mode = qcb->mode;
 
 	syncobj_unlock(&qcb->sobj, &syns);
@@ -135,6 +319,8 @@ static void queue_finalize(struct syncobj *sobj)
 	qcb = container_of(sobj, struct alchemy_queue, sobj);
 	registry_destroy_file(&qcb->fsobj);
 	heapobj_destroy(&qcb->hobj);
+	if (qcb->mode & Q_LOCKFREE)
+		xnfree(__mptr(qcb->ring));
 	xnfree(qcb);
 }
 fnref_register(libalchemy, queue_finalize);
@@ -172,9 +358,16 @@ fnref_register(libalchemy, queue_finalize);
  *
  * - Q_PRIO makes tasks pend in priority order on the queue.
  *
+ * - Q_LOCKFREE conveys messages through a lock-free ring of @a qlimit
+ * entries, so that sending and receiving only serialize on the queue
+ * lock for blocking or waking up receivers. This mode requires a
+ * queue limit, and does not support the Q_URGENT and Q_BROADCAST
+ * operation flags. Messages are always consumed in FIFO order.
+ *
  * @return Zero is returned upon success. Otherwise:
  *
- * - -EINVAL is returned if @a mode is invalid or @a poolsize is zero.
+ * - -EINVAL is returned if @a mode is invalid or @a poolsize is zero,
+ * or Q_LOCKFREE is given with an unlimited @a qlimit.
  *
  * - -ENOMEM is returned if the system fails to get memory from the
  * main heap in order to create the queue.
@@ -204,6 +397,7 @@ fnref_register(libalchemy, queue_finalize);
 int rt_queue_create(RT_QUEUE *queue, const char *name,
 		    size_t poolsize, size_t qlimit, int mode)
 {
+	struct alchemy_queue_ring *ring = NULL;
 	struct alchemy_queue *qcb;
 	int sobj_flags = 0, ret;
 	struct service svc;
@@ -211,7 +405,11 @@ int rt_queue_create(RT_QUEUE *queue, const char *name,
 	if (threadobj_irq_p())
 		return -EPERM;
 
-	if (poolsize == 0 || (mode & ~Q_PRIO) != 0)
+	if (poolsize == 0 || (mode & ~(Q_PRIO|Q_LOCKFREE)) != 0)
+		return -EINVAL;
+
+	if ((mode & Q_LOCKFREE) &&
+	    (qlimit == Q_UNLIMITED || qlimit > UINT_MAX / 2))
 		return -EINVAL;
 
 	CANCEL_DEFER(svc);
@@ -245,6 +443,16 @@ int rt_queue_create(RT_QUEUE *queue, const char *name,
 	qcb->limit = qlimit;
 	list_init(&qcb->mq);
 	qcb->mcount = 0;
+	atomic_set(&qcb->nwaiters, 0);
+
+	if (mode & Q_LOCKFREE) {
+		ring = alloc_ring(qlimit);
+		if (ring == NULL) {
+			ret = -ENOMEM;
+			goto fail_ringalloc;
+		}
+		qcb->ring = __moff(ring);
+	}
 
 	if (mode & Q_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
@@ -256,7 +464,15 @@ int rt_queue_create(RT_QUEUE *queue, const char *name,
 
 	qcb->magic = queue_magic;
 
-	registry_init_file_obstack(&qcb->fsobj, &registry_ops);
+	/*
+	 * Lock-free transfers do not advance the registry version,
+	 * so snapshots of such queues may not be cached.
+	 */
+	if (mode & Q_LOCKFREE)
+		registry_init_file_obstack(&qcb->fsobj, &registry_ops);
+	else
+		registry_init_file_cached(&qcb->fsobj, &registry_ops,
+					  &qcb->sobj);
 	ret = __bt(registry_add_file(&qcb->fsobj, O_RDONLY,
 				     "/alchemy/queues/%s", qcb->name));
 	if (ret)
@@ -278,6 +494,9 @@ fail_register:
 	registry_destroy_file(&qcb->fsobj);
 	syncobj_uninit(&qcb->sobj);
 fail_syncinit:
+	if (mode & Q_LOCKFREE)
+		xnfree(ring);
+fail_ringalloc:
 	heapobj_destroy(&qcb->hobj);
 fail_bufalloc:
 	xnfree(qcb);
@@ -351,37 +570,58 @@ out:
  *
  * @apitags{unrestricted, switch-primary}
  */
+static void *alloc_msg(struct alchemy_queue *qcb, size_t size)
+{
+	struct alchemy_queue_msg *msg;
+
+	msg = heapobj_alloc(&qcb->hobj, size + sizeof(*msg));
+	if (msg == NULL)
+		return NULL;
+
+	/*
+	 * XXX: no need to init the ->next holder, list_*pend() do not
+	 * require this, and this ends up being costly on low end.
+	 */
+	msg->size = size;	/* Zero is allowed. */
+	msg->refcount = 1;
+
+	return msg + 1;
+}
+
 void *rt_queue_alloc(RT_QUEUE *queue, size_t size)
 {
-	struct alchemy_queue_msg *msg = NULL;
 	struct alchemy_queue *qcb;
 	struct syncstate syns;
 	struct service svc;
+	void *buf = NULL;
 	int ret;
 
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &ret);
+	qcb = find_alchemy_queue(queue, &ret);
 	if (qcb == NULL)
 		goto out;
 
-	msg = heapobj_alloc(&qcb->hobj, size + sizeof(*msg));
-	if (msg == NULL)
-		goto done;
-
 	/*
-	 * XXX: no need to init the ->next holder, list_*pend() do not
-	 * require this, and this ends up being costly on low end.
+	 * The pool allocator is thread-safe, we only need the queue
+	 * lock for serializing with updates to the message list.
 	 */
-	msg->size = size;	/* Zero is allowed. */
-	msg->refcount = 1;
-	++msg;
-done:
+	if (qcb->mode & Q_LOCKFREE) {
+		buf = alloc_msg(qcb, size);
+		goto out;
+	}
+
+	qcb = get_alchemy_queue(queue, &syns, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	buf = alloc_msg(qcb, size);
+
 	put_alchemy_queue(qcb, &syns);
 out:
 	CANCEL_RESTORE(svc);
 
-	return msg;
+	return buf;
 }
 
 /**
@@ -420,6 +660,23 @@ int rt_queue_free(RT_QUEUE *queue, void *buf)
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	/*
+	 * Messages cannot be broadcast to lock-free queues, so the
+	 * caller is the only owner of the message buffer.
+	 */
+	if (qcb->mode & Q_LOCKFREE) {
+		if (heapobj_validate(&qcb->hobj, msg) == 0 ||
+		    msg->refcount == 0)
+			ret = -EINVAL;
+		else if (--msg->refcount == 0)
+			heapobj_free(&qcb->hobj, msg);
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &ret);
 	if (qcb == NULL)
 		goto out;
@@ -492,7 +749,8 @@ out:
  * codes is returned:
  *
  * - -EINVAL is returned if @a q is not a message queue descriptor, @a
- * mode is invalid, or @a buf is NULL.
+ * mode is invalid, or @a buf is NULL. Q_URGENT and Q_BROADCAST are
+ * invalid with queues created in Q_LOCKFREE mode.
  *
  * - -ENOMEM is returned if queuing the message would exceed the limit
  * defined for the queue at creation.
@@ -517,6 +775,24 @@ int rt_queue_send(RT_QUEUE *queue,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	if (qcb->mode & Q_LOCKFREE) {
+		if (mode != Q_NORMAL || msg->refcount == 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+		/* The receiver may grab the message once pushed. */
+		msg->refcount--;
+		msg->size = size;
+		ret = ring_send(qcb, msg);
+		if (ret < 0)
+			msg->refcount++;
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &ret);
 	if (qcb == NULL)
 		goto out;
@@ -607,7 +883,8 @@ out:
  * codes is returned:
  *
  * - -EINVAL is returned if @a mode is invalid, @a buf is NULL with a
- * non-zero @a size, or @a q is not a essage queue descriptor.
+ * non-zero @a size, or @a q is not a essage queue descriptor. Q_URGENT
+ * and Q_BROADCAST are invalid with queues created in Q_LOCKFREE mode.
  *
  * - -ENOMEM is returned if queuing the message would exceed the limit
  * defined for the queue at creation, or if no memory can be obtained
@@ -615,6 +892,28 @@ out:
  *
  * @apitags{unrestricted, switch-primary}
  */
+static int write_ring(struct alchemy_queue *qcb,
+		      const void *buf, size_t size)
+{
+	struct alchemy_queue_msg *msg;
+	int ret;
+
+	msg = heapobj_alloc(&qcb->hobj, size + sizeof(*msg));
+	if (msg == NULL)
+		return -ENOMEM;
+
+	msg->size = size;
+	msg->refcount = 0;
+	if (size > 0)
+		memcpy(msg + 1, buf, size);
+
+	ret = ring_send(qcb, msg);
+	if (ret < 0)
+		heapobj_free(&qcb->hobj, msg);
+
+	return ret;
+}
+
 int rt_queue_write(RT_QUEUE *queue,
 		   const void *buf, size_t size, int mode)
 {
@@ -635,6 +934,15 @@ int rt_queue_write(RT_QUEUE *queue,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	if (qcb->mode & Q_LOCKFREE) {
+		ret = mode != Q_NORMAL ? -EINVAL : write_ring(qcb, buf, size);
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &ret);
 	if (qcb == NULL)
 		goto out;
@@ -810,6 +1118,21 @@ ssize_t rt_queue_receive_timed(RT_QUEUE *queue, void **bufp,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &err);
+	if (qcb == NULL) {
+		ret = err;
+		goto out;
+	}
+
+	if (qcb->mode & Q_LOCKFREE) {
+		ret = ring_receive(qcb, &msg, abs_timeout);
+		if (ret >= 0) {
+			msg->refcount++;
+			*bufp = msg + 1;
+		}
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &err);
 	if (qcb == NULL) {
 		ret = err;
@@ -970,6 +1293,23 @@ ssize_t rt_queue_read_timed(RT_QUEUE *queue,
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &err);
+	if (qcb == NULL) {
+		ret = err;
+		goto out;
+	}
+
+	if (qcb->mode & Q_LOCKFREE) {
+		ret = ring_receive(qcb, &msg, abs_timeout);
+		if (ret >= 0) {
+			ret = (ssize_t)(msg->size > size ? size : msg->size);
+			if (ret > 0)
+				memcpy(buf, msg + 1, ret);
+			heapobj_free(&qcb->hobj, msg);
+		}
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &err);
 	if (qcb == NULL) {
 		ret = err;
@@ -1043,6 +1383,18 @@ int rt_queue_flush(RT_QUEUE *queue)
 
 	CANCEL_DEFER(svc);
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		goto out;
+
+	if (qcb->mode & Q_LOCKFREE) {
+		while ((msg = ring_pop(qcb)) != NULL) {
+			heapobj_free(&qcb->hobj, msg);
+			ret++;
+		}
+		goto out;
+	}
+
 	qcb = get_alchemy_queue(queue, &syns, &ret);
 	if (qcb == NULL)
 		goto out;
@@ -1103,7 +1455,7 @@ int rt_queue_inquire(RT_QUEUE *queue, RT_QUEUE_INFO *info)
 		goto out;
 
 	info->nwaiters = syncobj_count_grant(&qcb->sobj);
-	info->nmessages = qcb->mcount;
+	info->nmessages = queue_count(qcb);
 	info->mode = qcb->mode;
 	info->qlimit = qcb->limit;
 	info->poolsize = heapobj_size(&qcb->hobj);
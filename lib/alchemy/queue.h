@@ -20,12 +20,15 @@
 #define _ALCHEMY_QUEUE_H
 
 #include <boilerplate/list.h>
+#include <boilerplate/atomic.h>
 #include <copperplate/syncobj.h>
 #include <copperplate/registry.h>
 #include <copperplate/cluster.h>
 #include <copperplate/heapobj.h>
 #include <alchemy/queue.h>
 
+struct alchemy_queue_ring;
+
 struct alchemy_queue {
 	unsigned int magic;	/* Must be first. */
 	char name[XNOBJECT_NAME_LEN];
@@ -36,6 +39,10 @@ struct alchemy_queue {
 	struct clusterobj cobj;
 	struct listobj mq;
 	unsigned int mcount;
+	/* Q_LOCKFREE only, replaces mq and mcount. */
+	dref_type(struct alchemy_queue_ring *) ring;
+	/* Receivers about to sleep on a Q_LOCKFREE queue. */
+	atomic_t nwaiters;
 	struct fsobj fsobj;
 };
 
@@ -48,6 +55,27 @@ struct alchemy_queue_msg {
 	/* Payload data follows. */
 };
 
+/*
+ * Slot of a Q_LOCKFREE ring. The sequence number tells producers and
+ * consumers whose turn it is to use the slot for a given index.
+ */
+struct alchemy_queue_slot {
+	atomic_t seq;
+	dref_type(struct alchemy_queue_msg *) msg;
+};
+
+#define QUEUE_RING_PAD	64
+
+struct alchemy_queue_ring {
+	/* Producers and consumers update separate cache lines. */
+	atomic_t tail;
+	char __pad1[QUEUE_RING_PAD - sizeof(atomic_t)];
+	atomic_t head;
+	char __pad2[QUEUE_RING_PAD - sizeof(atomic_t)];
+	unsigned int mask;
+	struct alchemy_queue_slot slots[0];
+};
+
 struct alchemy_queue_wait {
 	dref_type(struct alchemy_queue_msg *) msg;
 	void *local_buf;
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/buffer.h>
+
+#define BUFSZ   1000
+#define MSGSZ   300
+#define NMSGS   100
+
+static struct traceobj trobj;
+
+static RT_TASK t_bgnd, t_fgnd;
+
+static RT_BUFFER buffer;
+
+static void fill_span(RT_BUFFER_SPAN *span, int n)
+{
+	size_t i, off = 0;
+	int part;
+
+	for (part = 0; part < 2; part++)
+		for (i = 0; i < span->len[part]; i++, off++)
+			((char *)span->ptr[part])[i] = (char)(n + off);
+}
+
+static int check_span(RT_BUFFER_SPAN *span, int n)
+{
+	size_t i, off = 0;
+	int part;
+
+	for (part = 0; part < 2; part++)
+		for (i = 0; i < span->len[part]; i++, off++)
+			if (((char *)span->ptr[part])[i] != (char)(n + off))
+				return 0;
+
+	return 1;
+}
+
+static void foreground_task(void *arg)
+{
+	RT_BUFFER_SPAN span;
+	int n, wrapped = 0;
+	ssize_t ret;
+
+	traceobj_enter(&trobj);
+
+	/* Only the owner may commit a reservation. */
+	ret = rt_buffer_write_commit(&buffer, 4);
+	traceobj_check(&trobj, ret, -EPERM);
+	ret = rt_buffer_clear(&buffer);
+	traceobj_check(&trobj, ret, 0);
+
+	for (n = 0; n < NMSGS; n++) {
+		ret = rt_buffer_read_peek(&buffer, MSGSZ, &span, TM_INFINITE);
+		traceobj_assert(&trobj, ret == MSGSZ);
+		traceobj_assert(&trobj, span.len[0] + span.len[1] == MSGSZ);
+		traceobj_assert(&trobj, check_span(&span, n));
+		if (span.ptr[1])
+			wrapped++;
+		ret = rt_buffer_read_consume(&buffer, MSGSZ + 1);
+		traceobj_check(&trobj, ret, -EINVAL);
+		ret = rt_buffer_read_consume(&buffer, MSGSZ);
+		traceobj_check(&trobj, ret, 0);
+	}
+
+	traceobj_assert(&trobj, wrapped > 0);
+
+	traceobj_exit(&trobj);
+}
+
+static void background_task(void *arg)
+{
+	RT_BUFFER_SPAN span;
+	ssize_t ret;
+	int n;
+
+	traceobj_enter(&trobj);
+
+	for (n = 0; n < NMSGS; n++) {
+		ret = rt_buffer_write_reserve(&buffer, MSGSZ, &span, TM_INFINITE);
+		traceobj_assert(&trobj, ret == MSGSZ);
+		fill_span(&span, n);
+		ret = rt_buffer_write_commit(&buffer, MSGSZ + 1);
+		traceobj_check(&trobj, ret, -EINVAL);
+		ret = rt_buffer_write_commit(&buffer, MSGSZ);
+		traceobj_check(&trobj, ret, 0);
+	}
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	RT_BUFFER_SPAN span;
+	ssize_t ret;
+	char buf[8];
+
+	traceobj_init(&trobj, argv[0], 0);
+
+	ret = rt_buffer_create(&buffer, NULL, BUFSZ, B_FIFO);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_task_shadow(NULL, "main_task", 30, 0);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_buffer_read_peek(&buffer, 1, &span, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	ret = rt_buffer_write_reserve(&buffer, BUFSZ + 1, &span, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	/* Regular writes wait for a pending reservation. */
+	ret = rt_buffer_write_reserve(&buffer, 4, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 4 && span.ptr[1] == NULL);
+	memcpy(span.ptr[0], "abcd", 4);
+	ret = rt_buffer_write(&buffer, "efgh", 4, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+	ret = rt_buffer_read(&buffer, buf, 4, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	/* Committing less than reserved gives back the remainder. */
+	ret = rt_buffer_write_commit(&buffer, 2);
+	traceobj_check(&trobj, ret, 0);
+	ret = rt_buffer_write(&buffer, "efgh", 4, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 4);
+
+	/* Consuming less than peeked leaves the remainder. */
+	ret = rt_buffer_read_peek(&buffer, 3, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 3);
+	traceobj_assert(&trobj, memcmp(span.ptr[0], "abe", 3) == 0);
+	ret = rt_buffer_read(&buffer, buf, 1, TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+	ret = rt_buffer_read_consume(&buffer, 1);
+	traceobj_check(&trobj, ret, 0);
+	ret = rt_buffer_read(&buffer, buf, 5, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 5);
+	traceobj_assert(&trobj, memcmp(buf, "befgh", 5) == 0);
+
+	/* Clearing releases pending reservations and peeks. */
+	ret = rt_buffer_write(&buffer, "ab", 2, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 2);
+	ret = rt_buffer_read_peek(&buffer, 2, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 2);
+	ret = rt_buffer_clear(&buffer);
+	traceobj_check(&trobj, ret, 0);
+	ret = rt_buffer_read_consume(&buffer, 2);
+	traceobj_check(&trobj, ret, -EPERM);
+	ret = rt_buffer_write_reserve(&buffer, 4, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 4);
+	ret = rt_buffer_clear(&buffer);
+	traceobj_check(&trobj, ret, 0);
+	ret = rt_buffer_write_commit(&buffer, 4);
+	traceobj_check(&trobj, ret, -EPERM);
+
+	/* Left pending for the foreground task. */
+	ret = rt_buffer_write_reserve(&buffer, 4, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == 4);
+
+	ret = rt_task_create(&t_fgnd, "FGND", 0,  20, 0);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_task_start(&t_fgnd, foreground_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_task_create(&t_bgnd, "BGND", 0,  10, 0);
+	traceobj_check(&trobj, ret, 0);
+
+	ret = rt_task_start(&t_bgnd, background_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_join(&trobj);
+
+	ret = rt_buffer_delete(&buffer);
+	traceobj_check(&trobj, ret, 0);
+
+	exit(0);
+}
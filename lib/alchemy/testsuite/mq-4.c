@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/queue.h>
+
+#define NMESSAGES  8
+#define POOLSIZE   8192
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	11, 1, 2, 3, 12, 8, 13,
+	4, 5, 9
+};
+
+static RT_QUEUE q;
+
+static void main_task(void *arg)
+{
+	int ret, msg, n;
+	void *buf;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = rt_queue_create(&q, "QUEUE", POOLSIZE, Q_UNLIMITED, Q_LOCKFREE);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_queue_create(&q, "QUEUE", POOLSIZE, NMESSAGES, Q_FIFO|Q_LOCKFREE);
+	traceobj_check(&trobj, ret, 0);
+
+	msg = 0;
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_URGENT);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_BROADCAST);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	buf = rt_queue_alloc(&q, sizeof(msg));
+	traceobj_assert(&trobj, buf != NULL);
+
+	ret = rt_queue_send(&q, buf, sizeof(msg), Q_URGENT);
+	traceobj_check(&trobj, ret, -EINVAL);
+
+	ret = rt_queue_free(&q, buf);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_mark(&trobj, 2);
+
+	for (msg = 0; msg < NMESSAGES; msg++) {
+		ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+		traceobj_check(&trobj, ret, 0);
+	}
+
+	ret = rt_queue_write(&q, &msg, sizeof(msg), Q_NORMAL);
+	traceobj_check(&trobj, ret, -ENOMEM);
+
+	for (n = 0; n < NMESSAGES; n++) {
+		ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+		traceobj_assert(&trobj, ret == sizeof(msg) && msg == n);
+	}
+
+	ret = rt_queue_read(&q, &msg, sizeof(msg), TM_NONBLOCK);
+	traceobj_check(&trobj, ret, -EWOULDBLOCK);
+
+	traceobj_mark(&trobj, 3);
+
+	/* The peer task blocks on the queue meanwhile. */
+	ret = rt_queue_read(&q, &msg, sizeof(msg), 100000000ULL);
+	traceobj_check(&trobj, ret, -ETIMEDOUT);
+
+	traceobj_mark(&trobj, 4);
+
+	ret = rt_queue_delete(&q);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_mark(&trobj, 5);
+
+	traceobj_exit(&trobj);
+}
+
+static void peer_task(void *arg)
+{
+	int ret, msg;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 8);
+
+	ret = rt_queue_read(&q, &msg, sizeof(msg), TM_INFINITE);
+	traceobj_check(&trobj, ret, -EIDRM);
+
+	traceobj_mark(&trobj, 9);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	RT_TASK t_main, t_peer;
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	traceobj_mark(&trobj, 11);
+
+	ret = rt_task_spawn(&t_main, "main_task", 0,  50, 0, main_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_mark(&trobj, 12);
+
+	ret = rt_task_spawn(&t_peer, "peer_task", 0,  49, 0, peer_task, NULL);
+	traceobj_check(&trobj, ret, 0);
+
+	traceobj_mark(&trobj, 13);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	exit(0);
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/timer.h>
+#include <alchemy/queue.h>
+
+/*
+ * Measure the throughput and latency of messages sent from a
+ * producer task to a consumer task, with and without Q_LOCKFREE.
+ * When multiple CPUs are available, each task is pinned to its own
+ * CPU. Otherwise the producer fills the queue before yielding to
+ * the consumer, so that the latency mostly reflects queuing delays.
+ */
+
+#define NMESSAGES  200000
+#define QLIMIT     256
+#define MSGSIZE    64
+#define POOLSIZE   (QLIMIT * MSGSIZE)
+
+static struct traceobj trobj;
+
+static RT_TASK t_producer, t_consumer;
+
+static RT_QUEUE queue;
+
+static RTIME lat_min, lat_max, lat_sum;
+
+static void producer_task(void *arg)
+{
+	RTIME *stamp;
+	int ret, n;
+
+	traceobj_enter(&trobj);
+
+	for (n = 0; n < NMESSAGES; n++) {
+		while ((stamp = rt_queue_alloc(&queue, MSGSIZE)) == NULL)
+			rt_task_yield();
+		*stamp = rt_timer_read();
+		while ((ret = rt_queue_send(&queue, stamp, MSGSIZE,
+					    Q_NORMAL)) == -ENOMEM)
+			rt_task_yield();
+		traceobj_assert(&trobj, ret >= 0);
+	}
+
+	traceobj_exit(&trobj);
+}
+
+static void consumer_task(void *arg)
+{
+	RTIME *stamp, lat;
+	ssize_t ret;
+	int n;
+
+	traceobj_enter(&trobj);
+
+	lat_min = ~0ULL;
+	lat_max = lat_sum = 0;
+
+	for (n = 0; n < NMESSAGES; n++) {
+		ret = rt_queue_receive(&queue, (void **)&stamp, TM_INFINITE);
+		traceobj_assert(&trobj, ret == MSGSIZE);
+		lat = rt_timer_read() - *stamp;
+		if (lat < lat_min)
+			lat_min = lat;
+		if (lat > lat_max)
+			lat_max = lat;
+		lat_sum += lat;
+		ret = rt_queue_free(&queue, stamp);
+		traceobj_check(&trobj, ret, 0);
+	}
+
+	traceobj_exit(&trobj);
+}
+
+static void start_task(RT_TASK *task, const char *name,
+		       void (*entry)(void *arg), int cpu)
+{
+	cpu_set_t cpus;
+	int ret;
+
+	ret = rt_task_create(task, name, 0, 50, T_JOINABLE);
+	traceobj_check(&trobj, ret, 0);
+
+	if (cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		ret = rt_task_set_affinity(task, &cpus);
+		traceobj_check(&trobj, ret, 0);
+	}
+
+	ret = rt_task_start(task, entry, NULL);
+	traceobj_check(&trobj, ret, 0);
+}
+
+static void run_bench(const char *label, int mode, int smp)
+{
+	RTIME start, elapsed;
+	int ret;
+
+	ret = rt_queue_create(&queue, "QUEUE", POOLSIZE, QLIMIT, mode);
+	traceobj_check(&trobj, ret, 0);
+
+	start = rt_timer_read();
+	start_task(&t_consumer, "CONSUMER", consumer_task, smp ? 1 : -1);
+	start_task(&t_producer, "PRODUCER", producer_task, smp ? 0 : -1);
+
+	ret = rt_task_join(&t_producer);
+	traceobj_check(&trobj, ret, 0);
+	ret = rt_task_join(&t_consumer);
+	traceobj_check(&trobj, ret, 0);
+	elapsed = rt_timer_ticks2ns(rt_timer_read() - start);
+
+	printf("%-9s %9llu msgs/s, latency min %llu ns, avg %llu ns, max %llu ns\n",
+	       label, NMESSAGES * 1000000000ULL / elapsed,
+	       rt_timer_ticks2ns(lat_min),
+	       rt_timer_ticks2ns(lat_sum / NMESSAGES),
+	       rt_timer_ticks2ns(lat_max));
+
+	ret = rt_queue_delete(&queue);
+	traceobj_check(&trobj, ret, 0);
+}
+
+int main(int argc, char *const argv[])
+{
+	int smp = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+	traceobj_init(&trobj, argv[0], 0);
+
+	run_bench("locked", Q_FIFO, smp);
+	run_bench("lockfree", Q_FIFO|Q_LOCKFREE, smp);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
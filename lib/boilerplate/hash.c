@@ -16,6 +16,7 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "boilerplate/lock.h"
@@ -91,6 +92,144 @@ unsigned int __hash_key(const void *key, size_t length, unsigned int c)
 	return c;
 }
 
+/*
+ * Table hashing routine, after MurmurHash3 by Austin Appleby,
+ * Public Domain. Unlike __hash_key(), it digests four bytes per
+ * round, and gives well-distributed low order bits, which is what
+ * linear hashing consumes.
+ */
+static inline unsigned int rotl32(unsigned int x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static unsigned int hash_table_key(const void *key, size_t length)
+{
+	const unsigned char *k = key;
+	unsigned int h, w;
+	size_t len;
+
+	h = GOLDEN_HASH_RATIO;
+
+	for (len = length; len >= 4; len -= 4, k += 4) {
+		memcpy(&w, k, sizeof(w));
+		w *= 0xcc9e2d51;
+		w = rotl32(w, 15);
+		w *= 0x1b873593;
+		h ^= w;
+		h = rotl32(h, 13);
+		h = h * 5 + 0xe6546b64;
+	}
+
+	w = 0;
+	switch (len) {
+	case 3: w ^= (unsigned int)k[2] << 16;
+	case 2: w ^= (unsigned int)k[1] << 8;
+	case 1: w ^= k[0];
+		w *= 0xcc9e2d51;
+		w = rotl32(w, 15);
+		w *= 0x1b873593;
+		h ^= w;
+	};
+
+	h ^= (unsigned int)length;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/*
+ * Linear hashing: with nr buckets and base the largest power of two
+ * not above nr, buckets [0, nr - base) have already been split into
+ * their [base, nr) siblings. Since base is a multiple of
+ * HASH_STRIPES, a bucket and its siblings are covered by the same
+ * stripe, which the low order bits of the hash designate.
+ */
+static inline unsigned int hash_base(unsigned int nr)
+{
+	return 1U << (31 - __builtin_clz(nr));
+}
+
+static inline unsigned int hash_index(unsigned int hash, unsigned int nr)
+{
+	unsigned int base = hash_base(nr), b;
+
+	b = hash & (base * 2 - 1);
+	if (b >= nr)
+		b = hash & (base - 1);
+
+	return b;
+}
+
+static inline pthread_mutex_t *hash_stripe(pthread_mutex_t *stripes,
+					   unsigned int hash)
+{
+	return &stripes[hash & (HASH_STRIPES - 1)];
+}
+
+static void init_locks(pthread_mutex_t *stripes, pthread_mutex_t *resize_lock,
+		       pthread_mutexattr_t *mattr)
+{
+	int n;
+
+	for (n = 0; n < HASH_STRIPES; n++)
+		__RT(pthread_mutex_init(&stripes[n], mattr));
+
+	__RT(pthread_mutex_init(resize_lock, mattr));
+}
+
+static void destroy_locks(pthread_mutex_t *stripes,
+			  pthread_mutex_t *resize_lock)
+{
+	int n;
+
+	for (n = 0; n < HASH_STRIPES; n++)
+		__RT(pthread_mutex_destroy(&stripes[n]));
+
+	__RT(pthread_mutex_destroy(resize_lock));
+}
+
+/*
+ * Walkers block growth, so that no object moves to a bucket beyond
+ * the range being scanned.
+ */
+static unsigned int begin_walk(pthread_mutex_t *resize_lock,
+			       int *walkers, atomic_t *nr_buckets)
+{
+	unsigned int nr;
+
+	write_lock_nocancel(resize_lock);
+	(*walkers)++;
+	nr = atomic_read(nr_buckets);
+	write_unlock(resize_lock);
+
+	return nr;
+}
+
+static void end_walk(pthread_mutex_t *resize_lock, int *walkers)
+{
+	write_lock_nocancel(resize_lock);
+	(*walkers)--;
+	write_unlock(resize_lock);
+}
+
+static inline int need_growth(atomic_t *nr_buckets, atomic_t *nr_objs)
+{
+	unsigned int nr = atomic_read(nr_buckets);
+
+	return nr < HASHSLOTS * HASH_MAXSEGS &&
+		(unsigned int)atomic_read(nr_objs) > nr * HASH_LOADFACTOR;
+}
+
+static inline void *alloc_segment(size_t size,
+				  const struct hash_operations *hops);
+
+static inline void release_segments(struct hash_table *t);
+
 void __hash_init(void *heap, struct hash_table *t)
 {
 	pthread_mutexattr_t mattr;
@@ -99,23 +238,96 @@ void __hash_init(void *heap, struct hash_table *t)
 	for (n = 0; n < HASHSLOTS; n++)
 		__list_init(heap, &t->table[n].obj_list);
 
+	memset(t->segs, 0, sizeof(t->segs));
+	atomic_set(&t->nr_buckets, HASHSLOTS);
+	atomic_set(&t->nr_objs, 0);
+	t->walkers = 0;
+
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
 	pthread_mutexattr_setpshared(&mattr, mutex_scope_attribute);
-	__RT(pthread_mutex_init(&t->lock, &mattr));
+	init_locks(t->stripes, &t->resize_lock, &mattr);
 	pthread_mutexattr_destroy(&mattr);
 }
 
 void hash_destroy(struct hash_table *t)
 {
-	__RT(pthread_mutex_destroy(&t->lock));
+	destroy_locks(t->stripes, &t->resize_lock);
+	release_segments(t);
 }
 
-static struct hash_bucket *do_hash(struct hash_table *t,
-				   const void *key, size_t len)
+static struct hash_bucket *get_bucket(struct hash_table *t, unsigned int b)
 {
-	unsigned int hash = __hash_key(key, len, 0);
-	return &t->table[hash & (HASHSLOTS-1)];
+	struct hash_bucket *seg;
+
+	if (b < HASHSLOTS)
+		return &t->table[b];
+
+	seg = __mptr(t->segs[b / HASHSLOTS]);
+
+	return seg + (b & (HASHSLOTS - 1));
+}
+
+/* Must be called with the stripe covering @hash locked. */
+static struct hash_bucket *do_hash(struct hash_table *t, unsigned int hash)
+{
+	return get_bucket(t, hash_index(hash, atomic_read(&t->nr_buckets)));
+}
+
+/*
+ * Split the next bucket in line. This is opportunistic: the caller
+ * does not wait for any concurrent resize or walk to complete.
+ */
+static void grow_table(struct hash_table *t,
+		       const struct hash_operations *hops)
+{
+	struct hash_bucket *seg, *from, *to;
+	unsigned int nr, base, mask, n;
+	struct hashobj *obj, *tmp;
+	pthread_mutex_t *lock;
+
+	if (!need_growth(&t->nr_buckets, &t->nr_objs))
+		return;
+
+	if (write_trylock_nocancel(&t->resize_lock))
+		return;
+
+	nr = atomic_read(&t->nr_buckets);
+	if (t->walkers || nr >= HASHSLOTS * HASH_MAXSEGS)
+		goto out;
+
+	if (!t->segs[nr / HASHSLOTS]) {
+		seg = alloc_segment(HASHSLOTS * sizeof(*seg), hops);
+		if (seg == NULL)
+			goto out;
+		for (n = 0; n < HASHSLOTS; n++)
+			list_init(&seg[n].obj_list);
+		t->segs[nr / HASHSLOTS] = __moff(seg);
+	}
+
+	base = hash_base(nr);
+	mask = base * 2 - 1;
+	from = get_bucket(t, nr - base);
+	to = get_bucket(t, nr);
+	lock = hash_stripe(t->stripes, nr);
+
+	write_lock_nocancel(lock);
+
+	if (!list_empty(&from->obj_list)) {
+		list_for_each_entry_safe(obj, tmp, &from->obj_list, link) {
+			if ((obj->hash & mask) == nr) {
+				list_remove(&obj->link);
+				list_append(&obj->link, &to->obj_list);
+			}
+		}
+	}
+
+	smp_wmb();
+	atomic_set(&t->nr_buckets, nr + 1);
+
+	write_unlock(lock);
+out:
+	write_unlock(&t->resize_lock);
 }
 
 int __hash_enter(struct hash_table *t,
@@ -125,6 +337,7 @@ int __hash_enter(struct hash_table *t,
 		 int nodup)
 {
 	struct hash_bucket *bucket;
+	pthread_mutex_t *lock;
 	struct hashobj *obj;
 	int ret;
 
@@ -133,12 +346,15 @@ int __hash_enter(struct hash_table *t,
 	if (ret)
 		return ret;
 
-	bucket = do_hash(t, key, len);
-	write_lock_nocancel(&t->lock);
+	newobj->hash = hash_table_key(key, len);
+	lock = hash_stripe(t->stripes, newobj->hash);
+	write_lock_nocancel(lock);
+	bucket = do_hash(t, newobj->hash);
 
 	if (nodup && !list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (obj->hash != newobj->hash ||
+			    obj->len != newobj->len)
 				continue;
 			if (hops->compare(__mptr(obj->key), __mptr(newobj->key),
 					  obj->len) == 0) {
@@ -150,8 +366,12 @@ int __hash_enter(struct hash_table *t,
 	}
 
 	list_append(&newobj->link, &bucket->obj_list);
+	atomic_add_fetch(&t->nr_objs, 1);
 out:
-	write_unlock(&t->lock);
+	write_unlock(lock);
+
+	if (ret == 0)
+		grow_table(t, hops);
 
 	return ret;
 }
@@ -160,25 +380,27 @@ int hash_remove(struct hash_table *t, struct hashobj *delobj,
 		const struct hash_operations *hops)
 {
 	struct hash_bucket *bucket;
+	pthread_mutex_t *lock;
 	struct hashobj *obj;
 	int ret = -ESRCH;
 
-	bucket = do_hash(t, __mptr(delobj->key), delobj->len);
-
-	write_lock_nocancel(&t->lock);
+	lock = hash_stripe(t->stripes, delobj->hash);
+	write_lock_nocancel(lock);
+	bucket = do_hash(t, delobj->hash);
 
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
 			if (obj == delobj) {
 				list_remove_init(&obj->link);
 				drop_key(obj, hops);
+				atomic_sub_fetch(&t->nr_objs, 1);
 				ret = 0;
 				goto out;
 			}
 		}
 	}
 out:
-	write_unlock(&t->lock);
+	write_unlock(lock);
 
 	return __bt(ret);
 }
@@ -187,15 +409,18 @@ struct hashobj *hash_search(struct hash_table *t, const void *key,
 			    size_t len, const struct hash_operations *hops)
 {
 	struct hash_bucket *bucket;
+	pthread_mutex_t *lock;
 	struct hashobj *obj;
+	unsigned int hash;
 
-	bucket = do_hash(t, key, len);
-
-	read_lock_nocancel(&t->lock);
+	hash = hash_table_key(key, len);
+	lock = hash_stripe(t->stripes, hash);
+	read_lock_nocancel(lock);
+	bucket = do_hash(t, hash);
 
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (obj->hash != hash || obj->len != len)
 				continue;
 			if (hops->compare(__mptr(obj->key), key, len) == 0)
 				goto out;
@@ -203,7 +428,7 @@ struct hashobj *hash_search(struct hash_table *t, const void *key,
 	}
 	obj = NULL;
 out:
-	read_unlock(&t->lock);
+	read_unlock(lock);
 
 	return obj;
 }
@@ -212,26 +437,33 @@ int hash_walk(struct hash_table *t, hash_walk_op walk, void *arg)
 {
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
-	int ret, n;
+	unsigned int nr, n;
+	pthread_mutex_t *lock;
+	int ret = 0;
 
-	read_lock_nocancel(&t->lock);
+	nr = begin_walk(&t->resize_lock, &t->walkers, &t->nr_buckets);
 
-	for (n = 0; n < HASHSLOTS; n++) {
-		bucket = &t->table[n];
-		if (list_empty(&bucket->obj_list))
+	for (n = 0; n < nr; n++) {
+		lock = hash_stripe(t->stripes, n);
+		read_lock_nocancel(lock);
+		bucket = get_bucket(t, n);
+		if (list_empty(&bucket->obj_list)) {
+			read_unlock(lock);
 			continue;
+		}
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			read_unlock(&t->lock);
+			read_unlock(lock);
 			ret = walk(t, obj, arg);
 			if (ret)
-				return __bt(ret);
-			read_lock_nocancel(&t->lock);
+				goto out;
+			read_lock_nocancel(lock);
 		}
+		read_unlock(lock);
 	}
+out:
+	end_walk(&t->resize_lock, &t->walkers);
 
-	read_unlock(&t->lock);
-
-	return 0;
+	return __bt(ret);
 }
 
 #ifdef CONFIG_XENO_PSHARED
@@ -268,6 +500,19 @@ static inline void drop_key(struct hashobj *obj,
 		hops->free((void *)key);
 }
 
+static inline void *alloc_segment(size_t size,
+				  const struct hash_operations *hops)
+{
+	return hops->alloc(size);
+}
+
+/*
+ * Extra segments were obtained from the main heap, which is
+ * reclaimed with the session.
+ */
+static inline void release_segments(struct hash_table *t)
+{ }
+
 int __hash_enter_probe(struct hash_table *t,
 		       const void *key, size_t len,
 		       struct hashobj *newobj,
@@ -276,6 +521,7 @@ int __hash_enter_probe(struct hash_table *t,
 {
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
+	pthread_mutex_t *lock;
 	int ret;
 
 	holder_init(&newobj->link);
@@ -283,13 +529,16 @@ int __hash_enter_probe(struct hash_table *t,
 	if (ret)
 		return ret;
 
-	bucket = do_hash(t, key, len);
-	push_cleanup_lock(&t->lock);
-	write_lock(&t->lock);
+	newobj->hash = hash_table_key(key, len);
+	lock = hash_stripe(t->stripes, newobj->hash);
+	push_cleanup_lock(lock);
+	write_lock(lock);
+	bucket = do_hash(t, newobj->hash);
 
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (obj->hash != newobj->hash ||
+			    obj->len != newobj->len)
 				continue;
 			if (hops->compare(__mptr(obj->key),
 					  __mptr(newobj->key), obj->len) == 0) {
@@ -303,14 +552,19 @@ int __hash_enter_probe(struct hash_table *t,
 				}
 				list_remove_init(&obj->link);
 				drop_key(obj, hops);
+				atomic_sub_fetch(&t->nr_objs, 1);
 			}
 		}
 	}
 
 	list_append(&newobj->link, &bucket->obj_list);
+	atomic_add_fetch(&t->nr_objs, 1);
 out:
-	write_unlock(&t->lock);
-	pop_cleanup_lock(&t->lock);
+	write_unlock(lock);
+	pop_cleanup_lock(lock);
+
+	if (ret == 0)
+		grow_table(t, hops);
 
 	return ret;
 }
@@ -321,20 +575,24 @@ struct hashobj *hash_search_probe(struct hash_table *t,
 {
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
+	pthread_mutex_t *lock;
+	unsigned int hash;
 
-	bucket = do_hash(t, key, len);
-
-	push_cleanup_lock(&t->lock);
-	write_lock(&t->lock);
+	hash = hash_table_key(key, len);
+	lock = hash_stripe(t->stripes, hash);
+	push_cleanup_lock(lock);
+	write_lock(lock);
+	bucket = do_hash(t, hash);
 
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (obj->hash != hash || obj->len != len)
 				continue;
 			if (hops->compare(__mptr(obj->key), key, len) == 0) {
 				if (!hops->probe(obj)) {
 					list_remove_init(&obj->link);
 					drop_key(obj, hops);
+					atomic_sub_fetch(&t->nr_objs, 1);
 					continue;
 				}
 				goto out;
@@ -343,8 +601,8 @@ struct hashobj *hash_search_probe(struct hash_table *t,
 	}
 	obj = NULL;
 out:
-	write_unlock(&t->lock);
-	pop_cleanup_lock(&t->lock);
+	write_unlock(lock);
+	pop_cleanup_lock(lock);
 
 	return obj;
 }
@@ -357,19 +615,84 @@ void pvhash_init(struct pvhash_table *t)
 	for (n = 0; n < HASHSLOTS; n++)
 		pvlist_init(&t->table[n].obj_list);
 
+	memset(t->segs, 0, sizeof(t->segs));
+	atomic_set(&t->nr_buckets, HASHSLOTS);
+	atomic_set(&t->nr_objs, 0);
+	t->walkers = 0;
+
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
 	pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
 	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE);
-	__RT(pthread_mutex_init(&t->lock, &mattr));
+	init_locks(t->stripes, &t->resize_lock, &mattr);
 	pthread_mutexattr_destroy(&mattr);
 }
 
+static struct pvhash_bucket *get_pvbucket(struct pvhash_table *t,
+					  unsigned int b)
+{
+	if (b < HASHSLOTS)
+		return &t->table[b];
+
+	return t->segs[b / HASHSLOTS] + (b & (HASHSLOTS - 1));
+}
+
+/* Must be called with the stripe covering @hash locked. */
 static struct pvhash_bucket *do_pvhash(struct pvhash_table *t,
-				       const void *key, size_t len)
+				       unsigned int hash)
+{
+	return get_pvbucket(t, hash_index(hash, atomic_read(&t->nr_buckets)));
+}
+
+static void grow_pvtable(struct pvhash_table *t)
 {
-	unsigned int hash = __hash_key(key, len, 0);
-	return &t->table[hash & (HASHSLOTS-1)];
+	struct pvhash_bucket *seg, *from, *to;
+	unsigned int nr, base, mask, n;
+	struct pvhashobj *obj, *tmp;
+	pthread_mutex_t *lock;
+
+	if (!need_growth(&t->nr_buckets, &t->nr_objs))
+		return;
+
+	if (write_trylock_nocancel(&t->resize_lock))
+		return;
+
+	nr = atomic_read(&t->nr_buckets);
+	if (t->walkers || nr >= HASHSLOTS * HASH_MAXSEGS)
+		goto out;
+
+	if (t->segs[nr / HASHSLOTS] == NULL) {
+		seg = malloc(HASHSLOTS * sizeof(*seg));
+		if (seg == NULL)
+			goto out;
+		for (n = 0; n < HASHSLOTS; n++)
+			pvlist_init(&seg[n].obj_list);
+		t->segs[nr / HASHSLOTS] = seg;
+	}
+
+	base = hash_base(nr);
+	mask = base * 2 - 1;
+	from = get_pvbucket(t, nr - base);
+	to = get_pvbucket(t, nr);
+	lock = hash_stripe(t->stripes, nr);
+
+	write_lock_nocancel(lock);
+
+	if (!pvlist_empty(&from->obj_list)) {
+		pvlist_for_each_entry_safe(obj, tmp, &from->obj_list, link) {
+			if ((obj->hash & mask) == nr) {
+				pvlist_remove(&obj->link);
+				pvlist_append(&obj->link, &to->obj_list);
+			}
+		}
+	}
+
+	smp_wmb();
+	atomic_set(&t->nr_buckets, nr + 1);
+
+	write_unlock(lock);
+out:
+	write_unlock(&t->resize_lock);
 }
 
 int __pvhash_enter(struct pvhash_table *t,
@@ -380,18 +703,22 @@ int __pvhash_enter(struct pvhash_table *t,
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj;
+	pthread_mutex_t *lock;
 	int ret = 0;
 
 	pvholder_init(&newobj->link);
 	newobj->key = key;
 	newobj->len = len;
-	bucket = do_pvhash(t, key, len);
+	newobj->hash = hash_table_key(key, len);
+	lock = hash_stripe(t->stripes, newobj->hash);
 
-	write_lock_nocancel(&t->lock);
+	write_lock_nocancel(lock);
+	bucket = do_pvhash(t, newobj->hash);
 
 	if (nodup && !pvlist_empty(&bucket->obj_list)) {
 		pvlist_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (obj->hash != newobj->hash ||
+			    obj->len != newobj->len)
 				continue;
 			if (hops->compare(obj->key, newobj->key, len) == 0) {
 				ret = -EEXIST;
@@ -401,8 +728,12 @@ int __pvhash_enter(struct pvhash_table *t,
 	}
 
 	pvlist_append(&newobj->link, &bucket->obj_list);
+	atomic_add_fetch(&t->nr_objs, 1);
 out:
-	write_unlock(&t->lock);
+	write_unlock(lock);
+
+	if (ret == 0)
+		grow_pvtable(t);
 
 	return ret;
 }
@@ -412,23 +743,25 @@ int pvhash_remove(struct pvhash_table *t, struct pvhashobj *delobj,
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj;
+	pthread_mutex_t *lock;
 	int ret = -ESRCH;
 
-	bucket = do_pvhash(t, delobj->key, delobj->len);
-
-	write_lock_nocancel(&t->lock);
+	lock = hash_stripe(t->stripes, delobj->hash);
+	write_lock_nocancel(lock);
+	bucket = do_pvhash(t, delobj->hash);
 
 	if (!pvlist_empty(&bucket->obj_list)) {
 		pvlist_for_each_entry(obj, &bucket->obj_list, link) {
 			if (obj == delobj) {
 				pvlist_remove_init(&obj->link);
+				atomic_sub_fetch(&t->nr_objs, 1);
 				ret = 0;
 				goto out;
 			}
 		}
 	}
 out:
-	write_unlock(&t->lock);
+	write_unlock(lock);
 
 	return __bt(ret);
 }
@@ -439,14 +772,17 @@ struct pvhashobj *pvhash_search(struct pvhash_table *t,
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj;
+	pthread_mutex_t *lock;
+	unsigned int hash;
 
-	bucket = do_pvhash(t, key, len);
-
-	read_lock_nocancel(&t->lock);
+	hash = hash_table_key(key, len);
+	lock = hash_stripe(t->stripes, hash);
+	read_lock_nocancel(lock);
+	bucket = do_pvhash(t, hash);
 
 	if (!pvlist_empty(&bucket->obj_list)) {
 		pvlist_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (obj->hash != hash || obj->len != len)
 				continue;
 			if (hops->compare(obj->key, key, len) == 0)
 				goto out;
@@ -454,7 +790,7 @@ struct pvhashobj *pvhash_search(struct pvhash_table *t,
 	}
 	obj = NULL;
 out:
-	read_unlock(&t->lock);
+	read_unlock(lock);
 
 	return obj;
 }
@@ -463,26 +799,33 @@ int pvhash_walk(struct pvhash_table *t,	pvhash_walk_op walk, void *arg)
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj, *tmp;
-	int ret, n;
+	unsigned int nr, n;
+	pthread_mutex_t *lock;
+	int ret = 0;
 
-	read_lock_nocancel(&t->lock);
+	nr = begin_walk(&t->resize_lock, &t->walkers, &t->nr_buckets);
 
-	for (n = 0; n < HASHSLOTS; n++) {
-		bucket = &t->table[n];
-		if (pvlist_empty(&bucket->obj_list))
+	for (n = 0; n < nr; n++) {
+		lock = hash_stripe(t->stripes, n);
+		read_lock_nocancel(lock);
+		bucket = get_pvbucket(t, n);
+		if (pvlist_empty(&bucket->obj_list)) {
+			read_unlock(lock);
 			continue;
+		}
 		pvlist_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			read_unlock(&t->lock);
+			read_unlock(lock);
 			ret = walk(t, obj, arg);
 			if (ret)
-				return __bt(ret);
-			read_lock_nocancel(&t->lock);
+				goto out;
+			read_lock_nocancel(lock);
 		}
+		read_unlock(lock);
 	}
+out:
+	end_walk(&t->resize_lock, &t->walkers);
 
-	read_unlock(&t->lock);
-
-	return 0;
+	return __bt(ret);
 }
 
 #else /* !CONFIG_XENO_PSHARED */
@@ -501,4 +844,18 @@ static inline void drop_key(struct hashobj *obj,
 			    const struct hash_operations *hops)
 { }
 
+static inline void *alloc_segment(size_t size,
+				  const struct hash_operations *hops)
+{
+	return malloc(size);
+}
+
+static inline void release_segments(struct hash_table *t)
+{
+	int n;
+
+	for (n = 1; n < HASH_MAXSEGS; n++)
+		free(t->segs[n]);
+}
+
 #endif /* !CONFIG_XENO_PSHARED */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <asm/xenomai/syscall.h>
+#include "internal.h"
+
+/**
+ * @ingroup cobalt_api
+ * @defgroup cobalt_api_epoll Event polling
+ *
+ * Cobalt services for waiting on persistent sets of RTDM descriptors
+ *
+ * Unlike select(), an interest set created by epoll_create_np()
+ * survives across waits, so that the cost of epoll_wait() only
+ * depends on the number of events pending, not on the number of
+ * descriptors watched. The descriptors are limited to RTDM ones
+ * below FD_SETSIZE. Only EPOLLIN, EPOLLOUT and EPOLLPRI are
+ * supported, in level-triggered mode; a descriptor ready for
+ * several of them is reported by a single event.
+ *
+ * epoll_ctl() and epoll_wait() are passed to the regular Linux
+ * implementation when applied to a Linux epoll instance.
+ *
+ *@{
+ */
+
+/**
+ * Create a Cobalt epoll instance.
+ *
+ * @param flags 0 or EPOLL_CLOEXEC.
+ *
+ * @return a file descriptor on success, -1 with errno set otherwise.
+ *
+ * @apitags{thread-unrestricted, switch-secondary}
+ */
+int epoll_create_np(int flags)
+{
+	int ret;
+
+	ret = XENOMAI_SYSCALL1(sc_cobalt_epoll_create, flags);
+	if (ret >= 0)
+		return ret;
+
+	errno = -ret;
+	return -1;
+}
+
+/**
+ * Control a Cobalt epoll instance.
+ *
+ * @see epoll_ctl(2).
+ *
+ * @apitags{thread-unrestricted, switch-secondary}
+ */
+COBALT_IMPL(int, epoll_ctl, (int epfd, int op, int fd,
+			     struct epoll_event *event))
+{
+	int ret;
+
+	ret = XENOMAI_SYSCALL4(sc_cobalt_epoll_ctl, epfd, op, fd, event);
+	if (ret == -EBADF || ret == -ENOSYS)
+		return __STD(epoll_ctl(epfd, op, fd, event));
+
+	if (ret >= 0)
+		return ret;
+
+	errno = -ret;
+	return -1;
+}
+
+/**
+ * Wait for events on a Cobalt epoll instance.
+ *
+ * At most 64 events are returned by a single call.
+ *
+ * @see epoll_wait(2).
+ *
+ * @apitags{xthread-only, switch-primary}
+ */
+COBALT_IMPL(int, epoll_wait, (int epfd, struct epoll_event *events,
+			      int maxevents, int timeout))
+{
+	struct timespec ts, *tsp = NULL;
+	int ret, oldtype;
+
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		tsp = &ts;
+	}
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+
+	ret = XENOMAI_SYSCALL4(sc_cobalt_epoll_wait,
+			       epfd, events, maxevents, tsp);
+
+	pthread_setcanceltype(oldtype, NULL);
+
+	/*
+	 * -EBADF denotes a Linux epoll instance, -EPERM a caller
+	 * which is not a Cobalt thread, for which the primary-mode
+	 * syscall is denied.
+	 */
+	if (ret == -EBADF || ret == -EPERM || ret == -ENOSYS)
+		return __STD(epoll_wait(epfd, events, maxevents, timeout));
+
+	if (ret >= 0)
+		return ret;
+
+	errno = -ret;
+	return -1;
+}
+
+/** @} */
@@ -73,6 +73,11 @@ static const struct option cobalt_options[] = {
 		.name = "print-sync-delay",
 		.has_arg = required_argument,
 	},
+	{
+#define print_deferred_opt	4
+		.name = "print-deferred",
+		.has_arg = no_argument,
+	},
 	{ /* Sentinel */ }
 };
 
@@ -282,6 +287,9 @@ static int cobalt_parse_option(int optnum, const char *optarg)
 			return ret;
 		__cobalt_print_syncdelay = value;
 		break;
+	case print_deferred_opt:
+		__cobalt_print_deferred = 1;
+		break;
 	default:
 		/* Paranoid, can't happen. */
 		return -EINVAL;
@@ -296,6 +304,7 @@ static void cobalt_help(void)
         fprintf(stderr, "--print-buffer-size=<bytes>	size of a print relay buffer (16k)\n");
         fprintf(stderr, "--print-buffer-count=<num>	number of print relay buffers (4)\n");
         fprintf(stderr, "--print-buffer-syncdelay=<ms>	max delay of output synchronization (100 ms)\n");
+        fprintf(stderr, "--print-deferred		defer formatting to the output thread\n");
 }
 
 static struct setup_descriptor cobalt_interface = {
@@ -47,10 +47,50 @@ struct entry_head {
 	FILE *dest;
 	uint32_t seq_no;
 	int priority;
+	/* Format of a deferred entry, NULL for plain text. */
+	const char *format;
 	size_t len;
 	char data[0];
 } __attribute__((packed));
 
+/*
+ * Deferred formatting: the RT caller only stores the format pointer
+ * and the raw argument values into the ring, the printer thread
+ * parses the format again to decode them.
+ */
+enum print_arg_type {
+	PRINT_ARG_NONE,
+	PRINT_ARG_INT,
+	PRINT_ARG_LONG,
+	PRINT_ARG_LLONG,
+	PRINT_ARG_INTMAX,
+	PRINT_ARG_SIZE,
+	PRINT_ARG_PTRDIFF,
+	PRINT_ARG_DOUBLE,
+	PRINT_ARG_LDOUBLE,
+	PRINT_ARG_PTR,
+	PRINT_ARG_STR,
+	PRINT_ARG_ERRNO,
+	PRINT_ARG_BAD,
+};
+
+#define PRINT_SPEC_MAX			32
+
+struct print_spec {
+	enum print_arg_type type;
+	int star_width;
+	int star_prec;
+	int prec;
+	const char *start;
+	const char *end;
+};
+
+struct print_line {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
 struct print_buffer {
 	off_t write_pos;
 
@@ -74,6 +114,8 @@ int __cobalt_print_bufcount = RT_PRINT_DEFAULT_BUFFERS_COUNT;
 
 int __cobalt_print_syncdelay = RT_PRINT_DEFAULT_SYNCDELAY;
 
+int __cobalt_print_deferred;
+
 static struct print_buffer *first_buffer;
 static int buffers;
 static uint32_t seq_no;
@@ -91,6 +133,372 @@ static unsigned long pool_start, pool_len;
 static void release_buffer(struct print_buffer *buffer);
 static void print_buffers(void);
 
+/*
+ * Parse the conversion specification @fmt points at (past the '%'
+ * sign). Positional arguments, %n and wide characters are not
+ * supported in deferred mode.
+ */
+static const char *parse_spec(const char *fmt, struct print_spec *spec)
+{
+	int lmod = 0;
+
+	spec->start = fmt - 1;
+	spec->star_width = 0;
+	spec->star_prec = 0;
+	spec->prec = -1;
+	spec->type = PRINT_ARG_BAD;
+
+	while (*fmt && strchr("-+ #0'I", *fmt))
+		fmt++;
+
+	if (*fmt == '*') {
+		spec->star_width = 1;
+		fmt++;
+	} else
+		while (*fmt >= '0' && *fmt <= '9')
+			fmt++;
+
+	if (*fmt == '.') {
+		fmt++;
+		if (*fmt == '*') {
+			spec->star_prec = 1;
+			fmt++;
+		} else {
+			spec->prec = 0;
+			while (*fmt >= '0' && *fmt <= '9')
+				spec->prec = spec->prec * 10 + *fmt++ - '0';
+		}
+	}
+
+	switch (*fmt) {
+	case 'h':
+		fmt++;
+		if (*fmt == 'h')
+			fmt++;
+		break;
+	case 'l':
+		fmt++;
+		lmod = 'l';
+		if (*fmt == 'l') {
+			fmt++;
+			lmod = 'q';
+		}
+		break;
+	case 'q':
+	case 'L':
+	case 'j':
+	case 'z':
+	case 'Z':
+	case 't':
+		lmod = *fmt++;
+		break;
+	}
+
+	switch (*fmt) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		switch (lmod) {
+		case 'l':
+			spec->type = PRINT_ARG_LONG;
+			break;
+		case 'q':
+		case 'L':
+			spec->type = PRINT_ARG_LLONG;
+			break;
+		case 'j':
+			spec->type = PRINT_ARG_INTMAX;
+			break;
+		case 'z':
+		case 'Z':
+			spec->type = PRINT_ARG_SIZE;
+			break;
+		case 't':
+			spec->type = PRINT_ARG_PTRDIFF;
+			break;
+		default:
+			spec->type = PRINT_ARG_INT;
+		}
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->type = lmod == 'L' ? PRINT_ARG_LDOUBLE : PRINT_ARG_DOUBLE;
+		break;
+	case 'c':
+		if (lmod == 0)
+			spec->type = PRINT_ARG_INT;
+		break;
+	case 's':
+		if (lmod == 0)
+			spec->type = PRINT_ARG_STR;
+		break;
+	case 'p':
+		spec->type = PRINT_ARG_PTR;
+		break;
+	case 'm':
+		spec->type = PRINT_ARG_ERRNO;
+		break;
+	case '%':
+		spec->type = PRINT_ARG_NONE;
+		break;
+	case '\0':
+		return fmt;
+	}
+
+	spec->end = ++fmt;
+	if (spec->end - spec->start >= PRINT_SPEC_MAX)
+		spec->type = PRINT_ARG_BAD;
+
+	return fmt;
+}
+
+#define pack_arg(__p, __end, __type, __val)		\
+	do {						\
+		__type __v = (__val);			\
+		if ((__p) + sizeof(__v) > (__end))	\
+			return -1;			\
+		memcpy(__p, &__v, sizeof(__v));		\
+		(__p) += sizeof(__v);			\
+	} while (0)
+
+#define unpack_arg(__p, __type)				\
+	({						\
+		__type __v;				\
+		memcpy(&__v, __p, sizeof(__v));		\
+		(__p) += sizeof(__v);			\
+		__v;					\
+	})
+
+/*
+ * Store the raw values of the arguments @format refers to into
+ * @data. Returns the number of bytes used, or -1 if the format is
+ * not supported in deferred mode, or the values would not fit.
+ */
+static int pack_args(char *data, int room, const char *format, va_list args)
+{
+	char *p = data, *end = data + room;
+	struct print_spec spec;
+	const char *s;
+	int prec, n;
+
+	if (room <= 0)
+		return -1;
+
+	while ((format = strchr(format, '%')) != NULL) {
+		format = parse_spec(format + 1, &spec);
+		if (spec.type == PRINT_ARG_BAD)
+			return -1;
+		if (spec.star_width)
+			pack_arg(p, end, int, va_arg(args, int));
+		prec = spec.prec;
+		if (spec.star_prec) {
+			prec = va_arg(args, int);
+			pack_arg(p, end, int, prec);
+		}
+		switch (spec.type) {
+		case PRINT_ARG_INT:
+			pack_arg(p, end, int, va_arg(args, int));
+			break;
+		case PRINT_ARG_LONG:
+			pack_arg(p, end, long, va_arg(args, long));
+			break;
+		case PRINT_ARG_LLONG:
+			pack_arg(p, end, long long, va_arg(args, long long));
+			break;
+		case PRINT_ARG_INTMAX:
+			pack_arg(p, end, intmax_t, va_arg(args, intmax_t));
+			break;
+		case PRINT_ARG_SIZE:
+			pack_arg(p, end, size_t, va_arg(args, size_t));
+			break;
+		case PRINT_ARG_PTRDIFF:
+			pack_arg(p, end, ptrdiff_t, va_arg(args, ptrdiff_t));
+			break;
+		case PRINT_ARG_DOUBLE:
+			pack_arg(p, end, double, va_arg(args, double));
+			break;
+		case PRINT_ARG_LDOUBLE:
+			pack_arg(p, end, long double, va_arg(args, long double));
+			break;
+		case PRINT_ARG_PTR:
+			pack_arg(p, end, void *, va_arg(args, void *));
+			break;
+		case PRINT_ARG_STR:
+			/*
+			 * The string may not outlive the call, so copy
+			 * it, honoring the precision which may bound a
+			 * non-terminated one.
+			 */
+			s = va_arg(args, const char *);
+			if (s == NULL) {
+				pack_arg(p, end, int, -1);
+				break;
+			}
+			n = prec >= 0 ? strnlen(s, prec) : strlen(s);
+			pack_arg(p, end, int, n);
+			if (p + n > end)
+				return -1;
+			memcpy(p, s, n);
+			p += n;
+			break;
+		case PRINT_ARG_ERRNO:
+			pack_arg(p, end, int, errno);
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* An empty entry would denote a wrap-around. */
+	if (p == data)
+		*p++ = '\0';
+
+	return p - data;
+}
+
+static void line_printf(struct print_line *line, const char *fmt, ...)
+{
+	size_t room, size;
+	va_list args;
+	char *buf;
+	int n;
+
+	for (;;) {
+		room = line->size - line->len;
+		va_start(args, fmt);
+		n = vsnprintf(line->buf + line->len, room, fmt, args);
+		va_end(args);
+		if (n < 0)
+			return;
+		if (n < room) {
+			line->len += n;
+			return;
+		}
+		size = line->size ? line->size * 2 : RT_PRINT_LINE_BREAK;
+		while (size - line->len <= n)
+			size *= 2;
+		buf = realloc(line->buf, size);
+		if (buf == NULL)
+			return;
+		line->buf = buf;
+		line->size = size;
+	}
+}
+
+#define format_arg(__line, __spec, __w, __pr, __val)			\
+	do {								\
+		if ((__spec)->star_width && (__spec)->star_prec)	\
+			line_printf(__line, fmtbuf, __w, __pr, __val);	\
+		else if ((__spec)->star_width)				\
+			line_printf(__line, fmtbuf, __w, __val);	\
+		else if ((__spec)->star_prec)				\
+			line_printf(__line, fmtbuf, __pr, __val);	\
+		else							\
+			line_printf(__line, fmtbuf, __val);		\
+	} while (0)
+
+/* Render a deferred entry, from the printer thread. */
+static void format_entry(struct entry_head *head, struct print_line *line)
+{
+	const char *format = head->format, *p = head->data, *s;
+	char fmtbuf[PRINT_SPEC_MAX], *str;
+	int width = 0, prec = 0, n;
+	struct print_spec spec;
+
+	line->len = 0;
+	if (line->buf)
+		line->buf[0] = '\0';
+
+	while (*format) {
+		s = strchr(format, '%');
+		if (s == NULL)
+			s = format + strlen(format);
+		if (s > format)
+			line_printf(line, "%.*s", (int)(s - format), format);
+		if (*s == '\0')
+			break;
+
+		format = parse_spec(s + 1, &spec);
+		memcpy(fmtbuf, spec.start, spec.end - spec.start);
+		fmtbuf[spec.end - spec.start] = '\0';
+
+		if (spec.star_width)
+			width = unpack_arg(p, int);
+		if (spec.star_prec)
+			prec = unpack_arg(p, int);
+
+		switch (spec.type) {
+		case PRINT_ARG_NONE:
+			line_printf(line, "%%");
+			break;
+		case PRINT_ARG_INT:
+			format_arg(line, &spec, width, prec, unpack_arg(p, int));
+			break;
+		case PRINT_ARG_LONG:
+			format_arg(line, &spec, width, prec, unpack_arg(p, long));
+			break;
+		case PRINT_ARG_LLONG:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, long long));
+			break;
+		case PRINT_ARG_INTMAX:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, intmax_t));
+			break;
+		case PRINT_ARG_SIZE:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, size_t));
+			break;
+		case PRINT_ARG_PTRDIFF:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, ptrdiff_t));
+			break;
+		case PRINT_ARG_DOUBLE:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, double));
+			break;
+		case PRINT_ARG_LDOUBLE:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, long double));
+			break;
+		case PRINT_ARG_PTR:
+			format_arg(line, &spec, width, prec,
+				   unpack_arg(p, void *));
+			break;
+		case PRINT_ARG_STR:
+			n = unpack_arg(p, int);
+			if (n < 0) {
+				format_arg(line, &spec, width, prec,
+					   (const char *)NULL);
+				break;
+			}
+			str = strndup(p, n);
+			p += n;
+			if (str) {
+				format_arg(line, &spec, width, prec, str);
+				free(str);
+			}
+			break;
+		case PRINT_ARG_ERRNO:
+			errno = unpack_arg(p, int);
+			format_arg(line, &spec, width, prec, 0);
+			break;
+		default:
+			/* Cannot happen, the format was checked. */
+			return;
+		}
+	}
+}
+
 /* *** rt_print API *** */
 
 static int 
@@ -99,7 +507,9 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 {
 	struct print_buffer *buffer = pthread_getspecific(buffer_key);
 	off_t write_pos, read_pos;
+	const char *deferred_format = NULL;
 	struct entry_head *head;
+	va_list deferred_args;
 	int len, str_len;
 	int res = 0;
 
@@ -149,6 +559,20 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 
 	head = buffer->ring + write_pos;
 
+	if (mode == RT_PRINT_MODE_FORMAT && __cobalt_print_deferred &&
+	    fortify_level == 0) {
+		va_copy(deferred_args, args);
+		res = pack_args(head->data, len, format, deferred_args);
+		va_end(deferred_args);
+		if (res > 0) {
+			/* The output length is unknown at this point. */
+			deferred_format = format;
+			len = res;
+			res = 0;
+			goto finalize;
+		}
+	}
+
 	if (mode == RT_PRINT_MODE_FORMAT) {
 		if (stream != RT_PRINT_SYSLOG_STREAM) {
 			/* We do not need the terminating \0 */
@@ -199,12 +623,13 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 		memcpy(head->data, format, len);
 	} else
 		len = 0;
-
+finalize:
 	/* If we were able to write some text, finalise the entry */
 	if (len > 0) {
 		head->seq_no = ++seq_no;
 		head->priority = priority;
 		head->dest = stream;
+		head->format = deferred_format;
 		head->len = len;
 
 		/* Move forward by text and head length */
@@ -577,6 +1002,7 @@ static struct print_buffer *get_next_buffer(void)
 
 static void print_buffers(void)
 {
+	static struct print_line line;
 	struct print_buffer *buffer;
 	struct entry_head *head;
 	off_t read_pos;
@@ -591,7 +1017,21 @@ static void print_buffers(void)
 		head = buffer->ring + read_pos;
 		len = head->len;
 
-		if (len) {
+		if (len && head->format) {
+			/* Format a deferred entry and proceed */
+			format_entry(head, &line);
+			if (head->dest == RT_PRINT_SYSLOG_STREAM) {
+				if (line.buf)
+					syslog(head->priority,
+					       "%s", line.buf);
+			} else if (line.len) {
+				ret = fwrite(line.buf,
+					     line.len, 1, head->dest);
+				(void)ret;
+			}
+
+			read_pos += sizeof(*head) + len;
+		} else if (len) {
 			/* Print out non-empty entry and proceed */
 			/* Check if output goes to syslog */
 			if (head->dest == RT_PRINT_SYSLOG_STREAM) {
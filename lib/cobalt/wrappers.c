@@ -26,6 +26,7 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <sys/mman.h>
@@ -255,6 +256,20 @@ ssize_t __real_sendmsg(int fd, const struct msghdr * msg, int flags)
 	return sendmsg(fd, msg, flags);
 }
 
+__weak
+int __real_recvmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen,
+		    int flags, struct timespec *timeout)
+{
+	return recvmmsg(fd, msgvec, vlen, flags, timeout);
+}
+
+__weak
+int __real_sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen,
+		    int flags)
+{
+	return sendmmsg(fd, msgvec, vlen, flags);
+}
+
 __weak
 ssize_t __real_recvfrom(int fd, void *buf, size_t len, int flags,
 			struct sockaddr * from, socklen_t * fromlen)
@@ -346,6 +361,19 @@ int __real_select (int __nfds, fd_set *__restrict __readfds,
 	return select(__nfds, __readfds, __writefds, __exceptfds, __timeout);
 }
 
+__weak
+int __real_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+	return epoll_ctl(epfd, op, fd, event);
+}
+
+__weak
+int __real_epoll_wait(int epfd, struct epoll_event *events,
+		      int maxevents, int timeout)
+{
+	return epoll_wait(epfd, events, maxevents, timeout);
+}
+
 __weak
 void *__real_mmap(void *addr, size_t length, int prot, int flags,
 		  int fd, off_t offset)
@@ -41,6 +41,7 @@
 #include "boilerplate/hash.h"
 #include "boilerplate/lock.h"
 #include "copperplate/heapobj.h"
+#include "copperplate/threadobj.h"
 #include "copperplate/debug.h"
 #include "xenomai/init.h"
 #include "internal.h"
@@ -175,7 +176,7 @@ static int init_heap(struct shared_heap *heap, void *base,
 {
 	struct shared_extent *extent;
 	pthread_mutexattr_t mattr;
-	int ret, bmapwords;
+	int ret, bmapwords, n;
 	memoff_t bmapoff;
 	size_t metasz;
 
@@ -191,12 +192,19 @@ static int init_heap(struct shared_heap *heap, void *base,
 	pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
 	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
 	ret = __bt(-__RT(pthread_mutex_init(&heap->lock, &mattr)));
+	for (n = 0; ret == 0 && n < HOBJ_NRMAGS; n++)
+		ret = __bt(-__RT(pthread_mutex_init(&heap->mags[n].lock, &mattr)));
 	pthread_mutexattr_destroy(&mattr);
 	if (ret)
 		return ret;
 
 	memset(heap->buckets, 0, sizeof(heap->buckets));
 
+	for (n = 0; n < HOBJ_NRMAGS; n++)
+		memset(heap->mags[n].classes, 0, sizeof(heap->mags[n].classes));
+
+	atomic_set(&heap->cbytes, 0);
+
 	/*
 	 * The heap descriptor is followed in memory by the initial
 	 * extent covering the 'size' bytes of user memory, which is a
@@ -351,11 +359,12 @@ splitpage:
 	 * pstart is the starting page number of a range of contiguous
 	 * free pages larger or equal than 'bsize'.
 	 */
-	if (bsize < HOBJ_PAGE_SIZE) {
+	if (bsize <= HOBJ_PAGE_SIZE) {
 		/*
-		 * If the allocation size is smaller than the internal
-		 * page size, split the page in smaller blocks of this
-		 * size, building a free list of bucketed free blocks.
+		 * If the allocation size is not larger than the
+		 * internal page size, split the page in blocks of
+		 * this size, building a free list of bucketed free
+		 * blocks.
 		 */
 		for (block = get_page_addr(base, extent, pstart),
 		     eblock = block + HOBJ_PAGE_SIZE - bsize;
@@ -402,12 +411,212 @@ align_alloc_size(size_t size)
 	return __align_to(size, HOBJ_MINALIGNSZ);
 }
 
-static void *alloc_block(struct shared_heap *heap, size_t size)
+static caddr_t get_free_block(struct shared_heap *heap, int log2size)
 {
 	struct shared_extent *extent;
 	void *base = main_base;
 	size_t pgnum, bsize;
-	int log2size, ilog;
+	caddr_t block;
+	int ilog;
+
+	/* That is the actual block size we need. */
+	bsize = 1 << log2size;
+	ilog = log2size - HOBJ_MINLOG2;
+	assert(ilog < HOBJ_NBUCKETS);
+
+	block = __shref_check(base, heap->buckets[ilog].freelist);
+	if (block == NULL) {
+		block = get_free_range(heap, bsize, log2size);
+		if (block == NULL)
+			return NULL;
+		if (bsize <= HOBJ_PAGE_SIZE)
+			heap->buckets[ilog].fcount += (HOBJ_PAGE_SIZE >> log2size) - 1;
+		else
+			/* Multi-page blocks are never listed. */
+			*((memoff_t *)block) = 0;
+	} else {
+		if (bsize <= HOBJ_PAGE_SIZE)
+			--heap->buckets[ilog].fcount;
+
+		/* Search for the source extent of block. */
+		__list_for_each_entry(base, extent, &heap->extents, link) {
+			if (__shoff(base, block) >= extent->membase &&
+			    __shoff(base, block) < extent->memlim)
+				goto found;
+		}
+		assert(0);
+	found:
+		pgnum = (__shoff(base, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
+		++extent->pagemap[pgnum].bcount;
+	}
+
+	heap->buckets[ilog].freelist = *((memoff_t *)block);
+	heap->ubytes += bsize;
+
+	return block;
+}
+
+static void *get_block(struct shared_heap *heap, size_t size, int log2size)
+{
+	caddr_t block;
+
+	write_lock_nocancel(&heap->lock);
+
+	if (log2size)
+		block = get_free_block(heap, log2size);
+	else {
+		/* Directly request a free page range. */
+		block = get_free_range(heap, size, 0);
+		if (block)
+			heap->ubytes += size;
+	}
+
+	write_unlock(&heap->lock);
+
+	return block;
+}
+
+static int release_block(struct shared_heap *heap, void *block);
+
+/*
+ * Pick the magazine of the current thread. Threads are spread over
+ * the magazines according to their control block, which lives in
+ * the main heap, so that threads from different processes do not
+ * pile up on the same one. Threads unknown to copperplate go to the
+ * heap directly.
+ */
+static struct shared_magazine *get_magazine(struct shared_heap *heap)
+{
+	struct threadobj *current = threadobj_current();
+	unsigned int h;
+
+	if (current == NULL)
+		return NULL;
+
+	h = (__shoff(main_base, current) >> HOBJ_PAGE_SHIFT) * 2654435761U;
+
+	return heap->mags + ((h >> 16) & (HOBJ_NRMAGS - 1));
+}
+
+static void *cache_alloc(struct shared_heap *heap, int log2size)
+{
+	int ilog = log2size - HOBJ_MINLOG2, n;
+	struct shared_magazine *mag;
+	void *base = main_base;
+	caddr_t block = NULL;
+
+	mag = get_magazine(heap);
+	if (mag == NULL || write_trylock_nocancel(&mag->lock))
+		return NULL;
+
+	n = mag->classes[ilog].count;
+	if (n == 0) {
+		/* Refill half of the magazine in a single pass. */
+		write_lock_nocancel(&heap->lock);
+		while (n < HOBJ_MAGSZ / 2) {
+			block = get_free_block(heap, log2size);
+			if (block == NULL)
+				break;
+			mag->classes[ilog].blocks[n++] = __shoff(base, block);
+		}
+		write_unlock(&heap->lock);
+		atomic_add_fetch(&heap->cbytes, n << log2size);
+	}
+
+	if (n > 0) {
+		block = __shref(base, mag->classes[ilog].blocks[--n]);
+		atomic_sub_fetch(&heap->cbytes, 1 << log2size);
+	}
+
+	mag->classes[ilog].count = n;
+	write_unlock(&mag->lock);
+
+	return block;
+}
+
+static int cache_free(struct shared_heap *heap, void *block)
+{
+	struct shared_extent *extent;
+	struct shared_magazine *mag;
+	int log2size, ilog, n, half;
+	void *base = main_base;
+	memoff_t boff, pgoff;
+
+	mag = get_magazine(heap);
+	if (mag == NULL)
+		return -EAGAIN;
+
+	/*
+	 * Only blocks from the initial extent are cached, since this
+	 * one is never unlinked from the heap. The page map entry of
+	 * a busy block cannot change, so we can figure out its size
+	 * class without holding the heap lock. Anything which does
+	 * not look like a bucketed block is left to release_block()
+	 * for validation.
+	 */
+	extent = __list_first_entry(base, &heap->extents,
+				    struct shared_extent, link);
+	boff = __shoff(base, block);
+	if (boff < extent->membase || boff >= extent->memlim)
+		return -EAGAIN;
+
+	pgoff = boff - extent->membase;
+	log2size = extent->pagemap[pgoff >> HOBJ_PAGE_SHIFT].type;
+	if (log2size < HOBJ_MINLOG2 || log2size > HOBJ_PAGE_SHIFT ||
+	    (pgoff & ((1 << log2size) - 1)) != 0)
+		return -EAGAIN;
+
+	if (write_trylock_nocancel(&mag->lock))
+		return -EAGAIN;
+
+	ilog = log2size - HOBJ_MINLOG2;
+	n = mag->classes[ilog].count;
+	if (n == HOBJ_MAGSZ) {
+		/* Drain the oldest half of the magazine to the heap. */
+		half = HOBJ_MAGSZ / 2;
+		atomic_sub_fetch(&heap->cbytes, half << log2size);
+		write_lock_nocancel(&heap->lock);
+		for (n = 0; n < half; n++)
+			release_block(heap, __shref(base, mag->classes[ilog].blocks[n]));
+		write_unlock(&heap->lock);
+		memmove(mag->classes[ilog].blocks,
+			mag->classes[ilog].blocks + half,
+			(HOBJ_MAGSZ - half) * sizeof(memoff_t));
+		n = HOBJ_MAGSZ - half;
+	}
+
+	mag->classes[ilog].blocks[n++] = boff;
+	mag->classes[ilog].count = n;
+	atomic_add_fetch(&heap->cbytes, 1 << log2size);
+	write_unlock(&mag->lock);
+
+	return 0;
+}
+
+static void flush_magazines(struct shared_heap *heap)
+{
+	struct shared_magazine *mag;
+	void *base = main_base;
+	int ilog, n;
+
+	for (mag = heap->mags; mag < heap->mags + HOBJ_NRMAGS; mag++) {
+		write_lock_nocancel(&mag->lock);
+		write_lock_nocancel(&heap->lock);
+		for (ilog = 0; ilog < HOBJ_NBUCKETS - 1; ilog++) {
+			n = mag->classes[ilog].count;
+			atomic_sub_fetch(&heap->cbytes, n << (ilog + HOBJ_MINLOG2));
+			while (n > 0)
+				release_block(heap, __shref(base, mag->classes[ilog].blocks[--n]));
+			mag->classes[ilog].count = 0;
+		}
+		write_unlock(&heap->lock);
+		write_unlock(&mag->lock);
+	}
+}
+
+static void *alloc_block(struct shared_heap *heap, size_t size)
+{
+	int log2size = 0;
 	caddr_t block;
 
 	if (size == 0)
@@ -418,63 +627,33 @@ static void *alloc_block(struct shared_heap *heap, size_t size)
 	 * It becomes more space efficient to directly allocate pages
 	 * from the free page pool whenever the requested size is
 	 * greater than 2 times the page size. Otherwise, use the
-	 * bucketed memory blocks.
+	 * bucketed memory blocks, which are cached in magazines up
+	 * to the page size.
 	 */
 	if (size <= HOBJ_PAGE_SIZE * 2) {
 		/* Find log2(size). */
 		log2size = sizeof(size) * 8 - 1 - clz(size);
 		if (size & (size - 1))
 			log2size++;
-		/* That is the actual block size we need. */
-		bsize = 1 << log2size;
-		ilog = log2size - HOBJ_MINLOG2;
-		assert(ilog < HOBJ_NBUCKETS);
-
-		write_lock_nocancel(&heap->lock);
-
-		block = __shref_check(base, heap->buckets[ilog].freelist);
-		if (block == NULL) {
-			block = get_free_range(heap, bsize, log2size);
-			if (block == NULL)
-				goto done;
-			if (bsize <= HOBJ_PAGE_SIZE)
-				heap->buckets[ilog].fcount += (HOBJ_PAGE_SIZE >> log2size) - 1;
-		} else {
-			if (bsize <= HOBJ_PAGE_SIZE)
-				--heap->buckets[ilog].fcount;
-
-			/* Search for the source extent of block. */
-			__list_for_each_entry(base, extent, &heap->extents, link) {
-				if (__shoff(base, block) >= extent->membase &&
-				    __shoff(base, block) < extent->memlim)
-					goto found;
-			}
-			assert(0);
-		found:
-			pgnum = (__shoff(base, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
-			++extent->pagemap[pgnum].bcount;
+		if (log2size <= HOBJ_PAGE_SHIFT) {
+			block = cache_alloc(heap, log2size);
+			if (block)
+				return block;
 		}
+	} else if (size > heap->maxcont)
+		return NULL;
 
-		heap->buckets[ilog].freelist = *((memoff_t *)block);
-		heap->ubytes += bsize;
-	} else {
-		if (size > heap->maxcont)
-			return NULL;
-
-		write_lock_nocancel(&heap->lock);
-
-		/* Directly request a free page range. */
-		block = get_free_range(heap, size, 0);
-		if (block)
-			heap->ubytes += size;
+	block = get_block(heap, size, log2size);
+	if (block == NULL && atomic_read(&heap->cbytes) > 0) {
+		/* Cached blocks may be pinning the memory we need. */
+		flush_magazines(heap);
+		block = get_block(heap, size, log2size);
 	}
-done:
-	write_unlock(&heap->lock);
 
 	return block;
 }
 
-static int free_block(struct shared_heap *heap, void *block)
+static int release_block(struct shared_heap *heap, void *block)
 {
 	int log2size, ret = 0, nblocks, xpage, ilog, pagenr,
 		maxpages, pghead, pgtail, n;
@@ -485,8 +664,6 @@ static int free_block(struct shared_heap *heap, void *block)
 	uint32_t *bitmap;
 	size_t bsize;
 
-	write_lock_nocancel(&heap->lock);
-
 	/*
 	 * Find the extent from which the returned block is
 	 * originating from.
@@ -627,9 +804,21 @@ found:
 
 	heap->ubytes -= bsize;
 out:
+	return __bt(ret);
+}
+
+static int free_block(struct shared_heap *heap, void *block)
+{
+	int ret;
+
+	if (cache_free(heap, block) == 0)
+		return 0;
+
+	write_lock_nocancel(&heap->lock);
+	ret = release_block(heap, block);
 	write_unlock(&heap->lock);
 
-	return __bt(ret);
+	return ret;
 }
 
 static size_t check_block(struct shared_heap *heap, void *block)
@@ -1000,13 +1189,22 @@ int heapobj_init_array(struct heapobj *hobj, const char *name,
 	return __bt(heapobj_init(hobj, name, size * elems));
 }
 
+static void destroy_heap_locks(struct shared_heap *heap)
+{
+	int n;
+
+	__RT(pthread_mutex_destroy(&heap->lock));
+	for (n = 0; n < HOBJ_NRMAGS; n++)
+		__RT(pthread_mutex_destroy(&heap->mags[n].lock));
+}
+
 void heapobj_destroy(struct heapobj *hobj)
 {
 	struct shared_heap *heap = __mptr(hobj->pool_ref);
 	int cpid;
 
 	if (hobj != &main_pool) {
-		__RT(pthread_mutex_destroy(&heap->lock));
+		destroy_heap_locks(heap);
 		sysgroup_remove(heap, &heap->memspec);
 		free_block(&main_heap.heap, heap);
 		return;
@@ -1019,7 +1217,7 @@ void heapobj_destroy(struct heapobj *hobj)
 		return;
 	}
 	
-	__RT(pthread_mutex_destroy(&heap->lock));
+	destroy_heap_locks(heap);
 	__RT(pthread_mutex_destroy(&main_heap.sysgroup.lock));
 	munmap(&main_heap, main_heap.maplen);
 	shm_unlink(hobj->fsname);
@@ -1076,7 +1274,9 @@ size_t heapobj_validate(struct heapobj *hobj, void *ptr)
 size_t heapobj_inquire(struct heapobj *hobj)
 {
 	struct shared_heap *heap = __mptr(hobj->pool_ref);
-	return heap->ubytes;
+
+	/* Blocks cached in magazines are not in use. */
+	return heap->ubytes - atomic_read(&heap->cbytes);
 }
 
 void *xnmalloc(size_t size)
@@ -25,6 +25,7 @@
 #include <semaphore.h>
 #include <xeno_config.h>
 #include <boilerplate/list.h>
+#include <boilerplate/atomic.h>
 #include <boilerplate/ancillaries.h>
 #include <boilerplate/limits.h>
 #include <boilerplate/sched.h>
@@ -54,6 +55,25 @@
 
 #define HOBJ_MAXEXTSZ   (1U << 31) /* 2Gb */
 
+/*
+ * Free blocks of bucketed sizes are cached in magazines, so that
+ * most allocation requests do not contend on the heap lock. Threads
+ * are spread over HOBJ_NRMAGS magazines (power of 2), each holding
+ * up to HOBJ_MAGSZ blocks per size class, refilled from or drained
+ * to the heap by halves.
+ */
+#define HOBJ_NRMAGS	4
+#define HOBJ_MAGSZ	8
+
+struct shared_magazine {
+	pthread_mutex_t lock;
+	/* Sizes up to HOBJ_PAGE_SIZE, multi-page blocks are not cached. */
+	struct {
+		int count;
+		memoff_t blocks[HOBJ_MAGSZ];
+	} classes[HOBJ_NBUCKETS - 1];
+};
+
 /*
  * The struct below has to live in shared memory; no direct reference
  * to process local memory in there.
@@ -70,6 +90,9 @@ struct shared_heap {
 		memoff_t freelist;
 		int fcount;
 	} buckets[HOBJ_NBUCKETS];
+	/* Bytes held in magazines, counted in ubytes. */
+	atomic_t cbytes;
+	struct shared_magazine mags[HOBJ_NRMAGS];
 };
 
 struct corethread_attributes {
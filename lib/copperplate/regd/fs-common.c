@@ -205,6 +205,7 @@ struct heap_data {
 	char name[XNOBJECT_NAME_LEN];
 	size_t total;
 	size_t used;
+	size_t cached;
 };
 
 int open_heaps(struct fsobj *fsobj, void *priv)
@@ -246,7 +247,8 @@ int open_heaps(struct fsobj *fsobj, void *priv)
 			break;
 		heap = container_of(obj, struct shared_heap, memspec);
 		namecpy(p->name, heap->name);
-		p->used = heap->ubytes;
+		p->cached = atomic_read(&heap->cbytes);
+		p->used = heap->ubytes - p->cached;
 		p->total = heap->total;
 		p++;
 	}
@@ -257,12 +259,13 @@ int open_heaps(struct fsobj *fsobj, void *priv)
 	if (count == 0)
 		goto out_free;
 
-	len = fsobstack_grow_format(o, "%9s %9s  %s\n",
-				    "TOTAL", "USED", "NAME");
+	len = fsobstack_grow_format(o, "%9s %9s %9s  %s\n",
+				    "TOTAL", "USED", "CACHED", "NAME");
 
 	for (p = heap_data; count > 0; count--) {
-		len += fsobstack_grow_format(o, "%9Zu %9Zu  %s\n",
-					     p->total, p->used, p->name);
+		len += fsobstack_grow_format(o, "%9Zu %9Zu %9Zu  %s\n",
+					     p->total, p->used, p->cached,
+					     p->name);
 		p++;
 	}
 
@@ -66,6 +66,7 @@ struct regfs_data {
 	pthread_mutex_t lock;
 	struct pvhash_table files;
 	struct pvhash_table dirs;
+	struct fsobj dump;
 };
 
 static inline struct regfs_data *regfs_get_context(void)
@@ -170,6 +171,10 @@ int registry_init_file(struct fsobj *fsobj,
 	fsobj->path = NULL;
 	fsobj->ops = ops;
 	fsobj->privsz = privsz;
+	fsobj->version = 0;
+	fsobj->sobj = NULL;
+	fsobj->cached = 0;
+	fsobj->cache.data = NULL;
 	pvholder_init(&fsobj->link);
 
 	pthread_mutexattr_init(&mattr);
@@ -263,6 +268,8 @@ void registry_destroy_file(struct fsobj *fsobj)
 	d->nfiles--;
 	assert(d->nfiles >= 0);
 	pvfree(fsobj->path);
+	if (fsobj->cache.data)
+		pvfree(fsobj->cache.data);
 	__RT(pthread_mutex_unlock(&fsobj->lock));
 out:
 	__RT(pthread_mutex_destroy(&fsobj->lock));
@@ -373,6 +380,193 @@ static int regfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 	return 0;
 }
 
+/*
+ * Called with the file lock held, which serializes updates to the
+ * cached snapshot.
+ */
+static int open_file(struct fsobj *fsobj, void *priv)
+{
+	struct fsobstack *o = priv;
+	unsigned long version;
+	int ret;
+
+	if (!fsobj->cached)
+		return fsobj->ops->open(fsobj, priv);
+
+	/*
+	 * Sample the version before the snapshot is built, so that
+	 * updates racing with ->open() invalidate it. Waiters leaving
+	 * upon cancellation do not go through registry_bump_file(),
+	 * account for them separately.
+	 */
+	version = ACCESS_ONCE(fsobj->version);
+	if (fsobj->sobj)
+		version += ACCESS_ONCE(fsobj->sobj->cancel_count);
+	smp_rmb();
+
+	if (fsobj->cache.data && fsobj->cache.version == version) {
+		fsobstack_init(o);
+		obstack_grow(&o->obstack, fsobj->cache.data, fsobj->cache.len);
+		fsobstack_finish(o);
+		return 0;
+	}
+
+	ret = fsobj->ops->open(fsobj, priv);
+	if (ret)
+		return ret;
+
+	if (fsobj->cache.data)
+		pvfree(fsobj->cache.data);
+
+	/* Failing to cache the snapshot is not an error. */
+	fsobj->cache.data = o->len ? pvmalloc(o->len) : NULL;
+	if (fsobj->cache.data) {
+		memcpy(fsobj->cache.data, o->data, o->len);
+		fsobj->cache.len = o->len;
+		fsobj->cache.version = version;
+	}
+
+	return 0;
+}
+
+/*
+ * Collect the paths of all readable files below @d into @paths, as
+ * consecutive null-terminated strings. Called with the registry lock
+ * held.
+ */
+static int dump_collect(struct obstack *paths, struct regfs_dir *d)
+{
+	struct regfs_data *p = regfs_get_context();
+	struct regfs_dir *subd;
+	struct fsobj *fsobj;
+	int nfiles = 0;
+
+	if (!pvlist_empty(&d->file_list)) {
+		pvlist_for_each_entry(fsobj, &d->file_list, link) {
+			if (fsobj == &p->dump || fsobj->mode == O_WRONLY ||
+			    fsobj->ops->read == NULL)
+				continue;
+			obstack_grow0(paths, fsobj->path, strlen(fsobj->path));
+			nfiles++;
+		}
+	}
+
+	if (!pvlist_empty(&d->dir_list)) {
+		pvlist_for_each_entry(subd, &d->dir_list, link)
+			nfiles += dump_collect(paths, subd);
+	}
+
+	return nfiles;
+}
+
+static void dump_file(struct fsobstack *o, const char *path)
+{
+	struct regfs_data *p = regfs_get_context();
+	struct pvhashobj *hobj;
+	struct fsobj *fsobj;
+	char buf[256];
+	void *priv;
+	off_t off;
+	ssize_t n;
+
+	read_lock_nocancel(&p->lock);
+
+	/* The file may have been deleted since the paths were collected. */
+	hobj = pvhash_search(&p->files, path, strlen(path),
+			     &pvhash_operations);
+	if (hobj == NULL) {
+		read_unlock(&p->lock);
+		return;
+	}
+
+	/*
+	 * Holding the file lock keeps the file from being destroyed
+	 * once the registry lock is dropped, like regfs_read() does.
+	 */
+	fsobj = container_of(hobj, struct fsobj, hobj);
+	read_lock_nocancel(&fsobj->lock);
+	read_unlock(&p->lock);
+
+	if (fsobj->privsz) {
+		priv = __STD(malloc(fsobj->privsz));
+		if (priv == NULL)
+			goto out;
+	} else
+		priv = NULL;
+
+	if (fsobj->ops->open && open_file(fsobj, priv))
+		goto out_free;
+
+	fsobstack_grow_format(o, "==> %s <==\n", fsobj->path);
+
+	for (off = 0;; off += n) {
+		n = fsobj->ops->read(fsobj, buf, sizeof(buf), off, priv);
+		if (n <= 0)
+			break;
+		obstack_grow(&o->obstack, buf, n);
+	}
+
+	if (fsobj->ops->release)
+		fsobj->ops->release(fsobj, priv);
+out_free:
+	if (priv)
+		__STD(free(priv));
+out:
+	read_unlock(&fsobj->lock);
+}
+
+/*
+ * The dump file concatenates the contents of all readable files,
+ * each preceded by a header line giving its path. The registry lock
+ * is only held for collecting the file paths, so that adding and
+ * removing files is not delayed by the dump. Files are then read
+ * one at a time the same way regfs_read() does, so that cached
+ * snapshots are reused and only the objects which changed since the
+ * previous read have to be locked. The contents of every file are
+ * copied into the dump nevertheless.
+ *
+ * Called from regfs_open(), without the registry lock held.
+ */
+static int dump_open(struct fsobj *fsobj, void *priv)
+{
+	struct regfs_data *p = regfs_get_context();
+	struct fsobstack *o = priv;
+	struct pvhashobj *hobj;
+	struct obstack paths;
+	int nfiles = 0;
+	char *path;
+
+	obstack_init(&paths);
+
+	read_lock_nocancel(&p->lock);
+	hobj = pvhash_search(&p->dirs, "/", 1, &pvhash_operations);
+	if (hobj)
+		nfiles = dump_collect(&paths,
+				      container_of(hobj, struct regfs_dir, hobj));
+	read_unlock(&p->lock);
+
+	path = obstack_finish(&paths);
+
+	fsobstack_init(o);
+
+	while (nfiles-- > 0) {
+		dump_file(o, path);
+		path += strlen(path) + 1;
+	}
+
+	fsobstack_finish(o);
+
+	obstack_free(&paths, NULL);
+
+	return 0;
+}
+
+static struct registry_operations dump_ops = {
+	.open		= dump_open,
+	.release	= fsobj_obstack_release,
+	.read		= fsobj_obstack_read
+};
+
 static int regfs_open(const char *path, struct fuse_file_info *fi)
 {
 	struct regfs_data *p = regfs_get_context();
@@ -408,13 +602,30 @@ static int regfs_open(const char *path, struct fuse_file_info *fi)
 		priv = NULL;
 
 	fi->fh = (uintptr_t)priv;
+	if (fsobj == &p->dump) {
+		/*
+		 * The dump may be larger than the size getattr
+		 * reports. The static dump file cannot go away, so
+		 * the registry lock is released before building it.
+		 */
+		fi->direct_io = 1;
+		read_unlock(&p->lock);
+		CANCEL_DEFER(svc);
+		ret = __bt(dump_open(fsobj, priv));
+		CANCEL_RESTORE(svc);
+		goto out;
+	}
 	if (fsobj->ops->open) {
 		CANCEL_DEFER(svc);
-		ret = __bt(fsobj->ops->open(fsobj, priv));
+		/* Serializes updates to the cached snapshot with dumps. */
+		read_lock_nocancel(&fsobj->lock);
+		ret = __bt(open_file(fsobj, priv));
+		read_unlock(&fsobj->lock);
 		CANCEL_RESTORE(svc);
 	}
 done:
 	read_unlock(&p->lock);
+out:
 	pop_cleanup_lock(&p->lock);
 
 	return __bt(ret);
@@ -768,6 +979,8 @@ int __registry_pkg_init(const char *arg0, char *mountpt, int flags)
 	pvhash_init(&p->dirs);
 
 	registry_add_dir("/");	/* Create the fs root. */
+	registry_init_file_obstack(&p->dump, &dump_ops);
+	registry_add_file(&p->dump, O_RDONLY, "/dump");
 
 	/* We want a SCHED_OTHER thread. */
 	pthread_attr_init(&thattr);
@@ -238,6 +238,7 @@ int syncobj_init(struct syncobj *sobj, clockid_t clk_id, int flags,
 	sobj->grant_count = 0;
 	sobj->drain_count = 0;
 	sobj->wait_count = 0;
+	sobj->cancel_count = 0;
 	sobj->finalizer = finalizer;
 	sobj->magic = SYNCOBJ_MAGIC;
 
@@ -386,6 +387,11 @@ void __syncobj_cleanup_wait(struct syncobj *sobj, struct threadobj *thobj)
 	 * GRANT/DRAIN condition.
 	 */
 	dequeue_waiter(sobj, thobj);
+	/*
+	 * The owner of the object is not told about this waiter
+	 * leaving, leave a trace of it.
+	 */
+	sobj->cancel_count++;
 
 	if (--sobj->wait_count == 0 && sobj->magic != SYNCOBJ_MAGIC) {
 		__syncobj_finalize(sobj);
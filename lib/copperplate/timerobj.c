@@ -41,7 +41,20 @@ static pthread_t svthread;
 
 static pid_t svpid;
 
-static DEFINE_PRIVATE_LIST(svtimers);
+/*
+ * Outstanding timers are indexed by a hashed timing wheel. Each slot
+ * covers 2 ** TIMEROBJ_WHEEL_SHIFT nanoseconds of the copperplate
+ * clock, and links the timers due within that period modulo a full
+ * revolution of the wheel, in expiry order.
+ */
+#define TIMEROBJ_WHEEL_SHIFT	20	/* i.e. ~1ms per slot */
+#define TIMEROBJ_WHEEL_SIZE	256
+#define TIMEROBJ_WHEEL_MASK	(TIMEROBJ_WHEEL_SIZE - 1)
+
+static struct pvlistobj svwheel[TIMEROBJ_WHEEL_SIZE];
+
+/* Slot tick the server is scanning, or scanned last. */
+static ticks_t svtick;
 
 #ifdef CONFIG_XENO_COBALT
 
@@ -60,24 +73,31 @@ static inline void timersv_init_corespec(void)
 
 #endif /* CONFIG_XENO_MERCURY */
 
-/*
- * XXX: at some point, we may consider using a timer wheel instead of
- * a simple linked list to index timers. The latter method is
- * efficient for up to ten outstanding timers or so, which should be
- * enough for most applications. However, there exist poorly designed
- * apps involving dozens of active timers, particularly in the legacy
- * embedded world.
- */
+static inline ticks_t timerobj_tick(const struct timespec *ts)
+{
+	return (ticks_t)timespec_scalar(ts) >> TIMEROBJ_WHEEL_SHIFT;
+}
+
 static void timerobj_enqueue(struct timerobj *tmobj)
 {
 	struct timerobj *__tmobj;
+	struct pvlistobj *slot;
+	ticks_t tick;
 
-	if (pvlist_empty(&svtimers)) {
-		pvlist_append(&tmobj->next, &svtimers);
-		return;
-	}
+	/*
+	 * Timers which are already due go to the slot the server
+	 * will scan next, which has not been passed yet.
+	 */
+	tick = timerobj_tick(&tmobj->itspec.it_value);
+	if (tick < svtick)
+		tick = svtick;
 
-	pvlist_for_each_entry_reverse(__tmobj, &svtimers, next) {
+	/*
+	 * Timers spread over the wheel, so that the sorted insertion
+	 * only has to scan the few timers due within the same slot.
+	 */
+	slot = &svwheel[tick & TIMEROBJ_WHEEL_MASK];
+	pvlist_for_each_entry_reverse(__tmobj, slot, next) {
 		if (timespec_before_or_same(&__tmobj->itspec.it_value,
 					    &tmobj->itspec.it_value))
 			break;
@@ -86,6 +106,52 @@ static void timerobj_enqueue(struct timerobj *tmobj)
 	atpvh(&__tmobj->next, &tmobj->next);
 }
 
+static void timerobj_expire(const struct timespec *now) /* svlock held */
+{
+	struct timespec value, interval;
+	struct timerobj *tmobj;
+	struct pvlistobj *slot;
+	ticks_t tick, last;
+
+	/*
+	 * Scan the slots elapsed since the previous run, at most one
+	 * full revolution, including the last slot scanned which may
+	 * still hold timers due later within the same tick.
+	 */
+	last = timerobj_tick(now);
+	tick = svtick;
+	if (last - tick >= TIMEROBJ_WHEEL_SIZE)
+		tick = last - TIMEROBJ_WHEEL_SIZE + 1;
+
+	for (;;) {
+		svtick = tick;
+		slot = &svwheel[tick & TIMEROBJ_WHEEL_MASK];
+		/*
+		 * Handlers run unlocked and may alter the slot, so we
+		 * restart from its head after each of them.
+		 */
+		while (!pvlist_empty(slot)) {
+			tmobj = pvlist_first_entry(slot, struct timerobj, next);
+			value = tmobj->itspec.it_value;
+			if (timespec_after(&value, now))
+				break;
+			pvlist_remove_init(&tmobj->next);
+			interval = tmobj->itspec.it_interval;
+			if (interval.tv_sec > 0 || interval.tv_nsec > 0) {
+				timespec_add(&tmobj->itspec.it_value,
+					     &value, &interval);
+				timerobj_enqueue(tmobj);
+			}
+			write_unlock(&svlock);
+			tmobj->handler(tmobj);
+			write_lock_nocancel(&svlock);
+		}
+		if (tick == last)
+			break;
+		tick++;
+	}
+}
+
 static int server_prologue(void *arg)
 {
 	svpid = get_thread_pid();
@@ -98,8 +164,7 @@ static int server_prologue(void *arg)
 
 static void *timerobj_server(void *arg)
 {
-	struct timespec now, value, interval;
-	struct timerobj *tmobj, *tmp;
+	struct timespec now;
 	sigset_t set;
 	int sig, ret;
 
@@ -117,23 +182,7 @@ static void *timerobj_server(void *arg)
 		write_lock_nocancel(&svlock);
 
 		__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
-
-		pvlist_for_each_entry_safe(tmobj, tmp, &svtimers, next) {
-			value = tmobj->itspec.it_value;
-			if (timespec_after(&value, &now))
-				break;
-			pvlist_remove_init(&tmobj->next);
-			interval = tmobj->itspec.it_interval;
-			if (interval.tv_sec > 0 || interval.tv_nsec > 0) {
-				timespec_add(&tmobj->itspec.it_value,
-					     &value, &interval);
-				timerobj_enqueue(tmobj);
-			}
-			write_unlock(&svlock);
-			tmobj->handler(tmobj);
-			write_lock_nocancel(&svlock);
-		}
-
+		timerobj_expire(&now);
 		write_unlock(&svlock);
 	}
 
@@ -263,7 +312,14 @@ int timerobj_stop(struct timerobj *tmobj) /* lock held, dropped */
 int timerobj_pkg_init(void)
 {
 	pthread_mutexattr_t mattr;
-	int ret;
+	struct timespec now;
+	int ret, n;
+
+	for (n = 0; n < TIMEROBJ_WHEEL_SIZE; n++)
+		pvlist_init(&svwheel[n]);
+
+	__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
+	svtick = timerobj_tick(&now);
 
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
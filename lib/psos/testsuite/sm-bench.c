@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <copperplate/traceobj.h>
+#include <psos/psos.h>
+
+/*
+ * Measure the throughput of sm_ident() lookups by name, with a
+ * growing number of semaphores registered, from a growing number of
+ * concurrent tasks. The main heap must be large enough for the
+ * biggest set, e.g. --mem-pool-size=8M; the bench stops at the first
+ * set which cannot be created.
+ */
+
+#define LOOKUPS  100000
+#define MAX_TASKS  4
+
+static struct traceobj trobj;
+
+static int counts[] = { 100, 1000, 10000 };
+
+static u_long done_sem;
+
+static int nr_sems;
+
+static void make_name(char *name, int n)
+{
+	static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	int i;
+
+	for (i = 3; i >= 0; i--) {
+		name[i] = digits[n % 36];
+		n /= 36;
+	}
+
+	name[4] = '\0';
+}
+
+static void lookup_task(u_long seed, u_long a1, u_long a2, u_long a3)
+{
+	unsigned int rseed = seed;
+	char name[5];
+	u_long smid;
+	int n, ret;
+
+	for (n = 0; n < LOOKUPS; n++) {
+		make_name(name, rand_r(&rseed) % nr_sems);
+		ret = sm_ident(name, 0, &smid);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	ret = sm_v(done_sem);
+	traceobj_assert(&trobj, ret == SUCCESS);
+}
+
+static long long diff_ns(const struct timespec *t1,
+			 const struct timespec *t0)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+static void run_bench(int nr_tasks)
+{
+	u_long args[] = { 0, 0, 0, 0 }, tids[MAX_TASKS];
+	struct timespec t0, t1;
+	long long ns;
+	char name[5];
+	int n, ret;
+
+	/*
+	 * Lookup tasks have a lower priority than the root task, so
+	 * that they only start running once all of them are ready.
+	 */
+	for (n = 0; n < nr_tasks; n++) {
+		make_name(name, n);
+		name[0] = 'L';
+		ret = t_create(name, 40, 0, 0, 0, &tids[n]);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (n = 0; n < nr_tasks; n++) {
+		args[0] = n + 1;
+		ret = t_start(tids[n], 0, lookup_task, args);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	for (n = 0; n < nr_tasks; n++) {
+		ret = sm_p(done_sem, SM_WAIT, 0);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	ns = diff_ns(&t1, &t0);
+	printf("%5d semaphores, %d task(s): %9lld lookups/s\n",
+	       nr_sems, nr_tasks,
+	       (long long)nr_tasks * LOOKUPS * 1000000000LL / ns);
+}
+
+static void root_task(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	u_long *sems;
+	char name[5];
+	int n, c, t, ret;
+
+	traceobj_enter(&trobj);
+
+	ret = sm_create("DONE", 0, SM_FIFO, &done_sem);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	n = sizeof(counts) / sizeof(counts[0]);
+	sems = malloc(counts[n - 1] * sizeof(*sems));
+	traceobj_assert(&trobj, sems != NULL);
+
+	for (c = 0; c < n; c++) {
+		for (; nr_sems < counts[c]; nr_sems++) {
+			make_name(name, nr_sems);
+			ret = sm_create(name, 1, SM_FIFO, &sems[nr_sems]);
+			if (ret == ERR_NOSCB) {
+				printf("out of memory at %d semaphores, "
+				       "raise --mem-pool-size\n", nr_sems);
+				goto out;
+			}
+			traceobj_assert(&trobj, ret == SUCCESS);
+		}
+		for (t = 1; t <= MAX_TASKS; t *= 2)
+			run_bench(t);
+	}
+out:
+	for (n = 0; n < nr_sems; n++) {
+		ret = sm_delete(sems[n]);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	free(sems);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	u_long args[] = { 0, 0, 0, 0 }, tid;
+	int ret;
+
+	traceobj_init(&trobj, argv[0], 0);
+
+	ret = t_create("ROOT", 50, 0, 0, 0, &tid);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = t_start(tid, 0, root_task, args);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
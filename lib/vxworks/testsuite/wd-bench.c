@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <copperplate/traceobj.h>
+#include <vxworks/errnoLib.h>
+#include <vxworks/taskLib.h>
+#include <vxworks/wdLib.h>
+
+/*
+ * Measure the average cost of arming then cancelling a watchdog,
+ * with a growing number of outstanding watchdogs. Watchdogs are
+ * armed in random order with long delays, so that none of them
+ * fires during the measurement.
+ */
+
+#define ROUNDS  20
+
+static struct traceobj trobj;
+
+static int counts[] = { 10, 100, 1000 };
+
+static void watchdogHandler(long arg)
+{
+	traceobj_assert(&trobj, 0);
+}
+
+static long long diff_ns(const struct timespec *t1,
+			 const struct timespec *t0)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		t1->tv_nsec - t0->tv_nsec;
+}
+
+static void run_bench(int count)
+{
+	long long arm_ns = 0, cancel_ns = 0;
+	struct timespec t0, t1, t2;
+	WDOG_ID *wdogs;
+	int *delays;
+	int n, m, r, ret, tmp;
+
+	wdogs = malloc(count * sizeof(*wdogs));
+	delays = malloc(count * sizeof(*delays));
+	traceobj_assert(&trobj, wdogs && delays);
+
+	for (n = 0; n < count; n++) {
+		wdogs[n] = wdCreate();
+		traceobj_assert(&trobj, wdogs[n] != 0);
+		delays[n] = 10000 + n * 4;
+	}
+
+	for (r = 0; r < ROUNDS; r++) {
+		for (n = count - 1; n > 0; n--) {
+			m = rand() % (n + 1);
+			tmp = delays[n];
+			delays[n] = delays[m];
+			delays[m] = tmp;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+
+		for (n = 0; n < count; n++) {
+			ret = wdStart(wdogs[n], delays[n], watchdogHandler, n);
+			traceobj_assert(&trobj, ret == OK);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		for (n = 0; n < count; n++) {
+			ret = wdCancel(wdogs[n]);
+			traceobj_assert(&trobj, ret == OK);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+
+		arm_ns += diff_ns(&t1, &t0);
+		cancel_ns += diff_ns(&t2, &t1);
+	}
+
+	printf("%5d watchdogs: wdStart %7lld ns, wdCancel %7lld ns\n",
+	       count, arm_ns / (ROUNDS * count),
+	       cancel_ns / (ROUNDS * count));
+
+	for (n = 0; n < count; n++) {
+		ret = wdDelete(wdogs[n]);
+		traceobj_assert(&trobj, ret == OK);
+	}
+
+	free(delays);
+	free(wdogs);
+}
+
+static void rootTask(long arg, ...)
+{
+	int n;
+
+	traceobj_enter(&trobj);
+
+	for (n = 0; n < sizeof(counts) / sizeof(counts[0]); n++)
+		run_bench(counts[n]);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	TASK_ID tid;
+
+	traceobj_init(&trobj, argv[0], 0);
+
+	tid = taskSpawn("rootTask", 50, 0, 0, rootTask,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	traceobj_assert(&trobj, tid != ERROR);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
@@ -22,6 +22,8 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <stdlib.h>
+#include <stdint.h>
+#include <endian.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -89,16 +91,68 @@ int32_t *histogram_avg = NULL, *histogram_max = NULL, *histogram_min = NULL;
 char *do_gnuplot = NULL;
 int do_histogram = 0, do_stats = 0, finished = 0;
 int bucketsize = 1000;		/* default = 1000ns, -B <size> to override */
+int hdr_histogram = 0;		/* log-linear buckets, -L to enable */
+char *hdr_output = NULL;	/* -o <file> */
+int hdr_merge = 0;		/* -M <file>... */
 
-#define need_histo() (do_histogram || do_stats || do_gnuplot)
+#define need_histo() (do_histogram || do_stats || do_gnuplot || hdr_histogram)
+
+/*
+ * Mergeable HDR histogram data, as dumped by -o. Counts are kept on
+ * 64bit so that results from many runs may be aggregated.
+ */
+#define HDR_DUMP_MAGIC		"XENOHDR"
+#define HDR_DUMP_VERSION	1
+
+enum { HDR_MIN, HDR_AVG, HDR_MAX, HDR_KINDS };
+
+static const char *hdr_kinds[HDR_KINDS] = { "min", "avg", "max" };
+
+struct hdr_data {
+	uint32_t runs;
+	int32_t min;
+	int32_t max;
+	uint32_t overruns;
+	uint64_t counts[HDR_KINDS][RTTST_HDR_BUCKETS];
+} hdr_data;
 
 static inline void add_histogram(int32_t *histogram, int32_t addval)
 {
+	int inabs;
+
+	if (hdr_histogram) {
+		histogram[rttst_hdr_index(addval)]++;
+		return;
+	}
+
 	/* bucketsize steps */
-	int inabs = (addval >= 0 ? addval : -addval) / bucketsize;
+	inabs = (addval >= 0 ? addval : -addval) / bucketsize;
 	histogram[inabs < histogram_size ? inabs : histogram_size - 1]++;
 }
 
+/* Lowest value and width of bucket @n, in nanoseconds. */
+static inline double bucket_lowest(int n)
+{
+	return hdr_histogram ? rttst_hdr_lowest(n) : (double)n * bucketsize;
+}
+
+static inline double bucket_width(int n)
+{
+	return hdr_histogram ? rttst_hdr_width(n) : bucketsize;
+}
+
+/*
+ * Value used for averaging bucket @n: the bucket index in linear
+ * mode, the bucket midpoint in microseconds in log-linear mode.
+ */
+static inline double bucket_value(int n)
+{
+	if (!hdr_histogram)
+		return n;
+
+	return (bucket_lowest(n) + bucket_width(n) / 2) / 1000;
+}
+
 static inline long long diff_ts(struct timespec *left, struct timespec *right)
 {
 	return (long long)(left->tv_sec - right->tv_sec) * ONE_BILLION
@@ -259,6 +313,8 @@ static void *display(void *cookie)
 		config.warmup_loops = WARMUP_TIME;
 		config.histogram_size = need_histo() ? histogram_size : 0;
 		config.histogram_bucketsize = bucketsize;
+		config.histogram_type = hdr_histogram ?
+			RTTST_HISTOGRAM_HDR : RTTST_HISTOGRAM_LINEAR;
 		config.freeze_max = freeze_max;
 
 		err = ioctl(benchdev, RTTST_RTIOC_TMBENCH_START, &config);
@@ -359,8 +415,15 @@ static double dump_histogram(int32_t *histogram, char *kind)
 
 		if (hits) {
 			total_hits += hits;
-			avg += n * hits;
-			if (do_histogram)
+			avg += bucket_value(n) * hits;
+			if (!do_histogram)
+				continue;
+			if (hdr_histogram)
+				printf("HSD|    %s| %9.3f -%9.3f | %8d\n", kind,
+				       bucket_lowest(n) / 1000,
+				       (bucket_lowest(n) + bucket_width(n)) / 1000,
+				       hits);
+			else
 				printf("HSD|    %s| %3d -%3d | %8d\n",
 				       kind, n, n + 1, hits);
 		}
@@ -412,7 +475,7 @@ static void dump_histo_gnuplot(int32_t *histogram, time_t duration)
 		fputs(buf, ofp);
 	}
 
-	fclose(ifp);
+	pclose(ifp);
 
 dump_data:
 	for (n = 0; n < histogram_size && histogram[n] == 0; n++)
@@ -423,11 +486,13 @@ dump_data:
 		;
 	stop = n;
 
-	fprintf(ofp, "%g 1\n", start * bucketsize / 1000.0);
+	fprintf(ofp, "%g 1\n", bucket_lowest(start) / 1000.0);
 	for (n = start; n <= stop; n++)
 		fprintf(ofp, "%g %d\n",
-			(n + 0.5) * bucketsize / 1000.0, histogram[n] + 1);
-	fprintf(ofp, "%g 1\n", (stop + 1) * bucketsize / 1000.0);
+			(bucket_lowest(n) + bucket_width(n) / 2) / 1000.0,
+			histogram[n] + 1);
+	fprintf(ofp, "%g 1\n",
+		(bucket_lowest(stop) + bucket_width(stop)) / 1000.0);
 
 	if (ofp != stdout)
 		fclose(ofp);
@@ -443,7 +508,8 @@ static void dump_stats(int32_t *histogram, char *kind, double avg)
 
 		if (hits) {
 			total_hits += hits;
-			variance += hits * (n - avg) * (n - avg);
+			variance += hits * (bucket_value(n) - avg) *
+				(bucket_value(n) - avg);
 		}
 	}
 
@@ -458,6 +524,203 @@ static void dump_stats(int32_t *histogram, char *kind, double avg)
 	       kind, total_hits, avg, variance);
 }
 
+/*
+ * Report the highest value of the bucket holding the requested
+ * rank, which is exact within the bucket resolution. The result is
+ * clamped to the extreme latencies we observed exactly.
+ */
+static double hdr_percentile(const uint64_t *counts, uint64_t total,
+			     unsigned int per100k)
+{
+	uint64_t rank, hits = 0;
+	double value;
+	int n;
+
+	rank = (total * per100k + 99999) / 100000;
+	if (rank == 0)
+		rank = 1;
+
+	for (n = 0; n < RTTST_HDR_BUCKETS - 1; n++) {
+		hits += counts[n];
+		if (hits >= rank)
+			break;
+	}
+
+	value = rttst_hdr_lowest(n) + rttst_hdr_width(n) - 1.0;
+	if (value > hdr_data.max)
+		value = hdr_data.max;
+	if (value < hdr_data.min)
+		value = hdr_data.min;
+
+	return value / 1000;
+}
+
+static void dump_hdr_percentiles(void)
+{
+	uint64_t total;
+	int kind, n;
+
+	printf("HSP|--param|--samples-|----p50----|----p99----"
+	       "|---p99.9---|--p99.999--\n");
+
+	for (kind = 0; kind < HDR_KINDS; kind++) {
+		for (n = 0, total = 0; n < RTTST_HDR_BUCKETS; n++)
+			total += hdr_data.counts[kind][n];
+		if (total == 0)
+			continue;
+		printf("HSP|    %s| %9llu| %10.3f| %10.3f| %10.3f| %10.3f\n",
+		       hdr_kinds[kind], (unsigned long long)total,
+		       hdr_percentile(hdr_data.counts[kind], total, 50000),
+		       hdr_percentile(hdr_data.counts[kind], total, 99000),
+		       hdr_percentile(hdr_data.counts[kind], total, 99900),
+		       hdr_percentile(hdr_data.counts[kind], total, 99999));
+	}
+}
+
+/*
+ * The dump format is a fixed header followed by the min, avg and max
+ * bucket counts, all fields being stored in little-endian order.
+ */
+static void hdr_put32(FILE *fp, uint32_t val)
+{
+	val = htole32(val);
+	fwrite(&val, sizeof(val), 1, fp);
+}
+
+static void hdr_put64(FILE *fp, uint64_t val)
+{
+	val = htole64(val);
+	fwrite(&val, sizeof(val), 1, fp);
+}
+
+static int hdr_get32(FILE *fp, uint32_t *val)
+{
+	if (fread(val, sizeof(*val), 1, fp) != 1)
+		return -1;
+
+	*val = le32toh(*val);
+
+	return 0;
+}
+
+static int hdr_get64(FILE *fp, uint64_t *val)
+{
+	if (fread(val, sizeof(*val), 1, fp) != 1)
+		return -1;
+
+	*val = le64toh(*val);
+
+	return 0;
+}
+
+static void hdr_write(const char *path)
+{
+	char magic[8] = HDR_DUMP_MAGIC;
+	int kind, n;
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	if (fp == NULL)
+		error(1, errno, "fopen(%s)", path);
+
+	fwrite(magic, sizeof(magic), 1, fp);
+	hdr_put32(fp, HDR_DUMP_VERSION);
+	hdr_put32(fp, RTTST_HDR_SUB_BITS);
+	hdr_put32(fp, RTTST_HDR_BUCKETS);
+	hdr_put32(fp, hdr_data.runs);
+	hdr_put32(fp, hdr_data.min);
+	hdr_put32(fp, hdr_data.max);
+	hdr_put32(fp, hdr_data.overruns);
+	hdr_put32(fp, HDR_KINDS);
+
+	for (kind = 0; kind < HDR_KINDS; kind++)
+		for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+			hdr_put64(fp, hdr_data.counts[kind][n]);
+
+	if (ferror(fp) | fclose(fp))
+		error(1, errno, "write(%s)", path);
+}
+
+static void hdr_merge_file(const char *path)
+{
+	uint32_t version, subbits, buckets, runs, min, max, overruns, kinds;
+	uint64_t count;
+	char magic[8];
+	int kind, n;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		error(1, errno, "fopen(%s)", path);
+
+	if (fread(magic, sizeof(magic), 1, fp) != 1 ||
+	    memcmp(magic, HDR_DUMP_MAGIC, sizeof(magic)) ||
+	    hdr_get32(fp, &version) || version != HDR_DUMP_VERSION ||
+	    hdr_get32(fp, &subbits) || subbits != RTTST_HDR_SUB_BITS ||
+	    hdr_get32(fp, &buckets) || buckets != RTTST_HDR_BUCKETS ||
+	    hdr_get32(fp, &runs) || hdr_get32(fp, &min) ||
+	    hdr_get32(fp, &max) || hdr_get32(fp, &overruns) ||
+	    hdr_get32(fp, &kinds) || kinds != HDR_KINDS)
+		error(1, EINVAL, "%s: not a compatible histogram dump", path);
+
+	for (kind = 0; kind < HDR_KINDS; kind++)
+		for (n = 0; n < RTTST_HDR_BUCKETS; n++) {
+			if (hdr_get64(fp, &count))
+				error(1, EINVAL, "%s: truncated histogram dump",
+				      path);
+			hdr_data.counts[kind][n] += count;
+		}
+
+	fclose(fp);
+
+	if (hdr_data.runs == 0 || (int32_t)min < hdr_data.min)
+		hdr_data.min = min;
+	if (hdr_data.runs == 0 || (int32_t)max > hdr_data.max)
+		hdr_data.max = max;
+	hdr_data.overruns += overruns;
+	hdr_data.runs += runs;
+}
+
+static void hdr_collect(void)
+{
+	int32_t *histograms[HDR_KINDS] = {
+		[HDR_MIN] = histogram_min,
+		[HDR_AVG] = histogram_avg,
+		[HDR_MAX] = histogram_max,
+	};
+	int kind, n;
+
+	hdr_data.runs = 1;
+	hdr_data.min = gminjitter;
+	hdr_data.max = gmaxjitter;
+	hdr_data.overruns = goverrun;
+
+	for (kind = 0; kind < HDR_KINDS; kind++)
+		for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+			hdr_data.counts[kind][n] = (uint32_t)histograms[kind][n];
+}
+
+static void do_hdr_merge(int nfiles, char *const *files)
+{
+	int n;
+
+	if (nfiles == 0)
+		error(1, EINVAL, "-M requires histogram dump files");
+
+	for (n = 0; n < nfiles; n++)
+		hdr_merge_file(files[n]);
+
+	printf("== Merged %u run(s) from %d file(s)\n"
+	       "== All results in microseconds\n", hdr_data.runs, nfiles);
+	dump_hdr_percentiles();
+	printf("HSR|%11.3f|%11.3f|%8u\n",
+	       (double)hdr_data.min / 1000, (double)hdr_data.max / 1000,
+	       hdr_data.overruns);
+
+	if (hdr_output)
+		hdr_write(hdr_output);
+}
+
 static void dump_hist_stats(time_t duration)
 {
 	double minavg, maxavg, avgavg;
@@ -514,6 +777,13 @@ static void cleanup(void)
 	if (need_histo())
 		dump_hist_stats(actual_duration);
 
+	if (hdr_histogram) {
+		hdr_collect();
+		dump_hdr_percentiles();
+		if (hdr_output)
+			hdr_write(hdr_output);
+	}
+
 	printf
 	    ("---|-----------|-----------|-----------|--------|------|-------------------------\n"
 	     "RTS|%11.3f|%11.3f|%11.3f|%8d|%6u|    %.2ld:%.2ld:%.2ld/%.2d:%.2d:%.2d\n",
@@ -611,6 +881,9 @@ void application_usage(void)
 		"-c <cpu>                        pin measuring task down to given CPU\n"
 		"-P <priority>                   task priority (test mode 0 and 1 only)\n"
 		"-b                              break upon mode switch\n"
+		"-L                              use log-linear histogram buckets, print percentiles\n"
+		"-o <file>                       dump log-linear histograms to <file> (implies -L)\n"
+		"-M <file>...                    merge histogram dumps, print percentiles, then exit\n"
 		);
 }
 
@@ -645,7 +918,7 @@ int main(int argc, char *const *argv)
 	cpu_set_t cpus;
 	sigset_t mask;
 
-	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:b")) != EOF)
+	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:bLo:M")) != EOF)
 		switch (c) {
 		case 'g':
 			do_gnuplot = strdup(optarg);
@@ -719,11 +992,32 @@ int main(int argc, char *const *argv)
 			stop_upon_switch = 1;
 			break;
 
+		case 'L':
+			hdr_histogram = 1;
+			break;
+
+		case 'o':
+			hdr_output = strdup(optarg);
+			hdr_histogram = 1;
+			break;
+
+		case 'M':
+			hdr_merge = 1;
+			break;
+
 		default:
 			xenomai_usage();
 			exit(2);
 		}
 
+	if (hdr_merge) {
+		do_hdr_merge(argc - optind, argv + optind);
+		exit(0);
+	}
+
+	if (hdr_histogram)
+		histogram_size = RTTST_HDR_BUCKETS;
+
 	if (!test_duration && quiet) {
 		warning("-q requires -T, ignoring -q");
 		quiet = 0;
@@ -0,0 +1,442 @@
+/*
+ * RTIPC/BUFP mapped ring test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(bufp_ring,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(frame_size),
+			   SMOKEY_INT(frames),
+		   ),
+		   "Check RTIPC/BUFP mapped ring mode, and compare its\n"
+		   "\tthroughput with the copying path.\n"
+		   "\tframe_size=<bytes>\tsize of frames to exchange\n"
+		   "\tframes=<count>\t\tnumber of frames per pass"
+);
+
+#define BUFP_RING_PORT	14
+#define BUFP_COPY_PORT	15
+#define BUFP_RING_SIZE	65536
+
+enum {
+	XFER_COPY,		/* read(2)/write(2) */
+	XFER_RING,		/* bufp_ring_read/write() */
+};
+
+struct endpoint {
+	int s;
+	struct bufp_ring *ring;
+	size_t ringlen;
+};
+
+struct pass {
+	const char *name;
+	struct endpoint *rx, *tx;
+	int rxmode, txmode;
+	int check;
+	unsigned int frame_size;
+	unsigned int frames;
+	int status;
+};
+
+static void fill_frame(unsigned char *buf, unsigned int len, unsigned int seq)
+{
+	unsigned int n;
+
+	for (n = 0; n < len; n++)
+		buf[n] = (unsigned char)(seq + n);
+}
+
+static int check_frame(const unsigned char *buf, unsigned int len,
+		       unsigned int seq)
+{
+	unsigned int n;
+
+	for (n = 0; n < len; n++)
+		if (buf[n] != (unsigned char)(seq + n))
+			return -EPROTO;
+
+	return 0;
+}
+
+static void *producer(void *arg)
+{
+	struct pass *p = arg;
+	struct endpoint *ep = p->tx;
+	unsigned char *buf;
+	unsigned int seq;
+	ssize_t ret;
+
+	buf = malloc(p->frame_size);
+	if (buf == NULL) {
+		p->status = -ENOMEM;
+		return NULL;
+	}
+
+	fill_frame(buf, p->frame_size, 0);
+
+	for (seq = 0; seq < p->frames; seq++) {
+		if (p->check)
+			fill_frame(buf, p->frame_size, seq);
+		if (p->txmode == XFER_RING)
+			ret = bufp_ring_write(ep->s, ep->ring,
+					      buf, p->frame_size);
+		else {
+			ret = write(ep->s, buf, p->frame_size);
+			if (ret == p->frame_size)
+				ret = 0;
+			else if (ret < 0)
+				ret = -errno;
+			else
+				ret = -EIO;
+		}
+		if (ret) {
+			p->status = ret;
+			break;
+		}
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	struct pass *p = arg;
+	struct endpoint *ep = p->rx;
+	unsigned char *buf;
+	unsigned int seq;
+	ssize_t ret;
+
+	buf = malloc(p->frame_size);
+	if (buf == NULL) {
+		p->status = -ENOMEM;
+		return NULL;
+	}
+
+	for (seq = 0; seq < p->frames; seq++) {
+		if (p->rxmode == XFER_RING)
+			ret = bufp_ring_read(ep->s, ep->ring,
+					     buf, p->frame_size);
+		else {
+			ret = read(ep->s, buf, p->frame_size);
+			if (ret == p->frame_size)
+				ret = 0;
+			else if (ret < 0)
+				ret = -errno;
+			else
+				ret = -EIO;
+		}
+		if (ret == 0 && p->check)
+			ret = check_frame(buf, p->frame_size, seq);
+		if (ret) {
+			smokey_warning("%s: frame #%u: %s",
+				       p->name, seq, strerror(-ret));
+			p->status = ret;
+			break;
+		}
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+static int run_pass(struct pass *p, unsigned long long *ns)
+{
+	struct sched_param rxparam = { .sched_priority = 71 };
+	struct sched_param txparam = { .sched_priority = 70 };
+	pthread_attr_t rxattr, txattr;
+	struct timespec start, end;
+	pthread_t rxtid, txtid;
+	int ret;
+
+	p->status = 0;
+
+	pthread_attr_init(&rxattr);
+	pthread_attr_setinheritsched(&rxattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&rxattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&rxattr, &rxparam);
+
+	pthread_attr_init(&txattr);
+	pthread_attr_setinheritsched(&txattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&txattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&txattr, &txparam);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	ret = smokey_check_status(pthread_create(&rxtid, &rxattr,
+						 consumer, p));
+	if (ret)
+		return ret;
+
+	ret = smokey_check_status(pthread_create(&txtid, &txattr,
+						 producer, p));
+	if (ret) {
+		pthread_cancel(rxtid);
+		pthread_join(rxtid, NULL);
+		return ret;
+	}
+
+	pthread_join(txtid, NULL);
+	if (p->status)
+		pthread_cancel(rxtid);
+	pthread_join(rxtid, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	pthread_attr_destroy(&rxattr);
+	pthread_attr_destroy(&txattr);
+
+	if (ns)
+		*ns = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+			end.tv_nsec - start.tv_nsec;
+
+	return p->status;
+}
+
+static int open_server(struct endpoint *ep, int port, int mmapped)
+{
+	struct sockaddr_ipc saddr;
+	size_t bufsz = BUFP_RING_SIZE;
+	socklen_t optlen;
+	int ret, on = 1;
+
+	ep->s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP));
+	if (ep->s < 0)
+		return ep->s;
+
+	ret = smokey_check_errno(setsockopt(ep->s, SOL_BUFP, BUFP_BUFSZ,
+					    &bufsz, sizeof(bufsz)));
+	if (ret)
+		return ret;
+
+	if (mmapped) {
+		ret = smokey_check_errno(setsockopt(ep->s, SOL_BUFP, BUFP_MMAP,
+						    &on, sizeof(on)));
+		if (ret)
+			return ret;
+	}
+
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = smokey_check_errno(bind(ep->s, (struct sockaddr *)&saddr,
+				      sizeof(saddr)));
+	if (ret)
+		return ret;
+
+	if (!mmapped)
+		return 0;
+
+	/* The ring mode may not be changed once bound. */
+	ret = setsockopt(ep->s, SOL_BUFP, BUFP_MMAP, &on, sizeof(on));
+	if (!smokey_assert(ret == -1 && errno == EALREADY))
+		return -EINVAL;
+
+	optlen = sizeof(ep->ringlen);
+	return smokey_check_errno(getsockopt(ep->s, SOL_BUFP, BUFP_MMAP,
+					     &ep->ringlen, &optlen));
+}
+
+static int open_client(struct endpoint *ep, int port)
+{
+	struct sockaddr_ipc saddr;
+	socklen_t optlen;
+	int ret;
+
+	ep->s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP));
+	if (ep->s < 0)
+		return ep->s;
+
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = smokey_check_errno(connect(ep->s, (struct sockaddr *)&saddr,
+					 sizeof(saddr)));
+	if (ret)
+		return ret;
+
+	optlen = sizeof(ep->ringlen);
+	return smokey_check_errno(getsockopt(ep->s, SOL_BUFP, BUFP_MMAP,
+					     &ep->ringlen, &optlen));
+}
+
+static int map_ring(struct endpoint *ep)
+{
+	void *p;
+
+	if (!smokey_assert(ep->ringlen > 0))
+		return -EINVAL;
+
+	p = mmap(NULL, ep->ringlen, PROT_READ|PROT_WRITE,
+		 MAP_SHARED, ep->s, 0);
+	if (p == MAP_FAILED)
+		return smokey_check_errno(-1);
+
+	ep->ring = p;
+
+	return 0;
+}
+
+static void close_endpoint(struct endpoint *ep)
+{
+	if (ep->ring)
+		munmap(ep->ring, ep->ringlen);
+	if (ep->s >= 0)
+		close(ep->s);
+}
+
+static int run_bufp_ring(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct endpoint rsv = { .s = -1 }, rcl = { .s = -1 },
+		csv = { .s = -1 }, ccl = { .s = -1 };
+	unsigned long long copy_ns, ring_ns;
+	unsigned int frame_size, frames;
+	struct pass p;
+	int ret, s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP);
+	if (s < 0) {
+		if (errno == EAFNOSUPPORT)
+			return -ENOSYS;
+	} else
+		close(s);
+
+	smokey_parse_args(t, argc, argv);
+
+	frame_size = 4096;
+	if (SMOKEY_ARG_ISSET(bufp_ring, frame_size))
+		frame_size = SMOKEY_ARG_INT(bufp_ring, frame_size);
+	frames = 20000;
+	if (SMOKEY_ARG_ISSET(bufp_ring, frames))
+		frames = SMOKEY_ARG_INT(bufp_ring, frames);
+
+	if (frame_size == 0 || frame_size > BUFP_RING_SIZE || frames == 0)
+		return -EINVAL;
+
+	ret = open_server(&rsv, BUFP_RING_PORT, 1);
+	if (ret)
+		goto out;
+
+	ret = open_client(&rcl, BUFP_RING_PORT);
+	if (ret)
+		goto out;
+
+	if (!smokey_assert(rcl.ringlen == rsv.ringlen)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = map_ring(&rsv);
+	if (ret)
+		goto out;
+
+	ret = map_ring(&rcl);
+	if (ret)
+		goto out;
+
+	if (!smokey_assert(rsv.ring->size == BUFP_RING_SIZE) ||
+	    !smokey_assert((long)rsv.ring->data == sysconf(_SC_PAGESIZE)) ||
+	    !smokey_assert(rsv.ring->head == rsv.ring->tail)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	p.rx = &rsv;
+	p.tx = &rcl;
+	p.check = 1;
+	p.frames = frames;
+	/* Pick an odd size, so that frames straddle the ring end. */
+	p.frame_size = frame_size | 1;
+	if (p.frame_size > BUFP_RING_SIZE)
+		p.frame_size -= 2;
+
+	p.name = "ring -> ring";
+	p.txmode = XFER_RING;
+	p.rxmode = XFER_RING;
+	ret = run_pass(&p, NULL);
+	if (ret)
+		goto out;
+
+	p.name = "copy -> ring";
+	p.txmode = XFER_COPY;
+	p.rxmode = XFER_RING;
+	ret = run_pass(&p, NULL);
+	if (ret)
+		goto out;
+
+	p.name = "ring -> copy";
+	p.txmode = XFER_RING;
+	p.rxmode = XFER_COPY;
+	ret = run_pass(&p, NULL);
+	if (ret)
+		goto out;
+
+	if (!smokey_assert(rsv.ring->head == rsv.ring->tail)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* Compare throughput with the copying path. */
+	ret = open_server(&csv, BUFP_COPY_PORT, 0);
+	if (ret)
+		goto out;
+
+	ret = open_client(&ccl, BUFP_COPY_PORT);
+	if (ret)
+		goto out;
+
+	if (!smokey_assert(ccl.ringlen == 0)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	p.check = 0;
+	p.frame_size = frame_size;
+
+	p.name = "copy";
+	p.rx = &csv;
+	p.tx = &ccl;
+	p.txmode = XFER_COPY;
+	p.rxmode = XFER_COPY;
+	ret = run_pass(&p, &copy_ns);
+	if (ret)
+		goto out;
+
+	p.name = "ring";
+	p.rx = &rsv;
+	p.tx = &rcl;
+	p.txmode = XFER_RING;
+	p.rxmode = XFER_RING;
+	ret = run_pass(&p, &ring_ns);
+	if (ret)
+		goto out;
+
+	smokey_trace("%u frames of %u bytes", frames, frame_size);
+	smokey_trace("copy: %llu MB/s, %llu ns/frame",
+		     (unsigned long long)frames * frame_size * 1000 / (copy_ns ?: 1),
+		     copy_ns / frames);
+	smokey_trace("ring: %llu MB/s, %llu ns/frame",
+		     (unsigned long long)frames * frame_size * 1000 / (ring_ns ?: 1),
+		     ring_ns / frames);
+out:
+	close_endpoint(&ccl);
+	close_endpoint(&csv);
+	close_endpoint(&rcl);
+	close_endpoint(&rsv);
+
+	return ret;
+}
@@ -0,0 +1,159 @@
+/*
+ * RTDM file descriptor lookup benchmark, measuring the round-trip
+ * cost of a trivial ioctl() depending on the number of descriptors
+ * open in the process.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(fd_lookup,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+			   SMOKEY_INT(max_fds),
+		   ),
+		   "Measure the ioctl() round-trip cost on RTDM sockets\n"
+		   "\tdepending on the number of descriptors open.\n"
+		   "\tloops=<n>\tnumber of timed calls per step\n"
+		   "\tmax_fds=<n>\tnumber of descriptors in the last step"
+);
+
+struct bench_args {
+	int *fds;
+	int nr_fds;
+	int loops;
+	int status;
+	unsigned long long min, max, sum;
+};
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *bench_thread(void *arg)
+{
+	struct rtdm_device_info info;
+	unsigned long long start, dt;
+	struct bench_args *b = arg;
+	int n, ret;
+
+	b->min = ~0ULL;
+	b->max = b->sum = 0;
+
+	/*
+	 * Cycle through all descriptors, so that the lookup cost
+	 * does not depend on the position of a single one in the
+	 * index.
+	 */
+	for (n = 0; n < b->loops; n++) {
+		start = now_ns();
+		ret = ioctl(b->fds[n % b->nr_fds], RTIOC_DEVICE_INFO, &info);
+		dt = now_ns() - start;
+		if (ret) {
+			b->status = -errno;
+			break;
+		}
+		if (dt < b->min)
+			b->min = dt;
+		if (dt > b->max)
+			b->max = dt;
+		b->sum += dt;
+	}
+
+	return NULL;
+}
+
+static int run_step(struct bench_args *b)
+{
+	struct sched_param param = { .sched_priority = 50 };
+	pthread_attr_t attr;
+	pthread_t tid;
+	int ret;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	ret = smokey_check_status(pthread_create(&tid, &attr,
+						 bench_thread, b));
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return ret;
+
+	pthread_join(tid, NULL);
+	if (b->status)
+		return b->status;
+
+	smokey_trace("%5d fds: min %llu ns, avg %llu ns, max %llu ns",
+		     b->nr_fds, b->min, b->sum / b->loops, b->max);
+
+	return 0;
+}
+
+static int run_fd_lookup(struct smokey_test *t, int argc, char *const argv[])
+{
+	int ret = 0, max_fds = 1024, nr, n, s;
+	struct bench_args b;
+
+	smokey_parse_args(t, argc, argv);
+
+	memset(&b, 0, sizeof(b));
+	b.loops = 100000;
+	if (SMOKEY_ARG_ISSET(fd_lookup, loops))
+		b.loops = SMOKEY_ARG_INT(fd_lookup, loops);
+
+	if (SMOKEY_ARG_ISSET(fd_lookup, max_fds))
+		max_fds = SMOKEY_ARG_INT(fd_lookup, max_fds);
+
+	if (b.loops <= 0 || max_fds <= 0)
+		return -EINVAL;
+
+	b.fds = malloc(max_fds * sizeof(int));
+	if (b.fds == NULL)
+		return -ENOMEM;
+
+	/* Double the descriptor count at each step. */
+	for (nr = 1; b.nr_fds < max_fds; nr *= 2) {
+		if (nr > max_fds)
+			nr = max_fds;
+		while (b.nr_fds < nr) {
+			s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+			if (s < 0) {
+				ret = -errno;
+				if (ret == -EAFNOSUPPORT)
+					ret = -ENOSYS;
+				else if (ret == -EMFILE && b.nr_fds > 0) {
+					smokey_note("fd_lookup: stopping at %d fds",
+						    b.nr_fds);
+					ret = 0;
+				}
+				goto out;
+			}
+			b.fds[b.nr_fds++] = s;
+		}
+		ret = run_step(&b);
+		if (ret)
+			goto out;
+	}
+out:
+	for (n = 0; n < b.nr_fds; n++)
+		close(b.fds[n]);
+
+	free(b.fds);
+
+	return ret;
+}
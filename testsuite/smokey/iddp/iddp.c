@@ -18,11 +18,14 @@
 
 smokey_test_plugin(iddp,
 		   SMOKEY_NOARGS,
-		   "Check RTIPC/IDDP protocol."
+		   "Check RTIPC/IDDP protocol, including batched I/O."
 );
 
 #define IDDP_SVPORT 12
 #define IDDP_CLPORT 13
+#define IDDP_MMSG_SVPORT 14
+#define IDDP_MMSG_CLPORT 15
+#define IDDP_MMSG_COUNT  8
 
 static pthread_t svtid, cltid;
 
@@ -136,12 +139,124 @@ static void *client(void *arg)
 	return NULL;
 }
 
+static int iddp_bind(int port, size_t poolsz)
+{
+	struct sockaddr_ipc saddr;
+	int ret, s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (s < 0)
+		return -errno;
+
+	if (poolsz) {
+		ret = setsockopt(s, SOL_IDDP, IDDP_POOLSZ,
+				 &poolsz, sizeof(poolsz));
+		if (ret)
+			goto fail;
+	}
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = bind(s, (struct sockaddr *)&saddr, sizeof(saddr));
+	if (ret)
+		goto fail;
+
+	return s;
+fail:
+	ret = -errno;
+	close(s);
+	return ret;
+}
+
+/*
+ * Send a batch of datagrams with sendmmsg(), then receive them back
+ * with recvmmsg(), checking the message lengths and contents.
+ */
+static int check_mmsg(void)
+{
+	struct mmsghdr msgvec[IDDP_MMSG_COUNT + 1];
+	struct iovec iov[IDDP_MMSG_COUNT + 1];
+	long data[IDDP_MMSG_COUNT + 1];
+	struct sockaddr_ipc svsaddr;
+	int ret, n, svs, cls;
+
+	svs = iddp_bind(IDDP_MMSG_SVPORT, 32768);
+	if (svs < 0)
+		return svs;
+
+	cls = iddp_bind(IDDP_MMSG_CLPORT, 0);
+	if (cls < 0) {
+		close(svs);
+		return cls;
+	}
+
+	svsaddr.sipc_family = AF_RTIPC;
+	svsaddr.sipc_port = IDDP_MMSG_SVPORT;
+
+	memset(msgvec, 0, sizeof(msgvec));
+	for (n = 0; n < IDDP_MMSG_COUNT; n++) {
+		data[n] = n + 1;
+		iov[n].iov_base = &data[n];
+		iov[n].iov_len = sizeof(data[n]);
+		msgvec[n].msg_hdr.msg_iov = &iov[n];
+		msgvec[n].msg_hdr.msg_iovlen = 1;
+		msgvec[n].msg_hdr.msg_name = &svsaddr;
+		msgvec[n].msg_hdr.msg_namelen = sizeof(svsaddr);
+	}
+
+	ret = sendmmsg(cls, msgvec, IDDP_MMSG_COUNT, 0);
+	if (!smokey_assert(ret == IDDP_MMSG_COUNT)) {
+		ret = ret < 0 ? -errno : -EPROTO;
+		goto out;
+	}
+
+	for (n = 0; n < IDDP_MMSG_COUNT; n++)
+		if (!smokey_assert(msgvec[n].msg_len == sizeof(data[n]))) {
+			ret = -EPROTO;
+			goto out;
+		}
+
+	/*
+	 * Ask for one more message than available, the call should
+	 * return early instead of blocking on the last one.
+	 */
+	memset(msgvec, 0, sizeof(msgvec));
+	for (n = 0; n <= IDDP_MMSG_COUNT; n++) {
+		data[n] = 0;
+		iov[n].iov_base = &data[n];
+		iov[n].iov_len = sizeof(data[n]);
+		msgvec[n].msg_hdr.msg_iov = &iov[n];
+		msgvec[n].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = recvmmsg(svs, msgvec, IDDP_MMSG_COUNT + 1, MSG_WAITFORONE, NULL);
+	if (!smokey_assert(ret == IDDP_MMSG_COUNT)) {
+		ret = ret < 0 ? -errno : -EPROTO;
+		goto out;
+	}
+
+	for (n = 0; n < IDDP_MMSG_COUNT; n++)
+		if (!smokey_assert(msgvec[n].msg_len == sizeof(data[n]) &&
+				   data[n] == n + 1)) {
+			ret = -EPROTO;
+			goto out;
+		}
+
+	smokey_trace("%s: exchanged %d datagrams", __func__, ret);
+	ret = 0;
+out:
+	close(cls);
+	close(svs);
+
+	return ret;
+}
+
 static int run_iddp(struct smokey_test *t, int argc, char *const argv[])
 {
 	struct sched_param svparam = {.sched_priority = 71 };
 	struct sched_param clparam = {.sched_priority = 70 };
 	pthread_attr_t svattr, clattr;
-	int s;
+	int ret, s;
 
 	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
 	if (s < 0) {
@@ -150,6 +265,10 @@ static int run_iddp(struct smokey_test *t, int argc, char *const argv[])
 	} else
 		close(s);
 
+	ret = check_mmsg();
+	if (ret)
+		return ret;
+
 	pthread_attr_init(&svattr);
 	pthread_attr_setdetachstate(&svattr, PTHREAD_CREATE_JOINABLE);
 	pthread_attr_setinheritsched(&svattr, PTHREAD_EXPLICIT_SCHED);
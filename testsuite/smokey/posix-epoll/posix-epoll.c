@@ -0,0 +1,271 @@
+/*
+ * Cobalt epoll test, also comparing the cost of polling a large set
+ * of RTDM sockets with epoll_wait() and select().
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(posix_epoll,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+			   SMOKEY_INT(nfds),
+		   ),
+		   "Check the Cobalt epoll services, and compare the cost\n"
+		   "\tof epoll_wait() and select() on many RTDM sockets.\n"
+		   "\tloops=<n>\tnumber of timed calls\n"
+		   "\tnfds=<n>\tnumber of sockets watched"
+);
+
+#define EPOLL_SVPORT 16
+#define EPOLL_CLPORT 17
+
+struct bench_args {
+	int *fds;
+	int nfds;
+	int epfd;
+	int loops;
+	int status;
+	unsigned long long epoll_ns, select_ns;
+};
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int iddp_bind(int s, int port)
+{
+	struct sockaddr_ipc saddr;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+
+	return bind(s, (struct sockaddr *)&saddr, sizeof(saddr)) ? -errno : 0;
+}
+
+static int iddp_send(int s, int port)
+{
+	struct sockaddr_ipc saddr;
+	long data = port;
+	int ret;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+	ret = sendto(s, &data, sizeof(data), 0,
+		     (struct sockaddr *)&saddr, sizeof(saddr));
+
+	return ret == sizeof(data) ? 0 : -errno;
+}
+
+static void *bench_thread(void *arg)
+{
+	struct bench_args *b = arg;
+	struct epoll_event ev[8];
+	struct timeval tv;
+	fd_set in, set;
+	int n, ret, maxfd = 0;
+	unsigned long long start;
+
+	FD_ZERO(&set);
+	for (n = 0; n < b->nfds; n++) {
+		FD_SET(b->fds[n], &set);
+		if (b->fds[n] > maxfd)
+			maxfd = b->fds[n];
+	}
+
+	start = now_ns();
+	for (n = 0; n < b->loops; n++) {
+		ret = epoll_wait(b->epfd, ev, 8, 0);
+		if (ret != 1) {
+			b->status = ret < 0 ? -errno : -EPROTO;
+			return NULL;
+		}
+	}
+	b->epoll_ns = (now_ns() - start) / b->loops;
+
+	start = now_ns();
+	for (n = 0; n < b->loops; n++) {
+		in = set;
+		tv.tv_sec = tv.tv_usec = 0;
+		ret = select(maxfd + 1, &in, NULL, NULL, &tv);
+		if (ret != 1) {
+			b->status = ret < 0 ? -errno : -EPROTO;
+			return NULL;
+		}
+	}
+	b->select_ns = (now_ns() - start) / b->loops;
+
+	return NULL;
+}
+
+static int run_bench(struct bench_args *b)
+{
+	struct sched_param param = { .sched_priority = 50 };
+	pthread_attr_t attr;
+	pthread_t tid;
+	int ret;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	ret = smokey_check_status(pthread_create(&tid, &attr,
+						 bench_thread, b));
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return ret;
+
+	pthread_join(tid, NULL);
+	if (b->status)
+		return b->status;
+
+	smokey_trace("%d fds, 1 ready: epoll_wait %llu ns, select %llu ns",
+		     b->nfds, b->epoll_ns, b->select_ns);
+
+	return 0;
+}
+
+static int run_posix_epoll(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct epoll_event ev, evs[4];
+	int ret = 0, n, nr = 0, s, cls = -1;
+	struct bench_args b;
+	long data;
+
+	smokey_parse_args(t, argc, argv);
+
+	memset(&b, 0, sizeof(b));
+	b.loops = 10000;
+	if (SMOKEY_ARG_ISSET(posix_epoll, loops))
+		b.loops = SMOKEY_ARG_INT(posix_epoll, loops);
+
+	b.nfds = 256;
+	if (SMOKEY_ARG_ISSET(posix_epoll, nfds))
+		b.nfds = SMOKEY_ARG_INT(posix_epoll, nfds);
+
+	if (b.loops <= 0 || b.nfds <= 0 || b.nfds > FD_SETSIZE / 2)
+		return -EINVAL;
+
+	b.epfd = epoll_create_np(EPOLL_CLOEXEC);
+	if (b.epfd < 0)
+		return -errno;
+
+	b.fds = malloc(b.nfds * sizeof(int));
+	if (b.fds == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (n = 0; n < b.nfds; n++) {
+		s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+		if (s < 0) {
+			ret = -errno;
+			if (ret == -EAFNOSUPPORT)
+				ret = -ENOSYS;
+			goto out;
+		}
+		b.fds[nr++] = s;
+		ev.events = EPOLLIN;
+		ev.data.u32 = n;
+		if (!__Terrno(ret, epoll_ctl(b.epfd, EPOLL_CTL_ADD, s, &ev)))
+			goto out;
+	}
+
+	/* Adding twice is an error, so is removing an unknown fd. */
+	if (!__Tassert(epoll_ctl(b.epfd, EPOLL_CTL_ADD, b.fds[0], &ev) == -1 &&
+		       errno == EEXIST))
+		goto fail;
+
+	cls = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (cls < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	if (!__Tassert(epoll_ctl(b.epfd, EPOLL_CTL_DEL, cls, NULL) == -1 &&
+		       errno == ENOENT))
+		goto fail;
+
+	if (!__T(ret, iddp_bind(cls, EPOLL_CLPORT)))
+		goto out;
+
+	/* Nothing is pending yet. */
+	if (!__Tassert(epoll_wait(b.epfd, evs, 4, 0) == 0))
+		goto fail;
+
+	if (!__T(ret, iddp_bind(b.fds[b.nfds - 1], EPOLL_SVPORT)) ||
+	    !__T(ret, iddp_send(cls, EPOLL_SVPORT)))
+		goto out;
+
+	if (!__Tassert(epoll_wait(b.epfd, evs, 4, 100) == 1 &&
+		       evs[0].events == EPOLLIN &&
+		       evs[0].data.u32 == b.nfds - 1))
+		goto fail;
+
+	/*
+	 * Events are level-triggered, so the pending datagram keeps
+	 * the last socket ready throughout the benchmark.
+	 */
+	ret = run_bench(&b);
+	if (ret)
+		goto out;
+
+	/* A descriptor ready for several types is reported once. */
+	ev.events = EPOLLIN | EPOLLOUT;
+	ev.data.u32 = b.nfds - 1;
+	if (!__Terrno(ret, epoll_ctl(b.epfd, EPOLL_CTL_MOD,
+				     b.fds[b.nfds - 1], &ev)))
+		goto out;
+
+	if (!__Tassert(epoll_wait(b.epfd, evs, 4, 0) == 1 &&
+		       evs[0].events == (EPOLLIN | EPOLLOUT) &&
+		       evs[0].data.u32 == b.nfds - 1))
+		goto fail;
+
+	if (!__Tassert(recv(b.fds[b.nfds - 1], &data, sizeof(data),
+			    MSG_DONTWAIT) == sizeof(data)))
+		goto fail;
+
+	if (!__Tassert(epoll_wait(b.epfd, evs, 4, 0) == 0))
+		goto fail;
+
+	/* A removed socket is no longer reported. */
+	if (!__Terrno(ret, epoll_ctl(b.epfd, EPOLL_CTL_DEL,
+				     b.fds[b.nfds - 1], NULL)) ||
+	    !__T(ret, iddp_send(cls, EPOLL_SVPORT)))
+		goto out;
+
+	if (!__Tassert(epoll_wait(b.epfd, evs, 4, 10) == 0))
+		goto fail;
+
+	goto out;
+fail:
+	ret = -EINVAL;
+out:
+	if (cls >= 0)
+		close(cls);
+
+	for (n = 0; n < nr; n++)
+		close(b.fds[n]);
+
+	free(b.fds);
+
+	close(b.epfd);
+
+	return ret;
+}
@@ -0,0 +1,282 @@
+/*
+ * POSIX message queue test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(posix_mq,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(count),
+		   ),
+		   "Check POSIX message queue services.\n"
+		   "\tcount=<messages>\tnumber of messages per stream pass"
+);
+
+#define MQ_NAME		"/smokey-mq"
+#define MQ_MAXMSG	8
+#define MQ_NOTIFY_SIG	SIGUSR1
+
+struct stream_msg {
+	unsigned int prio;
+	unsigned int seq;
+};
+
+struct stream {
+	mqd_t q;
+	unsigned int count;
+	int status;
+};
+
+static mqd_t open_queue(void)
+{
+	struct mq_attr attr = {
+		.mq_maxmsg = MQ_MAXMSG,
+		.mq_msgsize = sizeof(struct stream_msg),
+	};
+
+	mq_unlink(MQ_NAME);
+
+	return mq_open(MQ_NAME, O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+}
+
+static int check_ordering(mqd_t q)
+{
+	static const unsigned int prios[] = { 1, 3, 1, 2, 3, 0, 2 };
+	static const unsigned int order[] = { 1, 4, 3, 6, 0, 2, 5 };
+	struct stream_msg m;
+	unsigned int prio;
+	ssize_t len;
+	int n;
+
+	for (n = 0; n < sizeof(prios) / sizeof(prios[0]); n++) {
+		m.prio = prios[n];
+		m.seq = n;
+		if (!smokey_assert(mq_send(q, (char *)&m, sizeof(m),
+					   prios[n]) == 0))
+			return -errno;
+	}
+
+	for (n = 0; n < sizeof(order) / sizeof(order[0]); n++) {
+		len = mq_receive(q, (char *)&m, sizeof(m), &prio);
+		if (!smokey_assert(len == sizeof(m)))
+			return -EPROTO;
+		if (!smokey_assert(m.seq == order[n] && prio == m.prio)) {
+			smokey_warning("got message #%u, prio %u, "
+				       "expected #%u", m.seq, prio, order[n]);
+			return -EPROTO;
+		}
+	}
+
+	return 0;
+}
+
+static int wait_notification(int expected)
+{
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 100000000 };
+	siginfo_t si;
+	sigset_t set;
+	int sig;
+
+	sigemptyset(&set);
+	sigaddset(&set, MQ_NOTIFY_SIG);
+	sig = sigtimedwait(&set, &si, &timeout);
+	if (!expected)
+		return smokey_assert(sig < 0 && errno == EAGAIN) ? 0 : -EPROTO;
+
+	if (!smokey_assert(sig == MQ_NOTIFY_SIG && si.si_code == SI_MESGQ))
+		return -EPROTO;
+
+	return 0;
+}
+
+static int check_notify(mqd_t q)
+{
+	struct sigevent sev;
+	struct stream_msg m;
+	unsigned int prio;
+	int ret, n;
+
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_SIGNAL;
+	sev.sigev_signo = MQ_NOTIFY_SIG;
+	if (!smokey_assert(mq_notify(q, &sev) == 0))
+		return -errno;
+
+	/* Only the first message sent to the empty queue is notified. */
+	for (n = 0; n < 3; n++) {
+		m.prio = 0;
+		m.seq = n;
+		if (!smokey_assert(mq_send(q, (char *)&m, sizeof(m), 0) == 0))
+			return -errno;
+		ret = wait_notification(n == 0);
+		if (ret)
+			return ret;
+	}
+
+	for (n = 0; n < 3; n++)
+		if (!smokey_assert(mq_receive(q, (char *)&m, sizeof(m),
+					      &prio) == sizeof(m)))
+			return -errno;
+
+	/* The registration is gone after the notification. */
+	if (!smokey_assert(mq_send(q, (char *)&m, sizeof(m), 0) == 0))
+		return -errno;
+
+	ret = wait_notification(0);
+	if (ret)
+		return ret;
+
+	if (!smokey_assert(mq_receive(q, (char *)&m, sizeof(m),
+				      &prio) == sizeof(m)))
+		return -errno;
+
+	return 0;
+}
+
+static void *stream_producer(void *arg)
+{
+	unsigned int seqs[4] = { 0, 0, 0, 0 };
+	struct stream *s = arg;
+	struct stream_msg m;
+	unsigned int n;
+
+	for (n = 0; n < s->count; n++) {
+		m.prio = (n * 7) % 4;
+		m.seq = seqs[m.prio]++;
+		if (mq_send(s->q, (char *)&m, sizeof(m), m.prio)) {
+			s->status = smokey_check_errno(-1);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void *stream_consumer(void *arg)
+{
+	unsigned int seqs[4] = { 0, 0, 0, 0 };
+	struct stream *s = arg;
+	struct stream_msg m;
+	unsigned int n, prio;
+	ssize_t len;
+
+	for (n = 0; n < s->count; n++) {
+		len = mq_receive(s->q, (char *)&m, sizeof(m), &prio);
+		if (len != sizeof(m)) {
+			s->status = smokey_check_errno(-1);
+			break;
+		}
+		/* FIFO order within a given priority level. */
+		if (prio != m.prio || m.prio > 3 || m.seq != seqs[m.prio]) {
+			smokey_warning("message #%u out of order", n);
+			s->status = -EPROTO;
+			break;
+		}
+		seqs[m.prio]++;
+	}
+
+	return NULL;
+}
+
+static int check_stream(mqd_t q, unsigned int count,
+			int rxprio, int txprio)
+{
+	struct sched_param rxparam = { .sched_priority = rxprio };
+	struct sched_param txparam = { .sched_priority = txprio };
+	struct stream rx = { .q = q, .count = count, .status = 0 };
+	struct stream tx = { .q = q, .count = count, .status = 0 };
+	pthread_attr_t rxattr, txattr;
+	pthread_t rxtid, txtid;
+	int ret;
+
+	pthread_attr_init(&rxattr);
+	pthread_attr_setinheritsched(&rxattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&rxattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&rxattr, &rxparam);
+
+	pthread_attr_init(&txattr);
+	pthread_attr_setinheritsched(&txattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&txattr, SCHED_FIFO);
+	pthread_attr_setschedparam(&txattr, &txparam);
+
+	ret = smokey_check_status(pthread_create(&rxtid, &rxattr,
+						 stream_consumer, &rx));
+	if (ret)
+		goto out;
+
+	ret = smokey_check_status(pthread_create(&txtid, &txattr,
+						 stream_producer, &tx));
+	if (ret) {
+		pthread_cancel(rxtid);
+		pthread_join(rxtid, NULL);
+		goto out;
+	}
+
+	pthread_join(txtid, NULL);
+	pthread_join(rxtid, NULL);
+	ret = tx.status ?: rx.status;
+	smokey_trace("stream, rx prio %d, tx prio %d: %s",
+		     rxprio, txprio, ret ? "FAILED" : "ok");
+out:
+	pthread_attr_destroy(&rxattr);
+	pthread_attr_destroy(&txattr);
+
+	return ret;
+}
+
+static int run_posix_mq(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param param = { .sched_priority = 50 };
+	unsigned int count = 100000;
+	sigset_t set;
+	mqd_t q;
+	int ret;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(posix_mq, count))
+		count = SMOKEY_ARG_INT(posix_mq, count);
+
+	ret = smokey_check_status(pthread_setschedparam(pthread_self(),
+							SCHED_FIFO, &param));
+	if (ret)
+		return ret;
+
+	sigemptyset(&set);
+	sigaddset(&set, MQ_NOTIFY_SIG);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	q = open_queue();
+	if (q == (mqd_t)-1)
+		return smokey_check_errno(-1);
+
+	ret = check_ordering(q);
+	if (ret)
+		goto out;
+
+	ret = check_notify(q);
+	if (ret)
+		goto out;
+
+	/* Consumer outranking the producer, then the converse. */
+	ret = check_stream(q, count, 71, 70);
+	if (ret)
+		goto out;
+
+	ret = check_stream(q, count, 70, 71);
+out:
+	mq_close(q);
+	mq_unlink(MQ_NAME);
+
+	return ret;
+}
@@ -0,0 +1,149 @@
+/*
+ * Registry test and benchmark, exercising the enter, bind and
+ * remove paths through POSIX named semaphores.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(registry,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(count),
+			   SMOKEY_INT(loops),
+		   ),
+		   "Check and measure registry enter/bind/remove rates.\n"
+		   "\tcount=<objects>\tnumber of named objects to register\n"
+		   "\tloops=<n>\tnumber of bind passes over all objects"
+);
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void get_name(char *buf, size_t len, int n)
+{
+	snprintf(buf, len, "/smokey-reg-%d", n);
+}
+
+static void report(const char *what, int ops, unsigned long long ns)
+{
+	if (ops == 0)
+		return;
+
+	smokey_trace("%-8s %6d ops, %6llu ns/op, %8llu ops/s",
+		     what, ops, ns / ops,
+		     ns ? ops * 1000000000ULL / ns : 0);
+}
+
+static int run_registry(struct smokey_test *t, int argc, char *const argv[])
+{
+	int count = 256, loops = 16, n, l, created = 0, ret = 0;
+	unsigned long long start;
+	sem_t **sems, *sem;
+	char name[32];
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(registry, count))
+		count = SMOKEY_ARG_INT(registry, count);
+
+	if (SMOKEY_ARG_ISSET(registry, loops))
+		loops = SMOKEY_ARG_INT(registry, loops);
+
+	if (count <= 0 || loops <= 0)
+		return -EINVAL;
+
+	sems = calloc(count, sizeof(*sems));
+	if (sems == NULL)
+		return -ENOMEM;
+
+	for (n = 0; n < count; n++) {
+		get_name(name, sizeof(name), n);
+		sem_unlink(name);
+	}
+
+	/* Enter: miss on bind, then register. */
+	start = now_ns();
+	for (n = 0; n < count; n++) {
+		get_name(name, sizeof(name), n);
+		sem = sem_open(name, O_CREAT | O_EXCL, 0600, n);
+		if (sem == SEM_FAILED) {
+			if (errno == EAGAIN) {
+				smokey_note("registry full after %d objects", n);
+				break;
+			}
+			ret = smokey_check_errno(-1);
+			goto out;
+		}
+		sems[n] = sem;
+	}
+	created = n;
+	report("enter", created, now_ns() - start);
+
+	/* Bind: hit on existing keys. */
+	start = now_ns();
+	for (l = 0; l < loops; l++) {
+		for (n = 0; n < created; n++) {
+			get_name(name, sizeof(name), n);
+			sem = sem_open(name, 0);
+			if (!smokey_assert(sem == sems[n])) {
+				ret = sem == SEM_FAILED ? -errno : -EPROTO;
+				goto out;
+			}
+			/* Drop the extra reference. */
+			sem_close(sem);
+		}
+	}
+	report("bind", created * loops, now_ns() - start);
+
+	/* Check each name still maps to the right object. */
+	for (n = 0; n < created; n++) {
+		int val;
+
+		if (!smokey_assert(sem_getvalue(sems[n], &val) == 0 && val == n)) {
+			ret = -EPROTO;
+			goto out;
+		}
+	}
+
+	/* Remove. */
+	start = now_ns();
+	for (n = 0; n < created; n++) {
+		get_name(name, sizeof(name), n);
+		ret = smokey_check_errno(sem_unlink(name));
+		if (ret)
+			goto out;
+	}
+	report("remove", created, now_ns() - start);
+
+	for (n = 0; n < created; n++) {
+		get_name(name, sizeof(name), n);
+		if (!smokey_assert(sem_open(name, 0) == SEM_FAILED &&
+				   errno == ENOENT)) {
+			ret = -EPROTO;
+			goto out;
+		}
+	}
+out:
+	for (n = 0; n < created; n++) {
+		sem_close(sems[n]);
+		get_name(name, sizeof(name), n);
+		sem_unlink(name);
+	}
+
+	free(sems);
+
+	return ret;
+}
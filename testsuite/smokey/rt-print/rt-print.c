@@ -0,0 +1,211 @@
+/*
+ * rt_printf() test and latency benchmark, comparing in-line
+ * formatting with deferred formatting.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <cobalt/tunables.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(rt_print,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+		   "Check deferred rt_printf() formatting, and compare\n"
+		   "\tthe caller latency with in-line formatting.\n"
+		   "\tloops=<n>\tnumber of timed calls per mode"
+);
+
+#define BATCH  64
+
+struct print_stats {
+	unsigned long long min, max, sum;
+	int samples;
+};
+
+struct bench_args {
+	int loops;
+	int status;
+	struct print_stats stats[2];
+};
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_samples(FILE *fp)
+{
+	char label[16];
+	int n;
+
+	for (n = 0; n < 16; n++) {
+		snprintf(label, sizeof(label), "item-%d", n);
+		rt_fprintf(fp, "%d: %s [%-8s] %08x %.3f %lld %zu %c %p %.*s%%\n",
+			   n, label, "tag", n * 0x1111, n * 1.25,
+			   -1000000000000LL * n, (size_t)n, 'a' + n,
+			   (void *)(long)(n * 16), n % 5, "abcdefgh");
+		rt_print_flush_buffers();
+	}
+}
+
+static char *read_back(FILE *fp)
+{
+	long size;
+	char *buf;
+
+	fflush(fp);
+	size = ftell(fp);
+	rewind(fp);
+	buf = malloc(size + 1);
+	if (buf == NULL)
+		return NULL;
+
+	if (fread(buf, 1, size, fp) != size) {
+		free(buf);
+		return NULL;
+	}
+	buf[size] = '\0';
+
+	return buf;
+}
+
+static int check_output(void)
+{
+	char *text = NULL, *deferred = NULL;
+	FILE *fp[2];
+	int ret = -ENOMEM, mode;
+
+	for (mode = 0; mode < 2; mode++) {
+		fp[mode] = tmpfile();
+		if (fp[mode] == NULL) {
+			ret = -errno;
+			goto out;
+		}
+		set_runtime_tunable(print_deferred, mode);
+		print_samples(fp[mode]);
+	}
+
+	text = read_back(fp[0]);
+	deferred = read_back(fp[1]);
+	if (text == NULL || deferred == NULL)
+		goto out;
+
+	ret = 0;
+	if (!smokey_assert(strcmp(text, deferred) == 0)) {
+		smokey_warning("deferred output differs:\n%s---\n%s",
+			       text, deferred);
+		ret = -EPROTO;
+	}
+out:
+	set_runtime_tunable(print_deferred, 0);
+	free(text);
+	free(deferred);
+	while (--mode >= 0)
+		fclose(fp[mode]);
+
+	return ret;
+}
+
+static void *bench_thread(void *arg)
+{
+	unsigned long long start, dt;
+	struct bench_args *b = arg;
+	struct print_stats *st;
+	FILE *null;
+	int mode, n;
+
+	null = fopen("/dev/null", "w");
+	if (null == NULL) {
+		b->status = -errno;
+		return NULL;
+	}
+
+	for (mode = 0; mode < 2; mode++) {
+		set_runtime_tunable(print_deferred, mode);
+		st = &b->stats[mode];
+		st->min = ~0ULL;
+		for (n = 0; n < b->loops; n++) {
+			/*
+			 * Drain the relay buffer regularly, so that we
+			 * never measure a call which finds it full.
+			 */
+			if (n % BATCH == 0)
+				rt_print_flush_buffers();
+			start = now_ns();
+			rt_fprintf(null, "sample #%d: state=%s value=%08x "
+				   "ratio=%.4f delta=%lld\n",
+				   n, "running", n * 7, n * 0.5,
+				   (long long)n << 20);
+			dt = now_ns() - start;
+			if (dt < st->min)
+				st->min = dt;
+			if (dt > st->max)
+				st->max = dt;
+			st->sum += dt;
+			st->samples++;
+		}
+	}
+
+	set_runtime_tunable(print_deferred, 0);
+	rt_print_flush_buffers();
+	fclose(null);
+
+	return NULL;
+}
+
+static int run_rt_print(struct smokey_test *t, int argc, char *const argv[])
+{
+	static const char *const modes[] = { "in-line", "deferred" };
+	struct sched_param param = { .sched_priority = 50 };
+	struct bench_args b;
+	pthread_attr_t attr;
+	pthread_t tid;
+	int ret, mode;
+
+	smokey_parse_args(t, argc, argv);
+
+	memset(&b, 0, sizeof(b));
+	b.loops = 10000;
+	if (SMOKEY_ARG_ISSET(rt_print, loops))
+		b.loops = SMOKEY_ARG_INT(rt_print, loops);
+
+	if (b.loops <= 0)
+		return -EINVAL;
+
+	ret = check_output();
+	if (ret)
+		return ret;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	ret = smokey_check_status(pthread_create(&tid, &attr,
+						 bench_thread, &b));
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return ret;
+
+	pthread_join(tid, NULL);
+	if (b.status)
+		return b.status;
+
+	for (mode = 0; mode < 2; mode++)
+		smokey_trace("%-8s min %llu ns, avg %llu ns, max %llu ns",
+			     modes[mode], b.stats[mode].min,
+			     b.stats[mode].sum / b.stats[mode].samples,
+			     b.stats[mode].max);
+
+	return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * Select wakeup benchmark, measuring the cost of a descriptor state
+ * change depending on the number of selectors watching it.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(select_wakeup,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+			   SMOKEY_INT(nfds),
+			   SMOKEY_INT(max_selectors),
+		   ),
+		   "Measure the cost of RTDM socket state changes depending\n"
+		   "\ton the number of threads selecting them.\n"
+		   "\tloops=<n>\tnumber of timed state changes per step\n"
+		   "\tnfds=<n>\tnumber of sockets watched by each thread\n"
+		   "\tmax_selectors=<n>\tnumber of threads in the last step"
+);
+
+struct bench_args {
+	int *fds;
+	struct sockaddr_ipc *addrs;
+	int nfds;
+	int sender;
+	int loops;
+	int nr_selectors;
+	int status;
+	sem_t bound, release;
+	unsigned long long send_ns, recv_ns;
+};
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Cobalt keeps the bindings of a thread's selector across select()
+ * calls, so a single non-blocking call is enough for watching the
+ * sockets until the thread exits.
+ */
+static void *selector_thread(void *arg)
+{
+	struct bench_args *b = arg;
+	struct timeval tv;
+	int n, maxfd = 0;
+	fd_set set;
+
+	FD_ZERO(&set);
+	for (n = 0; n < b->nfds; n++) {
+		FD_SET(b->fds[n], &set);
+		if (b->fds[n] > maxfd)
+			maxfd = b->fds[n];
+	}
+
+	tv.tv_sec = tv.tv_usec = 0;
+	if (select(maxfd + 1, &set, NULL, NULL, &tv) < 0)
+		b->status = -errno;
+
+	sem_post(&b->bound);
+	sem_wait(&b->release);
+
+	return NULL;
+}
+
+static void *bench_thread(void *arg)
+{
+	unsigned long long t0, t1, t2;
+	struct bench_args *b = arg;
+	int n, ret, s;
+	long data;
+
+	b->send_ns = b->recv_ns = 0;
+
+	/*
+	 * Each datagram makes an empty socket readable, then the
+	 * receive makes it empty again, which signals both state
+	 * changes to all selectors.
+	 */
+	for (n = 0; n < b->loops; n++) {
+		s = n % b->nfds;
+		data = n;
+		t0 = now_ns();
+		ret = sendto(b->sender, &data, sizeof(data), 0,
+			     (struct sockaddr *)&b->addrs[s],
+			     sizeof(b->addrs[s]));
+		t1 = now_ns();
+		if (ret != sizeof(data))
+			goto fail;
+		ret = recv(b->fds[s], &data, sizeof(data), MSG_DONTWAIT);
+		t2 = now_ns();
+		if (ret != sizeof(data))
+			goto fail;
+		b->send_ns += t1 - t0;
+		b->recv_ns += t2 - t1;
+	}
+
+	return NULL;
+fail:
+	b->status = ret < 0 ? -errno : -EPROTO;
+
+	return NULL;
+}
+
+static int run_step(struct bench_args *b)
+{
+	struct sched_param param = { .sched_priority = 50 };
+	pthread_attr_t attr;
+	pthread_t tid;
+	int ret;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	ret = smokey_check_status(pthread_create(&tid, &attr,
+						 bench_thread, b));
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return ret;
+
+	pthread_join(tid, NULL);
+	if (b->status)
+		return b->status;
+
+	smokey_trace("%3d selectors x %d fds: send %llu ns, recv %llu ns",
+		     b->nr_selectors, b->nfds,
+		     b->send_ns / b->loops, b->recv_ns / b->loops);
+
+	return 0;
+}
+
+static int open_socket(struct sockaddr_ipc *addr)
+{
+	socklen_t addrlen = sizeof(*addr);
+	int ret, s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (s < 0)
+		return errno == EAFNOSUPPORT ? -ENOSYS : -errno;
+
+	/* Let the driver pick a free port. */
+	addr->sipc_family = AF_RTIPC;
+	addr->sipc_port = -1;
+	ret = bind(s, (struct sockaddr *)addr, sizeof(*addr));
+	if (ret == 0)
+		ret = getsockname(s, (struct sockaddr *)addr, &addrlen);
+	if (ret) {
+		ret = -errno;
+		close(s);
+		return ret;
+	}
+
+	return s;
+}
+
+static int run_select_wakeup(struct smokey_test *t,
+			     int argc, char *const argv[])
+{
+	int ret = 0, max_selectors = 32, nr, n, s, opened = 0;
+	struct sched_param param = { .sched_priority = 1 };
+	struct sockaddr_ipc addr;
+	struct bench_args b;
+	pthread_attr_t attr;
+	pthread_t *tids;
+
+	smokey_parse_args(t, argc, argv);
+
+	memset(&b, 0, sizeof(b));
+	b.loops = 10000;
+	if (SMOKEY_ARG_ISSET(select_wakeup, loops))
+		b.loops = SMOKEY_ARG_INT(select_wakeup, loops);
+
+	b.nfds = 8;
+	if (SMOKEY_ARG_ISSET(select_wakeup, nfds))
+		b.nfds = SMOKEY_ARG_INT(select_wakeup, nfds);
+
+	if (SMOKEY_ARG_ISSET(select_wakeup, max_selectors))
+		max_selectors = SMOKEY_ARG_INT(select_wakeup, max_selectors);
+
+	if (b.loops <= 0 || b.nfds <= 0 || max_selectors < 0)
+		return -EINVAL;
+
+	b.fds = malloc(b.nfds * sizeof(int));
+	b.addrs = malloc(b.nfds * sizeof(*b.addrs));
+	tids = malloc((max_selectors + 1) * sizeof(pthread_t));
+	if (b.fds == NULL || b.addrs == NULL || tids == NULL) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	sem_init(&b.bound, 0, 0);
+	sem_init(&b.release, 0, 0);
+
+	b.sender = open_socket(&addr);
+	if (b.sender < 0) {
+		ret = b.sender;
+		goto out_sem;
+	}
+
+	for (opened = 0; opened < b.nfds; opened++) {
+		s = open_socket(&b.addrs[opened]);
+		if (s < 0) {
+			ret = s;
+			goto out;
+		}
+		b.fds[opened] = s;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+
+	/* Double the selector count at each step, starting from none. */
+	for (nr = 0;; nr = nr ? nr * 2 : 1) {
+		if (nr > max_selectors)
+			nr = max_selectors;
+		while (b.nr_selectors < nr) {
+			ret = pthread_create(tids + b.nr_selectors, &attr,
+					     selector_thread, &b);
+			ret = smokey_check_status(ret);
+			if (ret)
+				goto out_threads;
+			b.nr_selectors++;
+			sem_wait(&b.bound);
+			if (b.status) {
+				ret = b.status;
+				goto out_threads;
+			}
+		}
+		ret = run_step(&b);
+		if (ret || nr == max_selectors)
+			break;
+	}
+out_threads:
+	pthread_attr_destroy(&attr);
+
+	for (n = 0; n < b.nr_selectors; n++)
+		sem_post(&b.release);
+
+	for (n = 0; n < b.nr_selectors; n++)
+		pthread_join(tids[n], NULL);
+out:
+	for (n = 0; n < opened; n++)
+		close(b.fds[n]);
+
+	close(b.sender);
+out_sem:
+	sem_destroy(&b.release);
+	sem_destroy(&b.bound);
+out_free:
+	free(tids);
+	free(b.addrs);
+	free(b.fds);
+
+	return ret;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <error.h>
+#include <getopt.h>
+#include <signal.h>
+#include <cobalt/uapi/signal.h>
+
+#define PROC_FLIGHTREC  "/proc/xenomai/flightrec"
+#define PROC_COMM       "/proc/%d/comm"
+
+#define EVENT_FMT   "%d %lu %Lu %15s %d %lx"
+#define EVENT_NFMT  6
+
+struct event {
+	int cpu;
+	unsigned long seq;
+	unsigned long long timestamp;
+	char type[16];
+	int pid;
+	unsigned long arg;
+};
+
+static const struct option base_options[] = {
+	{
+#define help_opt	0
+		.name = "help",
+		.has_arg = no_argument,
+	},
+	{
+#define file_opt	1
+		.name = "file",
+		.has_arg = required_argument,
+	},
+	{
+#define cpu_opt		2
+		.name = "cpu",
+		.has_arg = required_argument,
+	},
+	{
+#define window_opt	3
+		.name = "window",
+		.has_arg = required_argument,
+	},
+	{ /* Sentinel */ }
+};
+
+static const char *reason_str[] = {
+	[SIGDEBUG_UNDEFINED] = "undefined",
+	[SIGDEBUG_MIGRATE_SIGNAL] = "signal",
+	[SIGDEBUG_MIGRATE_SYSCALL] = "syscall",
+	[SIGDEBUG_MIGRATE_FAULT] = "fault",
+	[SIGDEBUG_MIGRATE_PRIOINV] = "pi-error",
+	[SIGDEBUG_NOMLOCK] = "mlock-check",
+	[SIGDEBUG_WATCHDOG] = "runaway-break",
+	[SIGDEBUG_RESCNT_IMBALANCE] = "resource-count-imbalance",
+	[SIGDEBUG_MUTEX_SLEEP] = "sleep-holding-mutex",
+	[SIGDEBUG_LOCK_BREAK] = "scheduler-lock-break",
+};
+
+static const char *get_reason(unsigned long reason)
+{
+	if (reason >= sizeof(reason_str) / sizeof(reason_str[0]) ||
+	    reason_str[reason] == NULL)
+		return "?";
+
+	return reason_str[reason];
+}
+
+/*
+ * The recorder only logs pids. Threads which are still alive when
+ * decoding are named after their current command.
+ */
+static const char *get_comm(int pid)
+{
+	static char comm[64];
+	char path[sizeof(PROC_COMM) + 16];
+	FILE *fp;
+
+	if (pid == 0)
+		return "ROOT";
+
+	snprintf(path, sizeof(path), PROC_COMM, pid);
+	fp = fopen(path, "r");
+	if (fp == NULL || fgets(comm, sizeof(comm), fp) == NULL)
+		strcpy(comm, "?");
+	else
+		comm[strcspn(comm, "\n")] = '\0';
+
+	if (fp)
+		fclose(fp);
+
+	return comm;
+}
+
+static int compare_events(const void *a, const void *b)
+{
+	const struct event *l = a, *r = b;
+
+	if (l->cpu != r->cpu)
+		return l->cpu - r->cpu;
+
+	/* Sequence numbers are monotonic on each CPU. */
+	return l->seq < r->seq ? -1 : l->seq > r->seq;
+}
+
+static void print_event(struct event *ev, unsigned long long ref,
+			unsigned long long *last_switch)
+{
+	long long offset = ev->timestamp - ref;
+
+	printf("  %+14.3f us  ", offset / 1000.0);
+
+	if (strcmp(ev->type, "switch") == 0) {
+		printf("switch  %6d %-16s", ev->pid, get_comm(ev->pid));
+		printf(" <- %6d %s", (int)ev->arg, get_comm((int)ev->arg));
+		if (*last_switch)
+			printf(", ran %.3f us",
+			       (ev->timestamp - *last_switch) / 1000.0);
+		*last_switch = ev->timestamp;
+	} else if (strcmp(ev->type, "wakeup") == 0)
+		printf("wakeup  %6d %-16s mask %#lx",
+		       ev->pid, get_comm(ev->pid), ev->arg);
+	else if (strcmp(ev->type, "timer") == 0)
+		printf("timer   %#lx", ev->arg);
+	else if (strcmp(ev->type, "irq") == 0)
+		printf("irq     %lu", ev->arg);
+	else if (strcmp(ev->type, "relax") == 0)
+		printf("relax   %6d %-16s reason: %s",
+		       ev->pid, get_comm(ev->pid), get_reason(ev->arg));
+	else if (strcmp(ev->type, "harden") == 0)
+		printf("harden  %6d %s", ev->pid, get_comm(ev->pid));
+	else if (strcmp(ev->type, "freeze") == 0)
+		printf("FREEZE  %6d %-16s reason: %s",
+		       ev->pid, get_comm(ev->pid), get_reason(ev->arg));
+	else
+		printf("%-7s %6d %#lx", ev->type, ev->pid, ev->arg);
+
+	putchar('\n');
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: flightrec [options]:\n");
+	fprintf(stderr, "   --file <file>		read recorder data from file (or - for stdin)\n");
+	fprintf(stderr, "   --cpu <cpu>		only display the timeline of the given CPU\n");
+	fprintf(stderr, "   --window <usecs>	only display the events preceding the end of the record\n");
+	fprintf(stderr, "   --help		print this help\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	unsigned long long ref = 0, window = 0, last_switch = 0;
+	int c, lindex, n, nr = 0, cpu = -1, lastcpu = -1;
+	struct event *events = NULL, *ev;
+	const char *file = NULL;
+	char buf[BUFSIZ];
+	FILE *fp;
+
+	for (;;) {
+		c = getopt_long_only(argc, argv, "", base_options, &lindex);
+		if (c == EOF)
+			break;
+		if (c == '?') {
+			usage();
+			return EINVAL;
+		}
+		if (c > 0)
+			continue;
+
+		switch (lindex) {
+		case help_opt:
+			usage();
+			return 0;
+		case file_opt:
+			file = optarg;
+			break;
+		case cpu_opt:
+			cpu = atoi(optarg);
+			break;
+		case window_opt:
+			window = strtoull(optarg, NULL, 10) * 1000ULL;
+			break;
+		default:
+			return EINVAL;
+		}
+	}
+
+	fp = stdin;
+	if (file == NULL) {
+		if (isatty(fileno(stdin))) {
+			file = PROC_FLIGHTREC;
+			goto open;
+		}
+	} else if (strcmp(file, "-")) {
+	open:
+		fp = fopen(file, "r");
+		if (fp == NULL)
+			error(1, errno, "cannot open %s", file);
+	}
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (buf[0] == '#') {
+			if (strncmp(buf, "# ", 2) == 0 &&
+			    strncmp(buf + 2, "CPU", 3))
+				fputs(buf + 2, stdout);
+			continue;
+		}
+		if ((nr & (nr - 1)) == 0) {
+			events = realloc(events,
+					 (nr ? nr * 2 : 1) * sizeof(*events));
+			if (events == NULL)
+				error(1, ENOMEM, "cannot allocate event table");
+		}
+		ev = events + nr;
+		if (sscanf(buf, EVENT_FMT, &ev->cpu, &ev->seq,
+			   &ev->timestamp, ev->type, &ev->pid,
+			   &ev->arg) != EVENT_NFMT)
+			continue;
+		if (cpu >= 0 && ev->cpu != cpu)
+			continue;
+		if (ev->timestamp > ref)
+			ref = ev->timestamp;
+		nr++;
+	}
+
+	if (fp != stdin)
+		fclose(fp);
+
+	if (nr == 0) {
+		printf("no event recorded\n");
+		return 0;
+	}
+
+	/*
+	 * Dates are displayed relative to the freeze marker if any,
+	 * otherwise to the most recent event.
+	 */
+	for (n = 0; n < nr; n++)
+		if (strcmp(events[n].type, "freeze") == 0)
+			ref = events[n].timestamp;
+
+	qsort(events, nr, sizeof(*events), compare_events);
+
+	for (n = 0; n < nr; n++) {
+		ev = events + n;
+		if (ev->cpu != lastcpu) {
+			printf("\nCPU%d:\n", ev->cpu);
+			lastcpu = ev->cpu;
+			last_switch = 0;
+		}
+		if (window && ev->timestamp + window < ref) {
+			if (strcmp(ev->type, "switch") == 0)
+				last_switch = ev->timestamp;
+			continue;
+		}
+		print_event(ev, ref, &last_switch);
+	}
+
+	free(events);
+
+	return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2026 Xenomai project.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <error.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/wait.h>
+
+#define PROC_LOCKSTAT  "/proc/xenomai/lockstat"
+#define PROC_MAPS      "/proc/%d/maps"
+
+#define STAT_FMT   "%d %lx %lu %lu %lu %Lu %Lu %Lu %63s"
+#define STAT_NFMT  9
+
+struct lockstat {
+	int pid;
+	unsigned long uaddr;
+	unsigned long acquires;
+	unsigned long contended;
+	unsigned long boosts;
+	unsigned long long wait_total;
+	unsigned long long wait_max;
+	unsigned long long hold_max;
+	char name[64];
+};
+
+static const struct option base_options[] = {
+	{
+#define help_opt	0
+		.name = "help",
+		.has_arg = no_argument,
+	},
+	{
+#define top_opt		1
+		.name = "top",
+		.has_arg = required_argument,
+	},
+	{
+#define sort_opt	2
+		.name = "sort",
+		.has_arg = required_argument,
+	},
+	{
+#define reset_opt	3
+		.name = "reset",
+		.has_arg = no_argument,
+	},
+	{ /* Sentinel */ }
+};
+
+static int (*sort_fn)(const void *, const void *);
+
+static int sort_contended(const void *a, const void *b)
+{
+	const struct lockstat *l = a, *r = b;
+
+	if (l->contended != r->contended)
+		return l->contended < r->contended ? 1 : -1;
+
+	return l->wait_total < r->wait_total ? 1 :
+		l->wait_total > r->wait_total ? -1 : 0;
+}
+
+static int sort_wait(const void *a, const void *b)
+{
+	const struct lockstat *l = a, *r = b;
+
+	if (l->wait_total != r->wait_total)
+		return l->wait_total < r->wait_total ? 1 : -1;
+
+	return l->contended < r->contended ? 1 :
+		l->contended > r->contended ? -1 : 0;
+}
+
+static int sort_max(const void *a, const void *b)
+{
+	const struct lockstat *l = a, *r = b;
+
+	return l->wait_max < r->wait_max ? 1 :
+		l->wait_max > r->wait_max ? -1 : 0;
+}
+
+static int sort_hold(const void *a, const void *b)
+{
+	const struct lockstat *l = a, *r = b;
+
+	return l->hold_max < r->hold_max ? 1 :
+		l->hold_max > r->hold_max ? -1 : 0;
+}
+
+/*
+ * Non-PIE executables are linked at their run-time address, all
+ * other ELF objects are relocated from the start of their first
+ * mapping.
+ */
+static int is_relocatable(const char *path)
+{
+	Elf64_Ehdr ehdr;
+	FILE *fp;
+	int ret;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+
+	/* e_type is at the same offset for ELF32 and ELF64. */
+	ret = fread(&ehdr, sizeof(ehdr), 1, fp) == 1 &&
+		memcmp(ehdr.e_ident, ELFMAG, SELFMAG) == 0 ?
+		ehdr.e_type == ET_DYN : -1;
+
+	fclose(fp);
+
+	return ret;
+}
+
+static int find_mapping(int pid, unsigned long addr,
+			char *path, size_t len, unsigned long *base)
+{
+	unsigned long start, end, offset, first = 0;
+	char mapspath[sizeof(PROC_MAPS) + 16], buf[BUFSIZ],
+		file[BUFSIZ], last[BUFSIZ] = "";
+	int found = 0;
+	FILE *fp;
+
+	snprintf(mapspath, sizeof(mapspath), PROC_MAPS, pid);
+	fp = fopen(mapspath, "r");
+	if (fp == NULL)
+		return -errno;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "%lx-%lx %*s %lx %*s %*s %s",
+			   &start, &end, &offset, file) != 4) {
+			last[0] = '\0';
+			continue;
+		}
+		if (file[0] != '/') {
+			last[0] = '\0';
+			continue;
+		}
+		if (strcmp(file, last)) {
+			strcpy(last, file);
+			first = start - offset;
+		}
+		if (addr >= start && addr < end) {
+			snprintf(path, len, "%s", file);
+			*base = first;
+			found = 1;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	return found ? 0 : -ENOENT;
+}
+
+/*
+ * Run nm on @path, returning a stream to its output. The path comes
+ * from the maps of the inspected process, so it is passed as a plain
+ * argument, never through the shell.
+ */
+static FILE *open_nm(const char *path, pid_t *pid_r)
+{
+	char *const argv[] = {
+		"nm", "--defined-only", "--demangle", "--",
+		(char *)path, NULL
+	};
+	int pfd[2], nullfd;
+	FILE *fp;
+	pid_t pid;
+
+	if (pipe(pfd))
+		return NULL;
+
+	pid = fork();
+	if (pid < 0) {
+		close(pfd[0]);
+		close(pfd[1]);
+		return NULL;
+	}
+
+	if (pid == 0) {
+		close(pfd[0]);
+		if (dup2(pfd[1], STDOUT_FILENO) < 0)
+			_exit(127);
+		close(pfd[1]);
+		nullfd = open("/dev/null", O_WRONLY);
+		if (nullfd >= 0) {
+			dup2(nullfd, STDERR_FILENO);
+			close(nullfd);
+		}
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+
+	close(pfd[1]);
+	fp = fdopen(pfd[0], "r");
+	if (fp == NULL) {
+		close(pfd[0]);
+		waitpid(pid, NULL, 0);
+		return NULL;
+	}
+
+	*pid_r = pid;
+
+	return fp;
+}
+
+static int lookup_symbol(const char *path, unsigned long value,
+			 char *sym, size_t len)
+{
+	unsigned long symval, best = 0;
+	char buf[BUFSIZ], name[BUFSIZ];
+	int found = 0;
+	pid_t pid;
+	FILE *fp;
+	char type;
+
+	fp = open_nm(path, &pid);
+	if (fp == NULL)
+		return -errno;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "%lx %c %[^\n]", &symval, &type, name) != 3)
+			continue;
+		/* Lock objects live in data or bss sections. */
+		if (strchr("bBdDgGsS", type) == NULL)
+			continue;
+		if (symval <= value && symval >= best) {
+			best = symval;
+			if (value == symval)
+				snprintf(sym, len, "%s", name);
+			else
+				snprintf(sym, len, "%s+%#lx",
+					 name, value - symval);
+			found = 1;
+		}
+	}
+
+	fclose(fp);
+	while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+		;
+
+	return found ? 0 : -ENOENT;
+}
+
+static const char *resolve(struct lockstat *l)
+{
+	static char sym[BUFSIZ + 64];
+	unsigned long base = 0;
+	char path[BUFSIZ];
+	int ret;
+
+	/* Objects living in the heap cannot be resolved. */
+	if (l->uaddr == 0 ||
+	    find_mapping(l->pid, l->uaddr, path, sizeof(path), &base))
+		goto noname;
+
+	ret = is_relocatable(path);
+	if (ret < 0)
+		goto noname;
+
+	if (lookup_symbol(path, ret ? l->uaddr - base : l->uaddr,
+			  sym, sizeof(sym)) == 0)
+		return sym;
+noname:
+	if (l->uaddr)
+		snprintf(sym, sizeof(sym), "%s @%#lx", l->name, l->uaddr);
+	else
+		snprintf(sym, sizeof(sym), "%s", l->name);
+
+	return sym;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: lockstat [options]:\n");
+	fprintf(stderr, "--top <n>                      show the n most contended locks only\n");
+	fprintf(stderr, "--sort contend|wait|max|hold   sort order (default: contend)\n");
+	fprintf(stderr, "--reset                        clear all lock statistics\n");
+	fprintf(stderr, "--help                         print this help\n");
+}
+
+static void reset_stats(void)
+{
+	FILE *fp;
+
+	fp = fopen(PROC_LOCKSTAT, "w");
+	if (fp == NULL)
+		error(1, errno, "cannot open %s", PROC_LOCKSTAT);
+
+	fputs("0\n", fp);
+	if (fclose(fp))
+		error(1, errno, "cannot reset %s", PROC_LOCKSTAT);
+}
+
+int main(int argc, char *const argv[])
+{
+	struct lockstat *stats = NULL, *l;
+	int c, lindex, n, nr = 0, top = 10;
+	char buf[BUFSIZ];
+	FILE *fp;
+
+	sort_fn = sort_contended;
+
+	for (;;) {
+		c = getopt_long_only(argc, argv, "", base_options, &lindex);
+		if (c == EOF)
+			break;
+		if (c == '?') {
+			usage();
+			return EINVAL;
+		}
+		if (c > 0)
+			continue;
+
+		switch (lindex) {
+		case help_opt:
+			usage();
+			return 0;
+		case top_opt:
+			top = atoi(optarg);
+			break;
+		case sort_opt:
+			if (strcmp(optarg, "contend") == 0)
+				sort_fn = sort_contended;
+			else if (strcmp(optarg, "wait") == 0)
+				sort_fn = sort_wait;
+			else if (strcmp(optarg, "max") == 0)
+				sort_fn = sort_max;
+			else if (strcmp(optarg, "hold") == 0)
+				sort_fn = sort_hold;
+			else
+				error(1, EINVAL, "invalid sort key '%s'", optarg);
+			break;
+		case reset_opt:
+			reset_stats();
+			return 0;
+		default:
+			return EINVAL;
+		}
+	}
+
+	fp = fopen(PROC_LOCKSTAT, "r");
+	if (fp == NULL)
+		error(1, errno, "cannot open %s\n"
+		      "(is CONFIG_XENO_OPT_STATS_LOCK enabled?)", PROC_LOCKSTAT);
+
+	/* Skip the header line. */
+	if (fgets(buf, sizeof(buf), fp) == NULL)
+		goto done;
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		if ((nr & (nr - 1)) == 0) {
+			stats = realloc(stats, (nr ? nr * 2 : 1) * sizeof(*stats));
+			if (stats == NULL)
+				error(1, ENOMEM, "cannot allocate lock table");
+		}
+		l = stats + nr;
+		if (sscanf(buf, STAT_FMT, &l->pid, &l->uaddr,
+			   &l->acquires, &l->contended, &l->boosts,
+			   &l->wait_total, &l->wait_max, &l->hold_max,
+			   l->name) != STAT_NFMT)
+			continue;
+		nr++;
+	}
+done:
+	fclose(fp);
+
+	qsort(stats, nr, sizeof(*stats), sort_fn);
+
+	if (top <= 0 || top > nr)
+		top = nr;
+
+	printf("%-6s %-10s %-10s %-8s %-14s %-10s %-10s %s\n",
+	       "PID", "ACQUIRE", "CONTEND", "BOOST",
+	       "WAIT-TOTAL(ns)", "WAIT-MAX", "HOLD-MAX", "LOCK");
+
+	for (n = 0; n < top; n++) {
+		l = stats + n;
+		printf("%-6d %-10lu %-10lu %-8lu %-14Lu %-10Lu %-10Lu %s\n",
+		       l->pid, l->acquires, l->contended, l->boosts,
+		       l->wait_total, l->wait_max, l->hold_max, resolve(l));
+	}
+
+	free(stats);
+
+	return 0;
+}
@@ -34,6 +34,7 @@
 #include <malloc.h>
 #include <getopt.h>
 #include <signal.h>
+#include <time.h>
 
 static const struct option base_options[] = {
 	{
@@ -66,6 +67,31 @@ static const struct option base_options[] = {
 		.name = "filter-out",
 		.has_arg = required_argument,
 	},
+#define live_opt	6
+	{
+		.name = "live",
+		.has_arg = required_argument,
+	},
+#define duration_opt	7
+	{
+		.name = "duration",
+		.has_arg = required_argument,
+	},
+#define flamegraph_opt	8
+	{
+		.name = "flamegraph",
+		.has_arg = no_argument,
+	},
+#define top_opt		9
+	{
+		.name = "top",
+		.has_arg = required_argument,
+	},
+#define max_stacks_opt	10
+	{
+		.name = "max-stacks",
+		.has_arg = required_argument,
+	},
 	{ /* Sentinel */ }
 };
 
@@ -119,6 +145,26 @@ int spot_count, filtered_count = 0;
 
 const char *toolchain_prefix;
 
+/*
+ * Relax spots aggregated by call stack, for the live and flamegraph
+ * modes. The table holds max_stacks entries at most: when full, the
+ * least hit stack is evicted to make room for a new one, and its
+ * count is folded into other_hits. This bounds the memory footprint
+ * over long runs, while keeping the heavy hitters accurate.
+ */
+struct stack_entry {
+	char *key;		/* Collapsed stack, root first. */
+	const char *reason;
+	unsigned long long hits;
+	unsigned long long last_hits;
+} *stack_table;
+
+int stack_count, max_stacks = 1024;
+
+unsigned long long other_hits, lost_hits;
+
+static volatile sig_atomic_t live_done;
+
 static int filter_thread(struct filter *f, struct relax_spot *p)
 {
 	return fnmatch(f->exp, p->thread_name, 0);
@@ -347,7 +393,14 @@ static void read_spots(FILE *fp)
 		goto bad_input;
 	}
 
-	hcreate(spot_count * SIGSHADOW_BACKTRACE_DEPTH);
+	/*
+	 * The mapping cache is kept across reads in live mode, make
+	 * room for all shared objects we may ever come across.
+	 */
+	if (mapping_list == NULL) {
+		hdestroy();
+		hcreate(spot_count * SIGSHADOW_BACKTRACE_DEPTH + 4096);
+	}
 
 	for (;;) {
 		p = malloc(sizeof(*p));
@@ -498,7 +551,10 @@ static void resolve_spots(void)
 		if (ret < 0)
 			goto no_mem;
 
+		/* Locations resolved by a previous pass are skipped. */
 		for (l = m->locs, s = a2l, a2lcmd = NULL; l; l = l->next) {
+			if (l->function)
+				continue;
 			ret = asprintf(&a2lcmd, "%s 0x%lx", s, l->pc);
 			if (ret < 0)
 				goto no_mem;
@@ -506,11 +562,18 @@ static void resolve_spots(void)
 			s = a2lcmd;
 		}
 
+		if (a2lcmd == NULL) {
+			free(a2l);
+			continue;
+		}
+
 		fp = popen(a2lcmd, "r");
 		if (fp == NULL)
 			error(1, errno, "cannot run %s", a2lcmd);
 
 		for (l = m->locs; l; l = l->next) {
+			if (l->function)
+				continue;
 			ret = fscanf(fp, "%ms\n", &l->function);
 			if (ret != 1)
 				goto bad_output;
@@ -593,6 +656,257 @@ static void display_spots(void)
 		       hits, spot_count);
 }
 
+static int put_frame(char *buf, size_t len, struct backtrace *b)
+{
+	const struct location *where = b->where;
+	const char *map;
+
+	if (where->function && strcmp(where->function, "??"))
+		return snprintf(buf, len, "%s", where->function);
+
+	if (*b->mapping->name == '?')
+		return snprintf(buf, len, "0x%lx", b->pc);
+
+	map = strrchr(b->mapping->name, '/');
+	map = map ? map + 1 : b->mapping->name;
+
+	return snprintf(buf, len, "%s+0x%lx", map, b->pc);
+}
+
+/*
+ * Build the collapsed form of a call stack, as expected by the
+ * flamegraph tools: frames are separated by semi-colons, outermost
+ * first, starting with the executable name. The relax reason is
+ * appended as the leaf frame.
+ */
+static char *collapse_spot(struct relax_spot *p)
+{
+	char buf[BUFSIZ], *exe;
+	size_t len = 0;
+	int depth;
+
+	exe = strrchr(p->exe_path, '/');
+	exe = exe ? exe + 1 : p->exe_path;
+	len = snprintf(buf, sizeof(buf), "%s", exe);
+
+	for (depth = p->depth - 1; depth >= 0 && len < sizeof(buf) - 1; depth--) {
+		buf[len++] = ';';
+		len += put_frame(buf + len, sizeof(buf) - len,
+				 p->backtrace + depth);
+	}
+
+	if (len < sizeof(buf) - 1)
+		snprintf(buf + len, sizeof(buf) - len, ";[%s]", p->reason);
+
+	return strdup(buf);
+}
+
+static struct stack_entry *get_stack_entry(char *key)
+{
+	struct stack_entry *e, *victim = NULL;
+	int n;
+
+	for (n = 0, e = stack_table; n < stack_count; n++, e++) {
+		if (strcmp(e->key, key) == 0) {
+			free(key);
+			return e;
+		}
+		if (victim == NULL || e->hits < victim->hits)
+			victim = e;
+	}
+
+	if (stack_count < max_stacks) {
+		e = stack_table + stack_count++;
+		e->key = key;
+		e->hits = 0;
+		e->last_hits = 0;
+		return e;
+	}
+
+	/* Table full, evict the least hit entry. */
+	other_hits += victim->hits;
+	free(victim->key);
+	victim->key = key;
+	victim->hits = 0;
+	victim->last_hits = 0;
+
+	return victim;
+}
+
+static void aggregate_spots(void)
+{
+	struct relax_spot *p;
+	struct stack_entry *e;
+	char *key;
+	int hits;
+
+	for (p = spot_list, hits = 0; p; p = p->next) {
+		hits += p->hits;
+		if (match_filter_list(p)) {
+			filtered_count++;
+			continue;
+		}
+		key = collapse_spot(p);
+		if (key == NULL)
+			error(1, ENOMEM, "aggregate_spots failed");
+		e = get_stack_entry(key);
+		/* The reason is the leaf frame, so it is part of the key. */
+		e->reason = strrchr(e->key, ';') + 1;
+		e->hits += p->hits;
+		e->last_hits += p->hits;
+	}
+
+	if (hits < spot_count)
+		lost_hits += spot_count - hits;
+}
+
+static void free_spots(void)
+{
+	struct relax_spot *p;
+
+	while ((p = spot_list) != NULL) {
+		spot_list = p->next;
+		free(p->exe_path);
+		free(p->reason);
+		free(p->thread_name);
+		free(p);
+	}
+
+	spot_count = 0;
+}
+
+static int compare_stacks(const void *a, const void *b)
+{
+	const struct stack_entry *l = a, *r = b;
+
+	return l->hits < r->hits ? 1 : l->hits > r->hits ? -1 : 0;
+}
+
+static void display_flamegraph(void)
+{
+	struct stack_entry *e;
+	int n;
+
+	qsort(stack_table, stack_count, sizeof(*stack_table), compare_stacks);
+
+	for (n = 0, e = stack_table; n < stack_count; n++, e++)
+		printf("%s %llu\n", e->key, e->hits);
+
+	if (other_hits)
+		printf("[other] %llu\n", other_hits);
+}
+
+static void display_live(double elapsed, double interval, int top)
+{
+	unsigned long long total = other_hits, recent = 0;
+	struct stack_entry *e;
+	const char *leaf;
+	int n, len;
+
+	qsort(stack_table, stack_count, sizeof(*stack_table), compare_stacks);
+
+	for (n = 0, e = stack_table; n < stack_count; n++, e++) {
+		total += e->hits;
+		recent += e->last_hits;
+	}
+
+	fprintf(stderr, "\n--- %.0fs: %llu relaxes (%.2f/s), %llu total, "
+		"%d stacks", elapsed, recent, recent / interval,
+		total, stack_count);
+	if (lost_hits)
+		fprintf(stderr, ", %llu lost", lost_hits);
+	fprintf(stderr, "\n%10s %10s  %-24s %s\n",
+		"HITS", "RATE/s", "REASON", "SPOT");
+
+	for (n = 0, e = stack_table; n < stack_count && n < top; n++, e++) {
+		/* Show the innermost frame above the reason. */
+		len = e->reason - e->key - 1;
+		for (leaf = e->reason - 1; leaf > e->key && leaf[-1] != ';'; leaf--)
+			;
+		fprintf(stderr, "%10llu %10.2f  %-24.*s %.*s\n",
+			e->hits, e->last_hits / interval,
+			(int)strlen(e->reason) - 2, e->reason + 1,
+			(int)(e->key + len - leaf), leaf);
+	}
+
+	for (n = 0, e = stack_table; n < stack_count; n++, e++)
+		e->last_hits = 0;
+}
+
+static void flush_trace(const char *trace_file)
+{
+	FILE *fp;
+
+	/* Writing anything to the vfile clears the relax log. */
+	fp = fopen(trace_file, "w");
+	if (fp == NULL)
+		error(1, errno, "cannot clear trace file %s", trace_file);
+
+	fputs("0\n", fp);
+	fclose(fp);
+}
+
+static void live_sighandler(int sig)
+{
+	live_done = 1;
+}
+
+static void run_live(const char *trace_file, int interval,
+		     int duration, int flamegraph, int top)
+{
+	struct timespec start, now, last;
+	struct sigaction sa;
+	double elapsed;
+	FILE *fp;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = live_sighandler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	last = start;
+
+	/*
+	 * Pull and clear the relax log periodically, so that the
+	 * kernel buffer never overflows. A few spots may be logged
+	 * between the read and the flush, these are lost.
+	 */
+	for (;;) {
+		fp = fopen(trace_file, "r");
+		if (fp == NULL)
+			error(1, errno, "cannot open trace file %s",
+			      trace_file);
+		read_spots(fp);
+		fclose(fp);
+		flush_trace(trace_file);
+
+		if (spot_list) {
+			resolve_spots();
+			aggregate_spots();
+			free_spots();
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) +
+			(now.tv_nsec - start.tv_nsec) / 1e9;
+
+		if (last.tv_sec != start.tv_sec ||
+		    last.tv_nsec != start.tv_nsec || live_done)
+			display_live(elapsed, (now.tv_sec - last.tv_sec) +
+				     (now.tv_nsec - last.tv_nsec) / 1e9, top);
+		last = now;
+
+		if (live_done || (duration && elapsed >= duration))
+			break;
+
+		sleep(interval);
+	}
+
+	if (flamegraph)
+		display_flamegraph();
+}
+
 static void usage(void)
 {
 	fprintf(stderr, "usage: slackspot [CROSS_COMPILE=<toolchain-prefix>] [options]\n");
@@ -601,14 +915,19 @@ static void usage(void)
 	fprintf(stderr, "   --filter-in <name=exp[,name...]>		exclude non-matching spots\n");
 	fprintf(stderr, "   --filter <name=exp[,name...]>		alias for --filter-in\n");
 	fprintf(stderr, "   --filter-out <name=exp[,name...]>		exclude matching spots\n");
+	fprintf(stderr, "   --live <secs>				poll and aggregate spots continuously\n");
+	fprintf(stderr, "   --duration <secs>				stop polling after this delay\n");
+	fprintf(stderr, "   --flamegraph				output spots in collapsed-stack format\n");
+	fprintf(stderr, "   --top <n>					number of stacks in live reports\n");
+	fprintf(stderr, "   --max-stacks <n>				max number of stacks to track\n");
 	fprintf(stderr, "   --help					print this help\n");
 }
 
 int main(int argc, char *const argv[])
 {
+	int c, lindex, ret, live = 0, duration = 0, flamegraph = 0, top = 10;
 	const char *trace_file, *filters;
 	const char *ldpath;
-	int c, lindex, ret;
 	FILE *fp;
 
 	trace_file = NULL;
@@ -645,11 +964,49 @@ int main(int argc, char *const argv[])
 		case filter_opt:
 			filters = optarg;
 			break;
+		case live_opt:
+			live = atoi(optarg);
+			if (live <= 0)
+				error(1, EINVAL, "invalid polling interval");
+			break;
+		case duration_opt:
+			duration = atoi(optarg);
+			break;
+		case flamegraph_opt:
+			flamegraph = 1;
+			break;
+		case top_opt:
+			top = atoi(optarg);
+			break;
+		case max_stacks_opt:
+			max_stacks = atoi(optarg);
+			if (max_stacks <= 0)
+				error(1, EINVAL, "invalid stack count");
+			break;
 		default:
 			return EINVAL;
 		}
 	}
 
+	if (live || flamegraph) {
+		stack_table = malloc(max_stacks * sizeof(*stack_table));
+		if (stack_table == NULL)
+			error(1, ENOMEM, "cannot allocate stack table");
+	}
+
+	/* The live mode pulls and clears the kernel log directly. */
+	if (live) {
+		if (trace_file)
+			error(1, EINVAL, "--live excludes --file");
+		ret = build_filter_list(filters);
+		if (ret)
+			error(1, 0, "bad filter expression: %s", filters);
+		build_ldpath_list(ldpath);
+		run_live("/proc/xenomai/debug/relax", live,
+			 duration, flamegraph, top);
+		return 0;
+	}
+
 	fp = stdin;
 	if (trace_file == NULL) {
 		if (isatty(fileno(stdin))) {
@@ -677,7 +1034,12 @@ int main(int argc, char *const argv[])
 	}
 
 	resolve_spots();
-	display_spots();
+
+	if (flamegraph) {
+		aggregate_spots();
+		display_flamegraph();
+	} else
+		display_spots();
 
 	return 0;
 }